@@ -1,20 +1,24 @@
 #include "Core.h"
+#include "Threading.h"
 
 #if _WIN32
 #include <direct.h>					// for mkdir()
+#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
+#define _WIN32_WINDOWS 0x0500		// for IsDebuggerPresent()
+#include <windows.h>				// for CreateHardLink()
+#else
+#include <unistd.h>					// for link()
 #endif
 
 #include <sys/stat.h>				// for mkdir(), stat()
-
-#if VSTUDIO_INTEGRATION
-#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
-#define _WIN32_WINDOWS 0x0500		// for IsDebuggerPresent()
-#include <windows.h>
-#endif // VSTUDIO_INTEGRATION
+#include <errno.h>
 
 
 static FILE *GLogFile = NULL;
 
+static THREAD_LOCAL PrintfRedirect_t PrintfRedirect = NULL;
+static THREAD_LOCAL void *PrintfRedirectParam = NULL;
+
 void appOpenLogFile(const char *filename)
 {
 	GLogFile = fopen(filename, "a");
@@ -32,7 +36,10 @@ void appPrintf(const char *fmt, ...)
 	va_end(argptr);
 	assert(len >= 0 && len < ARRAY_COUNT(buf) - 1);
 
-	fwrite(buf, len, 1, stdout);
+	if (PrintfRedirect)
+		PrintfRedirect(buf, len, PrintfRedirectParam);
+	else
+		fwrite(buf, len, 1, stdout);
 	if (GLogFile) fwrite(buf, len, 1, GLogFile);
 
 #if VSTUDIO_INTEGRATION
@@ -42,11 +49,24 @@ void appPrintf(const char *fmt, ...)
 }
 
 
+void appSetPrintfRedirect(PrintfRedirect_t Func, void *Param)
+{
+	PrintfRedirect      = Func;
+	PrintfRedirectParam = Param;
+}
+
+void appGetPrintfRedirect(PrintfRedirect_t &Func, void *&Param)
+{
+	Func  = PrintfRedirect;
+	Param = PrintfRedirectParam;
+}
+
+
 /*-----------------------------------------------------------------------------
 	Simple error/notofication functions
 -----------------------------------------------------------------------------*/
 
-bool GIsSwError = false;			// software-gererated error
+THREAD_LOCAL bool GIsSwError = false;	// software-gererated error
 
 void appError(const char *fmt, ...)
 {
@@ -127,8 +147,8 @@ void appNotify(const char *fmt, ...)
 }
 
 
-char GErrorHistory[2048];
-static bool WasError = false;
+THREAD_LOCAL char GErrorHistory[2048];
+static THREAD_LOCAL bool WasError = false;
 
 static void LogHistory(const char *part)
 {
@@ -144,30 +164,51 @@ void appUnwindPrefix(const char *fmt)
 	WasError = false;
 }
 
+void appRethrowError(const char *History, bool IsSwError)
+{
 #if DO_GUARD
+	appStrncpyz(GErrorHistory, History, ARRAY_COUNT(GErrorHistory));
+	GIsSwError = IsSwError;
+	WasError = true;				// continue call stack of the failed thread
+	THROW;
+#else
+	appError("%s", History);
+	exit(1);
+#endif
+}
 
-void appUnwindThrow(const char *fmt, ...)
+#if DO_GUARD
+
+static void UnwindLog(const char *text)
 {
 	char buf[512];
-	va_list argptr;
-
-	va_start(argptr, fmt);
 	if (WasError)
 	{
-		strcpy(buf, " <- ");
-		vsnprintf(buf+4, ARRAY_COUNT(buf)-4, fmt, argptr);
+		appSprintf(ARRAY_ARG(buf), " <- %s", text);
 	}
 	else
 	{
-		vsnprintf(buf, ARRAY_COUNT(buf), fmt, argptr);
+		appStrncpyz(buf, text, ARRAY_COUNT(buf));
 		WasError = true;
 	}
-	va_end(argptr);
 	LogHistory(buf);
+}
+
+void appUnwindThrow(const char *fmt, ...)
+{
+	char buf[512];
+	va_list argptr;
+
+	va_start(argptr, fmt);
+	vsnprintf(ARRAY_ARG(buf), fmt, argptr);
+	va_end(argptr);
+	buf[ARRAY_COUNT(buf)-1] = 0;
+	UnwindLog(buf);
 
 	THROW;
 }
 
+
 #endif // DO_GUARD
 
 
@@ -570,6 +611,55 @@ bool appContainsWildcard(const char *string)
 	File helpers
 -----------------------------------------------------------------------------*/
 
+// Cache of already created directories: export of many files into the same directory
+// should not perform mkdir() calls for every file. Directories could be removed by someone else
+// while cached, so the cache is reset when a file couldn't be created.
+#define DIR_CACHE_HASH_SIZE		1024
+
+struct CDirCacheEntry
+{
+	CDirCacheEntry	*Next;
+	char			Name[1];		// allocated together with the structure
+};
+
+static CMemoryChain   *DirCacheMem = NULL;
+static CDirCacheEntry *DirCacheHash[DIR_CACHE_HASH_SIZE];
+static CMutex          DirCacheLock;	// files are exported from several threads
+
+static int GetDirCacheHash(const char *Name)
+{
+	unsigned hash = 0;
+	while (char c = *Name++)
+		hash = hash * 31 + (byte)c;
+	return hash & (DIR_CACHE_HASH_SIZE - 1);
+}
+
+static bool IsDirectoryCreated(const char *Name)
+{
+	for (const CDirCacheEntry *Entry = DirCacheHash[GetDirCacheHash(Name)]; Entry; Entry = Entry->Next)
+		if (!strcmp(Entry->Name, Name)) return true;
+	return false;
+}
+
+static void RegisterCreatedDirectory(const char *Name)
+{
+	if (!DirCacheMem) DirCacheMem = new CMemoryChain();
+	int len = strlen(Name);
+	CDirCacheEntry *Entry = (CDirCacheEntry*)DirCacheMem->Alloc(sizeof(CDirCacheEntry) + len);
+	memcpy(Entry->Name, Name, len + 1);
+	int hash = GetDirCacheHash(Name);
+	Entry->Next = DirCacheHash[hash];
+	DirCacheHash[hash] = Entry;
+}
+
+void appResetDirectoryCache()
+{
+	CScopeLock Lock(DirCacheLock);
+	delete DirCacheMem;
+	DirCacheMem = NULL;
+	memset(DirCacheHash, 0, sizeof(DirCacheHash));
+}
+
 void appMakeDirectory(const char *dirname)
 {
 	if (!dirname[0]) return;
@@ -579,6 +669,9 @@ void appMakeDirectory(const char *dirname)
 	appStrncpyz(Name, dirname, ARRAY_COUNT(Name));
 	appNormalizeFilename(Name);
 
+	CScopeLock Lock(DirCacheLock);
+	if (IsDirectoryCreated(Name)) return;
+
 	for (char *s = Name; /* empty */ ; s++)
 	{
 		char c = *s;
@@ -586,12 +679,17 @@ void appMakeDirectory(const char *dirname)
 			continue;
 		*s = 0;						// temporarily cut rest of path
 		// here: path delimiter or end of string
-		if (Name[0] != '.' || Name[1] != 0)		// do not create "."
+		if ((Name[0] != '.' || Name[1] != 0) && !IsDirectoryCreated(Name))	// do not create "."
+		{
 #if _WIN32
-			_mkdir(Name);
+			int res = _mkdir(Name);
 #else
-			mkdir(Name, S_IRWXU);
+			int res = mkdir(Name, S_IRWXU);
 #endif
+			// don't cache directories which failed to create, so the next call will try again
+			if (res == 0 || errno == EEXIST)
+				RegisterCreatedDirectory(Name);
+		}
 		if (!c) break;				// end of string
 		*s = '/';					// restore string (c == '/')
 	}
@@ -618,6 +716,15 @@ void appMakeDirectoryForFile(const char *filename)
 #define stat _stati64
 #endif
 
+bool appCreateHardLink(const char *target, const char *linkname)
+{
+#if _WIN32
+	return CreateHardLinkA(linkname, target, NULL) != 0;
+#else
+	return link(target, linkname) == 0;
+#endif
+}
+
 unsigned appGetFileType(const char *filename)
 {
 	char Name[256];
@@ -123,6 +123,7 @@ template<>    struct CompileTimeError<true> {};
 #	define vsnwprintf			_vsnwprintf
 #	define FORCEINLINE			__forceinline
 #	define NORETURN				__declspec(noreturn)
+#	define THREAD_LOCAL			__declspec(thread)
 #	define stricmp				_stricmp
 #	define strnicmp				_strnicmp
 #	define GCC_PACK							// VC uses #pragma pack()
@@ -157,6 +158,7 @@ typedef unsigned __int64		uint64;
 #	define vsnwprintf			swprintf
 #	define __FUNCSIG__			__PRETTY_FUNCTION__
 #	define NORETURN				__attribute__((noreturn))
+#	define THREAD_LOCAL			__thread
 #	if (__GNUC__ > 3) || ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 2))
 	// strange, but there is only way to work (inline+always_inline)
 #		define FORCEINLINE		inline __attribute__((always_inline))
@@ -273,9 +275,20 @@ inline void QSort(const char** array, int count, int (*cmpFunc)(const char**, co
 void appOpenLogFile(const char *filename);
 void appPrintf(const char *fmt, ...);
 
-extern bool GIsSwError;
+// Redirect appPrintf() output of the current thread to the callback instead of console (log file
+// still receives everything). appParallelFor() passes the redirection to its worker threads, so
+// callback should be thread-safe. Func = NULL restores console output.
+typedef void (*PrintfRedirect_t)(const char *Text, int Length, void *Param);
+void appSetPrintfRedirect(PrintfRedirect_t Func, void *Param);
+void appGetPrintfRedirect(PrintfRedirect_t &Func, void *&Param);
+
+// Error state is kept per thread, so errors in different threads don't mix
+extern THREAD_LOCAL bool GIsSwError;
+extern THREAD_LOCAL char GErrorHistory[2048];
 
 void appError(const char *fmt, ...);
+// Raise error which happened in another thread, History is GErrorHistory of that thread
+NORETURN void appRethrowError(const char *History, bool IsSwError);
 
 
 // Log some information
@@ -301,6 +314,8 @@ bool appContainsWildcard(const char *string);
 void appNormalizeFilename(char *filename);
 void appMakeDirectory(const char *dirname);
 void appMakeDirectoryForFile(const char *filename);
+// Forget directories created by appMakeDirectory(), call it when a file couldn't be created
+void appResetDirectoryCache();
 
 #define FS_FILE				1
 #define FS_DIR				2
@@ -309,6 +324,9 @@ void appMakeDirectoryForFile(const char *filename);
 // and FS_DIR if this is a directory
 unsigned appGetFileType(const char *filename);
 
+// Create additional directory entry for existing file. Both names should be on the same volume.
+bool appCreateHardLink(const char *target, const char *linkname);
+
 
 // Memory management
 
@@ -366,10 +384,8 @@ private:
 };
 
 
-#if PROFILE
-// number of dynamic allocations
+// number of dynamic allocations (including reallocations) since program start
 extern int GNumAllocs;
-#endif
 
 // static allocation stats
 extern size_t GTotalAllocationSize;
@@ -471,8 +487,6 @@ long win32ExceptFilter(struct _EXCEPTION_POINTERS *info);
 void appUnwindPrefix(const char *fmt);		// not vararg (will display function name for unguardf only)
 NORETURN void appUnwindThrow(const char *fmt, ...);
 
-extern char GErrorHistory[2048];
-
 #else  // DO_GUARD
 
 #define guard(func)		{
@@ -495,13 +509,17 @@ extern bool GUseDebugger;
 
 #if RENDERING
 #	define appMilliseconds()		SDL_GetTicks()
-#else
+#elif _WIN32
 #	ifndef WINAPI		// detect <windows.h>
 	extern "C" {
 		__declspec(dllimport) unsigned long __stdcall GetTickCount();
 	}
 #	endif
 #	define appMilliseconds()		GetTickCount()
+#else
+	// console build without SDL: use monotonic clock from Profiler.cpp
+	int64 appNanoseconds();
+#	define appMilliseconds()		((unsigned)(appNanoseconds() / 1000000))
 #endif // RENDERING
 
 
@@ -1,4 +1,5 @@
 #include "Core.h"
+#include "Threading.h"
 
 #if DEBUG_MEMORY
 #define MAX_STACK_TRACE			16
@@ -6,9 +7,7 @@
 #endif // DEBUG_MEMORY
 
 
-#if PROFILE
 int GNumAllocs = 0;
-#endif
 
 size_t GTotalAllocationSize = 0;
 int    GTotalAllocationCount = 0;
@@ -142,12 +141,10 @@ void *appMalloc(int size, int alignment)
 	hdr->stack = found;
 #endif // DEBUG_MEMORY
 
-	// statistics
-	GTotalAllocationSize += size;
-	GTotalAllocationCount++;
-#if PROFILE
-	GNumAllocs++;
-#endif
+	// statistics (allocations could be performed from worker threads)
+	appInterlockedAdd(&GTotalAllocationSize, size);
+	appInterlockedAdd(&GTotalAllocationCount, 1);
+	appInterlockedAdd(&GNumAllocs, 1);
 
 	return ptr;
 	unguardf("size=%d (total=%d Mbytes)", size, (int)(GTotalAllocationSize >> 20));
@@ -186,12 +183,10 @@ void* appRealloc(void *ptr, int newSize)
 
 	// statistics: we're allocating a new block with appMalloc, which counts statistics
 	// for this allocation, so only eliminate statistics from old memory block here
-	GTotalAllocationSize -= oldSize;
-	GTotalAllocationCount--;
+	appInterlockedAdd(&GTotalAllocationSize, (size_t)-oldSize);
+	appInterlockedAdd(&GTotalAllocationCount, -1);
 
-#if PROFILE
-	GNumAllocs++;
-#endif
+	appInterlockedAdd(&GNumAllocs, 1);
 
 	return newData;
 
@@ -215,8 +210,8 @@ void appFree(void *ptr)
 #endif
 
 	// statistics
-	GTotalAllocationSize -= hdr->blockSize;
-	GTotalAllocationCount--;
+	appInterlockedAdd(&GTotalAllocationSize, (size_t)-hdr->blockSize);
+	appInterlockedAdd(&GTotalAllocationCount, -1);
 
 	free(block);
 
@@ -232,7 +227,8 @@ void* CMemoryChain::operator new(size_t size, int dataSize)
 {
 	guard(CMemoryChain::new);
 	int alloc = Align(size + dataSize, MEM_CHUNK_SIZE);
-	CMemoryChain *chain = (CMemoryChain *) appMalloc(alloc);	//!! allocate
+	// blocks are allocated with appMalloc(), so operator delete must release them with appFree()
+	CMemoryChain *chain = (CMemoryChain *) appMalloc(alloc);
 	if (!chain)
 		appError("Failed to allocate %d bytes", alloc);
 	chain->size = alloc;
@@ -255,7 +251,7 @@ void CMemoryChain::operator delete(void *ptr)
 	{
 		// free memory block
 		next = curr->next;
-		free(curr);				//!! deallocate
+		appFree(curr);
 	}
 	unguard;
 }
@@ -0,0 +1,298 @@
+#include "Core.h"
+#include "Profiler.h"
+#include "Threading.h"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
+#include <windows.h>
+#else
+#include <time.h>					// for clock_gettime()
+#endif
+
+
+#define EVENTS_PER_BLOCK		4096
+// number of lines in printed summary
+#define MAX_SUMMARY_LINES		40
+
+
+bool GProfilerEnabled = false;
+
+int64 appNanoseconds()
+{
+#if _WIN32
+	static double Scale = 0;
+	if (!Scale)
+	{
+		LARGE_INTEGER Freq;
+		QueryPerformanceFrequency(&Freq);
+		Scale = 1e9 / Freq.QuadPart;
+	}
+	LARGE_INTEGER Counter;
+	QueryPerformanceCounter(&Counter);
+	return (int64)(Counter.QuadPart * Scale);
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+/*-----------------------------------------------------------------------------
+	Event buffers
+-----------------------------------------------------------------------------*/
+
+struct CProfileEvent
+{
+	const char		*Name;
+	const char		*Arg;
+	int64			StartTime;
+	int64			Duration;
+	int64			Bytes;
+};
+
+struct CProfileEventBlock
+{
+	CProfileEventBlock *Next;
+	int				NumEvents;
+	CProfileEvent	Events[EVENTS_PER_BLOCK];
+};
+
+// Event buffer of a single thread. Only owning thread adds events, so no locks are required.
+struct CProfileThread
+{
+	CProfileThread	*Next;
+	int				ThreadIndex;
+	CProfileEventBlock *First;
+	CProfileEventBlock *Last;
+};
+
+static THREAD_LOCAL CProfileThread *CurrentThread = NULL;
+static CProfileThread *ProfileThreads = NULL;		// list of all threads' buffers
+static int NumProfileThreads = 0;
+static CMutex *ProfileLock = NULL;					// protects ProfileThreads list
+
+static int64 ProfileStartTime;
+static char TraceFileName[256];
+
+static CProfileThread* RegisterProfileThread()
+{
+	CProfileThread *Thread = new CProfileThread;
+	Thread->First = Thread->Last = NULL;
+	CScopeLock Lock(*ProfileLock);
+	Thread->ThreadIndex = NumProfileThreads++;
+	Thread->Next = ProfileThreads;
+	ProfileThreads = Thread;
+	return Thread;
+}
+
+void appAddProfileEvent(const char *Name, const char *Arg, int64 StartTime, int64 Bytes)
+{
+	int64 EndTime = appNanoseconds();
+	CProfileThread *Thread = CurrentThread;
+	if (!Thread)
+		Thread = CurrentThread = RegisterProfileThread();
+	CProfileEventBlock *Block = Thread->Last;
+	if (!Block || Block->NumEvents >= EVENTS_PER_BLOCK)
+	{
+		// allocate a new block
+		CProfileEventBlock *NewBlock = (CProfileEventBlock*)appMalloc(sizeof(CProfileEventBlock));
+		NewBlock->Next = NULL;
+		NewBlock->NumEvents = 0;
+		if (Block)
+			Block->Next = NewBlock;
+		else
+			Thread->First = NewBlock;
+		Thread->Last = Block = NewBlock;
+	}
+	CProfileEvent &E = Block->Events[Block->NumEvents++];
+	E.Name      = Name;
+	E.Arg       = Arg;
+	E.StartTime = StartTime;
+	E.Duration  = EndTime - StartTime;
+	E.Bytes     = Bytes;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Start/stop
+-----------------------------------------------------------------------------*/
+
+static void StopProfilerAtExit()
+{
+	appStopProfiler();
+}
+
+// Note: profiler could be started only once
+void appStartProfiler(const char *FileName)
+{
+	if (ProfileLock) return;
+	ProfileLock = new CMutex;
+	atexit(StopProfilerAtExit);
+	appStrncpyz(TraceFileName, FileName, ARRAY_COUNT(TraceFileName));
+	ProfileStartTime = appNanoseconds();
+	GProfilerEnabled = true;
+}
+
+static void WriteJsonString(FILE *f, const char *Str)
+{
+	fputc('"', f);
+	for (const char *s = Str; *s; s++)
+	{
+		char c = *s;
+		if (c == '"' || c == '\\')
+			fputc('\\', f);
+		else if ((byte)c < ' ')
+			c = ' ';
+		fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static void WriteTrace()
+{
+	FILE *f = fopen(TraceFileName, "w");
+	if (!f)
+	{
+		appPrintf("ERROR: unable to create profiler trace file \"%s\"\n", TraceFileName);
+		return;
+	}
+	fprintf(f, "{\"traceEvents\":[\n");
+	bool First = true;
+	for (CProfileThread *Thread = ProfileThreads; Thread; Thread = Thread->Next)
+	{
+		for (CProfileEventBlock *Block = Thread->First; Block; Block = Block->Next)
+		{
+			for (int i = 0; i < Block->NumEvents; i++)
+			{
+				const CProfileEvent &E = Block->Events[i];
+				if (!First) fprintf(f, ",\n");
+				First = false;
+				// time is in microseconds
+				fprintf(f, "{\"name\":");
+				WriteJsonString(f, E.Name);
+				fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+					Thread->ThreadIndex, (E.StartTime - ProfileStartTime) / 1000.0, E.Duration / 1000.0);
+				if (E.Arg || E.Bytes)
+				{
+					fprintf(f, ",\"args\":{");
+					if (E.Arg)
+					{
+						fprintf(f, "\"arg\":");
+						WriteJsonString(f, E.Arg);
+					}
+					if (E.Bytes)
+						fprintf(f, "%s\"bytes\":%lld", E.Arg ? "," : "", (long long)E.Bytes);
+					fputc('}', f);
+				}
+				fputc('}', f);
+			}
+		}
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(f);
+	appPrintf("Profiler trace saved to %s\n", TraceFileName);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Summary
+-----------------------------------------------------------------------------*/
+
+#define SUMMARY_HASH_SIZE		1024
+
+struct CProfileSummaryItem
+{
+	const char		*Name;
+	const char		*Arg;
+	int				Count;
+	int64			Time;
+	int64			Bytes;
+	CProfileSummaryItem *HashNext;
+};
+
+static int CompareSummaryItems(const void *p1, const void *p2)
+{
+	int64 t1 = (*(const CProfileSummaryItem**)p1)->Time;
+	int64 t2 = (*(const CProfileSummaryItem**)p2)->Time;
+	return (t1 < t2) ? 1 : (t1 > t2) ? -1 : 0;
+}
+
+static void PrintSummary()
+{
+	CMemoryChain *Mem = new CMemoryChain;
+	CProfileSummaryItem *Hash[SUMMARY_HASH_SIZE];
+	memset(Hash, 0, sizeof(Hash));
+	int NumItems = 0;
+
+	// group events by name and argument
+	for (CProfileThread *Thread = ProfileThreads; Thread; Thread = Thread->Next)
+	{
+		for (CProfileEventBlock *Block = Thread->First; Block; Block = Block->Next)
+		{
+			for (int i = 0; i < Block->NumEvents; i++)
+			{
+				const CProfileEvent &E = Block->Events[i];
+				const char *Arg = E.Arg ? E.Arg : "";
+				unsigned h = 0;
+				for (const char *s = E.Name; *s; s++) h = h * 31 + *s;
+				for (const char *s = Arg; *s; s++) h = h * 31 + *s;
+				h &= SUMMARY_HASH_SIZE - 1;
+				CProfileSummaryItem *Item;
+				for (Item = Hash[h]; Item; Item = Item->HashNext)
+				{
+					if (!strcmp(Item->Name, E.Name) && !strcmp(Item->Arg, Arg))
+						break;
+				}
+				if (!Item)
+				{
+					Item = (CProfileSummaryItem*)Mem->Alloc(sizeof(CProfileSummaryItem));
+					memset(Item, 0, sizeof(CProfileSummaryItem));
+					Item->Name = E.Name;
+					Item->Arg  = Arg;
+					Item->HashNext = Hash[h];
+					Hash[h] = Item;
+					NumItems++;
+				}
+				Item->Count++;
+				Item->Time  += E.Duration;
+				Item->Bytes += E.Bytes;
+			}
+		}
+	}
+
+	if (NumItems)
+	{
+		// sort by time
+		CProfileSummaryItem **Items = (CProfileSummaryItem**)Mem->Alloc(sizeof(CProfileSummaryItem*) * NumItems);
+		int n = 0;
+		for (int h = 0; h < SUMMARY_HASH_SIZE; h++)
+			for (CProfileSummaryItem *Item = Hash[h]; Item; Item = Item->HashNext)
+				Items[n++] = Item;
+		qsort(Items, NumItems, sizeof(Items[0]), CompareSummaryItems);
+
+		appPrintf("\nProfiler summary (inclusive time, %d threads):\n", NumProfileThreads);
+		appPrintf("%-16s %-32s %8s %10s %10s\n", "Scope", "Argument", "Count", "Time, ms", "MBytes");
+		for (int i = 0; i < NumItems && i < MAX_SUMMARY_LINES; i++)
+		{
+			const CProfileSummaryItem *Item = Items[i];
+			appPrintf("%-16s %-32s %8d %10.2f %10.2f\n", Item->Name, Item->Arg, Item->Count,
+				Item->Time / 1e6, Item->Bytes / (1024.0 * 1024.0));
+		}
+		if (NumItems > MAX_SUMMARY_LINES)
+			appPrintf("... %d more lines\n", NumItems - MAX_SUMMARY_LINES);
+	}
+
+	delete Mem;
+}
+
+
+void appStopProfiler()
+{
+	if (!GProfilerEnabled) return;
+	GProfilerEnabled = false;
+
+	CScopeLock Lock(*ProfileLock);
+	WriteTrace();
+	PrintSummary();
+}
@@ -0,0 +1,59 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+/*-----------------------------------------------------------------------------
+	Runtime scoped profiler
+-----------------------------------------------------------------------------*/
+
+// Profiler is disabled by default and enabled with appStartProfiler() call (-profile=file
+// command line option). When enabled, every PROFILE_SCOPE block records an event to the
+// thread's event buffer. When application exits, all events are written to the file in
+// Chrome trace format (could be opened with chrome://tracing or ui.perfetto.dev), and time
+// summary is printed to the log.
+
+// Monotonic clock
+int64 appNanoseconds();
+
+extern bool GProfilerEnabled;
+
+void appStartProfiler(const char *TraceFileName);
+// Write trace file and print summary; called automatically at exit. Events recorded after this
+// call are dropped.
+void appStopProfiler();
+
+// Record a finished event. Name should be a static string, Arg - static or pooled string
+// (for example, class or package name), it is used for grouping events in summary.
+void appAddProfileEvent(const char *Name, const char *Arg, int64 StartTime, int64 Bytes);
+
+class CProfileScope
+{
+public:
+	FORCEINLINE CProfileScope(const char *InName, const char *InArg = NULL, int64 InBytes = 0)
+	:	Name(InName)
+	,	Arg(InArg)
+	,	Bytes(InBytes)
+	{
+		if (GProfilerEnabled) StartTime = appNanoseconds();
+	}
+	FORCEINLINE ~CProfileScope()
+	{
+		if (GProfilerEnabled) appAddProfileEvent(Name, Arg, StartTime, Bytes);
+	}
+	// Set amount of processed data, when it is not known at the start of the scope
+	FORCEINLINE void SetBytes(int64 InBytes)
+	{
+		Bytes = InBytes;
+	}
+
+private:
+	const char	*Name;
+	const char	*Arg;
+	int64		Bytes;
+	int64		StartTime;
+};
+
+#define PROFILE_SCOPE(...)			CProfileScope _ProfileScope(__VA_ARGS__)
+#define PROFILE_SCOPE_BYTES(Bytes)	_ProfileScope.SetBytes(Bytes)
+
+
+#endif // __PROFILER_H__
@@ -0,0 +1,361 @@
+#include "Core.h"
+#include "Threading.h"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>					// for sysconf()
+#endif
+
+
+// upper limit for number of threads used by appParallelFor()
+#define MAX_WORKER_THREADS		16
+
+
+int GNumThreads = 0;
+
+int appGetNumCores()
+{
+	static int NumCores = 0;
+	if (!NumCores)
+	{
+#if _WIN32
+		SYSTEM_INFO Info;
+		GetSystemInfo(&Info);
+		NumCores = Info.dwNumberOfProcessors;
+#else
+		NumCores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (NumCores < 1) NumCores = 1;
+	}
+	return NumCores;
+}
+
+int appGetNumWorkerThreads()
+{
+#if DEBUG_MEMORY
+	// memory debugger is not thread-safe
+	return 1;
+#else
+	int NumThreads = (GNumThreads > 0) ? GNumThreads : appGetNumCores();
+	return min(NumThreads, MAX_WORKER_THREADS);
+#endif
+}
+
+
+/*-----------------------------------------------------------------------------
+	Synchronization primitives
+-----------------------------------------------------------------------------*/
+
+#if _WIN32
+
+CMutex::CMutex()
+{
+	CRITICAL_SECTION* cs = new CRITICAL_SECTION;
+	InitializeCriticalSection(cs);
+	Handle = cs;
+}
+
+CMutex::~CMutex()
+{
+	CRITICAL_SECTION* cs = (CRITICAL_SECTION*)Handle;
+	DeleteCriticalSection(cs);
+	delete cs;
+}
+
+void CMutex::Lock()
+{
+	EnterCriticalSection((CRITICAL_SECTION*)Handle);
+}
+
+void CMutex::Unlock()
+{
+	LeaveCriticalSection((CRITICAL_SECTION*)Handle);
+}
+
+CSemaphore::CSemaphore(int InitialCount)
+{
+	Handle = CreateSemaphore(NULL, InitialCount, 0x7FFFFFFF, NULL);
+	if (!Handle) appError("Unable to create semaphore");
+}
+
+CSemaphore::~CSemaphore()
+{
+	CloseHandle((HANDLE)Handle);
+}
+
+void CSemaphore::Post()
+{
+	ReleaseSemaphore((HANDLE)Handle, 1, NULL);
+}
+
+void CSemaphore::Wait()
+{
+	WaitForSingleObject((HANDLE)Handle, INFINITE);
+}
+
+#else // _WIN32
+
+CMutex::CMutex()
+{
+	pthread_mutex_t* m = new pthread_mutex_t;
+	pthread_mutex_init(m, NULL);
+	Handle = m;
+}
+
+CMutex::~CMutex()
+{
+	pthread_mutex_t* m = (pthread_mutex_t*)Handle;
+	pthread_mutex_destroy(m);
+	delete m;
+}
+
+void CMutex::Lock()
+{
+	pthread_mutex_lock((pthread_mutex_t*)Handle);
+}
+
+void CMutex::Unlock()
+{
+	pthread_mutex_unlock((pthread_mutex_t*)Handle);
+}
+
+// POSIX unnamed semaphores are not available on all platforms, so use condition variable
+struct CSemaphoreData
+{
+	pthread_mutex_t	Mutex;
+	pthread_cond_t	Cond;
+	int				Count;
+};
+
+CSemaphore::CSemaphore(int InitialCount)
+{
+	CSemaphoreData* d = new CSemaphoreData;
+	pthread_mutex_init(&d->Mutex, NULL);
+	pthread_cond_init(&d->Cond, NULL);
+	d->Count = InitialCount;
+	Handle = d;
+}
+
+CSemaphore::~CSemaphore()
+{
+	CSemaphoreData* d = (CSemaphoreData*)Handle;
+	pthread_cond_destroy(&d->Cond);
+	pthread_mutex_destroy(&d->Mutex);
+	delete d;
+}
+
+void CSemaphore::Post()
+{
+	CSemaphoreData* d = (CSemaphoreData*)Handle;
+	pthread_mutex_lock(&d->Mutex);
+	d->Count++;
+	pthread_cond_signal(&d->Cond);
+	pthread_mutex_unlock(&d->Mutex);
+}
+
+void CSemaphore::Wait()
+{
+	CSemaphoreData* d = (CSemaphoreData*)Handle;
+	pthread_mutex_lock(&d->Mutex);
+	while (d->Count <= 0)
+		pthread_cond_wait(&d->Cond, &d->Mutex);
+	d->Count--;
+	pthread_mutex_unlock(&d->Mutex);
+}
+
+#endif // _WIN32
+
+
+/*-----------------------------------------------------------------------------
+	Threads
+-----------------------------------------------------------------------------*/
+
+struct CThreadStartInfo
+{
+	ThreadFunc_t	Func;
+	void*			Param;
+};
+
+#if _WIN32
+
+static DWORD WINAPI ThreadStart(LPVOID Param)
+{
+	CThreadStartInfo Info = *(CThreadStartInfo*)Param;
+	delete (CThreadStartInfo*)Param;
+	Info.Func(Info.Param);
+	return 0;
+}
+
+#else
+
+static void* ThreadStart(void* Param)
+{
+	CThreadStartInfo Info = *(CThreadStartInfo*)Param;
+	delete (CThreadStartInfo*)Param;
+	Info.Func(Info.Param);
+	return NULL;
+}
+
+#endif // _WIN32
+
+bool appCreateThread(ThreadFunc_t Func, void *Param)
+{
+	CThreadStartInfo* Info = new CThreadStartInfo;
+	Info->Func  = Func;
+	Info->Param = Param;
+#if _WIN32
+	HANDLE Thread = CreateThread(NULL, 0, ThreadStart, Info, 0, NULL);
+	if (Thread)
+	{
+		CloseHandle(Thread);
+		return true;
+	}
+#else
+	pthread_t Thread;
+	if (pthread_create(&Thread, NULL, ThreadStart, Info) == 0)
+	{
+		pthread_detach(Thread);
+		return true;
+	}
+#endif
+	delete Info;
+	return false;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Parallel loop
+-----------------------------------------------------------------------------*/
+
+struct CParallelForContext
+{
+	ParallelForCallback_t Callback;
+	void*			Param;
+	int				Count;
+	volatile int	NextIndex;
+	volatile int	Failed;
+	PrintfRedirect_t PrintfRedirect;	// output redirection of the calling thread
+	void*			PrintfRedirectParam;
+	// error of the first failed item, passed to the calling thread
+	CMutex			ErrorLock;
+	char			ErrorHistory[2048];
+	bool			IsSwError;
+};
+
+// Separate function: no objects with destructors are allowed in a function with SEH blocks
+static void SaveParallelForError(CParallelForContext* Context)
+{
+	// keep the first error only, error message is in GErrorHistory of this thread
+	CScopeLock Lock(Context->ErrorLock);
+	if (!Context->Failed)
+	{
+		appStrncpyz(Context->ErrorHistory, GErrorHistory, ARRAY_COUNT(Context->ErrorHistory));
+		Context->IsSwError = GIsSwError;
+		Context->Failed = 1;
+	}
+}
+
+static void ParallelForThread(CParallelForContext* Context)
+{
+	appSetPrintfRedirect(Context->PrintfRedirect, Context->PrintfRedirectParam);
+	while (!Context->Failed)
+	{
+		int Index = appInterlockedAdd(&Context->NextIndex, 1) - 1;
+		if (Index >= Context->Count) break;
+#if DO_GUARD
+		TRY
+		{
+			Context->Callback(Index, Context->Param);
+		}
+		CATCH
+		{
+			// stop processing remaining items
+			SaveParallelForError(Context);
+			GErrorHistory[0] = 0;
+			GIsSwError = false;
+		}
+#else
+		Context->Callback(Index, Context->Param);		// appError() terminates the program
+#endif
+	}
+}
+
+#if _WIN32
+
+static DWORD WINAPI ThreadFunc(LPVOID Param)
+{
+	ParallelForThread((CParallelForContext*)Param);
+	return 0;
+}
+
+#else
+
+static void* ThreadFunc(void* Param)
+{
+	ParallelForThread((CParallelForContext*)Param);
+	return NULL;
+}
+
+#endif // _WIN32
+
+void appParallelForWorker(int Count, ParallelForCallback_t Callback, void *Param)
+{
+	guard(appParallelFor);
+
+	int NumThreads = min(appGetNumWorkerThreads(), Count);
+	if (NumThreads <= 1)
+	{
+		// execute everything in the calling thread
+		for (int i = 0; i < Count; i++)
+			Callback(i, Param);
+		return;
+	}
+
+	CParallelForContext Context;
+	Context.Callback  = Callback;
+	Context.Param     = Param;
+	Context.Count     = Count;
+	Context.NextIndex = 0;
+	Context.Failed    = 0;
+	appGetPrintfRedirect(Context.PrintfRedirect, Context.PrintfRedirectParam);
+
+	// start extra threads, calling thread will work too
+#if _WIN32
+	HANDLE Threads[MAX_WORKER_THREADS];
+#else
+	pthread_t Threads[MAX_WORKER_THREADS];
+#endif
+	int NumStarted = 0;
+	for (int i = 1; i < NumThreads; i++)
+	{
+#if _WIN32
+		HANDLE Thread = CreateThread(NULL, 0, ThreadFunc, &Context, 0, NULL);
+		if (!Thread) break;
+		Threads[NumStarted++] = Thread;
+#else
+		if (pthread_create(&Threads[NumStarted], NULL, ThreadFunc, &Context) != 0) break;
+		NumStarted++;
+#endif
+	}
+
+	ParallelForThread(&Context);
+
+	// wait for completion
+	for (int i = 0; i < NumStarted; i++)
+	{
+#if _WIN32
+		WaitForSingleObject(Threads[i], INFINITE);
+		CloseHandle(Threads[i]);
+#else
+		pthread_join(Threads[i], NULL);
+#endif
+	}
+
+	if (Context.Failed)
+		appRethrowError(Context.ErrorHistory, Context.IsSwError);
+
+	unguard;
+}
@@ -0,0 +1,126 @@
+#ifndef __THREADING_H__
+#define __THREADING_H__
+
+/*-----------------------------------------------------------------------------
+	Atomic operations
+-----------------------------------------------------------------------------*/
+
+// Returns new value
+#if _MSC_VER
+
+FORCEINLINE int appInterlockedAdd(volatile int *Value, int Add)
+{
+	return _InterlockedExchangeAdd((volatile long*)Value, Add) + Add;
+}
+
+FORCEINLINE size_t appInterlockedAdd(volatile size_t *Value, size_t Add)
+{
+#ifdef _WIN64
+	return _InterlockedExchangeAdd64((volatile __int64*)Value, Add) + Add;
+#else
+	return _InterlockedExchangeAdd((volatile long*)Value, Add) + Add;
+#endif
+}
+
+#else // _MSC_VER
+
+FORCEINLINE int appInterlockedAdd(volatile int *Value, int Add)
+{
+	return __sync_add_and_fetch(Value, Add);
+}
+
+FORCEINLINE size_t appInterlockedAdd(volatile size_t *Value, size_t Add)
+{
+	return __sync_add_and_fetch(Value, Add);
+}
+
+#endif // _MSC_VER
+
+
+/*-----------------------------------------------------------------------------
+	Synchronization primitives
+-----------------------------------------------------------------------------*/
+
+class CMutex
+{
+public:
+	CMutex();
+	~CMutex();
+	void Lock();
+	void Unlock();
+
+private:
+	void*		Handle;
+};
+
+class CScopeLock
+{
+public:
+	CScopeLock(CMutex &InMutex)
+	:	Mutex(InMutex)
+	{
+		Mutex.Lock();
+	}
+	~CScopeLock()
+	{
+		Mutex.Unlock();
+	}
+
+private:
+	CMutex		&Mutex;
+};
+
+// Counting semaphore
+class CSemaphore
+{
+public:
+	CSemaphore(int InitialCount = 0);
+	~CSemaphore();
+	// Increment counter, wake up one waiting thread
+	void Post();
+	// Wait until counter is positive, then decrement it
+	void Wait();
+
+private:
+	void*		Handle;
+};
+
+
+/*-----------------------------------------------------------------------------
+	Threads
+-----------------------------------------------------------------------------*/
+
+typedef void (*ThreadFunc_t)(void*);
+
+// Start a detached thread which executes Func(Param). Returns false when thread could not be created.
+bool appCreateThread(ThreadFunc_t Func, void *Param);
+
+
+/*-----------------------------------------------------------------------------
+	Parallel loop
+-----------------------------------------------------------------------------*/
+
+// Maximal number of threads used by appParallelFor(), 0 = use all available cores.
+// Value 1 disables multithreading.
+extern int GNumThreads;
+
+int appGetNumCores();
+// Returns number of threads which will be used by appParallelFor()
+int appGetNumWorkerThreads();
+
+typedef void (*ParallelForCallback_t)(int, void*);
+void appParallelForWorker(int Count, ParallelForCallback_t Callback, void *Param);
+
+// Execute Callback(Index, Param) for every Index in range [0 .. Count-1] using all worker
+// threads. Items are dispatched in increasing order, but could be completed in any order.
+// Function returns when all items are processed. Callback should not access shared data
+// without synchronization; note that va() and some other functions with static buffers
+// are not thread-safe. Error in any callback is rethrown in the calling thread.
+template<typename T>
+FORCEINLINE void appParallelFor(int Count, void (*Callback)(int, T&), T& Param)
+{
+	appParallelForWorker(Count, (ParallelForCallback_t)Callback, &Param);
+}
+
+
+#endif // __THREADING_H__
@@ -0,0 +1,698 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#include "UnObject.h"
+#include "UnMaterial.h"
+
+#include "SkeletalMesh.h"
+#include "StaticMesh.h"
+
+#include "Exporters.h"
+
+/*
+	glTF 2.0 binary (glb) exporter.
+
+	Vertex data is not welded and not converted: vertex arrays of CSkelMeshLod and CStaticMeshLod
+	are written once as interleaved buffer views, index buffers are written as is. Skinning data is
+	the only converted stream, see CGltfInfluence. Packed normals are
+	stored as normalized bytes, which requires KHR_mesh_quantization extension. Conversion from
+	Unreal (left-handed, Z up) to glTF (right-handed, Y up) coordinate system is performed with
+	transform of the root node, so vertex data keeps original winding order.
+*/
+
+#define GLB_MAGIC				BYTES4('g','l','T','F')
+#define GLB_VERSION				2
+#define GLB_CHUNK_JSON			BYTES4('J','S','O','N')
+#define GLB_CHUNK_BIN			BYTES4('B','I','N',0)
+
+// glTF component types
+#define GLTF_BYTE				5120
+#define GLTF_UNSIGNED_BYTE		5121
+#define GLTF_UNSIGNED_SHORT		5123
+#define GLTF_UNSIGNED_INT		5125
+#define GLTF_FLOAT				5126
+
+// glTF buffer view targets
+#define GLTF_ARRAY_BUFFER			34962
+#define GLTF_ELEMENT_ARRAY_BUFFER	34963
+
+// Swap Y and Z axes: Unreal -> glTF coordinates (column-major matrix)
+static const float RootMatrix[16] =
+{
+	1, 0, 0, 0,
+	0, 0, 1, 0,
+	0, 1, 0, 0,
+	0, 0, 0, 1
+};
+
+
+/*-----------------------------------------------------------------------------
+	glb file writer
+-----------------------------------------------------------------------------*/
+
+struct CGltfBufferView
+{
+	const void		*Data;
+	int				Size;
+	int				Offset;				// offset in BIN chunk
+};
+
+class CGltfWriter
+{
+public:
+	// JSON sections, filled by exporter
+	FMemWriter		Nodes;
+	FMemWriter		Meshes;
+	FMemWriter		Materials;
+	FMemWriter		Skins;
+	FMemWriter		Animations;
+
+	bool			UseQuantization;
+
+	CGltfWriter()
+	:	UseQuantization(false)
+	,	NumNodes(0)
+	,	NumAccessors(0)
+	,	BinSize(0)
+	{
+		TempData = new CMemoryChain;
+	}
+
+	~CGltfWriter()
+	{
+		delete TempData;
+	}
+
+	// Allocate memory for data which should be converted before writing. Memory is released
+	// after the file is saved.
+	void* AllocTemp(int Size)
+	{
+		return TempData->Alloc(Size, 16);
+	}
+
+	// Register data block for BIN chunk. Data is not copied, so it should remain valid until
+	// Save() call. Returns buffer view index.
+	int AddBufferView(const void *Data, int Size, int Stride = 0, int Target = 0)
+	{
+		CGltfBufferView *View = new (Views) CGltfBufferView;
+		View->Data   = Data;
+		View->Size   = Size;
+		View->Offset = BinSize;
+		BinSize = Align(BinSize + Size, 4);
+
+		Item(BufferViews).Printf("{\"buffer\":0,\"byteOffset\":%d,\"byteLength\":%d", View->Offset, Size);
+		if (Stride) BufferViews.Printf(",\"byteStride\":%d", Stride);
+		if (Target) BufferViews.Printf(",\"target\":%d", Target);
+		BufferViews.Printf("}");
+		return Views.Num() - 1;
+	}
+
+	// Returns accessor index. MinMax has 2*NumComponents values, it is required for POSITION
+	// attributes and for animation time values.
+	int AddAccessor(int BufferView, int Offset, int ComponentType, int Count, const char *Type,
+		bool Normalized = false, const float *MinMax = NULL)
+	{
+		Item(Accessors).Printf("{\"bufferView\":%d,\"byteOffset\":%d,\"componentType\":%d,\"count\":%d,\"type\":\"%s\"",
+			BufferView, Offset, ComponentType, Count, Type);
+		if (Normalized) Accessors.Printf(",\"normalized\":true");
+		if (MinMax)
+		{
+			int NumComponents = !strcmp(Type, "SCALAR") ? 1 : Type[3] - '0';	// VECn
+			Accessors.Printf(",\"min\":");
+			WriteFloats(Accessors, MinMax, NumComponents);
+			Accessors.Printf(",\"max\":");
+			WriteFloats(Accessors, MinMax + NumComponents, NumComponents);
+		}
+		Accessors.Printf("}");
+		return NumAccessors++;
+	}
+
+	// Begin a new node description, returns node index
+	int BeginNode(const char *Name)
+	{
+		Item(Nodes).Printf("{\"name\":");
+		WriteString(Nodes, Name);
+		return NumNodes++;
+	}
+
+	// Write comma separator when section already has items
+	static FArchive& Item(FMemWriter &Section)
+	{
+		if (Section.Tell()) Section.Printf(",");
+		return Section;
+	}
+
+	static void WriteString(FArchive &Ar, const char *Str)
+	{
+		char Buffer[1024];
+		char *d = Buffer;
+		*d++ = '"';
+		for (const char *s = Str; *s && d < Buffer + ARRAY_COUNT(Buffer) - 3; s++)
+		{
+			char c = *s;
+			if (c == '"' || c == '\\')
+				*d++ = '\\';
+			else if ((byte)c < 32)
+				c = ' ';
+			*d++ = c;
+		}
+		*d++ = '"';
+		Ar.Serialize(Buffer, d - Buffer);
+	}
+
+	static void WriteFloats(FArchive &Ar, const float *Values, int Count)
+	{
+		Ar.Printf("[");
+		for (int i = 0; i < Count; i++)
+			Ar.Printf(i ? ",%.9g" : "%.9g", Values[i]);
+		Ar.Printf("]");
+	}
+
+	void Save(FArchive &Ar)
+	{
+		guard(CGltfWriter::Save);
+
+		// build JSON
+		FMemWriter Json;
+		Json.Printf("{\"asset\":{\"version\":\"2.0\",\"generator\":\"UE Viewer\"}");
+		if (UseQuantization)
+			Json.Printf(",\"extensionsUsed\":[\"KHR_mesh_quantization\"],\"extensionsRequired\":[\"KHR_mesh_quantization\"]");
+		Json.Printf(",\"scene\":0,\"scenes\":[{\"nodes\":[0]}]");
+		WriteSection(Json, "nodes",       Nodes);
+		WriteSection(Json, "meshes",      Meshes);
+		WriteSection(Json, "materials",   Materials);
+		WriteSection(Json, "skins",       Skins);
+		WriteSection(Json, "animations",  Animations);
+		WriteSection(Json, "accessors",   Accessors);
+		WriteSection(Json, "bufferViews", BufferViews);
+		if (BinSize)
+			Json.Printf(",\"buffers\":[{\"byteLength\":%d}]", BinSize);
+		Json.Printf("}");
+		// JSON chunk is padded with spaces
+		while (Json.Tell() & 3)
+			Json.Printf(" ");
+
+		uint32 Header[3], ChunkHeader[2];
+		int JsonSize = Json.Tell();
+		Header[0] = GLB_MAGIC;
+		Header[1] = GLB_VERSION;
+		Header[2] = 12 + 8 + JsonSize + (BinSize ? 8 + BinSize : 0);
+		Ar.Serialize(Header, sizeof(Header));
+
+		ChunkHeader[0] = JsonSize;
+		ChunkHeader[1] = GLB_CHUNK_JSON;
+		Ar.Serialize(ChunkHeader, sizeof(ChunkHeader));
+		Json.WriteTo(Ar);
+
+		if (!BinSize) return;
+
+		// BIN chunk, data is written directly from source arrays
+		ChunkHeader[0] = BinSize;
+		ChunkHeader[1] = GLB_CHUNK_BIN;
+		Ar.Serialize(ChunkHeader, sizeof(ChunkHeader));
+		for (int i = 0; i < Views.Num(); i++)
+		{
+			const CGltfBufferView &View = Views[i];
+			assert(Ar.Tell() == 12 + 8 + JsonSize + 8 + View.Offset);
+			Ar.Serialize(const_cast<void*>(View.Data), View.Size);
+			static byte Padding[4] = { 0, 0, 0, 0 };
+			int PadSize = Align(View.Size, 4) - View.Size;
+			if (PadSize) Ar.Serialize(Padding, PadSize);
+		}
+
+		unguard;
+	}
+
+protected:
+	FMemWriter		Accessors;
+	FMemWriter		BufferViews;
+	int				NumNodes;
+	int				NumAccessors;
+	TArray<CGltfBufferView> Views;
+	int				BinSize;
+	CMemoryChain	*TempData;
+
+	static void WriteSection(FArchive &Ar, const char *Name, FMemWriter &Section)
+	{
+		if (!Section.Tell()) return;
+		Ar.Printf(",\"%s\":[", Name);
+		Section.WriteTo(Ar);
+		Ar.Printf("]");
+	}
+};
+
+
+/*-----------------------------------------------------------------------------
+	Mesh export
+-----------------------------------------------------------------------------*/
+
+static void ExportMeshPrimitives(CGltfWriter &W, const char *Name, const CBaseMeshLod &Lod,
+	const CMeshVertex *Verts, int VertexSize, int JointsAccessor, int WeightsAccessor)
+{
+	guard(ExportMeshPrimitives);
+
+	int i;
+
+	// interleaved vertex data
+	int VertView = W.AddBufferView(Verts, Lod.NumVerts * VertexSize, VertexSize, GLTF_ARRAY_BUFFER);
+
+	float Bounds[6];
+	Bounds[0] = Bounds[1] = Bounds[2] = Lod.NumVerts ? 1e30f : 0;
+	Bounds[3] = Bounds[4] = Bounds[5] = Lod.NumVerts ? -1e30f : 0;
+	for (i = 0; i < Lod.NumVerts; i++)
+	{
+		const CMeshVertex &V = *(const CMeshVertex*)OffsetPointer(Verts, i * VertexSize);
+		for (int j = 0; j < 3; j++)
+		{
+			float f = V.Position.v[j];
+			if (f < Bounds[j])     Bounds[j]     = f;
+			if (f > Bounds[j + 3]) Bounds[j + 3] = f;
+		}
+	}
+
+	int PosAccessor = W.AddAccessor(VertView, offsetof(CMeshVertex, Position), GLTF_FLOAT, Lod.NumVerts, "VEC3", false, Bounds);
+	int NormAccessor = -1;
+	if (Lod.HasNormals)
+	{
+		// CPackedNormal stores normal as signed bytes, the same as KHR_mesh_quantization format
+		NormAccessor = W.AddAccessor(VertView, offsetof(CMeshVertex, Normal), GLTF_BYTE, Lod.NumVerts, "VEC3", true);
+		W.UseQuantization = true;
+	}
+	int UVAccessors[MAX_MESH_UV_SETS];
+	UVAccessors[0] = W.AddAccessor(VertView, offsetof(CMeshVertex, UV), GLTF_FLOAT, Lod.NumVerts, "VEC2");
+	for (i = 1; i < Lod.NumTexCoords; i++)
+	{
+		int UVView = W.AddBufferView(Lod.ExtraUV[i-1], Lod.NumVerts * sizeof(CMeshUVFloat), 0, GLTF_ARRAY_BUFFER);
+		UVAccessors[i] = W.AddAccessor(UVView, 0, GLTF_FLOAT, Lod.NumVerts, "VEC2");
+	}
+
+	// index buffer
+	bool Is32Bit = Lod.Indices.Is32Bit();
+	int IndexSize = Is32Bit ? sizeof(uint32) : sizeof(uint16);
+	const void *IndexData = Is32Bit ? (const void*)Lod.Indices.Indices32.GetData() : (const void*)Lod.Indices.Indices16.GetData();
+	int IndexView = W.AddBufferView(IndexData, Lod.Indices.Num() * IndexSize, 0, GLTF_ELEMENT_ARRAY_BUFFER);
+
+	CGltfWriter::Item(W.Meshes).Printf("{\"name\":");
+	CGltfWriter::WriteString(W.Meshes, Name);
+	W.Meshes.Printf(",\"primitives\":[");
+	bool First = true;
+	for (i = 0; i < Lod.Sections.Num(); i++)
+	{
+		const CMeshSection &Sec = Lod.Sections[i];
+
+		// material is created for every section to keep section indices
+		const UUnrealMaterial *Mat = Sec.Material;
+		CGltfWriter::Item(W.Materials).Printf("{\"name\":");
+		if (Mat)
+		{
+			CGltfWriter::WriteString(W.Materials, Mat->Name);
+			ExportObject(Mat);
+		}
+		else
+		{
+			CGltfWriter::WriteString(W.Materials, va("material_%d", i));
+		}
+		W.Materials.Printf("}");
+
+		if (!Sec.NumFaces) continue;
+
+		int IndexAccessor = W.AddAccessor(IndexView, Sec.FirstIndex * IndexSize,
+			Is32Bit ? GLTF_UNSIGNED_INT : GLTF_UNSIGNED_SHORT, Sec.NumFaces * 3, "SCALAR");
+
+		W.Meshes.Printf("%s{\"attributes\":{\"POSITION\":%d", First ? "" : ",", PosAccessor);
+		First = false;
+		if (NormAccessor >= 0)
+			W.Meshes.Printf(",\"NORMAL\":%d", NormAccessor);
+		for (int j = 0; j < Lod.NumTexCoords; j++)
+			W.Meshes.Printf(",\"TEXCOORD_%d\":%d", j, UVAccessors[j]);
+		if (JointsAccessor >= 0)
+			W.Meshes.Printf(",\"JOINTS_0\":%d,\"WEIGHTS_0\":%d", JointsAccessor, WeightsAccessor);
+		W.Meshes.Printf("},\"indices\":%d,\"material\":%d}", IndexAccessor, i);
+	}
+	W.Meshes.Printf("]}");
+
+	unguard;
+}
+
+
+// Local bone rotation in glTF convention. Unreal stores inverted rotations for all bones except root.
+static void GetBoneRotation(const CQuat &Src, int BoneIndex, CQuat &Dst)
+{
+	Dst = Src;
+	if (BoneIndex) Dst.Conjugate();
+	Dst.Normalize();
+}
+
+
+// Vertex influences in glTF format: joint indices can't be negative, and normalized weights
+// must sum to exactly 255. Both streams are interleaved in a single buffer view.
+struct CGltfInfluence
+{
+	uint16			Joints[NUM_INFLUENCES];
+	byte			Weights[NUM_INFLUENCES];
+};
+
+static void GetGltfInfluence(const CSkelMeshVertex &V, CGltfInfluence &Dst)
+{
+	int Weights[NUM_INFLUENCES];
+	int Sum = 0, MaxIndex = 0;
+	for (int i = 0; i < NUM_INFLUENCES; i++)
+	{
+		int Bone = V.Bone[i];
+		Weights[i] = (Bone >= 0) ? (V.PackedWeights >> (i * 8)) & 0xFF : 0;
+		Dst.Joints[i] = (Bone >= 0) ? Bone : 0;		// weight is 0 for unused influence
+		Sum += Weights[i];
+		if (Weights[i] > Weights[MaxIndex]) MaxIndex = i;
+	}
+	if (!Sum)
+	{
+		// vertex is not weighted, attach it to the first bone
+		Weights[0] = Sum = 255;
+		MaxIndex = 0;
+	}
+	// scale weights and give the rounding error to the largest one
+	int NewSum = 0;
+	for (int i = 0; i < NUM_INFLUENCES; i++)
+	{
+		Weights[i] = (Weights[i] * 255 + Sum / 2) / Sum;
+		NewSum += Weights[i];
+	}
+	Weights[MaxIndex] += 255 - NewSum;
+	for (int i = 0; i < NUM_INFLUENCES; i++)
+		Dst.Weights[i] = Weights[i];
+}
+
+static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod &Lod, const char *Name, FArchive &Ar)
+{
+	guard(ExportSkeletalMeshLod);
+
+	CGltfWriter W;
+	int i;
+	int NumBones = Mesh.RefSkeleton.Num();
+
+	// nodes: 0 = root with coordinate system conversion, 1..NumBones = bones, then mesh
+	TArray<int> ParentNodes;
+	ParentNodes.AddUninitialized(NumBones);
+	for (i = 0; i < NumBones; i++)
+	{
+		int Parent = Mesh.RefSkeleton[i].ParentIndex;
+		ParentNodes[i] = (i == 0 || Parent == i || Parent < 0 || Parent >= NumBones) ? 0 : Parent + 1;
+	}
+
+	W.BeginNode("Root");
+	W.Nodes.Printf(",\"matrix\":");
+	CGltfWriter::WriteFloats(W.Nodes, RootMatrix, 16);
+	W.Nodes.Printf(",\"children\":[");
+	bool First = true;
+	for (i = 0; i < NumBones; i++)
+	{
+		if (ParentNodes[i] != 0) continue;
+		W.Nodes.Printf(First ? "%d" : ",%d", i + 1);
+		First = false;
+	}
+	W.Nodes.Printf(First ? "%d]}" : ",%d]}", NumBones + 1);
+
+	// bones and their inverse bind matrices
+	float *InvBindMatrices = (float*)W.AllocTemp(NumBones * 16 * sizeof(float));
+	TArray<CCoords> BoneCoords;
+	BoneCoords.AddUninitialized(NumBones);
+	for (i = 0; i < NumBones; i++)
+	{
+		const CSkelMeshBone &B = Mesh.RefSkeleton[i];
+		CQuat Rot;
+		GetBoneRotation(B.Orientation, i, Rot);
+
+		W.BeginNode(B.Name);
+		W.Nodes.Printf(",\"translation\":");
+		CGltfWriter::WriteFloats(W.Nodes, B.Position.v, 3);
+		W.Nodes.Printf(",\"rotation\":");
+		CGltfWriter::WriteFloats(W.Nodes, &Rot.x, 4);
+		// children; parent bones are always placed before children
+		First = true;
+		for (int j = i + 1; j < NumBones; j++)
+		{
+			if (ParentNodes[j] != i + 1) continue;
+			W.Nodes.Printf(First ? ",\"children\":[%d" : ",%d", j + 1);
+			First = false;
+		}
+		W.Nodes.Printf(First ? "}" : "]}");
+
+		// compute global bone transform, the same way as CSkelMeshInstance does
+		CCoords &BC = BoneCoords[i];
+		CQuat BO = B.Orientation;
+		if (!i) BO.Conjugate();
+		BC.origin = B.Position;
+		BO.ToAxis(BC.axis);
+		if (ParentNodes[i])
+			BoneCoords[ParentNodes[i] - 1].UnTransformCoords(BC, BC);
+		CCoords Inv;
+		InvertCoords(BC, Inv);
+		float *M = InvBindMatrices + i * 16;
+		for (int k = 0; k < 3; k++)
+		{
+			M[k * 4 + 0] = Inv.axis[k][0];
+			M[k * 4 + 1] = Inv.axis[k][1];
+			M[k * 4 + 2] = Inv.axis[k][2];
+			M[k * 4 + 3] = 0;
+		}
+		M[12] = Inv.origin[0];
+		M[13] = Inv.origin[1];
+		M[14] = Inv.origin[2];
+		M[15] = 1;
+	}
+
+	// joints and weights
+	CGltfInfluence *Influences = (CGltfInfluence*)W.AllocTemp(Lod.NumVerts * sizeof(CGltfInfluence));
+	for (i = 0; i < Lod.NumVerts; i++)
+		GetGltfInfluence(Lod.Verts[i], Influences[i]);
+	int InfluenceView   = W.AddBufferView(Influences, Lod.NumVerts * sizeof(CGltfInfluence), sizeof(CGltfInfluence), GLTF_ARRAY_BUFFER);
+	int JointsAccessor  = W.AddAccessor(InfluenceView, offsetof(CGltfInfluence, Joints), GLTF_UNSIGNED_SHORT, Lod.NumVerts, "VEC4");
+	int WeightsAccessor = W.AddAccessor(InfluenceView, offsetof(CGltfInfluence, Weights), GLTF_UNSIGNED_BYTE, Lod.NumVerts, "VEC4", true);
+
+	ExportMeshPrimitives(W, Name, Lod, Lod.Verts, sizeof(CSkelMeshVertex), JointsAccessor, WeightsAccessor);
+
+	// skin
+	int IBMView = W.AddBufferView(InvBindMatrices, NumBones * 16 * sizeof(float));
+	int IBMAccessor = W.AddAccessor(IBMView, 0, GLTF_FLOAT, NumBones, "MAT4");
+	W.Skins.Printf("{\"inverseBindMatrices\":%d,\"skeleton\":1,\"joints\":[", IBMAccessor);
+	for (i = 0; i < NumBones; i++)
+		W.Skins.Printf(i ? ",%d" : "%d", i + 1);
+	W.Skins.Printf("]}");
+
+	// mesh node
+	W.BeginNode(Name);
+	W.Nodes.Printf(",\"mesh\":0,\"skin\":0}");
+
+	W.Save(Ar);
+
+	unguard;
+}
+
+
+void ExportSkeletalMeshGltf(const CSkeletalMesh *Mesh)
+{
+	guard(ExportSkeletalMeshGltf);
+
+	UObject *OriginalMesh = Mesh->OriginalMesh;
+	if (!Mesh->Lods.Num())
+	{
+		appNotify("Mesh %s has 0 lods", OriginalMesh->Name);
+		return;
+	}
+
+	int MaxLod = (GExportLods) ? Mesh->Lods.Num() : 1;
+	for (int Lod = 0; Lod < MaxLod; Lod++)
+	{
+		const CSkelMeshLod &MeshLod = Mesh->Lods[Lod];
+		if (!MeshLod.Sections.Num()) continue;		// empty mesh
+
+		char Name[512];
+		if (Lod == 0)
+			appStrncpyz(Name, OriginalMesh->Name, ARRAY_COUNT(Name));
+		else
+			appSprintf(ARRAY_ARG(Name), "%s_Lod%d", OriginalMesh->Name, Lod);
+
+		FArchive *Ar = CreateExportArchive(OriginalMesh, "%s.glb", Name);
+		if (Ar)
+		{
+			ExportSkeletalMeshLod(*Mesh, MeshLod, Name, *Ar);
+			delete Ar;
+		}
+	}
+
+	unguard;
+}
+
+
+void ExportStaticMeshGltf(const CStaticMesh *Mesh)
+{
+	guard(ExportStaticMeshGltf);
+
+	UObject *OriginalMesh = Mesh->OriginalMesh;
+	if (!Mesh->Lods.Num())
+	{
+		appNotify("Mesh %s has 0 lods", OriginalMesh->Name);
+		return;
+	}
+
+	int MaxLod = (GExportLods) ? Mesh->Lods.Num() : 1;
+	for (int Lod = 0; Lod < MaxLod; Lod++)
+	{
+		const CStaticMeshLod &MeshLod = Mesh->Lods[Lod];
+		if (!MeshLod.Sections.Num()) continue;		// empty mesh
+
+		char Name[512];
+		if (Lod == 0)
+			appStrncpyz(Name, OriginalMesh->Name, ARRAY_COUNT(Name));
+		else
+			appSprintf(ARRAY_ARG(Name), "%s_Lod%d", OriginalMesh->Name, Lod);
+
+		FArchive *Ar = CreateExportArchive(OriginalMesh, "%s.glb", Name);
+		if (!Ar) continue;
+
+		CGltfWriter W;
+		W.BeginNode("Root");
+		W.Nodes.Printf(",\"matrix\":");
+		CGltfWriter::WriteFloats(W.Nodes, RootMatrix, 16);
+		W.Nodes.Printf(",\"children\":[1]}");
+		W.BeginNode(Name);
+		W.Nodes.Printf(",\"mesh\":0}");
+		ExportMeshPrimitives(W, Name, MeshLod, MeshLod.Verts, sizeof(CStaticMeshVertex), -1, -1);
+		W.Save(*Ar);
+
+		delete Ar;
+	}
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Animation export
+-----------------------------------------------------------------------------*/
+
+// Compute key times in seconds. Times is array of frame numbers, when it is empty,
+// keys are evenly distributed over the sequence.
+static int AddKeyTimes(CGltfWriter &W, const CAnimSequence &Seq, const TArray<float> &Times, int NumKeys)
+{
+	float Rate = (Seq.Rate > 0) ? Seq.Rate : 30;
+	float *Dst = (float*)W.AllocTemp(NumKeys * sizeof(float));
+	for (int i = 0; i < NumKeys; i++)
+	{
+		float Frame = Times.Num() ? Times[i] : (float)i * Seq.NumFrames / NumKeys;
+		Dst[i] = Frame / Rate;
+	}
+	float MinMax[2];
+	MinMax[0] = Dst[0];
+	MinMax[1] = Dst[NumKeys - 1];
+	int View = W.AddBufferView(Dst, NumKeys * sizeof(float));
+	return W.AddAccessor(View, 0, GLTF_FLOAT, NumKeys, "SCALAR", false, MinMax);
+}
+
+static void ExportAnimSequence(CGltfWriter &W, const CAnimSequence &Seq)
+{
+	guard(ExportAnimSequence);
+
+	static const TArray<float> NoTimes;
+	FMemWriter Samplers, Channels;
+	int NumSamplers = 0;
+
+	for (int b = 0; b < Seq.Tracks.Num(); b++)
+	{
+		const CAnimTrack &T = Seq.Tracks[b];
+		int NumPosKeys = T.KeyPos.Num();
+		int NumRotKeys = T.KeyQuat.Num();
+
+		// key times, see GetTrackKeyParams() for details
+		int PosTimes = -1, RotTimes = -1;
+		if (T.KeyTime.Num())
+		{
+			int Shared = AddKeyTimes(W, Seq, T.KeyTime, T.KeyTime.Num());
+			if (NumPosKeys) PosTimes = (NumPosKeys == T.KeyTime.Num()) ? Shared : AddKeyTimes(W, Seq, NoTimes, 1);
+			if (NumRotKeys) RotTimes = (NumRotKeys == T.KeyTime.Num()) ? Shared : AddKeyTimes(W, Seq, NoTimes, 1);
+		}
+		else
+		{
+			if (NumPosKeys) PosTimes = AddKeyTimes(W, Seq, T.KeyPosTime, NumPosKeys);
+			if (NumRotKeys) RotTimes = AddKeyTimes(W, Seq, T.KeyQuatTime, NumRotKeys);
+		}
+
+		if (NumPosKeys)
+		{
+			// positions are written directly from the track
+			int View = W.AddBufferView(T.KeyPos.GetData(), NumPosKeys * sizeof(CVec3));
+			int Output = W.AddAccessor(View, 0, GLTF_FLOAT, NumPosKeys, "VEC3");
+			CGltfWriter::Item(Samplers).Printf("{\"input\":%d,\"output\":%d,\"interpolation\":\"LINEAR\"}", PosTimes, Output);
+			CGltfWriter::Item(Channels).Printf("{\"sampler\":%d,\"target\":{\"node\":%d,\"path\":\"translation\"}}", NumSamplers++, b + 1);
+		}
+		if (NumRotKeys)
+		{
+			CQuat *Rot = (CQuat*)W.AllocTemp(NumRotKeys * sizeof(CQuat));
+			for (int i = 0; i < NumRotKeys; i++)
+				GetBoneRotation(T.KeyQuat[i], b, Rot[i]);
+			int View = W.AddBufferView(Rot, NumRotKeys * sizeof(CQuat));
+			int Output = W.AddAccessor(View, 0, GLTF_FLOAT, NumRotKeys, "VEC4");
+			CGltfWriter::Item(Samplers).Printf("{\"input\":%d,\"output\":%d,\"interpolation\":\"LINEAR\"}", RotTimes, Output);
+			CGltfWriter::Item(Channels).Printf("{\"sampler\":%d,\"target\":{\"node\":%d,\"path\":\"rotation\"}}", NumSamplers++, b + 1);
+		}
+	}
+
+	// glTF requires at least one channel in animation
+	if (!NumSamplers) return;
+
+	CGltfWriter::Item(W.Animations).Printf("{\"name\":");
+	CGltfWriter::WriteString(W.Animations, Seq.Name);
+	W.Animations.Printf(",\"samplers\":[");
+	Samplers.WriteTo(W.Animations);
+	W.Animations.Printf("],\"channels\":[");
+	Channels.WriteTo(W.Animations);
+	W.Animations.Printf("]}");
+
+	unguard;
+}
+
+
+void ExportAnimSetGltf(const CAnimSet *Anim)
+{
+	guard(ExportAnimSetGltf);
+
+	if (!Anim->Sequences.Num()) return;			// empty CAnimSet
+
+	UObject *OriginalAnim = Anim->OriginalAnim;
+	FArchive *Ar = CreateExportArchive(OriginalAnim, "%s.glb", OriginalAnim->Name);
+	if (!Ar) return;
+
+	CGltfWriter W;
+	int i;
+	int NumBones = Anim->TrackBoneNames.Num();
+
+	// bone hierarchy is unknown for CAnimSet, so attach all bones to the root bone (the same as psa)
+	W.BeginNode("Root");
+	W.Nodes.Printf(",\"matrix\":");
+	CGltfWriter::WriteFloats(W.Nodes, RootMatrix, 16);
+	W.Nodes.Printf(NumBones ? ",\"children\":[1]}" : "}");
+	for (i = 0; i < NumBones; i++)
+	{
+		W.BeginNode(Anim->TrackBoneNames[i]);
+		if (i == 0 && NumBones > 1)
+		{
+			W.Nodes.Printf(",\"children\":[");
+			for (int j = 1; j < NumBones; j++)
+				W.Nodes.Printf(j > 1 ? ",%d" : "%d", j + 1);
+			W.Nodes.Printf("]");
+		}
+		W.Nodes.Printf("}");
+	}
+
+	for (i = 0; i < Anim->Sequences.Num(); i++)
+	{
+		const CAnimSequence &Seq = *Anim->Sequences[i];
+		assert(Seq.Tracks.Num() == NumBones);
+		ExportAnimSequence(W, Seq);
+	}
+
+	W.Save(*Ar);
+	delete Ar;
+
+	unguard;
+}
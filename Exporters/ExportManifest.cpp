@@ -0,0 +1,602 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#include "UnObject.h"
+#include "UnPackage.h"
+
+#include "Exporters.h"
+
+#include <sys/stat.h>				// for stat()
+
+
+/*-----------------------------------------------------------------------------
+	Incremental export manifest
+-----------------------------------------------------------------------------*/
+
+// Manifest is a text file in export directory. It holds hash of export settings, and for every
+// processed package - stamps of package files, and for every processed export - its location in
+// package, hash of serialized data and list of written files. Fields are separated with tabs,
+// export lines belong to preceding package line:
+//   S <settings hash>
+//   P <stamp> <bulk stamp> <package file name>
+//   E <offset> <size> <data hash> <class name> <object path> <export path> [<file name> ...]
+// Export which has the same location and data hash as recorded, and has all its files present, is
+// not loaded and exported again. When package files weren't changed at all, data of exports is not
+// hashed. Separately stored bulk data (UE4 .ubulk files, UE3 texture file caches and packages
+// holding data of forced exports) is not covered by export's data hash, so when it is changed, all
+// exports of the package are loaded. Animations are combined from objects of several packages, so
+// they're always loaded and exported (see AggregatedClasses).
+
+#define MANIFEST_FILE				"umodel-manifest.txt"
+#define MANIFEST_HASH_SIZE			4096
+#define HASH_CHUNK_SIZE				65536
+
+bool GExportIncremental = false;
+
+struct CManifestExport
+{
+	const char		*ClassName;			// allocated with appStrdupPool()
+	char			*ObjectPath;
+	int				SerialOffset;
+	int				SerialSize;
+	CContentHash	Hash;
+	char			*ExportPath;		// relative to base export directory
+	char			*Files;				// tab-separated list of file names, relative to ExportPath
+};
+
+struct CManifestPackage
+{
+	const char		*Filename;			// allocated with appStrdupPool()
+	CContentHash	Stamp;				// package file (and UE4 .uexp file)
+	CContentHash	BulkStamp;			// UE4 .ubulk and .uptnl files
+	TArray<CManifestExport> Exports;
+	int				SearchHint;			// index of export following the last found one
+	CManifestPackage *HashNext;
+
+	// state of currently loaded package, valid when Package is not NULL
+	UnPackage		*Package;
+	CContentHash	NewStamp;
+	CContentHash	NewBulkStamp;
+	bool			Unchanged;			// package files are the same as at previous export
+	bool			Checked;			// all exports were checked by LoadChangedExports()
+	TArray<CContentHash> ExportHashes;	// hashes of export data, computed on demand
+	TArray<bool>	ExportHashValid;
+};
+
+static TArray<CManifestPackage*> ManifestPackages;
+static CManifestPackage *ManifestHash[MANIFEST_HASH_SIZE];
+static CContentHash ManifestSettings;
+static bool ManifestLoaded = false;
+static char ManifestDir[512];			// base export directory for which manifest was loaded
+
+
+/*-----------------------------------------------------------------------------
+	Package and export fingerprints
+-----------------------------------------------------------------------------*/
+
+// Files are identified by size and modification time, files from virtual file systems (pak files
+// etc) - by their size and the time of container file, see appGetGameFileStamp(). When container
+// file is changed, all its packages are treated as changed, and data hashes of their exports are
+// compared.
+static void AddFileStamp(const CGameFileInfo *Info, const char *Filename, CContentHash &Stamp)
+{
+	guard(AddFileStamp);
+
+	if (Info)
+	{
+		appGetGameFileStamp(Info, Stamp);
+		return;
+	}
+
+	struct stat buf;
+	if (stat(Filename, &buf) != 0) return;
+	int64 Values[2] = { (int64)buf.st_size, (int64)buf.st_mtime };
+	Stamp.Update(Values, sizeof(Values));
+
+	unguard;
+}
+
+static void AddCompanionFileStamp(const UnPackage *Package, const char *Ext, CContentHash &Stamp)
+{
+	char Name[MAX_PACKAGE_PATH];
+	appStrncpyz(Name, Package->Filename, ARRAY_COUNT(Name));
+	char *s = strrchr(Name, '.');
+	if (!s) return;
+	strcpy(s, Ext);
+	const CGameFileInfo *Info = appFindGameFile(Name);
+	if (Info)
+	{
+		Stamp.Update(Ext);
+		AddFileStamp(Info, Info->RelativeName, Stamp);
+	}
+}
+
+#if UNREAL3
+
+static void AddExternalFileStamp(const CGameFileInfo *Info, const UnPackage *Package, TArray<const CGameFileInfo*> &Added, CContentHash &Stamp)
+{
+	if (!Info || Info == Package->FileInfo || Added.FindItem(Info) >= 0) return;
+	Added.Add(Info);
+	Stamp.Update(Info->RelativeName);
+	AddFileStamp(Info, Info->RelativeName, Stamp);
+}
+
+// UE3 texture could store mips in texture file cache, or in other package when texture is a forced
+// export. Names of texture file caches are stored in package's name table, so all names are checked
+// the same way as UTexture2D::LoadBulkTexture() looks for tfc files.
+static void AddExternalPayloadStamps(const UnPackage *Package, CContentHash &Stamp)
+{
+	guard(AddExternalPayloadStamps);
+
+	static const char* Extensions[] = { "tfc", "xxx" };
+	static const char* Suffixes[] = { "", "_DXT", "_ETC", "_PVRTC" };
+
+	TArray<const CGameFileInfo*> Added;
+	for (int i = 0; i < Package->Summary.NameCount; i++)
+	{
+		const char *Name = Package->NameTable[i];
+		if (!Name || !stricmp(Name, "None")) continue;
+		for (int j = 0; j < ARRAY_COUNT(Suffixes); j++)
+		{
+			char FileName[MAX_PACKAGE_PATH];
+			appSprintf(ARRAY_ARG(FileName), "%s%s", Name, Suffixes[j]);
+			for (int k = 0; k < ARRAY_COUNT(Extensions); k++)
+				AddExternalFileStamp(appFindGameFile(FileName, Extensions[k]), Package, Added, Stamp);
+		}
+	}
+
+	for (int i = 0; i < Package->Summary.ExportCount; i++)
+	{
+		const FObjectExport &Exp = Package->ExportTable[i];
+		if (Exp.PackageIndex == 0 && (Exp.ExportFlags & EF_ForcedExport))
+			AddExternalFileStamp(appFindGameFile(Exp.ObjectName), Package, Added, Stamp);
+	}
+
+	unguard;
+}
+
+#endif // UNREAL3
+
+static void GetPackageStamps(const UnPackage *Package, CContentHash &Stamp, CContentHash &BulkStamp)
+{
+	guard(GetPackageStamps);
+
+	AddFileStamp(Package->FileInfo, Package->Filename, Stamp);
+#if UNREAL4
+	if (Package->Game >= GAME_UE4_BASE && Package->FileInfo)
+	{
+		AddCompanionFileStamp(Package, ".uexp", Stamp);
+		AddCompanionFileStamp(Package, ".ubulk", BulkStamp);
+		AddCompanionFileStamp(Package, ".uptnl", BulkStamp);
+	}
+#endif // UNREAL4
+#if UNREAL3
+	if (Package->Game >= GAME_UE3 && Package->Game < GAME_UE4_BASE)
+		AddExternalPayloadStamps(Package, BulkStamp);
+#endif // UNREAL3
+
+	unguardf("%s", Package->Filename);
+}
+
+static void HashExportData(UnPackage *Package, int ExportIndex, CContentHash &Hash)
+{
+	guard(HashExportData);
+
+	const FObjectExport &Exp = Package->GetExport(ExportIndex);
+	Package->SetupReader(ExportIndex);
+	byte *Buffer = (byte*)appMalloc(HASH_CHUNK_SIZE);
+	for (int Pos = 0; Pos < Exp.SerialSize; Pos += HASH_CHUNK_SIZE)
+	{
+		int ChunkSize = min(Exp.SerialSize - Pos, HASH_CHUNK_SIZE);
+		Package->Serialize(Buffer, ChunkSize);
+		Hash.Update(Buffer, ChunkSize);
+	}
+	appFree(Buffer);
+
+	unguardf("%s", *Package->GetExport(ExportIndex).ObjectName);
+}
+
+// Object path inside the package, "Outer.Name"
+static void GetExportObjectPath(const UnPackage *Package, int ExportIndex, char *Buffer, int BufferSize)
+{
+	const FObjectExport &Exp = Package->GetExport(ExportIndex);
+	Buffer[0] = 0;
+	if (Exp.PackageIndex > 0)
+	{
+		GetExportObjectPath(Package, Exp.PackageIndex - 1, Buffer, BufferSize);
+		appStrcatn(Buffer, BufferSize, ".");
+	}
+	appStrcatn(Buffer, BufferSize, *Exp.ObjectName);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Manifest records
+-----------------------------------------------------------------------------*/
+
+static void FreeManifest()
+{
+	for (int i = 0; i < ManifestPackages.Num(); i++)
+	{
+		CManifestPackage *Rec = ManifestPackages[i];
+		for (int j = 0; j < Rec->Exports.Num(); j++)
+		{
+			CManifestExport &E = Rec->Exports[j];
+			appFree(E.ObjectPath);
+			appFree(E.ExportPath);
+			appFree(E.Files);
+		}
+		delete Rec;
+	}
+	ManifestPackages.Empty();
+	memset(ManifestHash, 0, sizeof(ManifestHash));
+}
+
+static CManifestPackage *FindManifestPackage(const char *Filename, bool Create)
+{
+	int h = appStrihash(Filename) & (MANIFEST_HASH_SIZE - 1);
+	for (CManifestPackage *Rec = ManifestHash[h]; Rec; Rec = Rec->HashNext)
+	{
+		if (!stricmp(Rec->Filename, Filename)) return Rec;
+	}
+	if (!Create) return NULL;
+
+	CManifestPackage *Rec = new CManifestPackage;
+	Rec->Filename   = appStrdupPool(Filename);
+	Rec->SearchHint = 0;
+	Rec->Package    = NULL;
+	Rec->Unchanged  = Rec->Checked = false;
+	Rec->HashNext   = ManifestHash[h];
+	ManifestHash[h] = Rec;
+	ManifestPackages.Add(Rec);
+	return Rec;
+}
+
+static CManifestExport *FindManifestExport(CManifestPackage *Rec, const char *ClassName, const char *ObjectPath)
+{
+	// exports are usually processed in the same order as they were recorded, so start search from
+	// the export following the previously found one
+	int Num = Rec->Exports.Num();
+	for (int i = 0; i < Num; i++)
+	{
+		int Index = (Rec->SearchHint + i) % Num;
+		CManifestExport &E = Rec->Exports[Index];
+		if (!stricmp(E.ObjectPath, ObjectPath) && !stricmp(E.ClassName, ClassName))
+		{
+			Rec->SearchHint = Index + 1;
+			return &E;
+		}
+	}
+	return NULL;
+}
+
+static void LoadManifest()
+{
+	guard(LoadManifest);
+
+	const char *BaseDir = appGetBaseExportDirectory();
+	if (ManifestLoaded && !strcmp(ManifestDir, BaseDir)) return;
+	FreeManifest();
+	ManifestLoaded = true;
+	appStrncpyz(ManifestDir, BaseDir, ARRAY_COUNT(ManifestDir));
+
+	char ManifestName[1024];
+	appSprintf(ARRAY_ARG(ManifestName), "%s/" MANIFEST_FILE, BaseDir);
+	FILE *f = fopen(ManifestName, "r");
+	if (!f) return;
+
+	CManifestPackage *Rec = NULL;
+	int NumExports = 0;
+	bool SettingsMatch = false;
+	char Line[4096];
+	while (fgets(Line, sizeof(Line), f))
+	{
+		char *s = strchr(Line, '\n');
+		if (s) *s = 0;
+		// split line to fields
+		char *Fields[8];
+		int NumFields = 0;
+		Fields[NumFields++] = Line;
+		for (s = Line; *s && NumFields < ARRAY_COUNT(Fields); s++)
+		{
+			if (*s != '\t') continue;
+			*s = 0;
+			Fields[NumFields++] = s + 1;
+		}
+		// the last field of export line holds tab-separated file list, so it is not split
+		const char *Tag = Fields[0];
+		if (!strcmp(Tag, "S") && NumFields >= 2)
+		{
+			CContentHash Settings;
+			SettingsMatch = Settings.FromString(Fields[1]) && Settings == ManifestSettings;
+			if (!SettingsMatch) break;
+		}
+		else if (!strcmp(Tag, "P") && NumFields >= 4 && SettingsMatch)
+		{
+			Rec = FindManifestPackage(Fields[3], true);
+			Rec->Stamp.FromString(Fields[1]);
+			Rec->BulkStamp.FromString(Fields[2]);
+		}
+		else if (!strcmp(Tag, "E") && NumFields >= 7 && Rec)
+		{
+			CManifestExport *E = new (Rec->Exports) CManifestExport;
+			E->SerialOffset = atoi(Fields[1]);
+			E->SerialSize   = atoi(Fields[2]);
+			E->Hash.FromString(Fields[3]);
+			E->ClassName    = appStrdupPool(Fields[4]);
+			E->ObjectPath   = appStrdup(Fields[5]);
+			E->ExportPath   = appStrdup(Fields[6]);
+			E->Files        = appStrdup(NumFields >= 8 ? Fields[7] : "");
+			NumExports++;
+		}
+	}
+	fclose(f);
+
+	if (SettingsMatch)
+		appPrintf("Loaded export manifest: %d packages, %d objects\n", ManifestPackages.Num(), NumExports);
+	else
+		appPrintf("Export settings were changed, ignoring export manifest\n");
+
+	unguard;
+}
+
+void SaveExportManifest()
+{
+	guard(SaveExportManifest);
+
+	if (!ManifestLoaded) return;
+
+	char ManifestName[1024], TempName[1024];
+	appSprintf(ARRAY_ARG(ManifestName), "%s/" MANIFEST_FILE, ManifestDir);
+	appSprintf(ARRAY_ARG(TempName), "%s.tmp", ManifestName);
+	appMakeDirectory(ManifestDir);
+	FILE *f = fopen(TempName, "w");
+	if (!f)
+	{
+		appPrintf("ERROR: unable to write export manifest \"%s\"\n", TempName);
+		return;
+	}
+
+	char HashStr[64], HashStr2[64];
+	ManifestSettings.ToString(HashStr);
+	fprintf(f, "S\t%s\n", HashStr);
+	for (int i = 0; i < ManifestPackages.Num(); i++)
+	{
+		const CManifestPackage *Rec = ManifestPackages[i];
+		// stamps are updated only when all exports were verified, otherwise the next run will
+		// compare data hashes of all exports of this package
+		const CContentHash &Stamp = Rec->Checked ? Rec->NewStamp : Rec->Stamp;
+		const CContentHash &BulkStamp = Rec->Checked ? Rec->NewBulkStamp : Rec->BulkStamp;
+		Stamp.ToString(HashStr);
+		BulkStamp.ToString(HashStr2);
+		fprintf(f, "P\t%s\t%s\t%s\n", HashStr, HashStr2, Rec->Filename);
+		for (int j = 0; j < Rec->Exports.Num(); j++)
+		{
+			const CManifestExport &E = Rec->Exports[j];
+			E.Hash.ToString(HashStr);
+			fprintf(f, "E\t%d\t%d\t%s\t%s\t%s\t%s\t%s\n", E.SerialOffset, E.SerialSize, HashStr,
+				E.ClassName, E.ObjectPath, E.ExportPath, E.Files);
+		}
+	}
+	fclose(f);
+
+	remove(ManifestName);
+	if (rename(TempName, ManifestName) != 0)
+		appPrintf("ERROR: unable to write export manifest \"%s\"\n", ManifestName);
+
+	unguard;
+}
+
+void SetIncrementalExportSettings(const char *Settings)
+{
+	ManifestSettings = CContentHash();
+	ManifestSettings.Update(Settings);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Checking exports
+-----------------------------------------------------------------------------*/
+
+static CManifestPackage *GetPackageRecord(UnPackage *Package)
+{
+	guard(GetPackageRecord);
+
+	LoadManifest();
+	CManifestPackage *Rec = FindManifestPackage(Package->Filename, true);
+	if (Rec->Package != Package)
+	{
+		// package was loaded (or reloaded after unloading), compute its stamps
+		Rec->Package = Package;
+		Rec->NewStamp = Rec->NewBulkStamp = CContentHash();
+		GetPackageStamps(Package, Rec->NewStamp, Rec->NewBulkStamp);
+		Rec->Unchanged = (Rec->NewStamp == Rec->Stamp) && (Rec->NewBulkStamp == Rec->BulkStamp);
+		Rec->ExportHashes.Empty(Package->Summary.ExportCount);
+		Rec->ExportHashes.AddZeroed(Package->Summary.ExportCount);
+		Rec->ExportHashValid.Empty(Package->Summary.ExportCount);
+		Rec->ExportHashValid.AddZeroed(Package->Summary.ExportCount);
+	}
+	return Rec;
+
+	unguard;
+}
+
+static const CContentHash &GetExportHash(CManifestPackage *Rec, int ExportIndex)
+{
+	if (!Rec->ExportHashValid[ExportIndex])
+	{
+		HashExportData(Rec->Package, ExportIndex, Rec->ExportHashes[ExportIndex]);
+		Rec->ExportHashValid[ExportIndex] = true;
+	}
+	return Rec->ExportHashes[ExportIndex];
+}
+
+// Exporters of these classes write files combined from several objects: UE3 AnimSet - from its
+// AnimSequence objects, UE4 Skeleton - from AnimSequence objects which are usually stored in other
+// packages. Their data hashes don't cover the source objects, and when only a part of sources is
+// loaded, the combined file is written from that part. So these objects are never skipped.
+static const char *AggregatedClasses[] = { "AnimSet", "AnimSequence", "Skeleton" };
+
+static bool IsAggregatedClass(const char *ClassName)
+{
+	for (int i = 0; i < ARRAY_COUNT(AggregatedClasses); i++)
+	{
+		if (!stricmp(ClassName, AggregatedClasses[i])) return true;
+	}
+	return false;
+}
+
+static bool IsExportUnchanged(CManifestPackage *Rec, int ExportIndex)
+{
+	guard(IsExportUnchanged);
+
+	// exports could refer to changed separate bulk data without any changes in export itself
+	if (!(Rec->NewBulkStamp == Rec->BulkStamp)) return false;
+
+	UnPackage *Package = Rec->Package;
+	const FObjectExport &Exp = Package->GetExport(ExportIndex);
+	const char *ClassName = Package->GetObjectName(Exp.ClassIndex);
+	if (IsAggregatedClass(ClassName)) return false;
+
+	char ObjectPath[1024];
+	GetExportObjectPath(Package, ExportIndex, ARRAY_ARG(ObjectPath));
+	const CManifestExport *E = FindManifestExport(Rec, ClassName, ObjectPath);
+	if (!E) return false;
+
+	if (E->SerialOffset != Exp.SerialOffset || E->SerialSize != Exp.SerialSize)
+		return false;
+	if (!Rec->Unchanged && !(GetExportHash(Rec, ExportIndex) == E->Hash))
+		return false;
+
+	// verify presence of exported files
+	const char *s = E->Files;
+	while (*s)
+	{
+		const char *end = strchr(s, '\t');
+		if (!end) end = s + strlen(s);
+		char Name[1024];
+		int len = appSprintf(ARRAY_ARG(Name), "%s/%s%s", appGetBaseExportDirectory(), E->ExportPath, E->ExportPath[0] ? "/" : "");
+		appStrncpyz(Name + len, s, min((int)(end - s) + 1, (int)ARRAY_COUNT(Name) - len));
+		if (!appFileExists(Name)) return false;
+		s = *end ? end + 1 : end;
+	}
+	return true;
+
+	unguard;
+}
+
+bool LoadChangedExports(UnPackage *Package)
+{
+	guard(LoadChangedExports);
+
+	CManifestPackage *Rec = GetPackageRecord(Package);
+
+	// find changed exports before loading anything, because HashExportData() moves package reader
+	TArray<int> ChangedExports;
+	int NumUnchanged = 0;
+	for (int idx = 0; idx < Package->Summary.ExportCount; idx++)
+	{
+		if (!IsKnownClass(Package->GetObjectName(Package->GetExport(idx).ClassIndex)))
+			continue;
+		if (IsExportUnchanged(Rec, idx))
+			NumUnchanged++;
+		else
+			ChangedExports.Add(idx);
+	}
+
+	UObject::BeginLoad();
+	for (int i = 0; i < ChangedExports.Num(); i++)
+		Package->CreateExport(ChangedExports[i]);
+	UObject::EndLoad();
+
+	Rec->Checked = true;
+	if (NumUnchanged)
+		appPrintf("%s: skipping %d unchanged object(s)\n", Package->Name, NumUnchanged);
+	return ChangedExports.Num() > 0;
+
+	unguardf("%s", Package->Name);
+}
+
+void DropExportedFile(const char *ExportPath, const char *FileName)
+{
+	guard(DropExportedFile);
+
+	if (!GExportIncremental) return;
+
+	int Len = strlen(FileName);
+	for (int i = 0; i < ManifestPackages.Num(); i++)
+	{
+		CManifestPackage *Rec = ManifestPackages[i];
+		for (int j = Rec->Exports.Num() - 1; j >= 0; j--)
+		{
+			CManifestExport &E = Rec->Exports[j];
+			if (strcmp(E.ExportPath, ExportPath) != 0) continue;
+			// find the file in tab-separated list
+			const char *s = E.Files;
+			bool Found = false;
+			while (*s && !Found)
+			{
+				const char *end = strchr(s, '\t');
+				if (!end) end = s + strlen(s);
+				Found = (end - s == Len) && !strncmp(s, FileName, Len);
+				s = *end ? end + 1 : end;
+			}
+			if (!Found) continue;
+			appFree(E.ObjectPath);
+			appFree(E.ExportPath);
+			appFree(E.Files);
+			Rec->Exports.RemoveAt(j);
+		}
+	}
+
+	unguardf("%s/%s", ExportPath, FileName);
+}
+
+bool IsExportUpToDate(const UObject *Obj)
+{
+	guard(IsExportUpToDate);
+
+	if (!GExportIncremental || !Obj->Package || Obj->PackageIndex < 0) return false;
+	CManifestPackage *Rec = GetPackageRecord(Obj->Package);
+	return IsExportUnchanged(Rec, Obj->PackageIndex);
+
+	unguardf("%s", Obj->Name);
+}
+
+void RegisterExportedObject(const UObject *Obj, const char *ExportPath, const char *Files)
+{
+	guard(RegisterExportedObject);
+
+	if (!GExportIncremental || !Obj->Package || Obj->PackageIndex < 0) return;
+
+	UnPackage *Package = Obj->Package;
+	CManifestPackage *Rec = GetPackageRecord(Package);
+	int ExportIndex = Obj->PackageIndex;
+	const FObjectExport &Exp = Package->GetExport(ExportIndex);
+	const char *ClassName = Package->GetObjectName(Exp.ClassIndex);
+
+	char ObjectPath[1024];
+	GetExportObjectPath(Package, ExportIndex, ARRAY_ARG(ObjectPath));
+	CManifestExport *E = FindManifestExport(Rec, ClassName, ObjectPath);
+	if (E)
+	{
+		// when package wasn't changed, recorded hash is still valid
+		if (!Rec->Unchanged || E->SerialOffset != Exp.SerialOffset || E->SerialSize != Exp.SerialSize)
+			E->Hash = GetExportHash(Rec, ExportIndex);
+		appFree(E->ExportPath);
+		appFree(E->Files);
+	}
+	else
+	{
+		E = new (Rec->Exports) CManifestExport;
+		E->ClassName  = appStrdupPool(ClassName);
+		E->ObjectPath = appStrdup(ObjectPath);
+		E->Hash       = GetExportHash(Rec, ExportIndex);
+	}
+	E->SerialOffset = Exp.SerialOffset;
+	E->SerialSize   = Exp.SerialSize;
+	E->ExportPath   = appStrdup(ExportPath);
+	E->Files        = appStrdup(Files);
+
+	unguardf("%s", Obj->Name);
+}
@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Threading.h"
 
 #include "UnObject.h"
 #include "UnMaterial.h"
@@ -291,84 +292,144 @@ if (i == 32 || i == 34)
 }
 
 
-void ExportMd5Anim(const CAnimSet *Anim)
+// Number of sequences processed in parallel before writing data to files
+#define MD5_SEQUENCE_BATCH		64
+
+struct CMd5AnimContext
 {
-	guard(ExportMd5Anim);
+	const CAnimSet	*Anim;
+	int				FirstSequence;
+	bool			Skip[MD5_SEQUENCE_BATCH];		// do not export this sequence
+	FMemWriter		Buffers[MD5_SEQUENCE_BATCH];
+};
+
+// Called from worker threads: generates md5anim file contents in the sequence's buffer
+static void ExportMd5AnimSequence(int Index, CMd5AnimContext &Context)
+{
+	guard(ExportMd5AnimSequence);
+
+	if (Context.Skip[Index]) return;
+
+	int i;
+	const CAnimSet *Anim = Context.Anim;
+	const CAnimSequence &S = *Anim->Sequences[Context.FirstSequence + Index];
+	FMemWriter *Ar = &Context.Buffers[Index];
 
 	int numBones = Anim->TrackBoneNames.Num();
-	UObject *OriginalAnim = Anim->OriginalAnim;
 
-	for (int AnimIndex = 0; AnimIndex < Anim->Sequences.Num(); AnimIndex++)
-	{
-		int i;
-		const CAnimSequence &S = *Anim->Sequences[AnimIndex];
+	Ar->Printf(
+		"MD5Version 10\n"
+		"commandline \"Created with UE Viewer\"\n"
+		"\n"
+		"numFrames %d\n"
+		"numJoints %d\n"
+		"frameRate %g\n"
+		"numAnimatedComponents %d\n"
+		"\n",
+		S.NumFrames,
+		numBones,
+		S.Rate,
+		numBones * 6
+	);
 
-		FArchive *Ar = CreateExportArchive(OriginalAnim, "%s/%s.md5anim", OriginalAnim->Name, *S.Name);
-		if (!Ar) continue;
+	// skeleton
+	Ar->Printf("hierarchy {\n");
+	for (i = 0; i < numBones; i++)
+	{
+		Ar->Printf("\t\"%s\" %d %d %d\n", *Anim->TrackBoneNames[i], (i == 0) ? -1 : 0, 63, i * 6);
+			// ParentIndex is unknown for UAnimSet, so always write "0"
+			// here: 6 is number of components per frame, 63 = (1<<6)-1 -- flags "all components are used"
+	}
 
-		Ar->Printf(
-			"MD5Version 10\n"
-			"commandline \"Created with UE Viewer\"\n"
-			"\n"
-			"numFrames %d\n"
-			"numJoints %d\n"
-			"frameRate %g\n"
-			"numAnimatedComponents %d\n"
-			"\n",
-			S.NumFrames,
-			numBones,
-			S.Rate,
-			numBones * 6
-		);
+	// bounds
+	Ar->Printf("}\n\nbounds {\n");
+	for (i = 0; i < S.NumFrames; i++)
+		Ar->Printf("\t( -100 -100 -100 ) ( 100 100 100 )\n");	//!! dummy
+	Ar->Printf("}\n\n");
 
-		// skeleton
-		Ar->Printf("hierarchy {\n");
-		for (i = 0; i < numBones; i++)
+	// baseframe and frames
+	CAnimPoseSampler Sampler(S);
+	TArray<CVec3> PosePos;
+	TArray<CQuat> PoseQuat;
+	PosePos.AddZeroed(S.Tracks.Num());
+	PoseQuat.AddUninitialized(S.Tracks.Num());
+	for (i = 0; i < PoseQuat.Num(); i++)
+		PoseQuat[i].Set(0, 0, 0, 1);		// pose is not changed for tracks without keys
+	for (int Frame = -1; Frame < S.NumFrames; Frame++)
+	{
+		int t = Frame;
+		if (Frame == -1)
 		{
-			Ar->Printf("\t\"%s\" %d %d %d\n", *Anim->TrackBoneNames[i], (i == 0) ? -1 : 0, 63, i * 6);
-				// ParentIndex is unknown for UAnimSet, so always write "0"
-				// here: 6 is number of components per frame, 63 = (1<<6)-1 -- flags "all components are used"
+			Ar->Printf("baseframe {\n");
+			t = 0;
 		}
+		else
+			Ar->Printf("frame %d {\n", Frame);
 
-		// bounds
-		Ar->Printf("}\n\nbounds {\n");
-		for (i = 0; i < S.NumFrames; i++)
-			Ar->Printf("\t( -100 -100 -100 ) ( 100 100 100 )\n");	//!! dummy
-		Ar->Printf("}\n\n");
+		Sampler.SamplePose(t, PosePos.GetData(), PoseQuat.GetData());
 
-		// baseframe and frames
-		for (int Frame = -1; Frame < S.NumFrames; Frame++)
+		for (int b = 0; b < numBones; b++)
 		{
-			int t = Frame;
-			if (Frame == -1)
-			{
-				Ar->Printf("baseframe {\n");
-				t = 0;
-			}
+			CVec3 BP = PosePos[b];
+			CQuat BO = PoseQuat[b];
+			if (!b) BO.Conjugate();			// root bone
+#if MIRROR_MESH
+			BO.y  *= -1;
+			BO.w  *= -1;
+			BP[1] *= -1;					// y
+#endif
+			if (BO.w < 0) BO.Negate();		// W-component of quaternion will be removed ...
+			if (Frame < 0)
+				Ar->Printf("\t( %f %f %f ) ( %.10f %.10f %.10f )\n", VECTOR_ARG(BP), BO.x, BO.y, BO.z);
 			else
-				Ar->Printf("frame %d {\n", Frame);
+				Ar->Printf("\t%f %f %f %.10f %.10f %.10f\n", VECTOR_ARG(BP), BO.x, BO.y, BO.z);
+		}
+		Ar->Printf("}\n\n");
+	}
+
+	unguardf("Seq=%d", Context.FirstSequence + Index);
+}
+
 
-			for (int b = 0; b < numBones; b++)
+void ExportMd5Anim(const CAnimSet *Anim)
+{
+	guard(ExportMd5Anim);
+
+	UObject *OriginalAnim = Anim->OriginalAnim;
+	int numAnims = Anim->Sequences.Num();
+
+	CMd5AnimContext Context;
+	Context.Anim = Anim;
+
+	for (int FirstSeq = 0; FirstSeq < numAnims; FirstSeq += MD5_SEQUENCE_BATCH)
+	{
+		int i;
+		int NumSeqs = min(numAnims - FirstSeq, MD5_SEQUENCE_BATCH);
+		Context.FirstSequence = FirstSeq;
+
+		// don't waste time for files which will not be overwritten
+		for (i = 0; i < NumSeqs; i++)
+		{
+			const CAnimSequence &S = *Anim->Sequences[FirstSeq + i];
+			Context.Skip[i] = GDontOverwriteFiles && CheckExportFilePresence(OriginalAnim, "%s/%s.md5anim", OriginalAnim->Name, *S.Name);
+		}
+
+		// generate file contents in parallel
+		appParallelFor(NumSeqs, ExportMd5AnimSequence, Context);
+
+		// write files in the main thread, CreateExportArchive() is not thread-safe
+		for (i = 0; i < NumSeqs; i++)
+		{
+			if (Context.Skip[i]) continue;
+			const CAnimSequence &S = *Anim->Sequences[FirstSeq + i];
+			FArchive *Ar = CreateExportArchive(OriginalAnim, "%s/%s.md5anim", OriginalAnim->Name, *S.Name);
+			if (Ar)
 			{
-				CVec3 BP;
-				CQuat BO;
-				S.Tracks[b].GetBonePosition(t, S.NumFrames, false, BP, BO);
-				if (!b) BO.Conjugate();			// root bone
-#if MIRROR_MESH
-				BO.y  *= -1;
-				BO.w  *= -1;
-				BP[1] *= -1;					// y
-#endif
-				if (BO.w < 0) BO.Negate();		// W-component of quaternion will be removed ...
-				if (Frame < 0)
-					Ar->Printf("\t( %f %f %f ) ( %.10f %.10f %.10f )\n", VECTOR_ARG(BP), BO.x, BO.y, BO.z);
-				else
-					Ar->Printf("\t%f %f %f %.10f %.10f %.10f\n", VECTOR_ARG(BP), BO.x, BO.y, BO.z);
+				Context.Buffers[i].WriteTo(*Ar);
+				delete Ar;
 			}
-			Ar->Printf("}\n\n");
+			Context.Buffers[i].Reset();
 		}
-
-		delete Ar;
 	}
 
 	unguard;
@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Threading.h"
 
 #include "UnObject.h"
 #include "UnMaterial.h"
@@ -62,6 +63,32 @@ static void ExportScript(const CSkeletalMesh *Mesh, FArchive &Ar)
 }
 
 
+#if MIRROR_MESH
+
+// Negate Y component of all points
+static void MirrorPoints(CVec3 *Points, int NumPoints)
+{
+	float *F = Points->v;
+	int i = 0;
+#if USE_SSE
+	// 4 points are packed into 3 SSE registers as "xyzx yzxy zxyz", flip sign bit of Y values
+	const __m128 Mask0 = _mm_set_ps(0, 0, -0.0f, 0);
+	const __m128 Mask1 = _mm_set_ps(-0.0f, 0, 0, -0.0f);
+	const __m128 Mask2 = _mm_set_ps(0, -0.0f, 0, 0);
+	for ( ; i + 4 <= NumPoints; i += 4, F += 12)
+	{
+		_mm_storeu_ps(F,     _mm_xor_ps(_mm_loadu_ps(F),     Mask0));
+		_mm_storeu_ps(F + 4, _mm_xor_ps(_mm_loadu_ps(F + 4), Mask1));
+		_mm_storeu_ps(F + 8, _mm_xor_ps(_mm_loadu_ps(F + 8), Mask2));
+	}
+#endif // USE_SSE
+	for ( ; i < NumPoints; i++, F += 3)
+		F[1] = -F[1];
+}
+
+#endif // MIRROR_MESH
+
+
 // Common code for psk format, shared between CSkeletalMesh and CStaticMesh
 
 #define VERT(n)		OffsetPointer(Verts, VertexSize * (n))
@@ -77,8 +104,7 @@ static void ExportCommonMeshData
 {
 	guard(ExportCommonMeshData);
 
-	// using 'static' here to avoid zero-filling unused fields
-	static VChunkHeader MainHdr, PtsHdr, WedgHdr, FacesHdr, MatrHdr;
+	VChunkHeader MainHdr, PtsHdr, WedgHdr, FacesHdr, MatrHdr;
 	int i;
 
 #define SECT(n)		(Sections + n)
@@ -89,14 +115,15 @@ static void ExportCommonMeshData
 	PtsHdr.DataCount = Share.Points.Num();
 	PtsHdr.DataSize  = sizeof(FVector);
 	SAVE_CHUNK(PtsHdr, "PNTS0000");
-	for (i = 0; i < Share.Points.Num(); i++)
-	{
-		FVector V = (FVector&) Share.Points[i];
 #if MIRROR_MESH
-		V.Y = -V.Y;
+	TArray<CVec3> Points;
+	Points.AddUninitialized(Share.Points.Num());
+	memcpy(Points.GetData(), Share.Points.GetData(), Points.Num() * sizeof(CVec3));
+	MirrorPoints(Points.GetData(), Points.Num());
+	SaveChunkData(Ar, (FVector*)Points.GetData(), Points.Num());
+#else
+	SaveChunkData(Ar, (FVector*)Share.Points.GetData(), Share.Points.Num());
 #endif
-		Ar << V;
-	}
 
 	// get number of faces (some Gears3 meshes may have index buffer larger than needed)
 	// get wedge-material mapping
@@ -119,9 +146,11 @@ static void ExportCommonMeshData
 	WedgHdr.DataCount = NumVerts;
 	WedgHdr.DataSize  = sizeof(VVertex);
 	SAVE_CHUNK(WedgHdr, "VTXW0000");
+	TArray<VVertex> Wedges;
+	Wedges.AddUninitialized(NumVerts);
 	for (i = 0; i < NumVerts; i++)
 	{
-		VVertex W;
+		VVertex &W = Wedges[i];
 		const CMeshVertex &S = *VERT(i);
 		W.PointIndex = Share.WedgeToVert[i];
 		W.U          = S.UV.U;
@@ -129,35 +158,38 @@ static void ExportCommonMeshData
 		W.MatIndex   = WedgeMat[i];
 		W.Reserved   = 0;
 		W.Pad        = 0;
-		Ar << W;
 	}
+	SaveChunkData(Ar, Wedges.GetData(), Wedges.Num());
+	Wedges.Empty();
 
 	if (NumVerts <= 65536)
 	{
 		FacesHdr.DataCount = numFaces;
 		FacesHdr.DataSize  = sizeof(VTriangle16);
 		SAVE_CHUNK(FacesHdr, "FACE0000");
+		TArray<VTriangle16> Faces;
+		Faces.AddUninitialized(numFaces);
+		VTriangle16 *T = Faces.GetData();
 		for (i = 0; i < NumSections; i++)
 		{
 			const CMeshSection &Sec = *SECT(i);
-			for (int j = 0; j < Sec.NumFaces; j++)
+			for (int j = 0; j < Sec.NumFaces; j++, T++)
 			{
-				VTriangle16 T;
 				for (int k = 0; k < 3; k++)
 				{
 					int idx = Index(Sec.FirstIndex + j * 3 + k);
 					assert(idx >= 0 && idx < 65536);
-					T.WedgeIndex[k] = idx;
+					T->WedgeIndex[k] = idx;
 				}
-				T.MatIndex        = i;
-				T.AuxMatIndex     = 0;
-				T.SmoothingGroups = 1;
+				T->MatIndex        = i;
+				T->AuxMatIndex     = 0;
+				T->SmoothingGroups = 1;
 #if MIRROR_MESH
-				Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
+				Exchange(T->WedgeIndex[0], T->WedgeIndex[1]);
 #endif
-				Ar << T;
 			}
 		}
+		SaveChunkData(Ar, Faces.GetData(), Faces.Num());
 	}
 	else
 	{
@@ -165,26 +197,33 @@ static void ExportCommonMeshData
 		FacesHdr.DataCount = numFaces;
 		FacesHdr.DataSize  = 18; // sizeof(VTriangle32) without alignment
 		SAVE_CHUNK(FacesHdr, "FACE3200");
+		// VTriangle32 has different in-memory layout, so build on-disk data manually
+		assert(!Ar.ReverseBytes);
+		TArray<byte> Faces;
+		Faces.AddUninitialized(numFaces * FacesHdr.DataSize);
+		byte *T = Faces.GetData();
 		for (i = 0; i < NumSections; i++)
 		{
 			const CMeshSection &Sec = *SECT(i);
-			for (int j = 0; j < Sec.NumFaces; j++)
+			for (int j = 0; j < Sec.NumFaces; j++, T += FacesHdr.DataSize)
 			{
-				VTriangle32 T;
+				int WedgeIndex[3];
 				for (int k = 0; k < 3; k++)
 				{
 					int idx = Index(Sec.FirstIndex + j * 3 + k);
-					T.WedgeIndex[k] = idx;
+					WedgeIndex[k] = idx;
 				}
-				T.MatIndex        = i;
-				T.AuxMatIndex     = 0;
-				T.SmoothingGroups = 1;
 #if MIRROR_MESH
-				Exchange(T.WedgeIndex[0], T.WedgeIndex[1]);
+				Exchange(WedgeIndex[0], WedgeIndex[1]);
 #endif
-				Ar << T;
+				uint32 SmoothingGroups = 1;
+				memcpy(T, WedgeIndex, sizeof(WedgeIndex));
+				T[12] = i;							// MatIndex
+				T[13] = 0;							// AuxMatIndex
+				memcpy(T + 14, &SmoothingGroups, sizeof(SmoothingGroups));
 			}
 		}
+		Ar.Serialize(Faces.GetData(), Faces.Num());
 	}
 
 	MatrHdr.DataCount = NumSections;
@@ -222,7 +261,7 @@ static void ExportExtraUV
 {
 	guard(ExportExtraUV);
 
-	static VChunkHeader UVHdr;
+	VChunkHeader UVHdr;
 	UVHdr.DataCount = NumVerts;
 	UVHdr.DataSize  = sizeof(VMeshUV);
 
@@ -231,14 +270,8 @@ static void ExportExtraUV
 		char chunkName[32];
 		appSprintf(ARRAY_ARG(chunkName), "EXTRAUVS%d", j-1);
 		SAVE_CHUNK(UVHdr, chunkName);
-		const CMeshUVFloat* SUV = ExtraUV[j-1];
-		for (int i = 0; i < NumVerts; i++, SUV++)
-		{
-			VMeshUV UV;
-			UV.U = SUV->U;
-			UV.V = SUV->V;
-			Ar << UV;
-		}
+		// CMeshUVFloat has the same layout as VMeshUV
+		SaveChunkData(Ar, (const VMeshUV*)ExtraUV[j-1], NumVerts);
 	}
 
 	unguard;
@@ -249,8 +282,7 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 {
 	guard(ExportSkeletalMeshLod);
 
-	// using 'static' here to avoid zero-filling unused fields
-	static VChunkHeader BoneHdr, InfHdr;
+	VChunkHeader BoneHdr, InfHdr;
 
 	int i, j;
 	CVertexShare Share;
@@ -291,18 +323,23 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 	BoneHdr.DataCount = numBones;
 	BoneHdr.DataSize  = sizeof(VBone);
 	SAVE_CHUNK(BoneHdr, "REFSKELT");
+	// count NumChildren
+	TArray<int> NumChildren;
+	NumChildren.AddZeroed(numBones);
+	for (i = 0; i < numBones; i++)
+	{
+		int ParentIndex = Mesh.RefSkeleton[i].ParentIndex;
+		if (ParentIndex != i && ParentIndex >= 0 && ParentIndex < numBones)
+			NumChildren[ParentIndex]++;
+	}
+	TArray<VBone> Bones;
+	Bones.AddZeroed(numBones);
 	for (i = 0; i < numBones; i++)
 	{
-		VBone B;
-		memset(&B, 0, sizeof(B));
+		VBone &B = Bones[i];
 		const CSkelMeshBone &S = Mesh.RefSkeleton[i];
 		strcpy(B.Name, S.Name);
-		// count NumChildren
-		int NumChildren = 0;
-		for (j = 0; j < numBones; j++)
-			if ((j != i) && (Mesh.RefSkeleton[j].ParentIndex == i))
-				NumChildren++;
-		B.NumChildren = NumChildren;
+		B.NumChildren = NumChildren[i];
 		B.ParentIndex = S.ParentIndex;
 		B.BonePos.Position    = (FVector&) S.Position;
 		B.BonePos.Orientation = (FQuat&)   S.Orientation;
@@ -312,9 +349,8 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 		B.BonePos.Orientation.W *= -1;
 		B.BonePos.Position.Y    *= -1;
 #endif
-
-		Ar << B;
 	}
+	SaveChunkData(Ar, Bones.GetData(), Bones.Num());
 
 	// count influences
 	int NumInfluences = 0;
@@ -332,6 +368,9 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 	InfHdr.DataCount = NumInfluences;
 	InfHdr.DataSize  = sizeof(VRawBoneInfluence);
 	SAVE_CHUNK(InfHdr, "RAWWEIGHTS");
+	TArray<VRawBoneInfluence> Influences;
+	Influences.AddUninitialized(NumInfluences);
+	VRawBoneInfluence *I = Influences.GetData();
 	for (i = 0; i < Share.Points.Num(); i++)
 	{
 		int WedgeIndex = Share.VertToWedge[i];
@@ -343,14 +382,14 @@ static void ExportSkeletalMeshLod(const CSkeletalMesh &Mesh, const CSkelMeshLod
 			if (V.Bone[j] < 0) break;
 			NumInfluences--;				// just for verification
 
-			VRawBoneInfluence I;
-			I.Weight     = UnpackedWeights.v[j];
-			I.BoneIndex  = V.Bone[j];
-			I.PointIndex = i;
-			Ar << I;
+			I->Weight     = UnpackedWeights.v[j];
+			I->BoneIndex  = V.Bone[j];
+			I->PointIndex = i;
+			I++;
 		}
 	}
 	assert(NumInfluences == 0);
+	SaveChunkData(Ar, Influences.GetData(), Influences.Num());
 
 	ExportExtraUV(Ar, Lod.ExtraUV, Lod.NumVerts, Lod.NumTexCoords);
 
@@ -412,10 +451,73 @@ void ExportPsk(const CSkeletalMesh *Mesh)
 }
 
 
+// Number of sequences processed in parallel before writing data to the file. Limits
+// amount of memory used for temporary key buffers.
+#define PSA_SEQUENCE_BATCH		64
+
+struct CPsaKeysContext
+{
+	const CAnimSet	*Anim;
+	int				FirstSequence;
+	FMemWriter		Buffers[PSA_SEQUENCE_BATCH];
+};
+
+// Called from worker threads: samples all frames of the sequence and saves VQuatAnimKey's
+// into the sequence's buffer.
+static void ExportPsaSequenceKeys(int Index, CPsaKeysContext &Context)
+{
+	guard(ExportPsaSequenceKeys);
+
+	const CAnimSequence &S = *Context.Anim->Sequences[Context.FirstSequence + Index];
+	FMemWriter &Ar = Context.Buffers[Index];
+
+	int numBones = Context.Anim->TrackBoneNames.Num();
+	assert(S.Tracks.Num() == numBones);
+
+	TArray<CVec3> PosePos;
+	TArray<CQuat> PoseQuat;
+	TArray<VQuatAnimKey> Keys;
+	PosePos.AddUninitialized(numBones);
+	PoseQuat.AddUninitialized(numBones);
+	Keys.AddUninitialized(numBones);
+	Ar.Reserve(S.NumFrames * numBones * sizeof(VQuatAnimKey));
+
+	CAnimPoseSampler Sampler(S);
+	for (int t = 0; t < S.NumFrames; t++)
+	{
+		// SamplePose() will not alter pose when animation tracks are not exists
+		for (int b = 0; b < numBones; b++)
+		{
+			PosePos[b].Set(0, 0, 0);
+			PoseQuat[b].Set(0, 0, 0, 1);
+		}
+		Sampler.SamplePose(t, PosePos.GetData(), PoseQuat.GetData());
+
+		for (int b = 0; b < numBones; b++)
+		{
+			VQuatAnimKey &K = Keys[b];
+			const CVec3 &BP = PosePos[b];
+			const CQuat &BO = PoseQuat[b];
+
+			K.Position    = (FVector&) BP;
+			K.Orientation = (FQuat&)   BO;
+			K.Time        = 1;
+#if MIRROR_MESH
+			K.Orientation.Y *= -1;
+			K.Orientation.W *= -1;
+			K.Position.Y    *= -1;
+#endif
+		}
+		SaveChunkData(Ar, Keys.GetData(), numBones);
+	}
+
+	unguardf("Seq=%d", Context.FirstSequence + Index);
+}
+
+
 void ExportPsa(const CAnimSet *Anim)
 {
-	// using 'static' here to avoid zero-filling unused fields
-	static VChunkHeader MainHdr, BoneHdr, AnimHdr, KeyHdr;
+	VChunkHeader MainHdr, BoneHdr, AnimHdr, KeyHdr;
 	int i;
 
 	if (!Anim->Sequences.Num()) return;			// empty CAnimSet
@@ -434,18 +536,19 @@ void ExportPsa(const CAnimSet *Anim)
 	BoneHdr.DataCount = numBones;
 	BoneHdr.DataSize  = sizeof(FNamedBoneBinary);
 	SAVE_CHUNK(BoneHdr, "BONENAMES");
+	TArray<FNamedBoneBinary> Bones;
+	Bones.AddZeroed(numBones);
 	for (i = 0; i < numBones; i++)
 	{
-		FNamedBoneBinary B;
-		memset(&B, 0, sizeof(B));
+		FNamedBoneBinary &B = Bones[i];
 		assert(strlen(*Anim->TrackBoneNames[i]) < sizeof(B.Name));
 		strcpy(B.Name, *Anim->TrackBoneNames[i]);
 		B.Flags       = 0;						// reserved
 		B.NumChildren = 0;						// unknown here
 		B.ParentIndex = (i > 0) ? 0 : -1;		// unknown for UAnimSet
 //		B.BonePos     =							// unknown here
-		Ar << B;
 	}
+	SaveChunkData(Ar, Bones.GetData(), Bones.Num());
 
 	AnimHdr.DataCount = numAnims;
 	AnimHdr.DataSize  = sizeof(AnimInfoBinary);
@@ -478,36 +581,31 @@ void ExportPsa(const CAnimSet *Anim)
 	KeyHdr.DataSize  = sizeof(VQuatAnimKey);
 	SAVE_CHUNK(KeyHdr, "ANIMKEYS");
 	bool requireConfig = false;
-	for (i = 0; i < numAnims; i++)
+	CPsaKeysContext Context;
+	Context.Anim = Anim;
+	for (int FirstSeq = 0; FirstSeq < numAnims; FirstSeq += PSA_SEQUENCE_BATCH)
 	{
-		const CAnimSequence &S = *Anim->Sequences[i];
-		for (int t = 0; t < S.NumFrames; t++)
+		// sample a batch of sequences in parallel
+		int NumSeqs = min(numAnims - FirstSeq, PSA_SEQUENCE_BATCH);
+		Context.FirstSequence = FirstSeq;
+		for (i = 0; i < NumSeqs; i++)
+			Context.Buffers[i].SetupFrom(Ar);
+		appParallelFor(NumSeqs, ExportPsaSequenceKeys, Context);
+
+		// write keys in original sequence order
+		for (i = 0; i < NumSeqs; i++)
 		{
-			for (int b = 0; b < numBones; b++)
-			{
-				VQuatAnimKey K;
-				CVec3 BP;
-				CQuat BO;
+			const CAnimSequence &S = *Anim->Sequences[FirstSeq + i];
+			Context.Buffers[i].WriteTo(Ar);
+			Context.Buffers[i].Reset();
+			keysCount -= S.NumFrames * numBones;
 
-				BP.Set(0, 0, 0);			// GetBonePosition() will not alter BP and BO when animation tracks are not exists
-				BO.Set(0, 0, 0, 1);
-				S.Tracks[b].GetBonePosition(t, S.NumFrames, false, BP, BO);
-
-				K.Position    = (FVector&) BP;
-				K.Orientation = (FQuat&)   BO;
-				K.Time        = 1;
-#if MIRROR_MESH
-				K.Orientation.Y *= -1;
-				K.Orientation.W *= -1;
-				K.Position.Y    *= -1;
-#endif
-
-				Ar << K;
-				keysCount--;
-
-				// check for user error
-				if ((S.Tracks[b].KeyPos.Num() == 0) || (S.Tracks[b].KeyQuat.Num() == 0))
-					requireConfig = true;
+			// check for user error
+			if (S.NumFrames)
+			{
+				for (int b = 0; b < numBones; b++)
+					if ((S.Tracks[b].KeyPos.Num() == 0) || (S.Tracks[b].KeyQuat.Num() == 0))
+						requireConfig = true;
 			}
 		}
 	}
@@ -573,8 +671,7 @@ static void ExportStaticMeshLod(const CStaticMeshLod &Lod, FArchive &Ar)
 {
 	guard(ExportStaticMeshLod);
 
-	// using 'static' here to avoid zero-filling unused fields
-	static VChunkHeader BoneHdr, InfHdr;
+	VChunkHeader BoneHdr, InfHdr;
 
 	CVertexShare Share;
 
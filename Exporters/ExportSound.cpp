@@ -30,6 +30,14 @@ static void SaveSound(const UObject *Obj, void *Data, int DataSize, const char *
 	else if (!memcmp(Data, "MSFC", 4))
 		ext = "mp3";		// PS3 MP3 codec
 
+	if (GExportDedup)
+	{
+		CContentHash Hash;
+		Hash.Update(ext);
+		Hash.Update(Data, DataSize);
+		if (LinkDuplicateContent(Obj, Hash)) return;
+	}
+
 	FArchive *Ar = CreateExportArchive(Obj, "%s.%s", Obj->Name, ext);
 	if (Ar)
 	{
@@ -229,7 +237,11 @@ void ExportSoundNodeWave(const USoundNodeWave *Snd)
 		bulk = &Snd->CompressedXbox360Data;
 		ext  = "x360audio";
 #if XMA_EXPORT
-		if (SaveXMASound(Snd, bulk->BulkData, bulk->ElementCount, "xma")) return;
+		if (SaveXMASound(Snd, bulk->GetData(), bulk->ElementCount, "xma"))
+		{
+			const_cast<FByteBulkData*>(bulk)->ReleaseData();
+			return;
+		}
 		// else - detect format by data tags, like for PC
 #endif
 	}
@@ -246,7 +258,8 @@ void ExportSoundNodeWave(const USoundNodeWave *Snd)
 
 	if (bulk)
 	{
-		SaveSound(Snd, OffsetPointer(bulk->BulkData, extraHeaderSize), bulk->ElementCount - extraHeaderSize, ext);
+		SaveSound(Snd, OffsetPointer(bulk->GetData(), extraHeaderSize), bulk->ElementCount - extraHeaderSize, ext);
+		const_cast<FByteBulkData*>(bulk)->ReleaseData();
 	}
 }
 
@@ -273,7 +286,8 @@ void ExportSoundWave4(const USoundWave *Snd)
 
 	if (bulk)
 	{
-		SaveSound(Snd, bulk->BulkData, bulk->ElementCount, ext);
+		SaveSound(Snd, bulk->GetData(), bulk->ElementCount, ext);
+		const_cast<FByteBulkData*>(bulk)->ReleaseData();
 	}
 }
 
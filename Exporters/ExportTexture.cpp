@@ -39,6 +39,7 @@ struct GCC_PACK tgaHdr_t
 
 bool GNoTgaCompress = false;
 bool GExportDDS = false;
+bool GExportPassthrough = false;
 
 //?? place this function outside (cannot place to Core - using FArchive)
 
@@ -187,7 +188,7 @@ void WriteTGA(FArchive &Ar, int width, int height, byte *pic)
 }
 
 
-static void WriteDDS(const CTextureData &TexData, const char *Filename)
+static void WriteDDS(const UUnrealMaterial *Tex, const CTextureData &TexData)
 {
 	guard(WriteDDS);
 
@@ -210,12 +211,11 @@ static void WriteDDS(const CTextureData &TexData, const char *Filename)
 //	header.setNormalFlag(TexData.Format == TPF_DXT5N || TexData.Format == TPF_3DC); -- required for decompression only
 	header.setLinearSize(Mip.DataSize);
 
-	appMakeDirectoryForFile(Filename);
-
 	byte headerBuffer[128];							// DDS header is 128 bytes long
 	memset(headerBuffer, 0, 128);
 	WriteDDSHeader(headerBuffer, header);
-	FArchive *Ar = new FFileWriter(Filename);
+	FArchive *Ar = CreateExportArchive(Tex, "%s.dds", Tex->Name);
+	if (!Ar) return;
 	Ar->Serialize(headerBuffer, 128);
 	Ar->Serialize(const_cast<byte*>(Mip.CompressedData), Mip.DataSize);
 	delete Ar;
@@ -224,6 +224,235 @@ static void WriteDDS(const CTextureData &TexData, const char *Filename)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Compressed texture passthrough
+-----------------------------------------------------------------------------*/
+
+// Compressed blocks are saved as is, with all mipmaps: PC formats are saved as DDS with DX10
+// header, mobile formats - as KTX2.
+
+// Khronos Data Format Specification: color models and channels
+#define KDF_MODEL_ETC2			161
+#define KDF_MODEL_ASTC			162
+#define KDF_MODEL_PVRTC			164
+#define KDF_CHANNEL_DATA		0		// ASTC, PVRTC
+#define KDF_CHANNEL_ETC2_COLOR	2
+#define KDF_CHANNEL_ETC2_ALPHA	15
+#define KDF_CHANNEL_NONE		0xFF
+
+struct CContainerFormat
+{
+	ETexturePixelFormat	Format;
+	unsigned			DXGIFormat;			// DDS format, 0 when saved as KTX2
+	unsigned			VkFormat;			// KTX2 format
+	byte				ColorModel;			// KTX2 data format descriptor
+	byte				Channel0;			// channel of 1st sample
+	byte				Channel1;			// channel of 2nd sample, KDF_CHANNEL_NONE when block has a single sample
+};
+
+static const CContainerFormat ContainerFormats[] =
+{
+	// Format			DXGIFormat	VkFormat	ColorModel		Channel0				Channel1
+	{ TPF_DXT1,			71,			0,			0,				0,						0						},	// BC1_UNORM
+	{ TPF_DXT3,			74,			0,			0,				0,						0						},	// BC2_UNORM
+	{ TPF_DXT5,			77,			0,			0,				0,						0						},	// BC3_UNORM
+	{ TPF_DXT5N,		77,			0,			0,				0,						0						},	// BC3_UNORM
+	{ TPF_BC5,			83,			0,			0,				0,						0						},	// BC5_UNORM
+	{ TPF_BC7,			98,			0,			0,				0,						0						},	// BC7_UNORM
+#if SUPPORT_IPHONE
+	{ TPF_PVRTC2,		0,	1000054000,			KDF_MODEL_PVRTC, KDF_CHANNEL_DATA,		KDF_CHANNEL_NONE		},	// PVRTC1_2BPP_UNORM_BLOCK_IMG
+	{ TPF_PVRTC4,		0,	1000054001,			KDF_MODEL_PVRTC, KDF_CHANNEL_DATA,		KDF_CHANNEL_NONE		},	// PVRTC1_4BPP_UNORM_BLOCK_IMG
+#endif
+#if SUPPORT_ANDROID
+	{ TPF_ETC1,			0,			147,		KDF_MODEL_ETC2,	KDF_CHANNEL_ETC2_COLOR,	KDF_CHANNEL_NONE		},	// ETC2_R8G8B8_UNORM_BLOCK
+	{ TPF_ETC2_RGB,		0,			147,		KDF_MODEL_ETC2,	KDF_CHANNEL_ETC2_COLOR,	KDF_CHANNEL_NONE		},	// ETC2_R8G8B8_UNORM_BLOCK
+	{ TPF_ETC2_RGBA,	0,			151,		KDF_MODEL_ETC2,	KDF_CHANNEL_ETC2_ALPHA,	KDF_CHANNEL_ETC2_COLOR	},	// ETC2_R8G8B8A8_UNORM_BLOCK
+	{ TPF_ASTC_4x4,		0,			157,		KDF_MODEL_ASTC,	KDF_CHANNEL_DATA,		KDF_CHANNEL_NONE		},	// ASTC_4x4_UNORM_BLOCK
+	{ TPF_ASTC_6x6,		0,			165,		KDF_MODEL_ASTC,	KDF_CHANNEL_DATA,		KDF_CHANNEL_NONE		},	// ASTC_6x6_UNORM_BLOCK
+	{ TPF_ASTC_8x8,		0,			171,		KDF_MODEL_ASTC,	KDF_CHANNEL_DATA,		KDF_CHANNEL_NONE		},	// ASTC_8x8_UNORM_BLOCK
+	{ TPF_ASTC_10x10,	0,			179,		KDF_MODEL_ASTC,	KDF_CHANNEL_DATA,		KDF_CHANNEL_NONE		},	// ASTC_10x10_UNORM_BLOCK
+	{ TPF_ASTC_12x12,	0,			183,		KDF_MODEL_ASTC,	KDF_CHANNEL_DATA,		KDF_CHANNEL_NONE		},	// ASTC_12x12_UNORM_BLOCK
+#endif // SUPPORT_ANDROID
+};
+
+// Find mipmaps which could be stored as a mip chain, and compute their data sizes
+static void GetMipChain(const CTextureData &TexData, TArray<int> &MipSizes)
+{
+	const CPixelFormatInfo &Info = PixelFormatInfo[TexData.Format];
+	const CMipMap &Base = TexData.Mips[0];
+	for (int i = 0; i < TexData.Mips.Num(); i++)
+	{
+		const CMipMap &Mip = TexData.Mips[i];
+		if (Mip.USize != max(Base.USize >> i, 1) || Mip.VSize != max(Base.VSize >> i, 1))
+			break;
+		int Size = ((Mip.USize + Info.BlockSizeX - 1) / Info.BlockSizeX) * ((Mip.VSize + Info.BlockSizeY - 1) / Info.BlockSizeY)
+			* Info.BytesPerBlock;
+		if (!Mip.CompressedData || Mip.DataSize < Size)
+			break;
+		MipSizes.Add(Size);
+	}
+}
+
+static void WriteDDS10(FArchive &Ar, const CTextureData &TexData, const CContainerFormat &Fmt, const TArray<int> &MipSizes)
+{
+	guard(WriteDDS10);
+
+	const CMipMap &Mip = TexData.Mips[0];
+
+	nv::DDSHeader header;
+	header.setFourCC('D', 'X', '1', '0');
+	header.setDX10Format(Fmt.DXGIFormat);
+	header.setTexture2D();
+	header.header10.arraySize = 1;
+	header.setWidth(Mip.USize);
+	header.setHeight(Mip.VSize);
+	header.setLinearSize(MipSizes[0]);
+	header.setMipmapCount(MipSizes.Num());
+
+	byte headerBuffer[148];							// DDS header with DX10 extension
+	memset(headerBuffer, 0, sizeof(headerBuffer));
+	WriteDDSHeader(headerBuffer, header);
+	Ar.Serialize(headerBuffer, sizeof(headerBuffer));
+	for (int i = 0; i < MipSizes.Num(); i++)
+		Ar.Serialize(const_cast<byte*>(TexData.Mips[i].CompressedData), MipSizes[i]);
+
+	unguard;
+}
+
+static void WriteKTX2(FArchive &Ar, const CTextureData &TexData, const CContainerFormat &Fmt, const TArray<int> &MipSizes)
+{
+	guard(WriteKTX2);
+
+	static const byte Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	const CPixelFormatInfo &Info = PixelFormatInfo[TexData.Format];
+	int NumMips = MipSizes.Num();
+	int i;
+
+	// data format descriptor with a single basic descriptor block
+	int NumSamples = (Fmt.Channel1 != KDF_CHANNEL_NONE) ? 2 : 1;
+	int SampleBits = Info.BytesPerBlock * 8 / NumSamples;
+	uint32 Dfd[7 + 2 * 4];
+	int DfdSize = (7 + NumSamples * 4) * sizeof(uint32);
+	Dfd[0] = DfdSize;
+	Dfd[1] = 0;												// vendor: Khronos, descriptor type: basic
+	Dfd[2] = 2 | ((24 + NumSamples * 16) << 16);			// version, descriptor block size
+	Dfd[3] = Fmt.ColorModel | (1 << 8) | (1 << 16);			// color model, BT.709 primaries, linear transfer
+	Dfd[4] = (Info.BlockSizeX - 1) | ((Info.BlockSizeY - 1) << 8);
+	Dfd[5] = Info.BytesPerBlock;							// bytes in plane 0
+	Dfd[6] = 0;
+	for (i = 0; i < NumSamples; i++)
+	{
+		uint32 *Sample = Dfd + 7 + i * 4;
+		Sample[0] = (i * SampleBits) | ((SampleBits - 1) << 16) | ((i ? Fmt.Channel1 : Fmt.Channel0) << 24);
+		Sample[1] = 0;										// sample position
+		Sample[2] = 0;										// lower value
+		Sample[3] = 0xFFFFFFFF;								// upper value
+	}
+
+	// file layout: header, level index, DFD, then mip levels from the smallest one to the largest
+	int DfdOffset = 80 + NumMips * 24;
+	int Offset = Align(DfdOffset + DfdSize, Info.BytesPerBlock);
+	TArray<uint64> LevelIndex;
+	LevelIndex.AddZeroed(NumMips * 3);
+	for (i = NumMips - 1; i >= 0; i--)
+	{
+		LevelIndex[i * 3]     = Offset;
+		LevelIndex[i * 3 + 1] = MipSizes[i];
+		LevelIndex[i * 3 + 2] = MipSizes[i];				// uncompressed size, the same without supercompression
+		Offset = Align(Offset + MipSizes[i], Info.BytesPerBlock);
+	}
+
+	uint32 Header[17];
+	Header[0]  = Fmt.VkFormat;
+	Header[1]  = 1;											// typeSize
+	Header[2]  = TexData.Mips[0].USize;
+	Header[3]  = TexData.Mips[0].VSize;
+	Header[4]  = 0;											// pixelDepth
+	Header[5]  = 0;											// layerCount
+	Header[6]  = 1;											// faceCount
+	Header[7]  = NumMips;
+	Header[8]  = 0;											// supercompressionScheme
+	Header[9]  = DfdOffset;
+	Header[10] = DfdSize;
+	Header[11] = Header[12] = 0;							// key/value data
+	Header[13] = Header[14] = Header[15] = Header[16] = 0;	// supercompression global data (64-bit offset and size)
+
+	Ar.Serialize(const_cast<byte*>(Identifier), sizeof(Identifier));
+	Ar.Serialize(Header, sizeof(Header));
+	Ar.Serialize(&LevelIndex[0], NumMips * 3 * sizeof(uint64));
+	Ar.Serialize(Dfd, DfdSize);
+
+	static byte Padding[16];
+	int Pos = DfdOffset + DfdSize;
+	for (i = NumMips - 1; i >= 0; i--)
+	{
+		int Start = (int)LevelIndex[i * 3];
+		Ar.Serialize(Padding, Start - Pos);
+		Ar.Serialize(const_cast<byte*>(TexData.Mips[i].CompressedData), MipSizes[i]);
+		Pos = Start + MipSizes[i];
+	}
+
+	unguard;
+}
+
+// Hash of texture data for LinkDuplicateContent(). Export options are hashed too, because they
+// affect format of exported files.
+static void GetTextureContentHash(const CTextureData &TexData, CContentHash &Hash)
+{
+	guard(GetTextureContentHash);
+
+	byte Options[4] = { GExportPassthrough, GExportDDS, GNoTgaCompress, TexData.isNormalmap };
+	Hash.Update(Options, sizeof(Options));
+	Hash.UpdateValue(TexData.Format);
+	for (int i = 0; i < TexData.Mips.Num(); i++)
+	{
+		const CMipMap &Mip = TexData.Mips[i];
+		int Header[3] = { Mip.USize, Mip.VSize, Mip.DataSize };
+		Hash.Update(Header, sizeof(Header));
+		if (Mip.CompressedData)
+			Hash.Update(Mip.CompressedData, Mip.DataSize);
+	}
+
+	unguard;
+}
+
+// Save compressed texture data without decoding. Returns false when texture format is not
+// supported, so texture should be exported in a regular way.
+static bool ExportCompressedTexture(const UUnrealMaterial *Tex, const CTextureData &TexData)
+{
+	guard(ExportCompressedTexture);
+
+	const CContainerFormat *Fmt = NULL;
+	for (int i = 0; i < ARRAY_COUNT(ContainerFormats); i++)
+	{
+		if (ContainerFormats[i].Format == TexData.Format)
+		{
+			Fmt = &ContainerFormats[i];
+			break;
+		}
+	}
+	if (!Fmt || !TexData.Mips.Num()) return false;
+
+	TArray<int> MipSizes;
+	GetMipChain(TexData, MipSizes);
+	if (!MipSizes.Num()) return false;
+
+	FArchive *Ar = CreateExportArchive(Tex, Fmt->DXGIFormat ? "%s.dds" : "%s.ktx2", Tex->Name);
+	if (Ar)
+	{
+		if (Fmt->DXGIFormat)
+			WriteDDS10(*Ar, TexData, *Fmt, MipSizes);
+		else
+			WriteKTX2(*Ar, TexData, *Fmt, MipSizes);
+		delete Ar;
+	}
+	return true;
+
+	unguard;
+}
+
+
 void ExportTexture(const UUnrealMaterial *Tex)
 {
 	guard(ExportTexture);
@@ -232,6 +461,7 @@ void ExportTexture(const UUnrealMaterial *Tex)
 	{
 		if (CheckExportFilePresence(Tex, "%s.tga", Tex->Name)) return;
 		if (CheckExportFilePresence(Tex, "%s.dds", Tex->Name)) return;
+		if (CheckExportFilePresence(Tex, "%s.ktx2", Tex->Name)) return;
 		if (CheckExportFilePresence(Tex, "%s.png", Tex->Name)) return;
 	}
 
@@ -243,16 +473,19 @@ void ExportTexture(const UUnrealMaterial *Tex)
 		// ETextureSourceFormat enum to determine exact format.
 		const UTexture3* Tex3 = static_cast<const UTexture3*>(Tex);
 		const FByteBulkData& Bulk = Tex3->SourceArt;
-		if (Bulk.BulkData && memcmp(Bulk.BulkData, "\x89PNG", 4) == 0)
+		const byte* BulkData = Bulk.GetData();
+		if (BulkData && memcmp(BulkData, "\x89PNG", 4) == 0)
 		{
 			FArchive *Ar = CreateExportArchive(Tex, "%s.png", Tex->Name);
 			if (Ar)
 			{
-				Ar->Serialize(Bulk.BulkData, Bulk.ElementCount * Bulk.GetElementSize());
+				Ar->Serialize(const_cast<byte*>(BulkData), Bulk.ElementCount * Bulk.GetElementSize());
 				delete Ar;
 			}
+			const_cast<FByteBulkData*>(&Bulk)->ReleaseData();
 			return;
 		}
+		const_cast<FByteBulkData*>(&Bulk)->ReleaseData();
 	}
 
 	byte *pic = NULL;
@@ -261,9 +494,25 @@ void ExportTexture(const UUnrealMaterial *Tex)
 	CTextureData TexData;
 	if (Tex->GetTextureData(TexData))
 	{
+		if (GExportDedup && TexData.Mips.Num())
+		{
+			CContentHash Hash;
+			GetTextureContentHash(TexData, Hash);
+			if (LinkDuplicateContent(Tex, Hash))
+			{
+				Tex->ReleaseTextureData();
+				return;
+			}
+		}
+		if (GExportPassthrough && ExportCompressedTexture(Tex, TexData))
+		{
+			Tex->ReleaseTextureData();
+			return;
+		}
 		if (GExportDDS && TexData.IsDXT())
 		{
-			WriteDDS(TexData, GetExportFileName(Tex, "%s.dds", Tex->Name));
+			WriteDDS(Tex, TexData);
+			Tex->ReleaseTextureData();
 			return;
 		}
 
@@ -5,6 +5,8 @@
 #include "UnPackage.h"		// for Package->Name
 
 #include "Exporters.h"
+#include "Profiler.h"
+#include "ObjectMetrics.h"
 
 
 // configuration variables
@@ -40,13 +42,418 @@ void RegisterExporter(const char *ClassName, ExporterFunc_t Func)
 }
 
 
-// List of already exported objects
+/*-----------------------------------------------------------------------------
+	Content deduplication
+-----------------------------------------------------------------------------*/
+
+// Exporters compute hash of object's source data (texture mips, sound data etc) before decoding
+// it, and call LinkDuplicateContent(). Hashes of exported objects are stored in content index
+// together with names of written files. When object with the same contents is found, hard links
+// to already written files are created instead of exporting the object again. Index is saved in
+// export directory, so it is used in subsequent runs too.
+// Files could be shared by several objects, so a file is never overwritten in place: it is
+// removed before writing, and index entries of the rewritten object are dropped (the index has
+// a special record for this, with "-" instead of hash).
+// Content index and CurrentExport are not protected with locks: ExportObject() is called from a
+// single thread only, and exporters must not call LinkDuplicateContent() from worker threads.
+
+#define CONTENT_INDEX_FILE			"umodel-content.idx"
+#define CONTENT_HASH_SIZE			4096
+
+bool GExportDedup = false;
+
+static char BaseExportDir[512];
+
+struct CExportedContent
+{
+	CContentHash	Hash;
+	char			*Path;				// export path of the object, relative to BaseExportDir
+	char			*ObjectName;		// used to build file names for duplicates
+	char			*Files;				// tab-separated list of file names, relative to Path
+	bool			Dropped;			// files were rewritten with another content
+	int				HashNext;
+	int				ObjectHashNext;		// hash chain for Path and ObjectName
+};
+
+static TArray<CExportedContent> ExportedContent;
+static int ExportedContentHash[CONTENT_HASH_SIZE];
+static int ExportedObjectHash[CONTENT_HASH_SIZE];
+static FILE *ContentIndexFile = NULL;
+static char ContentIndexDir[512];		// BaseExportDir for which index was loaded
+
+// Information about object being exported by ExportObject()
+struct CExportContext
+{
+	const UObject	*Obj;
+	bool			HasHash;
+	CContentHash	Hash;
+	FString			Files;				// tab-separated list of written files
+};
+
+static CExportContext *CurrentExport = NULL;
+
+static int GetExportedObjectHash(const char *Path, const char *ObjectName)
+{
+	return (appStrihash(Path) ^ appStrihash(ObjectName)) & (CONTENT_HASH_SIZE - 1);
+}
+
+static int AddExportedContent(const CContentHash &Hash, const char *Path, const char *ObjectName, const char *Files)
+{
+	int h = Hash.Hash[0] & (CONTENT_HASH_SIZE - 1);
+	int h2 = GetExportedObjectHash(Path, ObjectName);
+	int Index = ExportedContent.AddZeroed();
+	CExportedContent &E = ExportedContent[Index];
+	E.Hash       = Hash;
+	E.Path       = appStrdup(Path);
+	E.ObjectName = appStrdup(ObjectName);
+	E.Files      = appStrdup(Files);
+	E.HashNext   = ExportedContentHash[h];
+	ExportedContentHash[h] = Index;
+	E.ObjectHashNext = ExportedObjectHash[h2];
+	ExportedObjectHash[h2] = Index;
+	return Index;
+}
+
+// Mark entries of the object as dropped, returns false when nothing was found
+static bool DropExportedContent(const char *Path, const char *ObjectName)
+{
+	bool Found = false;
+	for (int Index = ExportedObjectHash[GetExportedObjectHash(Path, ObjectName)]; Index >= 0; Index = ExportedContent[Index].ObjectHashNext)
+	{
+		CExportedContent &E = ExportedContent[Index];
+		if (!E.Dropped && !strcmp(E.Path, Path) && !strcmp(E.ObjectName, ObjectName))
+		{
+			E.Dropped = true;
+			Found = true;
+		}
+	}
+	return Found;
+}
+
+static CExportedContent *FindExportedContent(const CContentHash &Hash)
+{
+	int h = Hash.Hash[0] & (CONTENT_HASH_SIZE - 1);
+	// later entries are preferred, so search from the hash chain's head
+	for (int Index = ExportedContentHash[h]; Index >= 0; Index = ExportedContent[Index].HashNext)
+	{
+		if (ExportedContent[Index].Hash == Hash && !ExportedContent[Index].Dropped)
+			return &ExportedContent[Index];
+	}
+	return NULL;
+}
+
+static void CloseContentIndex()
+{
+	if (ContentIndexFile)
+	{
+		fclose(ContentIndexFile);
+		ContentIndexFile = NULL;
+	}
+	for (int i = 0; i < ExportedContent.Num(); i++)
+	{
+		CExportedContent &E = ExportedContent[i];
+		appFree(E.Path);
+		appFree(E.ObjectName);
+		appFree(E.Files);
+	}
+	ExportedContent.Empty();
+	memset(ExportedContentHash, -1, sizeof(ExportedContentHash));
+	memset(ExportedObjectHash, -1, sizeof(ExportedObjectHash));
+	ContentIndexDir[0] = 0;
+}
+
+// Index file is a text file, every line has tab-separated hash, path, object name and file names
+static void OpenContentIndex()
+{
+	guard(OpenContentIndex);
+
+	if (!BaseExportDir[0])
+		appSetBaseExportDirectory(".");
+	if (ContentIndexDir[0] && !strcmp(ContentIndexDir, BaseExportDir)) return;
+	CloseContentIndex();
+	strcpy(ContentIndexDir, BaseExportDir);
+
+	char IndexName[1024];
+	appSprintf(ARRAY_ARG(IndexName), "%s/" CONTENT_INDEX_FILE, BaseExportDir);
+	FILE *f = fopen(IndexName, "r");
+	if (f)
+	{
+		char Line[4096];
+		while (fgets(Line, sizeof(Line), f))
+		{
+			char *s = strchr(Line, '\n');
+			if (s) *s = 0;
+			// split hash, path and object name
+			char *Fields[3];
+			Fields[0] = Line;
+			int NumFields = 1;
+			for (s = Line; *s && NumFields < 4; s++)
+			{
+				if (*s != '\t') continue;
+				*s = 0;
+				if (NumFields < 3)
+					Fields[NumFields] = s + 1;
+				NumFields++;
+			}
+			if (NumFields < 4) continue;		// bad line
+			if (!strcmp(Fields[0], "-"))
+			{
+				DropExportedContent(Fields[1], Fields[2]);
+				continue;
+			}
+			CContentHash Hash;
+			if (!Hash.FromString(Fields[0])) continue;
+			AddExportedContent(Hash, Fields[1], Fields[2], s);
+		}
+		fclose(f);
+		appPrintf("Loaded content index with %d entries\n", ExportedContent.Num());
+	}
+
+	appMakeDirectory(BaseExportDir);
+	ContentIndexFile = fopen(IndexName, "a");
+	if (!ContentIndexFile)
+		appPrintf("ERROR: unable to write content index \"%s\"\n", IndexName);
+
+	unguard;
+}
+
+// Object's export path relative to BaseExportDir
+static const char *GetRelativeExportPath(const UObject *Obj)
+{
+	const char *Path = GetExportPath(Obj) + strlen(BaseExportDir);
+	if (*Path == '/') Path++;
+	return Path;
+}
+
+static void RegisterExportedContent(const CExportContext &Ctx)
+{
+	guard(RegisterExportedContent);
+
+	const char *Path = GetRelativeExportPath(Ctx.Obj);
+	AddExportedContent(Ctx.Hash, Path, Ctx.Obj->Name, *Ctx.Files);
+	if (ContentIndexFile)
+	{
+		char HashStr[64];
+		Ctx.Hash.ToString(HashStr);
+		fprintf(ContentIndexFile, "%s\t%s\t%s\t%s\n", HashStr, Path, Ctx.Obj->Name, *Ctx.Files);
+	}
+
+	unguard;
+}
+
+// Object's files will be rewritten: forget their content
+static void DropObjectContent(const UObject *Obj)
+{
+	guard(DropObjectContent);
+
+	OpenContentIndex();
+	const char *Path = GetRelativeExportPath(Obj);
+	if (DropExportedContent(Path, Obj->Name) && ContentIndexFile)
+		fprintf(ContentIndexFile, "-\t%s\t%s\t\n", Path, Obj->Name);
+
+	unguard;
+}
+
+// Remember file written for currently exported object
+static void RegisterExportedFile(const UObject *Obj, const char *FileName)
+{
+	CExportContext *Ctx = CurrentExport;
+	if (!Ctx || Ctx->Obj != Obj) return;
+	if (Ctx->Files.Len()) Ctx->Files += "\t";
+	Ctx->Files += FileName;
+}
+
+bool LinkDuplicateContent(const UObject *Obj, const CContentHash &Hash)
+{
+	guard(LinkDuplicateContent);
+
+	if (!GExportDedup) return false;
+	OpenContentIndex();
+
+	CExportContext *Ctx = CurrentExport;
+	if (Ctx && Ctx->Obj == Obj)
+	{
+		Ctx->Hash    = Hash;
+		Ctx->HasHash = true;
+	}
+
+	const CExportedContent *E = FindExportedContent(Hash);
+	if (!E) return false;
+
+	char DstPath[1024];
+	appStrncpyz(DstPath, GetExportPath(Obj), ARRAY_COUNT(DstPath));
+
+	// build list of file names, check presence of original files
+	TArray<FString> SrcFiles, DstFiles;
+	int ObjectNameLen = strlen(E->ObjectName);
+	const char *s = E->Files;
+	while (*s)
+	{
+		const char *end = strchr(s, '\t');
+		if (!end) end = s + strlen(s);
+		char Name[512];
+		appStrncpyz(Name, s, min((int)(end - s) + 1, (int)ARRAY_COUNT(Name)));
+		s = *end ? end + 1 : end;
+
+		char Buf[1024];
+		appSprintf(ARRAY_ARG(Buf), "%s/%s%s%s", BaseExportDir, E->Path, E->Path[0] ? "/" : "", Name);
+		if (!appFileExists(Buf))
+			return false;				// file was removed, export object again
+		SrcFiles.Add(Buf);
+		// file names are usually started with object name, replace it with the new one
+		if (!strncmp(Name, E->ObjectName, ObjectNameLen))
+			appSprintf(ARRAY_ARG(Buf), "%s/%s%s", DstPath, Obj->Name, Name + ObjectNameLen);
+		else
+			appSprintf(ARRAY_ARG(Buf), "%s/%s", DstPath, Name);
+		DstFiles.Add(Buf);
+	}
+	if (!SrcFiles.Num()) return false;
+
+	// object which was exported before as an original will have content of another object
+	if (strcmp(E->Path, GetRelativeExportPath(Obj)) || strcmp(E->ObjectName, Obj->Name))
+		DropObjectContent(Obj);
+
+	TArray<int> LinkedFiles;
+	for (int i = 0; i < SrcFiles.Num(); i++)
+	{
+		const char *Src = *SrcFiles[i];
+		const char *Dst = *DstFiles[i];
+		if (!strcmp(Src, Dst)) continue;			// the same object was exported in previous run
+		if (appFileExists(Dst))
+		{
+			if (GDontOverwriteFiles) continue;
+			remove(Dst);
+		}
+		appMakeDirectoryForFile(Dst);
+		if (!appCreateHardLink(Src, Dst))
+		{
+			appPrintf("Unable to create link %s, exporting object\n", Dst);
+			// remove links created so far, so files of another object won't remain among
+			// files of this object when exporter writes a different set of files
+			for (int j = 0; j < LinkedFiles.Num(); j++)
+				remove(*DstFiles[LinkedFiles[j]]);
+			return false;
+		}
+		LinkedFiles.Add(i);
+	}
+	appPrintf("... duplicate of %s/%s, linked %d file(s)\n", E->Path, E->ObjectName, SrcFiles.Num());
+
+	// linked files are outputs of the object, so the export manifest could verify their presence
+	for (int i = 0; i < DstFiles.Num(); i++)
+		RegisterExportedFile(Obj, *DstFiles[i] + strlen(DstPath) + 1);
+
+	// contents is already registered
+	if (Ctx && Ctx->Obj == Obj) Ctx->HasHash = false;
+	return true;
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Write errors
+-----------------------------------------------------------------------------*/
+
+// Files are written by a background thread (see FFileWriter), so a write error is detected after
+// export of the object is completed. Written files are remembered until all writes are complete,
+// so the error could be reported against the object which wrote the file.
+
+#define MAX_WRITTEN_FILES			4096		// wait for completion of writes when more files are written
+
+struct CWrittenFile
+{
+	char			*FileName;			// full name, as passed to FFileWriter
+	char			*Path;				// export path of the object, relative to BaseExportDir
+	char			*ObjectName;
+	const char		*ClassName;
+};
+
+static TArray<CWrittenFile> WrittenFiles;
+
+static void AddWrittenFile(const UObject *Obj, const char *FileName)
+{
+	CWrittenFile *W = new (WrittenFiles) CWrittenFile;
+	W->FileName   = appStrdup(FileName);
+	W->Path       = appStrdup(GetRelativeExportPath(Obj));
+	W->ObjectName = appStrdup(Obj->Name);
+	W->ClassName  = Obj->GetClassName();
+}
+
+static void ReleaseWrittenFiles()
+{
+	for (int i = 0; i < WrittenFiles.Num(); i++)
+	{
+		CWrittenFile &W = WrittenFiles[i];
+		appFree(W.FileName);
+		appFree(W.Path);
+		appFree(W.ObjectName);
+	}
+	WrittenFiles.Empty();
+}
+
+// Report files which were not written. Objects which wrote them are dropped from the content index
+// and from the export manifest, so they're not used as duplicates and will be exported again.
+static void CheckWriteErrors()
+{
+	guard(CheckWriteErrors);
+
+	char FileName[1024];
+	while (FFileWriter::GetWriteError(ARRAY_ARG(FileName)))
+	{
+		// the same file could be written several times, use the latest record
+		const CWrittenFile *W = NULL;
+		for (int i = WrittenFiles.Num() - 1; i >= 0; i--)
+		{
+			if (!strcmp(WrittenFiles[i].FileName, FileName))
+			{
+				W = &WrittenFiles[i];
+				break;
+			}
+		}
+		if (!W)
+		{
+			appPrintf("ERROR: unable to write file %s\n", FileName);
+			continue;
+		}
+		appPrintf("ERROR: %s'%s': unable to write file %s\n", W->ClassName, W->ObjectName, FileName);
+
+		if (GExportDedup)
+		{
+			OpenContentIndex();
+			if (DropExportedContent(W->Path, W->ObjectName) && ContentIndexFile)
+				fprintf(ContentIndexFile, "-\t%s\t%s\t\n", W->Path, W->ObjectName);
+		}
+		// file name relative to object's export path
+		const char *RelativeName = FileName + strlen(BaseExportDir);
+		if (*RelativeName == '/') RelativeName++;
+		if (W->Path[0]) RelativeName += strlen(W->Path) + 1;
+		DropExportedFile(W->Path, RelativeName);
+	}
+
+	unguard;
+}
+
+// Wait for completion of writes and report errors
+static void FlushWrittenFiles()
+{
+	FFileWriter::WaitForPendingWrites();
+	CheckWriteErrors();
+	ReleaseWrittenFiles();
+}
+
+
+/*-----------------------------------------------------------------------------
+	List of already exported objects
+-----------------------------------------------------------------------------*/
 
 #define EXPORTED_LIST_HASH_SIZE		4096
 
 struct ExportedObjectEntry
 {
-	const UnPackage* Package;
+	// Package file name is used instead of UnPackage pointer, because the package could be
+	// unloaded and then loaded again. This string is allocated with appStrdupPool(), so it
+	// is unique for the package and stays valid after unloading.
+	const char*		PackageName;
 	int				ExportIndex;
 	int				HashNext;
 
@@ -54,23 +461,31 @@ struct ExportedObjectEntry
 	{}
 
 	ExportedObjectEntry(const UObject* Obj)
-	:	Package(Obj->Package)
+	:	PackageName(Obj->Package->Filename)
 	,	ExportIndex(Obj->PackageIndex)
 	,	HashNext(0)
 	{}
 
 	int GetHash() const
 	{
-		return ( ((size_t)Package >> 3) ^ ExportIndex ^ (ExportIndex << 4) ) & (EXPORTED_LIST_HASH_SIZE - 1);
+		return ( ((size_t)PackageName >> 3) ^ ExportIndex ^ (ExportIndex << 4) ) & (EXPORTED_LIST_HASH_SIZE - 1);
 	}
 };
 
 static TArray<ExportedObjectEntry> ProcessedObjects;
 static int ProcessedObjectHash[EXPORTED_LIST_HASH_SIZE];
+// names of exported files, used to find name collisions
+static UniqueNameList ExportedNames;
 
 void ResetExportedList()
 {
 	ProcessedObjects.Empty(1024);
+	// next export could write the same objects again, don't rename them
+	ExportedNames.Items.Empty();
+	// make sure all exported files are completely written
+	FlushWrittenFiles();
+	if (ContentIndexFile) fflush(ContentIndexFile);
+	if (GExportIncremental) SaveExportManifest();
 }
 
 // return 'false' if object already registered
@@ -102,7 +517,7 @@ static bool RegisterProcessedObject(const UObject* Obj)
 	{
 //		appPrintf("-- %d ", newIndex);
 		expEntry = &ProcessedObjects[newIndex];
-		if ((expEntry->Package == exp.Package) && (expEntry->ExportIndex == exp.ExportIndex))
+		if ((expEntry->PackageName == exp.PackageName) && (expEntry->ExportIndex == exp.ExportIndex))
 		{
 //			appPrintf("-> FOUND\n");
 			return false;		// the object already exists
@@ -129,11 +544,19 @@ bool ExportObject(const UObject *Obj)
 	if (strnicmp(Obj->Name, "Default__", 9) == 0)	// default properties object, nothing to export
 		return true;
 
-	static UniqueNameList ExportedNames;
-
 	// check for duplicate object export
 	if (!RegisterProcessedObject(Obj)) return true;
 
+	// Report write errors of previously exported objects. Not done for nested exports: files of
+	// the parent object are not registered yet.
+	if (!CurrentExport)
+	{
+		if (WrittenFiles.Num() >= MAX_WRITTEN_FILES)
+			FlushWrittenFiles();
+		else
+			CheckWriteErrors();
+	}
+
 	for (int i = 0; i < numExporters; i++)
 	{
 		const CExporterInfo &Info = exporters[i];
@@ -158,13 +581,28 @@ bool ExportObject(const UObject *Obj)
 			}
 
 			appPrintf("Exporting %s %s to %s\n", Obj->GetClassName(), Obj->Name, ExportPath);
-			Info.Func(Obj);
+			{
+				PROFILE_SCOPE("Export", ClassName);
+				OBJECT_METRICS_SCOPE(Obj, METRIC_Export);
+				CExportContext Ctx;
+				Ctx.Obj     = Obj;
+				Ctx.HasHash = false;
+				CExportContext *ParentExport = CurrentExport;
+				CurrentExport = &Ctx;
+				Info.Func(Obj);
+				CurrentExport = ParentExport;
+				if (Ctx.HasHash && Ctx.Files.Len())
+					RegisterExportedContent(Ctx);
+				RegisterExportedObject(Obj, GetRelativeExportPath(Obj), *Ctx.Files);
+			}
 
 			//?? restore object name
 			if (OriginalName) const_cast<UObject*>(Obj)->Name = OriginalName;
 			return true;
 		}
 	}
+	// remember that object has nothing to export
+	RegisterExportedObject(Obj, "", "");
 	return false;
 
 	unguardf("%s'%s'", Obj->GetClassName(), Obj->Name);
@@ -175,8 +613,6 @@ bool ExportObject(const UObject *Obj)
 	Export path functions
 -----------------------------------------------------------------------------*/
 
-static char BaseExportDir[512];
-
 bool GUncook    = false;
 bool GUseGroups = false;
 
@@ -185,6 +621,13 @@ void appSetBaseExportDirectory(const char *Dir)
 	strcpy(BaseExportDir, Dir);
 }
 
+const char* appGetBaseExportDirectory()
+{
+	if (!BaseExportDir[0])
+		appSetBaseExportDirectory(".");
+	return BaseExportDir;
+}
+
 
 const char* GetExportPath(const UObject *Obj)
 {
@@ -324,14 +767,33 @@ FArchive *CreateExportArchive(const UObject *Obj, const char *fmt, ...)
 
 //	appPrintf("... writing %s'%s' to %s ...\n", Obj->GetClassName(), Obj->Name, filename);
 
+	if (GExportDedup)
+	{
+		// file could be a hard link created by LinkDuplicateContent(), don't modify contents of
+		// other linked files
+		DropObjectContent(Obj);
+		remove(filename);
+	}
+
 	appMakeDirectoryForFile(filename);
 	FFileWriter *Ar = new FFileWriter(filename, FRO_NoOpenError);
 	if (!Ar->IsOpen())
+	{
+		// directory could be removed after it was created, create it again
+		delete Ar;
+		appResetDirectoryCache();
+		appMakeDirectoryForFile(filename);
+		Ar = new FFileWriter(filename, FRO_NoOpenError);
+	}
+	if (!Ar->IsOpen())
 	{
 		appPrintf("Error opening file \"%s\" ...\n", filename);
 		delete Ar;
 		return NULL;
 	}
+	if (CurrentExport)
+		RegisterExportedFile(Obj, filename + strlen(GetExportPath(Obj)) + 1);
+	AddWrittenFile(Obj, filename);
 
 	Ar->ArVer = 128;			// less than UE3 version (required at least for VJointPos structure)
 
@@ -15,13 +15,20 @@ FORCEINLINE void RegisterExporter(const char *ClassName, void (*Func)(const T*))
 	RegisterExporter(ClassName, (ExporterFunc_t)Func);
 }
 
-// This function will clear list of already exported objects
+// Register all supported object classes for the engine of Game, and all exporters. Used by
+// UModel and tools which load packages with UModel code.
+void RegisterUnrealClasses(int Game, bool RegisterSounds = true);
+void RegisterExporters();
+
+// This function will clear list of already exported objects, and wait until all exported
+// files are written
 void ResetExportedList();
 
 bool ExportObject(const UObject *Obj);
 
 // path
 void appSetBaseExportDirectory(const char *Dir);
+const char* appGetBaseExportDirectory();
 const char* GetExportPath(const UObject *Obj);
 
 const char* GetExportFileName(const UObject *Obj, const char *fmt, ...);
@@ -32,17 +39,48 @@ bool CheckExportFilePresence(const UObject *Obj, const char *fmt, ...);
 // Function may return NULL.
 FArchive *CreateExportArchive(const UObject *Obj, const char *fmt, ...);
 
+// Content deduplication (-dedup option). Should be called by exporter with hash of object's source
+// data before decoding it. When object with the same contents was already exported, files of that
+// object are hard-linked to this object's export path, and function returns true - exporter should
+// skip this object. Content index is not locked, so objects must be exported from a single thread.
+bool LinkDuplicateContent(const UObject *Obj, const CContentHash &Hash);
+
+// Incremental export (-incremental option). Information about exported objects is saved to the
+// manifest in export directory, so objects which weren't changed since previous export could be
+// skipped without loading them.
+// Settings string should contain all options which affect exported files.
+void SetIncrementalExportSettings(const char *Settings);
+// Load exports of the package which were changed or not exported yet. Returns false when nothing
+// was loaded.
+bool LoadChangedExports(UnPackage *Package);
+// Check if object was already exported, and it wasn't changed since that.
+bool IsExportUpToDate(const UObject *Obj);
+// Called by ExportObject(). Files are tab-separated, relative to ExportPath, which is relative to
+// base export directory.
+void RegisterExportedObject(const UObject *Obj, const char *ExportPath, const char *Files);
+// Save the manifest, called by ResetExportedList().
+void SaveExportManifest();
+// Called when a file was not written successfully. The object which has this file will be exported
+// again. FileName is relative to ExportPath.
+void DropExportedFile(const char *ExportPath, const char *FileName);
+
 // configuration
 extern bool GExportScripts;
 extern bool GExportLods;
 extern bool GNoTgaCompress;
 extern bool GExportDDS;
+extern bool GExportPassthrough;
 extern bool GUncook;
 extern bool GUseGroups;
 extern bool GDontOverwriteFiles;
+extern bool GExportDedup;
+extern bool GExportIncremental;
+extern bool GExportMd5Mesh;				// export meshes and animations in MD5 format instead of ActorX
+extern bool GExportGltf;				// export meshes and animations in glTF format
 
 // forwards
 class UObject;
+class UnPackage;
 class UVertMesh;
 class UUnrealMaterial;
 class USound;
@@ -63,6 +101,10 @@ void ExportStaticMesh(const CStaticMesh *Mesh);
 // MD5Mesh
 void ExportMd5Mesh(const CSkeletalMesh *Mesh);
 void ExportMd5Anim(const CAnimSet *Anim);
+// glTF
+void ExportSkeletalMeshGltf(const CSkeletalMesh *Mesh);
+void ExportStaticMeshGltf(const CStaticMesh *Mesh);
+void ExportAnimSetGltf(const CAnimSet *Anim);
 // 3D
 void Export3D (const UVertMesh *Mesh);
 // TGA
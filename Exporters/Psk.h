@@ -13,6 +13,12 @@ struct VChunkHeader
 	int				DataSize;				// sizeof(type)
 	int				DataCount;				// number of array elements
 
+	VChunkHeader()
+	{
+		// zero-fill unused fields (and rest of ChunkID) for saving
+		memset(this, 0, sizeof(*this));
+	}
+
 	friend FArchive& operator<<(FArchive &Ar, VChunkHeader &H)
 	{
 		Ar.Serialize(ARRAY_ARG(H.ChunkID));
@@ -34,6 +40,21 @@ struct VChunkHeader
 	Ar << var;
 //	appPrintf("%08X: %s: type=%d / count=%d / size=%d\n", Ar.Tell(), var.ChunkID, var.TypeFlag, var.DataCount, var.DataSize);
 
+// Write chunk data with a single Serialize() call. Should be used only for structures which
+// has the same in-memory and on-disk layout (no padding). Data is written "as is" when archive
+// doesn't require byte swapping, otherwise each item is serialized separately.
+template<typename T>
+void SaveChunkData(FArchive &Ar, const T *Data, int Count)
+{
+	if (!Ar.ReverseBytes)
+	{
+		Ar.Serialize(const_cast<T*>(Data), Count * sizeof(T));
+		return;
+	}
+	for (int i = 0; i < Count; i++)
+		Ar << const_cast<T&>(Data[i]);
+}
+
 
 /******************************************************************************
  *	PSK file format structures
@@ -0,0 +1,287 @@
+#include "Core.h"
+#include "UnCore.h"
+
+// Classes for registration
+#include "UnrealClasses.h"
+#include "UnPackage.h"
+#include "UnAnimNotify.h"
+
+#include "UnMaterial2.h"
+#include "UnMaterial3.h"
+
+#include "UnMesh2.h"
+#include "UnMesh3.h"
+#include "UnMesh4.h"
+
+#include "UnSound.h"
+#include "UnThirdParty.h"
+
+#include "SkeletalMesh.h"
+#include "StaticMesh.h"
+
+#include "Exporters.h"
+
+
+// Class and exporter registration, shared by UModel, umodel-bench and libumodel
+
+bool GExportMd5Mesh = false;
+bool GExportGltf    = false;
+
+
+/*-----------------------------------------------------------------------------
+	Table of known Unreal classes
+-----------------------------------------------------------------------------*/
+
+static void RegisterCommonUnrealClasses()
+{
+	// classes and structures
+	RegisterCoreClasses();
+BEGIN_CLASS_TABLE
+
+	REGISTER_MATERIAL_CLASSES
+	REGISTER_ANIM_NOTIFY_CLASSES
+#if BIOSHOCK
+	REGISTER_MATERIAL_CLASSES_BIO
+	REGISTER_MESH_CLASSES_BIO
+#endif
+#if SPLINTER_CELL
+	REGISTER_MATERIAL_CLASSES_SCELL
+#endif
+#if UNREAL3
+	REGISTER_MATERIAL_CLASSES_U3		//!! needed for Bioshock 2 too
+#endif
+
+#if DECLARE_VIEWER_PROPS
+	REGISTER_SKELMESH_VCLASSES
+	REGISTER_STATICMESH_VCLASSES
+#endif // DECLARE_VIEWER_PROPS
+
+END_CLASS_TABLE
+	// enumerations
+	REGISTER_MATERIAL_ENUMS
+#if UNREAL3
+	REGISTER_MATERIAL_ENUMS_U3
+	REGISTER_MESH_ENUMS_U3
+#endif
+}
+
+
+static void RegisterUnrealClasses2()
+{
+BEGIN_CLASS_TABLE
+	REGISTER_MESH_CLASSES_U2
+#if UNREAL1
+	REGISTER_MESH_CLASSES_U1
+#endif
+#if RUNE
+	REGISTER_MESH_CLASSES_RUNE
+#endif
+END_CLASS_TABLE
+}
+
+
+static void RegisterUnrealClasses3()
+{
+#if UNREAL3
+BEGIN_CLASS_TABLE
+//	REGISTER_MATERIAL_CLASSES_U3 -- registered for Bioshock in RegisterCommonUnrealClasses()
+	REGISTER_MESH_CLASSES_U3
+#if TUROK
+	REGISTER_MESH_CLASSES_TUROK
+#endif
+#if MASSEFF
+	REGISTER_MESH_CLASSES_MASSEFF
+#endif
+#if DCU_ONLINE
+	REGISTER_MATERIAL_CLASSES_DCUO
+#endif
+#if TRANSFORMERS
+	REGISTER_MESH_CLASSES_TRANS
+#endif
+#if MKVSDC
+	REGISTER_MESH_CLASSES_MK
+#endif
+END_CLASS_TABLE
+#endif // UNREAL3
+}
+
+
+static void RegisterUnrealClasses4()
+{
+#if UNREAL4
+BEGIN_CLASS_TABLE
+	REGISTER_MESH_CLASSES_U4
+	REGISTER_MATERIAL_CLASSES_U4
+END_CLASS_TABLE
+	REGISTER_MATERIAL_ENUMS_U4
+#endif // UNREAL4
+}
+
+
+
+static void RegisterUnrealSoundClasses()
+{
+BEGIN_CLASS_TABLE
+	REGISTER_SOUND_CLASSES
+#if UNREAL3
+	REGISTER_SOUND_CLASSES_UE3
+#endif
+#if TRANSFORMERS
+	REGISTER_SOUND_CLASSES_TRANS
+#endif
+#if UNREAL4
+	REGISTER_SOUND_CLASSES_UE4
+#endif
+END_CLASS_TABLE
+}
+
+
+static void RegisterUnreal3rdPartyClasses()
+{
+#if UNREAL3
+BEGIN_CLASS_TABLE
+	REGISTER_3RDP_CLASSES
+END_CLASS_TABLE
+#endif
+}
+
+void RegisterUnrealClasses(int Game, bool RegisterSounds)
+{
+	// note: we are registering classes after loading package: in this case we can know engine version (1/2/3)
+	RegisterCommonUnrealClasses();
+	if (Game < GAME_UE3)
+	{
+		RegisterUnrealClasses2();
+	}
+	else if (Game < GAME_UE4_BASE)
+	{
+		RegisterUnrealClasses3();
+		RegisterUnreal3rdPartyClasses();
+	}
+	else
+	{
+		RegisterUnrealClasses4();
+	}
+	if (RegisterSounds) RegisterUnrealSoundClasses();
+}
+
+
+/*-----------------------------------------------------------------------------
+	Exporters
+-----------------------------------------------------------------------------*/
+
+// wrappers
+static void ExportSkeletalMeshCommon(const CSkeletalMesh *Mesh)
+{
+	assert(Mesh);
+	if (GExportGltf)
+		ExportSkeletalMeshGltf(Mesh);
+	else if (GExportMd5Mesh)
+		ExportMd5Mesh(Mesh);
+	else
+		ExportPsk(Mesh);
+}
+
+static void ExportStaticMeshCommon(const CStaticMesh *Mesh)
+{
+	assert(Mesh);
+	if (GExportGltf)
+		ExportStaticMeshGltf(Mesh);
+	else
+		ExportStaticMesh(Mesh);
+}
+
+static void ExportAnimSetCommon(const CAnimSet *Anim)
+{
+	assert(Anim);
+	if (GExportGltf)
+		ExportAnimSetGltf(Anim);
+	else if (GExportMd5Mesh)
+		ExportMd5Anim(Anim);
+	else
+		ExportPsa(Anim);
+}
+
+static void ExportSkeletalMesh2(const USkeletalMesh *Mesh)
+{
+	ExportSkeletalMeshCommon(Mesh->ConvertedMesh);
+}
+
+#if UNREAL3
+static void ExportSkeletalMesh3(const USkeletalMesh3 *Mesh)
+{
+	ExportSkeletalMeshCommon(Mesh->ConvertedMesh);
+}
+#endif // UNREAL3
+
+static void ExportStaticMesh2(const UStaticMesh *Mesh)
+{
+	ExportStaticMeshCommon(Mesh->ConvertedMesh);
+}
+
+#if UNREAL3
+static void ExportStaticMesh3(const UStaticMesh3 *Mesh)
+{
+	ExportStaticMeshCommon(Mesh->ConvertedMesh);
+}
+#endif
+
+#if UNREAL4
+static void ExportSkeletalMesh4(const USkeletalMesh4 *Mesh)
+{
+	ExportSkeletalMeshCommon(Mesh->ConvertedMesh);
+}
+
+static void ExportStaticMesh4(const UStaticMesh4 *Mesh)
+{
+	ExportStaticMeshCommon(Mesh->ConvertedMesh);
+}
+#endif
+
+static void ExportMeshAnimation(const UMeshAnimation *Anim)
+{
+	ExportAnimSetCommon(Anim->ConvertedAnim);
+}
+
+#if UNREAL3
+static void ExportAnimSet(const UAnimSet *Anim)
+{
+	ExportAnimSetCommon(Anim->ConvertedAnim);
+}
+#endif // UNREAL3
+
+#if UNREAL4
+static void ExportSkeleton(const USkeleton *Skeleton)
+{
+	ExportAnimSetCommon(Skeleton->ConvertedAnim);
+}
+#endif // UNREAL4
+
+void RegisterExporters()
+{
+	RegisterExporter("SkeletalMesh",  ExportSkeletalMesh2);
+	RegisterExporter("MeshAnimation", ExportMeshAnimation);
+#if UNREAL3
+	RegisterExporter("SkeletalMesh3", ExportSkeletalMesh3);
+	RegisterExporter("AnimSet",       ExportAnimSet      );
+#endif
+	RegisterExporter("VertMesh",      Export3D           );
+	RegisterExporter("StaticMesh",    ExportStaticMesh2  );
+	RegisterExporter("Texture",       ExportTexture      );
+	RegisterExporter("Sound",         ExportSound        );
+#if UNREAL3
+	RegisterExporter("StaticMesh3",   ExportStaticMesh3  );
+	RegisterExporter("Texture2D",     ExportTexture      );
+	RegisterExporter("SoundNodeWave", ExportSoundNodeWave);
+	RegisterExporter("SwfMovie",      ExportGfx          );
+	RegisterExporter("FaceFXAnimSet", ExportFaceFXAnimSet);
+	RegisterExporter("FaceFXAsset",   ExportFaceFXAsset  );
+#endif // UNREAL3
+#if UNREAL4
+	RegisterExporter("SkeletalMesh4", ExportSkeletalMesh4);
+	RegisterExporter("StaticMesh4",   ExportStaticMesh4  );
+	RegisterExporter("Skeleton",      ExportSkeleton     );
+	RegisterExporter("SoundWave",     ExportSoundWave4   );
+#endif // UNREAL4
+	RegisterExporter("UnrealMaterial", ExportMaterial    );			// register this after Texture/Texture2D exporters
+}
@@ -243,6 +243,9 @@ protected:
 	// animation state
 	CAnimChan	Channels[MAX_SKELANIMCHANNELS];
 	int			MaxAnimChannel;
+	// sampled animation poses, indexed by track; used in UpdateSkeleton()
+	TArray<CVec3> Pose1Pos, Pose2Pos;
+	TArray<CQuat> Pose1Quat, Pose2Quat;
 
 	CAnimChan &GetStage(int StageIndex)
 	{
@@ -258,6 +261,8 @@ protected:
 	int FindBone(const char *BoneName) const;
 	const CAnimSequence *FindAnim(const char *AnimName) const;
 	void PlayAnimInternal(const char *AnimName, float Rate, float TweenTime, int Channel, bool Looped);
+	void SamplePose(const CAnimSequence *Seq, float Time, bool Looped, int firstBone, int lastBone,
+		TArray<CVec3> &PosePos, TArray<CQuat> &PoseQuat) const;
 	void UpdateSkeleton();
 	void BuildInfColors();
 };
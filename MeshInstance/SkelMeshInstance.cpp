@@ -408,6 +408,36 @@ CVec3 CSkelMeshInstance::GetMeshOrigin() const
 static int BoneUpdateCounts[MAX_MESHBONES];
 #endif
 
+// Sample animation tracks used by bones [firstBone .. lastBone]
+void CSkelMeshInstance::SamplePose(const CAnimSequence *Seq, float Time, bool Looped, int firstBone, int lastBone,
+	TArray<CVec3> &PosePos, TArray<CQuat> &PoseQuat) const
+{
+	guard(CSkelMeshInstance::SamplePose);
+
+	int NumTracks = Seq->Tracks.Num();
+	PosePos.Reset(NumTracks);
+	PosePos.AddUninitialized(NumTracks);
+	PoseQuat.Reset(NumTracks);
+	PoseQuat.AddUninitialized(NumTracks);
+
+	// default pose - from bind pose
+	int i;
+	const CMeshBoneData *data;
+	for (i = firstBone, data = BoneData + firstBone; i <= lastBone; i++, data++)
+	{
+		int BoneIndex = data->BoneMap;
+		if (BoneIndex == INDEX_NONE) continue;
+		const CSkelMeshBone &Bone = pMesh->RefSkeleton[i];
+		PosePos[BoneIndex]  = Bone.Position;
+		PoseQuat[BoneIndex] = Bone.Orientation;
+	}
+
+	CAnimPoseSampler Sampler(*Seq, Looped);
+	Sampler.SamplePose(Time, PosePos.GetData(), PoseQuat.GetData());
+
+	unguard;
+}
+
 void CSkelMeshInstance::UpdateSkeleton()
 {
 	guard(CSkelMeshInstance::UpdateSkeleton);
@@ -444,6 +474,14 @@ void CSkelMeshInstance::UpdateSkeleton()
 
 		int i;
 		CMeshBoneData *data;
+
+		// sample animation tracks for all bones at once; default pose is taken from
+		// bind pose, the sampler will not change it for tracks without keys
+		if (AnimSeq1 && (!AnimSeq2 || Chn->SecondaryBlend != 1.0f))
+			SamplePose(AnimSeq1, Chn->Time, Chn->Looped, firstBone, lastBone, Pose1Pos, Pose1Quat);
+		if (AnimSeq2)
+			SamplePose(AnimSeq2, Time2, Chn->Looped, firstBone, lastBone, Pose2Pos, Pose2Quat);
+
 		for (i = firstBone, data = BoneData + firstBone; i <= lastBone; i++, data++)
 		{
 			if (Stage < data->FirstChannel)
@@ -472,7 +510,8 @@ void CSkelMeshInstance::UpdateSkeleton()
 				// get bone position from track
 				if (!AnimSeq2 || Chn->SecondaryBlend != 1.0f)
 				{
-					AnimSeq1->Tracks[BoneIndex].GetBonePosition(Chn->Time, AnimSeq1->NumFrames, Chn->Looped, BP, BO);
+					BP = Pose1Pos[BoneIndex];
+					BO = Pose1Quat[BoneIndex];
 //const char *bname = *Bone.Name;
 //CQuat BOO = BO;
 //if (!strcmp(bname, "b_MF_UpperArm_L")) { BO.Set(-0.225, -0.387, -0.310,  0.839); }
@@ -492,11 +531,8 @@ void CSkelMeshInstance::UpdateSkeleton()
 				// blend secondary animation
 				if (AnimSeq2)
 				{
-					CVec3 BP2;
-					CQuat BO2;
-					BP2 = Bone.Position;		// default position - from bind pose
-					BO2 = Bone.Orientation;		// ...
-					AnimSeq2->Tracks[BoneIndex].GetBonePosition(Time2, AnimSeq2->NumFrames, Chn->Looped, BP2, BO2);
+					const CVec3 &BP2 = Pose2Pos[BoneIndex];
+					const CQuat &BO2 = Pose2Quat[BoneIndex];
 					if (Chn->SecondaryBlend == 1.0f)
 					{
 						BO = BO2;
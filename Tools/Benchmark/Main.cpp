@@ -0,0 +1,2211 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
+#include <windows.h>
+#include <psapi.h>					// GetProcessMemoryInfo()
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>			// getrusage()
+#endif
+
+// Classes for registration
+#include "UnrealClasses.h"
+#include "UnPackage.h"
+#include "UnAnimNotify.h"
+
+#include "UnMaterial2.h"
+#include "UnMaterial3.h"
+
+#include "UnMesh2.h"
+#include "UnMesh3.h"
+#include "UnMesh4.h"
+
+#include "UnSound.h"
+#include "UnThirdParty.h"
+
+#include "SkeletalMesh.h"
+#include "StaticMesh.h"
+
+#include "Threading.h"
+#include "Profiler.h"
+#include "ObjectMetrics.h"
+#include "Exporters/Exporters.h"
+
+#include "GameDatabase.h"
+#include "PackageUtils.h"
+
+#include "zlib/zlib.h"				// adler32()
+
+#define HOMEPAGE		"http://www.gildor.org/"
+
+// Synthetic packages are UE3 packages of this version (engine version of many UE3 games released in 2008)
+#define BENCH_PACKAGE_VERSION	576
+// Synthetic UE4 packages use UE4.11 format, it's the latest one with LegacyVersion -6; newer
+// versions may split cooked packages into .uasset and .uexp files
+#define BENCH_UE4_LEGACY_VERSION	-6
+#define BENCH_UE4_PACKAGE_VERSION	VER_UE4_11
+// Compression parameters of synthetic packages
+#define BENCH_CHUNK_SIZE		0x100000
+#define BENCH_BLOCK_SIZE		0x20000
+#define BENCH_PAK_BLOCK_SIZE	0x10000
+// Mount point of synthetic pak files
+#define BENCH_MOUNT_POINT		"../../../Bench/Content/"
+
+
+#if UNREAL4
+
+int UE4UnversionedPackage(int verMin, int verMax)
+{
+	appError("Unversioned UE4 packages are not supported. Please restart the benchmark with -game=ue4.%d..ue4.%d option.", verMin, verMax);
+	return -1;
+}
+
+#endif // UNREAL4
+
+
+/*-----------------------------------------------------------------------------
+	Stage statistics
+-----------------------------------------------------------------------------*/
+
+struct CBenchStage
+{
+	const char		*Name;
+	int				Runs;
+	double			TimeMs;					// best time of all runs
+	int64			Bytes;					// amount of processed data
+	int				Objects;				// number of processed objects
+	int				Allocs;					// number of memory allocations performed by the stage
+	int64			HeapBytes;				// live heap memory at the end of the stage
+	int64			PeakRss;				// peak resident memory during the stage (see GPeakRssPerStage)
+};
+
+static TArray<CBenchStage> GStages;
+
+// When false, peak resident memory counter couldn't be reset, and PeakRss is the peak since process start
+static bool GPeakRssPerStage = true;
+
+// Reset peak resident memory counter, so GetPeakRss() will return the peak from this moment.
+// Returns false when the counter couldn't be reset.
+static bool ResetPeakRss()
+{
+#if __linux__
+	// writing "5" to clear_refs sets VmHWM to the current resident size (Linux 4.0+)
+	FILE *f = fopen("/proc/self/clear_refs", "w");
+	if (!f) return false;
+	bool Ok = (fputs("5", f) >= 0);
+	if (fclose(f) != 0) Ok = false;
+	return Ok;
+#else
+	// there's no way to reset PeakWorkingSetSize and ru_maxrss
+	return false;
+#endif
+}
+
+static int64 GetPeakRss()
+{
+#if __linux__
+	// VmHWM is affected by ResetPeakRss(), ru_maxrss is not
+	FILE *f = fopen("/proc/self/status", "r");
+	if (f)
+	{
+		char Line[256];
+		int64 Value = -1;
+		while (fgets(Line, sizeof(Line), f))
+		{
+			if (!strncmp(Line, "VmHWM:", 6))
+			{
+				Value = (int64)atoll(Line + 6) * 1024;	// in kilobytes
+				break;
+			}
+		}
+		fclose(f);
+		if (Value >= 0) return Value;
+	}
+#endif // __linux__
+#if _WIN32
+	PROCESS_MEMORY_COUNTERS Counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+		return Counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage Usage;
+	if (getrusage(RUSAGE_SELF, &Usage) != 0) return 0;
+#if __APPLE__
+	return Usage.ru_maxrss;					// in bytes
+#else
+	return (int64)Usage.ru_maxrss * 1024;	// in kilobytes
+#endif
+#endif // _WIN32
+}
+
+// Measure a single stage of the benchmark. When the same stage is executed several times,
+// the best time and the largest memory peak are kept. Stages should not be nested, otherwise
+// the outer stage will get memory peak of the last inner stage only.
+class CBenchScope
+{
+public:
+	int64			Bytes;
+	int				Objects;
+
+	CBenchScope(const char *InName)
+	:	Bytes(0)
+	,	Objects(0)
+	,	Name(InName)
+	,	Profile("BenchStage", InName)
+	{
+		appPrintf("--- %s\n", Name);
+		StartAllocs = GNumAllocs;
+		if (GPeakRssPerStage && !ResetPeakRss())
+		{
+			appPrintf("WARNING: unable to reset peak memory counter, reporting peak memory since process start\n");
+			GPeakRssPerStage = false;
+		}
+		StartTime   = appNanoseconds();
+	}
+
+	~CBenchScope()
+	{
+		double TimeMs = (appNanoseconds() - StartTime) / 1e6;
+		Profile.SetBytes(Bytes);
+
+		CBenchStage *Stage = NULL;
+		for (int i = 0; i < GStages.Num(); i++)
+		{
+			if (!strcmp(GStages[i].Name, Name))
+			{
+				Stage = &GStages[i];
+				break;
+			}
+		}
+		if (!Stage)
+		{
+			Stage = new (GStages) CBenchStage;
+			memset(Stage, 0, sizeof(CBenchStage));
+			Stage->Name = Name;
+		}
+		if (!Stage->Runs || TimeMs < Stage->TimeMs)
+			Stage->TimeMs = TimeMs;
+		Stage->Runs++;
+		Stage->Bytes     = Bytes;
+		Stage->Objects   = Objects;
+		Stage->Allocs    = GNumAllocs - StartAllocs;
+		Stage->HeapBytes = GTotalAllocationSize;
+		Stage->PeakRss   = max(Stage->PeakRss, GetPeakRss());
+	}
+
+private:
+	const char		*Name;
+	int64			StartTime;
+	int				StartAllocs;
+	CProfileScope	Profile;
+};
+
+
+/*-----------------------------------------------------------------------------
+	Minimal zlib compressor
+-----------------------------------------------------------------------------*/
+
+// The source tree has zlib decompressor only, so use a simple greedy LZ77 encoder with
+// fixed Huffman codes. Compression ratio is much worse than zlib's one, but this doesn't
+// matter for benchmarking of decompression.
+
+class CBitWriter
+{
+public:
+	CBitWriter(TArray<byte> &InData)
+	:	Data(InData)
+	,	BitBuffer(0)
+	,	NumBits(0)
+	{}
+
+	// put bits, least significant bit first
+	FORCEINLINE void PutBits(unsigned Value, int Count)
+	{
+		BitBuffer |= Value << NumBits;
+		NumBits += Count;
+		while (NumBits >= 8)
+		{
+			Data.Add(BitBuffer & 0xFF);
+			BitBuffer >>= 8;
+			NumBits -= 8;
+		}
+	}
+
+	// put Huffman code, most significant bit first
+	FORCEINLINE void PutCode(unsigned Code, int Count)
+	{
+		unsigned Reversed = 0;
+		for (int i = 0; i < Count; i++, Code >>= 1)
+			Reversed = (Reversed << 1) | (Code & 1);
+		PutBits(Reversed, Count);
+	}
+
+	void Flush()
+	{
+		if (NumBits) Data.Add(BitBuffer & 0xFF);
+		BitBuffer = 0;
+		NumBits = 0;
+	}
+
+private:
+	TArray<byte>	&Data;
+	unsigned		BitBuffer;
+	int				NumBits;
+};
+
+static const int LengthBase[] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const int LengthExtra[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const int DistBase[] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const int DistExtra[] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static void PutLiteralCode(CBitWriter &Writer, int Symbol)
+{
+	// fixed literal/length Huffman table from RFC 1951
+	if (Symbol < 144)
+		Writer.PutCode(0x30 + Symbol, 8);
+	else if (Symbol < 256)
+		Writer.PutCode(0x190 + Symbol - 144, 9);
+	else if (Symbol < 280)
+		Writer.PutCode(Symbol - 256, 7);
+	else
+		Writer.PutCode(0xC0 + Symbol - 280, 8);
+}
+
+#define DEFLATE_WINDOW		32768
+#define DEFLATE_HASH_BITS	15
+#define DEFLATE_MAX_MATCH	258
+
+static void CompressZlib(const byte *Data, int Size, TArray<byte> &Out)
+{
+	guard(CompressZlib);
+
+	Out.Empty(Size / 2 + 64);
+	Out.Add(0x78);							// CMF: deflate, 32K window
+	Out.Add(0x01);							// FLG: fastest compression, no dictionary
+
+	CBitWriter Writer(Out);
+	Writer.PutBits(1, 1);					// BFINAL
+	Writer.PutBits(1, 2);					// BTYPE = fixed Huffman codes
+
+	int *Head = new int[1 << DEFLATE_HASH_BITS];
+	for (int i = 0; i < (1 << DEFLATE_HASH_BITS); i++) Head[i] = -DEFLATE_WINDOW - 1;
+
+#define HASH3(p)	(( ((p)[0] << 10) ^ ((p)[1] << 5) ^ (p)[2] ) & ((1 << DEFLATE_HASH_BITS) - 1))
+
+	int Pos = 0;
+	while (Pos < Size)
+	{
+		int MatchLen = 0, MatchDist = 0;
+		if (Pos + 3 <= Size)
+		{
+			int h = HASH3(Data + Pos);
+			int Candidate = Head[h];
+			Head[h] = Pos;
+			if (Pos - Candidate <= DEFLATE_WINDOW)
+			{
+				int MaxLen = min(Size - Pos, DEFLATE_MAX_MATCH);
+				const byte *s1 = Data + Candidate;
+				const byte *s2 = Data + Pos;
+				while (MatchLen < MaxLen && s1[MatchLen] == s2[MatchLen]) MatchLen++;
+				MatchDist = Pos - Candidate;
+			}
+		}
+		if (MatchLen < 3)
+		{
+			PutLiteralCode(Writer, Data[Pos]);
+			Pos++;
+			continue;
+		}
+		// length code
+		int Code;
+		for (Code = ARRAY_COUNT(LengthBase) - 1; LengthBase[Code] > MatchLen; Code--) {}
+		PutLiteralCode(Writer, 257 + Code);
+		if (LengthExtra[Code]) Writer.PutBits(MatchLen - LengthBase[Code], LengthExtra[Code]);
+		// distance code
+		for (Code = ARRAY_COUNT(DistBase) - 1; DistBase[Code] > MatchDist; Code--) {}
+		Writer.PutCode(Code, 5);
+		if (DistExtra[Code]) Writer.PutBits(MatchDist - DistBase[Code], DistExtra[Code]);
+		// insert skipped positions into hash table
+		for (int i = 1; i < MatchLen && Pos + i + 3 <= Size; i++)
+			Head[HASH3(Data + Pos + i)] = Pos + i;
+		Pos += MatchLen;
+	}
+#undef HASH3
+
+	delete[] Head;
+
+	PutLiteralCode(Writer, 256);			// end of block
+	Writer.Flush();
+
+	// adler32 checksum, big-endian
+	uLong Checksum = adler32(adler32(0, NULL, 0), Data, Size);
+	for (int Shift = 24; Shift >= 0; Shift -= 8)
+		Out.Add((Checksum >> Shift) & 0xFF);
+
+	unguard;
+}
+
+// All blocks compressed during generation of synthetic data, used for decompression stage
+struct CBenchBlob
+{
+	byte			*Data;
+	int				CompressedSize;
+	int				UncompressedSize;
+};
+
+static TArray<CBenchBlob> GBlobs;
+
+static void CompressBlock(const byte *Data, int Size, TArray<byte> &Out)
+{
+	CompressZlib(Data, Size, Out);
+	CBenchBlob *Blob = new (GBlobs) CBenchBlob;
+	Blob->CompressedSize   = Out.Num();
+	Blob->UncompressedSize = Size;
+	Blob->Data = (byte*)appMalloc(Out.Num());
+	memcpy(Blob->Data, Out.GetData(), Out.Num());
+}
+
+
+/*-----------------------------------------------------------------------------
+	Synthetic UE3 package writer
+-----------------------------------------------------------------------------*/
+
+static uint32 GRandSeed;
+
+// Deterministic random number generator, so generated data is the same on all platforms
+static FORCEINLINE uint32 BenchRand()
+{
+	GRandSeed = GRandSeed * 1664525 + 1013904223;
+	return GRandSeed >> 8;
+}
+
+static void PutString(FArchive &Ar, const char *Str)
+{
+	int Len = strlen(Str) + 1;
+	Ar << Len;
+	Ar.Serialize(const_cast<char*>(Str), Len);
+}
+
+static void PutZeros(FArchive &Ar, int Count)
+{
+	static const byte Zero[32] = { 0 };
+	assert(Count <= sizeof(Zero));
+	Ar.Serialize(const_cast<byte*>(Zero), Count);
+}
+
+struct CBenchImport
+{
+	const char		*ClassPackage;
+	const char		*ClassName;
+	int				PackageIndex;
+	const char		*ObjectName;
+};
+
+// File offset field in export data
+struct CBenchFixup
+{
+	int				Pos;					// position of the field in export data
+	int				Target;					// position in export data the field should point to
+};
+
+struct CBenchExport
+{
+	int				ClassIndex;
+	int				PackageIndex;
+	const char		*ObjectName;
+	FMemWriter		*Data;
+	TArray<CBenchFixup> Fixups;
+};
+
+struct CBenchChunk
+{
+	int				UncompressedOffset;
+	int				UncompressedSize;
+	int				CompressedOffset;
+	int				CompressedSize;
+};
+
+class CBenchPackage
+{
+public:
+	bool			UE4;
+
+	CBenchPackage(bool InUE4 = false)
+	:	UE4(InUE4)
+	{
+		AddName("None");
+	}
+
+	~CBenchPackage()
+	{
+		for (int i = 0; i < Exports.Num(); i++)
+			delete Exports[i].Data;
+	}
+
+	int AddName(const char *Name)
+	{
+		for (int i = 0; i < Names.Num(); i++)
+			if (!strcmp(Names[i], Name)) return i;
+		return Names.Add(appStrdupPool(Name));
+	}
+
+	// Returns object index of import
+	int AddImport(const char *ClassPackage, const char *ClassName, int PackageIndex, const char *ObjectName)
+	{
+		CBenchImport *Imp = new (Imports) CBenchImport;
+		Imp->ClassPackage = ClassPackage;
+		Imp->ClassName    = ClassName;
+		Imp->PackageIndex = PackageIndex;
+		Imp->ObjectName   = ObjectName;
+		AddName(ClassPackage);
+		AddName(ClassName);
+		AddName(ObjectName);
+		return -Imports.Num();
+	}
+
+	// Returns object index of export; object data should be written to GetData(Index)
+	int AddExport(int ClassIndex, int PackageIndex, const char *ObjectName)
+	{
+		CBenchExport *Exp = new (Exports) CBenchExport;
+		Exp->ClassIndex   = ClassIndex;
+		Exp->PackageIndex = PackageIndex;
+		Exp->ObjectName   = appStrdupPool(ObjectName);
+		Exp->Data         = new FMemWriter;
+		AddName(ObjectName);
+		if (!UE4)
+		{
+			// UObject::Serialize(): NetIndex
+			int NetIndex = -1;
+			*Exp->Data << NetIndex;
+		}
+		return Exports.Num();
+	}
+
+	FMemWriter& GetData(int Index)
+	{
+		return *Exports[Index - 1].Data;
+	}
+
+	// Property writers
+	void PutName(FArchive &Ar, const char *Name)
+	{
+		int Index = AddName(Name), Number = 0;
+		Ar << Index << Number;
+	}
+
+	void PutTag(FArchive &Ar, const char *Name, const char *Type, int DataSize)
+	{
+		int ArrayIndex = 0;
+		PutName(Ar, Name);
+		PutName(Ar, Type);
+		Ar << DataSize << ArrayIndex;
+	}
+
+	void PropInt(FArchive &Ar, const char *Name, int Value)
+	{
+		PutTag(Ar, Name, "IntProperty", sizeof(int));
+		Ar << Value;
+	}
+
+	void PropFloat(FArchive &Ar, const char *Name, float Value)
+	{
+		PutTag(Ar, Name, "FloatProperty", sizeof(float));
+		Ar << Value;
+	}
+
+	void PropBool(FArchive &Ar, const char *Name, bool Value)
+	{
+		// boolean value is stored after the tag and is not counted in DataSize
+		PutTag(Ar, Name, "BoolProperty", 0);
+		int IntValue = Value;
+		Ar << IntValue;
+	}
+
+	void PropName(FArchive &Ar, const char *Name, const char *Value)
+	{
+		PutTag(Ar, Name, "NameProperty", 8);
+		PutName(Ar, Value);
+	}
+
+	void PropEnum(FArchive &Ar, const char *Name, const char *Value)
+	{
+		PutTag(Ar, Name, "ByteProperty", 8);
+		PutName(Ar, Value);
+	}
+
+	void PropIntArray(FArchive &Ar, const char *Name, const TArray<int> &Values)
+	{
+		PutTag(Ar, Name, "ArrayProperty", sizeof(int) + Values.Num() * sizeof(int));
+		int Count = Values.Num();
+		Ar << Count;
+		for (int i = 0; i < Count; i++)
+		{
+			int Value = Values[i];
+			Ar << Value;
+		}
+	}
+
+	// Both object references and names are stored as TArray<int> here
+	void PropObjArray(FArchive &Ar, const char *Name, const TArray<int> &Objects)
+	{
+		PropIntArray(Ar, Name, Objects);
+	}
+
+	void PropNameArray(FArchive &Ar, const char *Name, const TArray<const char*> &Values)
+	{
+		PutTag(Ar, Name, "ArrayProperty", sizeof(int) + Values.Num() * 8);
+		int Count = Values.Num();
+		Ar << Count;
+		for (int i = 0; i < Count; i++)
+			PutName(Ar, Values[i]);
+	}
+
+	// Array of structures with default values in all fields
+	void PropStructArray(FArchive &Ar, const char *Name, int Count)
+	{
+		PutTag(Ar, Name, "ArrayProperty", sizeof(int) + Count * 8);
+		Ar << Count;
+		for (int i = 0; i < Count; i++)
+			EndProps(Ar);
+	}
+
+	void EndProps(FArchive &Ar)
+	{
+		PutName(Ar, "None");
+	}
+
+	// Put absolute file offset field into export data, the offset is set with SetOffsetTarget().
+	// Returns fixup index.
+	int PutOffset(int Index)
+	{
+		CBenchExport &Exp = Exports[Index - 1];
+		CBenchFixup *Fixup = new (Exp.Fixups) CBenchFixup;
+		Fixup->Pos    = Exp.Data->Tell();
+		Fixup->Target = 0;
+		int Offset = 0;
+		*Exp.Data << Offset;
+		return Exp.Fixups.Num() - 1;
+	}
+
+	// Make the offset field point to the current position in export data
+	void SetOffsetTarget(int Index, int Fixup)
+	{
+		CBenchExport &Exp = Exports[Index - 1];
+		Exp.Fixups[Fixup].Target = Exp.Data->Tell();
+	}
+
+	// Bulk data stored inside export data
+	void PutBulk(int Index, const void *Data, int Size)
+	{
+		FMemWriter &Ar = *Exports[Index - 1].Data;
+#if UNREAL4
+		if (UE4)
+		{
+			int Flags = BULKDATA_ForceInlinePayload;
+			int64 Offset = 0;				// not used for inline data
+			Ar << Flags << Size << Size << Offset;
+		}
+		else
+#endif // UNREAL4
+		{
+			int Flags = 0;
+			Ar << Flags << Size << Size;
+			SetOffsetTarget(Index, PutOffset(Index));
+		}
+		if (Size) Ar.Serialize(const_cast<void*>(Data), Size);
+	}
+
+	void Save(FArchive &Ar, bool Compress)
+	{
+		guard(CBenchPackage::Save);
+
+		int NumNames = Names.Num();
+		assert(!UE4 || !Compress);			// compressed UE4 packages are not used by games, pak files are compressed instead
+
+		// name and import tables, they don't depend on package layout
+		FMemWriter Tables;
+		for (int i = 0; i < Names.Num(); i++)
+		{
+			PutString(Tables, Names[i]);
+			if (UE4) continue;				// UE4 has no name flags
+			uint64 Flags = 0;
+			Tables << Flags;
+		}
+		int ImportTableStart = Tables.Tell();
+		for (int i = 0; i < Imports.Num(); i++)
+		{
+			const CBenchImport &Imp = Imports[i];
+			PutName(Tables, Imp.ClassPackage);
+			PutName(Tables, Imp.ClassName);
+			int PackageIndex = Imp.PackageIndex;
+			Tables << PackageIndex;
+			PutName(Tables, Imp.ObjectName);
+		}
+
+		// compute layout
+		int ExportEntrySize = GetExportEntrySize();
+		int DataSize = 0;
+		for (int i = 0; i < Exports.Num(); i++)
+			DataSize += Exports[i].Data->GetFileSize();
+		int BodySize = Tables.GetFileSize() + Exports.Num() * ExportEntrySize + DataSize;
+		TArray<CBenchChunk> Chunks;
+		if (Compress)
+			Chunks.AddZeroed((BodySize + BENCH_CHUNK_SIZE - 1) / BENCH_CHUNK_SIZE);
+		FMemWriter Summary;
+		WriteSummary(Summary, 0, 0, 0, Chunks);
+		int HeaderSize = Summary.GetFileSize();
+
+		int NameOffset   = HeaderSize;
+		int ImportOffset = NameOffset + ImportTableStart;
+		int ExportOffset = NameOffset + Tables.GetFileSize();
+		int SerialOffset = ExportOffset + Exports.Num() * ExportEntrySize;
+
+		// build uncompressed package body
+		FMemWriter Body(BodySize);
+		Tables.WriteTo(Body);
+		for (int i = 0; i < Exports.Num(); i++)
+		{
+			CBenchExport &Exp = Exports[i];
+			int SerialSize = Exp.Data->GetFileSize();
+			// file offsets are absolute
+			for (int j = 0; j < Exp.Fixups.Num(); j++)
+			{
+				const CBenchFixup &Fixup = Exp.Fixups[j];
+				int Offset = SerialOffset + Fixup.Target;
+				Exp.Data->Seek(Fixup.Pos);
+				*Exp.Data << Offset;
+			}
+			Exp.Data->Seek(SerialSize);
+
+			int EntryStart = Body.Tell();
+			WriteExportEntry(Body, Exp, SerialSize, SerialOffset);
+			assert(Body.Tell() - EntryStart == ExportEntrySize);
+			SerialOffset += SerialSize;
+		}
+		for (int i = 0; i < Exports.Num(); i++)
+			Exports[i].Data->WriteTo(Body);
+		assert(Body.GetFileSize() == BodySize);
+		assert(Names.Num() == NumNames);	// all names should be registered before saving
+
+		if (!Compress)
+		{
+			WriteSummary(Ar, NameOffset, ImportOffset, ExportOffset, Chunks);
+			Body.WriteTo(Ar);
+			return;
+		}
+
+		// compress body with chunks
+		const byte *BodyData = Body.GetData().GetData();
+		FMemWriter ChunkData;
+		TArray<byte> Packed;
+		for (int ChunkIndex = 0; ChunkIndex < Chunks.Num(); ChunkIndex++)
+		{
+			CBenchChunk &Chunk = Chunks[ChunkIndex];
+			Chunk.UncompressedOffset = HeaderSize + ChunkIndex * BENCH_CHUNK_SIZE;
+			Chunk.UncompressedSize   = min(BodySize - ChunkIndex * BENCH_CHUNK_SIZE, BENCH_CHUNK_SIZE);
+			Chunk.CompressedOffset   = HeaderSize + ChunkData.Tell();
+
+			// compress blocks
+			int NumBlocks = (Chunk.UncompressedSize + BENCH_BLOCK_SIZE - 1) / BENCH_BLOCK_SIZE;
+			TArray<int> BlockSizes;
+			FMemWriter Blocks;
+			for (int Block = 0; Block < NumBlocks; Block++)
+			{
+				int Offset = Block * BENCH_BLOCK_SIZE;
+				int Size = min(Chunk.UncompressedSize - Offset, BENCH_BLOCK_SIZE);
+				CompressBlock(BodyData + Chunk.UncompressedOffset - HeaderSize + Offset, Size, Packed);
+				BlockSizes.Add(Packed.Num());
+				BlockSizes.Add(Size);
+				Blocks.Serialize(Packed.GetData(), Packed.Num());
+			}
+
+			// chunk header
+			uint32 Tag = PACKAGE_FILE_TAG;
+			int BlockSize = BENCH_BLOCK_SIZE, CompressedSize = Blocks.GetFileSize(), UncompressedSize = Chunk.UncompressedSize;
+			ChunkData << Tag << BlockSize << CompressedSize << UncompressedSize;
+			for (int i = 0; i < BlockSizes.Num(); i++)
+				ChunkData << BlockSizes[i];
+			Blocks.WriteTo(ChunkData);
+			Chunk.CompressedSize = HeaderSize + ChunkData.Tell() - Chunk.CompressedOffset;
+		}
+
+		WriteSummary(Ar, NameOffset, ImportOffset, ExportOffset, Chunks);
+		ChunkData.WriteTo(Ar);
+
+		unguard;
+	}
+
+private:
+	TArray<const char*>		Names;
+	TArray<CBenchImport>	Imports;
+	TArray<CBenchExport>	Exports;
+
+	int GetExportEntrySize() const
+	{
+		return UE4 ? 72 : 68;
+	}
+
+	void WriteExportEntry(FArchive &Ar, const CBenchExport &Exp, int SerialSize, int SerialOffset)
+	{
+		int ClassIndex = Exp.ClassIndex, SuperIndex = 0, PackageIndex = Exp.PackageIndex;
+		uint32 ObjectFlags = 0;
+		Ar << ClassIndex << SuperIndex;
+		if (UE4)
+		{
+			// UE4.11 format: no Archetype, NetObjectCount and ObjectFlags2
+			int bForcedExport = 0, bNotForClient = 0, bNotForServer = 0, PackageFlags = 0;
+			int bNotForEditorGame = 0, bIsAsset = 1;
+			Ar << PackageIndex;
+			PutName(Ar, Exp.ObjectName);
+			Ar << ObjectFlags << SerialSize << SerialOffset;
+			Ar << bForcedExport << bNotForClient << bNotForServer;
+			PutZeros(Ar, 16);				// Guid
+			Ar << PackageFlags << bNotForEditorGame << bIsAsset;
+			return;
+		}
+		int Archetype = 0;
+		uint32 ObjectFlags2 = 0;
+		int ExportFlags = 0, NetObjectCount = 0, U3unk6C = 0;
+		Ar << PackageIndex;
+		PutName(Ar, Exp.ObjectName);
+		Ar << Archetype << ObjectFlags << ObjectFlags2 << SerialSize << SerialOffset;
+		Ar << ExportFlags << NetObjectCount;
+		PutZeros(Ar, 16);					// Guid
+		Ar << U3unk6C;
+	}
+
+	void WriteSummary(FArchive &Ar, int NameOffset, int ImportOffset, int ExportOffset, const TArray<CBenchChunk> &Chunks)
+	{
+#if UNREAL4
+		if (UE4)
+		{
+			WriteSummary4(Ar, NameOffset, ImportOffset, ExportOffset);
+			return;
+		}
+#endif
+		uint32 Tag = PACKAGE_FILE_TAG;
+		int Version = BENCH_PACKAGE_VERSION;
+		int HeadersSize = ExportOffset + Exports.Num() * GetExportEntrySize();
+		int PackageFlags = 0;
+		int NameCount = Names.Num(), ExportCount = Exports.Num(), ImportCount = Imports.Num();
+		int DependsOffset = 0;
+		int GenerationCount = 1, NetObjectCount = 0;
+		int EngineVersion = 3240, CookerVersion = 0;
+		int CompressionFlags = Chunks.Num() ? COMPRESS_ZLIB : 0;
+		int ChunkCount = Chunks.Num();
+		int U3unk60 = 0;
+
+		Ar << Tag << Version << HeadersSize;
+		PutString(Ar, "None");				// PackageGroup
+		Ar << PackageFlags;
+		Ar << NameCount << NameOffset << ExportCount << ExportOffset << ImportCount << ImportOffset;
+		Ar << DependsOffset;
+		PutZeros(Ar, 16);					// Guid
+		Ar << GenerationCount << ExportCount << NameCount << NetObjectCount;
+		Ar << EngineVersion << CookerVersion << CompressionFlags << ChunkCount;
+		for (int i = 0; i < ChunkCount; i++)
+		{
+			CBenchChunk Chunk = Chunks[i];
+			Ar << Chunk.UncompressedOffset << Chunk.UncompressedSize << Chunk.CompressedOffset << Chunk.CompressedSize;
+		}
+		Ar << U3unk60;
+	}
+
+#if UNREAL4
+	void WriteSummary4(FArchive &Ar, int NameOffset, int ImportOffset, int ExportOffset)
+	{
+		uint32 Tag = PACKAGE_FILE_TAG;
+		int LegacyVersion = BENCH_UE4_LEGACY_VERSION, VersionUE3 = 864, Version = BENCH_UE4_PACKAGE_VERSION, LicenseeVersion = 0;
+		int NumCustomVersions = 0;
+		int HeadersSize = ExportOffset + Exports.Num() * GetExportEntrySize();
+		uint32 PackageFlags = PKG_FilterEditorOnly;	// cooked package
+		int NameCount = Names.Num(), ExportCount = Exports.Num(), ImportCount = Imports.Num();
+		int GatherableTextDataCount = 0, GatherableTextDataOffset = 0;
+		int DependsOffset = 0, StringAssetReferencesCount = 0, StringAssetReferencesOffset = 0;
+		int ThumbnailTableOffset = 0;
+		int GenerationCount = 1;
+		int CompressionFlags = 0, ChunkCount = 0, PackageSource = 0, NumAdditionalPackages = 0;
+		int NumTextureAllocations = 0, AssetRegistryDataOffset = 0;
+		int64 BulkDataStartOffset = 0;
+
+		Ar << Tag << LegacyVersion << VersionUE3 << Version << LicenseeVersion << NumCustomVersions;
+		Ar << HeadersSize;
+		PutString(Ar, "None");				// PackageGroup
+		Ar << PackageFlags;
+		Ar << NameCount << NameOffset << GatherableTextDataCount << GatherableTextDataOffset;
+		Ar << ExportCount << ExportOffset << ImportCount << ImportOffset;
+		Ar << DependsOffset << StringAssetReferencesCount << StringAssetReferencesOffset;
+		Ar << ThumbnailTableOffset;
+		PutZeros(Ar, 16);					// Guid
+		Ar << GenerationCount << ExportCount << NameCount;
+		for (int i = 0; i < 2; i++)
+		{
+			// EngineVersion and CompatibleEngineVersion
+			uint16 Major = 4, Minor = 11, Patch = 0;
+			int Changelist = 0;
+			Ar << Major << Minor << Patch << Changelist;
+			PutString(Ar, "");				// Branch
+		}
+		Ar << CompressionFlags << ChunkCount << PackageSource << NumAdditionalPackages;
+		Ar << NumTextureAllocations << AssetRegistryDataOffset << BulkDataStartOffset;
+	}
+#endif // UNREAL4
+};
+
+
+/*-----------------------------------------------------------------------------
+	Synthetic content
+-----------------------------------------------------------------------------*/
+
+static int GScale = 1;
+
+static const struct
+{
+	const char		*Format;
+	int				Size;
+} BenchTextureSet[] =
+{
+	{ "PF_DXT1",     1024 },
+	{ "PF_DXT1",     512  },
+	{ "PF_DXT5",     512  },
+	{ "PF_DXT5",     256  },
+	{ "PF_A8R8G8B8", 256  },
+	{ "PF_G8",       256  },
+};
+
+static int GetMipDataSize(const char *Format, int USize, int VSize)
+{
+	int BlocksX = max(USize / 4, 1), BlocksY = max(VSize / 4, 1);
+	if (!strcmp(Format, "PF_DXT1")) return BlocksX * BlocksY * 8;
+	if (!strcmp(Format, "PF_DXT5")) return BlocksX * BlocksY * 16;
+	if (!strcmp(Format, "PF_A8R8G8B8")) return USize * VSize * 4;
+	return USize * VSize;	// PF_G8
+}
+
+static void PutDxtColorBlock(byte *Dst, int x, int y)
+{
+	// RGB565 gradient, color0 > color1 selects 4-color mode
+	int r = (x * 3) & 31, g = (y * 5) & 63, b = ((x + y) * 2) & 31;
+	uint16 c0 = (r << 11) | (g << 5) | b;
+	uint16 c1 = c0 >> 1;
+	if (c0 <= c1) c0 = c1 + 1;
+	uint32 Indices = (BenchRand() & 0xFF) * 0x01010101;
+	memcpy(Dst, &c0, 2);
+	memcpy(Dst + 2, &c1, 2);
+	memcpy(Dst + 4, &Indices, 4);
+}
+
+static void FillMipData(byte *Dst, const char *Format, int USize, int VSize)
+{
+	if (!strcmp(Format, "PF_DXT1") || !strcmp(Format, "PF_DXT5"))
+	{
+		bool HasAlpha = (Format[5] == '5');
+		for (int y = 0; y < max(VSize / 4, 1); y++)
+		{
+			for (int x = 0; x < max(USize / 4, 1); x++)
+			{
+				if (HasAlpha)
+				{
+					// alpha block: 2 reference values + 16 3-bit indices
+					Dst[0] = 255;
+					Dst[1] = (x * 8) & 0xFF;
+					uint32 Indices = BenchRand();
+					memcpy(Dst + 2, &Indices, 4);
+					Dst[6] = Dst[7] = 0;
+					Dst += 8;
+				}
+				PutDxtColorBlock(Dst, x, y);
+				Dst += 8;
+			}
+		}
+	}
+	else if (!strcmp(Format, "PF_A8R8G8B8"))
+	{
+		for (int y = 0; y < VSize; y++)
+		{
+			for (int x = 0; x < USize; x++, Dst += 4)
+			{
+				int Noise = BenchRand() & 7;
+				Dst[0] = x + Noise;			// B
+				Dst[1] = y + Noise;			// G
+				Dst[2] = (x ^ y) + Noise;	// R
+				Dst[3] = 255;				// A
+			}
+		}
+	}
+	else
+	{
+		for (int y = 0; y < VSize; y++)
+			for (int x = 0; x < USize; x++)
+				*Dst++ = ((x + y) >> 1) + (BenchRand() & 7);
+	}
+}
+
+static void PutMip(CBenchPackage &Pkg, int Obj, const char *Format, int MipSize)
+{
+	FMemWriter &Ar = Pkg.GetData(Obj);
+	int DataSize = GetMipDataSize(Format, MipSize, MipSize);
+	byte *Data = (byte*)appMalloc(DataSize);
+	FillMipData(Data, Format, MipSize, MipSize);
+	if (Pkg.UE4)
+	{
+		int bCooked = 1;
+		Ar << bCooked;
+	}
+	Pkg.PutBulk(Obj, Data, DataSize);
+	appFree(Data);
+	Ar << MipSize << MipSize;
+}
+
+static void BuildTexturePackage(CBenchPackage &Pkg)
+{
+	guard(BuildTexturePackage);
+
+	int EnginePackage, TextureClass;
+	if (!Pkg.UE4)
+	{
+		EnginePackage = Pkg.AddImport("Core", "Package", 0, "Engine");
+		TextureClass  = Pkg.AddImport("Core", "Class", EnginePackage, "Texture2D");
+	}
+	else
+	{
+		EnginePackage = Pkg.AddImport("/Script/CoreUObject", "Package", 0, "/Script/Engine");
+		TextureClass  = Pkg.AddImport("/Script/CoreUObject", "Class", EnginePackage, "Texture2D");
+	}
+
+	int NumTextures = ARRAY_COUNT(BenchTextureSet) * 2 * GScale;
+	for (int TexIndex = 0; TexIndex < NumTextures; TexIndex++)
+	{
+		const char *Format = BenchTextureSet[TexIndex % ARRAY_COUNT(BenchTextureSet)].Format;
+		int Size = BenchTextureSet[TexIndex % ARRAY_COUNT(BenchTextureSet)].Size;
+		int Obj = Pkg.AddExport(TextureClass, 0, va("BenchTex%03d", TexIndex));
+		FMemWriter &Ar = Pkg.GetData(Obj);
+		int NumMips = 0;
+		for (int MipSize = Size; MipSize >= 4; MipSize >>= 1) NumMips++;
+
+		if (Pkg.UE4)
+		{
+			// UE4 has the same memory layout of this format with different name
+			const char *FormatName = !strcmp(Format, "PF_A8R8G8B8") ? "PF_B8G8R8A8" : Format;
+			Pkg.EndProps(Ar);
+			int bSerializeGuid = 0;
+			Ar << bSerializeGuid;
+			// UTexture and UTexture2D strip flags: editor data is stripped
+			byte StripFlags[4] = { 1, 0, 1, 0 };
+			Ar.Serialize(StripFlags, sizeof(StripFlags));
+			int bCooked = 1;
+			Ar << bCooked;
+			// cooked platform data, list is terminated with "None" format
+			Pkg.PutName(Ar, FormatName);
+			int SkipOffset = Pkg.PutOffset(Obj);
+			int NumSlices = 1, FirstMip = 0;
+			Ar << Size << Size << NumSlices;
+			PutString(Ar, FormatName);
+			Ar << FirstMip << NumMips;
+			for (int Mip = 0; Mip < NumMips; Mip++)
+				PutMip(Pkg, Obj, Format, Size >> Mip);
+			Pkg.SetOffsetTarget(Obj, SkipOffset);
+			Pkg.PutName(Ar, "None");
+			continue;
+		}
+
+		// properties
+		Pkg.PropInt(Ar, "SizeX", Size);
+		Pkg.PropInt(Ar, "SizeY", Size);
+		Pkg.PropEnum(Ar, "Format", Format);
+		Pkg.EndProps(Ar);
+
+		// UTexture3::SourceArt
+		Pkg.PutBulk(Obj, NULL, 0);
+		// mipmaps
+		Ar << NumMips;
+		for (int Mip = 0; Mip < NumMips; Mip++)
+			PutMip(Pkg, Obj, Format, Size >> Mip);
+		// TextureFileCacheGuid
+		PutZeros(Ar, 16);
+	}
+
+	unguard;
+}
+
+static void BuildAnimPackage(CBenchPackage &Pkg)
+{
+	guard(BuildAnimPackage);
+
+	const int NumTracks = 64;
+	const int NumFrames = 120;
+
+	int EnginePackage = Pkg.AddImport("Core", "Package", 0, "Engine");
+	int AnimSetClass  = Pkg.AddImport("Core", "Class", EnginePackage, "AnimSet");
+	int AnimSeqClass  = Pkg.AddImport("Core", "Class", EnginePackage, "AnimSequence");
+
+	// register all names before writing data
+	TArray<const char*> BoneNames;
+	for (int Track = 0; Track < NumTracks; Track++)
+	{
+		const char *BoneName = appStrdupPool(va("Bone%02d", Track));
+		BoneNames.Add(BoneName);
+		Pkg.AddName(BoneName);
+	}
+
+	int AnimSet = Pkg.AddExport(AnimSetClass, 0, "BenchAnimSet");
+	TArray<int> Sequences;
+	int NumSequences = 8 * GScale;
+	for (int SeqIndex = 0; SeqIndex < NumSequences; SeqIndex++)
+	{
+		const char *SeqName = appStrdupPool(va("BenchSeq%03d", SeqIndex));
+		int Seq = Pkg.AddExport(AnimSeqClass, AnimSet, SeqName);
+		Sequences.Add(Seq);
+
+		// compressed stream: ACF_None translation (single key for most bones), ACF_Fixed48NoW rotation
+		FMemWriter Stream;
+		TArray<int> TrackOffsets;
+		for (int Track = 0; Track < NumTracks; Track++)
+		{
+			int TransKeys = (Track == 0) ? NumFrames : 1;
+			TrackOffsets.Add(Stream.Tell());
+			TrackOffsets.Add(TransKeys);
+			for (int Key = 0; Key < TransKeys; Key++)
+			{
+				float X = (Track == 0) ? Key * 2.0f : 10.0f, Y = SeqIndex, Z = 0;
+				Stream << X << Y << Z;
+			}
+			PutZeros(Stream, Align(Stream.Tell(), 4) - Stream.Tell());
+
+			TrackOffsets.Add(Stream.Tell());
+			TrackOffsets.Add(NumFrames);
+			FVector Mins, Ranges;
+			Mins.Set(0, 0, 0);
+			Ranges.Set(1, 1, 1);
+			Stream << Mins << Ranges;
+			for (int Key = 0; Key < NumFrames; Key++)
+			{
+				float Angle = sin(Key * 0.05f + Track + SeqIndex) * 0.6f;
+				float s = sin(Angle / 2);
+				float Axis[3] = { 0.6f, 0.0f, 0.8f };
+				for (int c = 0; c < 3; c++)
+				{
+					uint16 Value = (uint16)(Axis[(c + Track) % 3] * s * 32767 + 32767);
+					Stream << Value;
+				}
+			}
+			PutZeros(Stream, Align(Stream.Tell(), 4) - Stream.Tell());
+		}
+
+		FMemWriter &Ar = Pkg.GetData(Seq);
+		Pkg.PropName(Ar, "SequenceName", SeqName);
+		Pkg.PropFloat(Ar, "SequenceLength", NumFrames / 30.0f);
+		Pkg.PropInt(Ar, "NumFrames", NumFrames);
+		Pkg.PropFloat(Ar, "RateScale", 1.0f);
+		Pkg.PropEnum(Ar, "TranslationCompressionFormat", "ACF_None");
+		Pkg.PropEnum(Ar, "RotationCompressionFormat", "ACF_Fixed48NoW");
+		Pkg.PropEnum(Ar, "KeyEncodingFormat", "AKF_ConstantKeyLerp");
+		Pkg.PropIntArray(Ar, "CompressedTrackOffsets", TrackOffsets);
+		Pkg.EndProps(Ar);
+		// CompressedByteStream
+		int StreamSize = Stream.GetFileSize();
+		Ar << StreamSize;
+		Stream.WriteTo(Ar);
+	}
+
+	FMemWriter &Ar = Pkg.GetData(AnimSet);
+	Pkg.PropBool(Ar, "bAnimRotationOnly", false);
+	Pkg.PropNameArray(Ar, "TrackBoneNames", BoneNames);
+	Pkg.PropObjArray(Ar, "Sequences", Sequences);
+	Pkg.EndProps(Ar);
+
+	unguard;
+}
+
+#if UNREAL3
+
+// Meshes are regular grids of (GridSize+1)^2 vertices over a height field
+static const int BenchMeshGridScale = 4;
+
+static float GetGridHeight(int x, int y)
+{
+	return sin(x * 0.1f) * cos(y * 0.13f) * 10.0f;
+}
+
+static void PutGridVertex(FArchive &Ar, int x, int y)
+{
+	FVector Pos;
+	Pos.Set(x * BenchMeshGridScale, y * BenchMeshGridScale, GetGridHeight(x, y));
+	Ar << Pos;
+}
+
+// Tangent and normal of the height field, computed with central differences
+static void PutGridNormals(FArchive &Ar, int x, int y)
+{
+	float dx = (GetGridHeight(x + 1, y) - GetGridHeight(x - 1, y)) / (2 * BenchMeshGridScale);
+	float dy = (GetGridHeight(x, y + 1) - GetGridHeight(x, y - 1)) / (2 * BenchMeshGridScale);
+	float TLen = sqrt(1 + dx * dx), NLen = sqrt(dx * dx + dy * dy + 1);
+	FVector T, N;
+	T.Set(1 / TLen, 0, dx / TLen);
+	N.Set(-dx / NLen, -dy / NLen, 1 / NLen);
+	FPackedNormal Tangent, Normal;
+	Tangent = T;
+	Normal = N;
+	Normal.Data |= 0xFF000000;				// W is sign of binormal
+	Ar << Tangent << Normal;
+}
+
+static void PutGridUV(FArchive &Ar, int x, int y, int GridSize)
+{
+	FMeshUVFloat UV;
+	UV.U = (float)x / GridSize;
+	UV.V = (float)y / GridSize;
+	Ar << UV;
+}
+
+static void PutGridBounds(FArchive &Ar, int GridSize)
+{
+	float HalfSize = GridSize * BenchMeshGridScale / 2.0f;
+	FBoxSphereBounds Bounds;
+	Bounds.Origin.Set(HalfSize, HalfSize, 0);
+	Bounds.BoxExtent.Set(HalfSize, HalfSize, 10);
+	Bounds.SphereRadius = sqrt(2 * HalfSize * HalfSize + 100);
+	Ar << Bounds;
+}
+
+// Header of the array serialized with TArray::BulkSerialize()
+static void PutBulkArrayHeader(FArchive &Ar, int ElementSize, int Count)
+{
+	Ar << ElementSize << Count;
+}
+
+// 16-bit index buffer of the grid, 2 triangles per cell
+static void PutGridIndices(FArchive &Ar, int GridSize)
+{
+	PutBulkArrayHeader(Ar, sizeof(uint16), GridSize * GridSize * 6);
+	for (int y = 0; y < GridSize; y++)
+	{
+		for (int x = 0; x < GridSize; x++)
+		{
+			uint16 v00 = y * (GridSize + 1) + x, v10 = v00 + 1, v01 = v00 + GridSize + 1, v11 = v01 + 1;
+			Ar << v00 << v10 << v11 << v00 << v11 << v01;
+		}
+	}
+}
+
+static void PutSkeletalMesh(CBenchPackage &Pkg, int Obj, int GridSize, const TArray<const char*> &BoneNames)
+{
+	guard(PutSkeletalMesh);
+
+	FMemWriter &Ar = Pkg.GetData(Obj);
+	int NumBones = BoneNames.Num();
+	int NumVerts = (GridSize + 1) * (GridSize + 1);
+	int NumFaces = GridSize * GridSize * 2;
+	int Zero = 0;
+	assert(NumVerts <= 65536 && NumFaces <= 65535);
+
+	Pkg.PropStructArray(Ar, "LODInfo", 1);
+	Pkg.EndProps(Ar);
+
+	PutGridBounds(Ar, GridSize);
+	Ar << Zero;								// Materials
+	FVector MeshOrigin;
+	FRotator RotOrigin;
+	MeshOrigin.Set(0, 0, 0);
+	RotOrigin.Set(0, 0, 0);
+	Ar << MeshOrigin << RotOrigin;
+
+	// skeleton: chain of bones along X axis
+	float BoneStep = (float)GridSize * BenchMeshGridScale / NumBones;
+	Ar << NumBones;
+	for (int i = 0; i < NumBones; i++)
+	{
+		FQuat Orientation;
+		FVector Position;
+		Orientation.Set(0, 0, 0, 1);
+		Position.Set((i > 0) ? BoneStep : 0, 0, 0);
+		int Flags = 0, NumChildren = (i < NumBones - 1) ? 1 : 0, ParentIndex = max(i - 1, 0), unk44 = -1;
+		Pkg.PutName(Ar, BoneNames[i]);
+		Ar << Flags << Orientation << Position << NumChildren << ParentIndex << unk44;
+	}
+	Ar << NumBones;							// SkeletalDepth
+
+	int NumLods = 1;
+	Ar << NumLods;
+	// FStaticLODModel3: single section and chunk
+	int NumSections = 1, FirstIndex = 0;
+	int16 MaterialIndex = 0, ChunkIndex = 0;
+	uint16 NumTriangles = NumFaces;
+	Ar << NumSections << MaterialIndex << ChunkIndex << FirstIndex << NumTriangles;
+	PutGridIndices(Ar, GridSize);
+	Ar << Zero;								// f68
+	Ar << NumBones;							// UsedBones
+	for (int16 i = 0; i < NumBones; i++) Ar << i;
+	Ar << Zero;								// f74
+	int NumChunks = 1, NumRigidVerts = 0, MaxInfluences = 2;
+	Ar << NumChunks << FirstIndex << Zero << Zero;	// FirstVertex, RigidVerts, SoftVerts
+	Ar << NumBones;							// chunk bone map
+	for (int16 i = 0; i < NumBones; i++) Ar << i;
+	Ar << NumRigidVerts << NumVerts << MaxInfluences;
+	Ar << Zero << NumVerts;					// f80, NumVertices
+	Ar << Zero;								// Edges
+	Ar << NumBones;							// f24
+	for (int i = 0; i < NumBones; i++)
+	{
+		byte Bone = i;
+		Ar << Bone;
+	}
+	Pkg.PutBulk(Obj, NULL, 0);				// raw point indices
+
+	// GPU skin with float UVs, vertices are weighted between 2 neighbour bones
+	int bUseFullPrecisionUVs = 1;
+	Ar << bUseFullPrecisionUVs;
+	PutBulkArrayHeader(Ar, 36, NumVerts);
+	for (int y = 0; y <= GridSize; y++)
+	{
+		for (int x = 0; x <= GridSize; x++)
+		{
+			float BonePos = x * BenchMeshGridScale / BoneStep;
+			int Bone = min((int)BonePos, NumBones - 1);
+			byte Weight1 = (Bone < NumBones - 1) ? (byte)((BonePos - Bone) * 255) : 0;
+			byte BoneIndex[4] = { (byte)Bone, (byte)min(Bone + 1, NumBones - 1), 0, 0 };
+			byte BoneWeight[4] = { (byte)(255 - Weight1), Weight1, 0, 0 };
+			PutGridVertex(Ar, x, y);
+			PutGridNormals(Ar, x, y);
+			Ar.Serialize(BoneIndex, 4);
+			Ar.Serialize(BoneWeight, 4);
+			PutGridUV(Ar, x, y, GridSize);
+		}
+	}
+	Ar << Zero;								// ExtraVertexInfluences
+
+	unguard;
+}
+
+static void PutStaticMesh(CBenchPackage &Pkg, int Obj, int GridSize)
+{
+	guard(PutStaticMesh);
+
+	FMemWriter &Ar = Pkg.GetData(Obj);
+	int NumVerts = (GridSize + 1) * (GridSize + 1);
+	int Zero = 0;
+	assert(NumVerts <= 65536);
+
+	Pkg.EndProps(Ar);
+	PutGridBounds(Ar, GridSize);
+	Ar << Zero;								// BodySetup
+	PutBulkArrayHeader(Ar, 32, 0);			// kDOPNodes
+	PutBulkArrayHeader(Ar, 8, 0);			// kDOPTriangles
+	int InternalVersion = 18;
+	Ar << InternalVersion << Zero;			// InternalVersion, ContentTags
+
+	int NumLods = 1;
+	Ar << NumLods;
+	// FStaticMeshLODModel3
+	Pkg.PutBulk(Obj, NULL, 0);				// raw triangles
+	int NumSections = 1, bEnableShadowCasting = 1, FirstIndex = 0, NumFaces = GridSize * GridSize * 2, LastVertex = NumVerts - 1;
+	Ar << NumSections;
+	Ar << Zero << Zero << Zero << bEnableShadowCasting;	// Mat, f10, f14
+	Ar << FirstIndex << NumFaces << Zero << LastVertex << Zero << Zero;	// ..., Index, f30
+	// position stream
+	int VertexSize = sizeof(FVector);
+	Ar << VertexSize << NumVerts;
+	PutBulkArrayHeader(Ar, VertexSize, NumVerts);
+	for (int y = 0; y <= GridSize; y++)
+		for (int x = 0; x <= GridSize; x++)
+			PutGridVertex(Ar, x, y);
+	// normals and UVs
+	int NumTexCoords = 1, ItemSize = 20, bUseFullPrecisionUVs = 1;
+	Ar << NumTexCoords << ItemSize << NumVerts << bUseFullPrecisionUVs;
+	PutBulkArrayHeader(Ar, ItemSize, NumVerts);
+	for (int y = 0; y <= GridSize; y++)
+	{
+		for (int x = 0; x <= GridSize; x++)
+		{
+			int Color = -1;
+			PutGridNormals(Ar, x, y);
+			Ar << Color;
+			PutGridUV(Ar, x, y, GridSize);
+		}
+	}
+	// empty color stream
+	int ColorSize = sizeof(int);
+	Ar << ColorSize << Zero;
+	PutBulkArrayHeader(Ar, ColorSize, 0);
+	Ar << NumVerts;
+	PutGridIndices(Ar, GridSize);
+	PutBulkArrayHeader(Ar, sizeof(uint16), 0);	// wireframe indices
+	PutBulkArrayHeader(Ar, 16, 0);			// Edges
+	Ar << Zero;								// fEC
+
+	unguard;
+}
+
+static void BuildMeshPackage(CBenchPackage &Pkg)
+{
+	guard(BuildMeshPackage);
+
+	const int NumBones = 64;
+
+	int EnginePackage   = Pkg.AddImport("Core", "Package", 0, "Engine");
+	int SkelMeshClass   = Pkg.AddImport("Core", "Class", EnginePackage, "SkeletalMesh");
+	int StaticMeshClass = Pkg.AddImport("Core", "Class", EnginePackage, "StaticMesh");
+
+	TArray<const char*> BoneNames;
+	for (int i = 0; i < NumBones; i++)
+	{
+		const char *BoneName = appStrdupPool(va("Bone%02d", i));
+		BoneNames.Add(BoneName);
+		Pkg.AddName(BoneName);
+	}
+
+	for (int i = 0; i < 2 * GScale; i++)
+	{
+		PutSkeletalMesh(Pkg, Pkg.AddExport(SkelMeshClass, 0, va("BenchSkelMesh%02d", i)), 128, BoneNames);
+		PutStaticMesh(Pkg, Pkg.AddExport(StaticMeshClass, 0, va("BenchStaticMesh%02d", i)), 64);
+	}
+
+	unguard;
+}
+
+#endif // UNREAL3
+
+enum
+{
+	BENCH_TEXTURES,
+	BENCH_ANIMS,
+	BENCH_MESHES,
+	BENCH_TEXTURES_UE4,
+};
+
+static void GeneratePackage(int Type, bool Compress, FArchive &Ar)
+{
+	GRandSeed = Type * 2 + Compress;
+	CBenchPackage Pkg(Type == BENCH_TEXTURES_UE4);
+	if (Type == BENCH_TEXTURES || Type == BENCH_TEXTURES_UE4)
+		BuildTexturePackage(Pkg);
+	else if (Type == BENCH_ANIMS)
+		BuildAnimPackage(Pkg);
+#if UNREAL3
+	else if (Type == BENCH_MESHES)
+		BuildMeshPackage(Pkg);
+#endif
+	Pkg.Save(Ar, Compress);
+}
+
+static int64 WriteBenchFile(const char *DataDir, const char *Name, const FMemWriter &Data)
+{
+	char Path[512];
+	appSprintf(ARRAY_ARG(Path), "%s/%s", DataDir, Name);
+	appMakeDirectoryForFile(Path);
+	FFileWriter Ar(Path);
+	const TArray<byte> &Buf = Data.GetData();
+	Ar.Serialize(const_cast<byte*>(Buf.GetData()), Buf.Num());
+	return Buf.Num();
+}
+
+
+#if UNREAL4
+
+struct CBenchPakEntry
+{
+	const char		*Name;
+	int64			Pos;
+	int64			Size;
+	int64			UncompressedSize;
+	int				CompressionMethod;
+	TArray<int64>	Blocks;					// pairs of CompressedStart/CompressedEnd
+};
+
+static void WritePakEntry(FArchive &Ar, const CBenchPakEntry &E)
+{
+	int64 Pos = E.Pos, Size = E.Size, UncompressedSize = E.UncompressedSize;
+	int CompressionMethod = E.CompressionMethod;
+	Ar << Pos << Size << UncompressedSize << CompressionMethod;
+	PutZeros(Ar, 20);						// Hash
+	if (CompressionMethod)
+	{
+		int NumBlocks = E.Blocks.Num() / 2;
+		Ar << NumBlocks;
+		for (int i = 0; i < E.Blocks.Num(); i++)
+		{
+			int64 Offset = E.Blocks[i];
+			Ar << Offset;
+		}
+	}
+	byte bEncrypted = 0;
+	int BlockSize = CompressionMethod ? BENCH_PAK_BLOCK_SIZE : 0;
+	Ar << bEncrypted << BlockSize;
+}
+
+// Pak file of version 3 (PAK_COMPRESSION_ENCRYPTION)
+static void BuildPakFile(FArchive &Ar, const TArray<const char*> &FileNames, const TArray<FMemWriter*> &Files, bool Compress)
+{
+	guard(BuildPakFile);
+
+	assert(FileNames.Num() == Files.Num());
+	TArray<CBenchPakEntry> Entries;
+	Entries.AddDefaulted(Files.Num());
+
+	for (int FileIndex = 0; FileIndex < Files.Num(); FileIndex++)
+	{
+		CBenchPakEntry &E = Entries[FileIndex];
+		const TArray<byte> &Data = Files[FileIndex]->GetData();
+		E.Name = FileNames[FileIndex];
+		E.Pos  = Ar.Tell();
+		E.UncompressedSize = Data.Num();
+		if (!Compress)
+		{
+			E.Size = Data.Num();
+			WritePakEntry(Ar, E);
+			Ar.Serialize(const_cast<byte*>(Data.GetData()), Data.Num());
+			continue;
+		}
+		// compress blocks first, block offsets are stored in entry header
+		E.CompressionMethod = COMPRESS_ZLIB;
+		int NumBlocks = (Data.Num() + BENCH_PAK_BLOCK_SIZE - 1) / BENCH_PAK_BLOCK_SIZE;
+		int HeaderSize = 8 * 3 + 4 + 20 + 4 + NumBlocks * 16 + 1 + 4;
+		FMemWriter Blocks;
+		TArray<byte> Packed;
+		for (int Block = 0; Block < NumBlocks; Block++)
+		{
+			int Offset = Block * BENCH_PAK_BLOCK_SIZE;
+			CompressBlock(Data.GetData() + Offset, min(Data.Num() - Offset, BENCH_PAK_BLOCK_SIZE), Packed);
+			E.Blocks.Add(E.Pos + HeaderSize + Blocks.Tell());
+			Blocks.Serialize(Packed.GetData(), Packed.Num());
+			E.Blocks.Add(E.Pos + HeaderSize + Blocks.Tell());
+		}
+		E.Size = Blocks.GetFileSize();
+		WritePakEntry(Ar, E);
+		assert(Ar.Tell() == E.Pos + HeaderSize);
+		Blocks.WriteTo(Ar);
+	}
+
+	// index
+	int64 IndexOffset = Ar.Tell();
+	PutString(Ar, BENCH_MOUNT_POINT);
+	int NumEntries = Entries.Num();
+	Ar << NumEntries;
+	for (int i = 0; i < NumEntries; i++)
+	{
+		PutString(Ar, Entries[i].Name);
+		WritePakEntry(Ar, Entries[i]);
+	}
+	int64 IndexSize = Ar.Tell() - IndexOffset;
+
+	// footer (FPakInfo)
+	byte bEncryptedIndex = 0;
+	uint32 Magic = 0x5A6F12E1;
+	int Version = 3;
+	Ar << bEncryptedIndex << Magic << Version << IndexOffset << IndexSize;
+	PutZeros(Ar, 20);						// IndexHash
+
+	unguard;
+}
+
+#endif // UNREAL4
+
+static void GenerateData(const char *DataDir)
+{
+	guard(GenerateData);
+
+	CBenchScope Scope("generate");
+
+	static const struct
+	{
+		const char	*Name;
+		int			Type;
+		bool		Compress;
+	} Packages[] =
+	{
+		{ "BenchTextures.upk",  BENCH_TEXTURES, false },
+		{ "BenchTexturesC.upk", BENCH_TEXTURES, true  },
+		{ "BenchAnims.upk",     BENCH_ANIMS,    false },
+		{ "BenchAnimsC.upk",    BENCH_ANIMS,    true  },
+#if UNREAL3
+		{ "BenchMeshes.upk",    BENCH_MESHES,   false },
+		{ "BenchMeshesC.upk",   BENCH_MESHES,   true  },
+#endif
+#if UNREAL4
+		{ "BenchTextures4.uasset", BENCH_TEXTURES_UE4, false },
+#endif
+	};
+	for (int i = 0; i < ARRAY_COUNT(Packages); i++)
+	{
+		FMemWriter Data;
+		GeneratePackage(Packages[i].Type, Packages[i].Compress, Data);
+		Scope.Bytes += WriteBenchFile(DataDir, Packages[i].Name, Data);
+		Scope.Objects++;
+	}
+
+#if UNREAL4
+	// pak files with uncompressed packages inside: one with uncompressed and one with compressed entries
+	static const struct
+	{
+		const char	*Name;
+		int			Type;
+	} PakPackages[] =
+	{
+		{ "PakTextures%s.upk",     BENCH_TEXTURES     },
+		{ "PakAnims%s.upk",        BENCH_ANIMS        },
+		{ "PakTextures4%s.uasset", BENCH_TEXTURES_UE4 },
+	};
+	for (int Compress = 0; Compress < 2; Compress++)
+	{
+		TArray<const char*> Names;
+		TArray<FMemWriter*> Files;
+		for (int i = 0; i < ARRAY_COUNT(PakPackages); i++)
+		{
+			FMemWriter *Data = new FMemWriter;
+			GeneratePackage(PakPackages[i].Type, false, *Data);
+			Names.Add(appStrdupPool(va(PakPackages[i].Name, Compress ? "Z" : "")));
+			Files.Add(Data);
+		}
+		FMemWriter Pak;
+		BuildPakFile(Pak, Names, Files, Compress != 0);
+		Scope.Bytes += WriteBenchFile(DataDir, Compress ? "BenchZ.pak" : "Bench.pak", Pak);
+		Scope.Objects += Files.Num();
+		for (int i = 0; i < Files.Num(); i++)
+			delete Files[i];
+	}
+#endif // UNREAL4
+
+	FFileWriter::FlushPendingWrites();
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Mesh export
+-----------------------------------------------------------------------------*/
+
+#if UNREAL3
+
+// Meshes from synthetic packages are exported to psk/pskx in BenchPackages(), here they are
+// exported to glTF
+static void BenchMeshes()
+{
+	guard(BenchMeshes);
+
+	CBenchScope Scope("export_gltf");
+	for (int i = 0; i < UObject::GObjObjects.Num(); i++)
+	{
+		UObject *Obj = UObject::GObjObjects[i];
+		if (Obj->IsA("SkeletalMesh3"))
+		{
+			const CSkeletalMesh *Mesh = static_cast<USkeletalMesh3*>(Obj)->ConvertedMesh;
+			if (!Mesh || !Mesh->Lods.Num()) continue;
+			ExportSkeletalMeshGltf(Mesh);
+			Scope.Bytes += Mesh->Lods[0].NumVerts * sizeof(CSkelMeshVertex);
+			Scope.Objects++;
+		}
+		else if (Obj->IsA("StaticMesh3"))
+		{
+			const CStaticMesh *Mesh = static_cast<UStaticMesh3*>(Obj)->ConvertedMesh;
+			if (!Mesh || !Mesh->Lods.Num()) continue;
+			ExportStaticMeshGltf(Mesh);
+			Scope.Bytes += Mesh->Lods[0].NumVerts * sizeof(CStaticMeshVertex);
+			Scope.Objects++;
+		}
+	}
+	ResetExportedList();
+
+	unguard;
+}
+
+#endif // UNREAL3
+
+
+/*-----------------------------------------------------------------------------
+	Guard overhead
+-----------------------------------------------------------------------------*/
+
+// Guards are compared with calls of a tiny function through a pointer, so the compiler couldn't
+// inline it. With table-based C++ exceptions guards are almost free, with Win32 SEH every guard()
+// registers an exception frame.
+
+#define GUARD_BENCH_CALLS		(1 << 24)
+#define GUARD_BENCH_READ_SIZE	(64 << 20)
+
+static int GuardNone(int Value)
+{
+	return Value * 3 + 1;
+}
+
+static int GuardFull(int Value)
+{
+	guard(GuardFull);
+	return Value * 3 + 1;
+	unguard;
+}
+
+static int GGuardBenchResult;		// prevents optimizing away the work
+
+static void BenchGuardCalls(const char *StageName, int (* volatile Func)(int))
+{
+	CBenchScope Scope(StageName);
+	int Count = GUARD_BENCH_CALLS * GScale;
+	int Value = 0;
+	for (int i = 0; i < Count; i++)
+		Value = Func(Value);
+	GGuardBenchResult += Value;
+	Scope.Objects = Count;
+}
+
+static void BenchGuards()
+{
+	guard(BenchGuards);
+
+	BenchGuardCalls("guard_none", GuardNone);
+	BenchGuardCalls("guard_full", GuardFull);
+
+	// FMemReader::Serialize() is a guarded function called for every value
+	byte *Data = (byte*)appMalloc(GUARD_BENCH_READ_SIZE);
+	for (int i = 0; i < GUARD_BENCH_READ_SIZE; i++)
+		Data[i] = i & 0xFF;
+	{
+		CBenchScope Scope("read_int32");
+		FMemReader Ar(Data, GUARD_BENCH_READ_SIZE);
+		int Sum = 0;
+		for (int i = 0; i < GUARD_BENCH_READ_SIZE / 4; i++)
+		{
+			int Value;
+			Ar << Value;
+			Sum += Value;
+		}
+		GGuardBenchResult += Sum;
+		Scope.Bytes   = GUARD_BENCH_READ_SIZE;
+		Scope.Objects = GUARD_BENCH_READ_SIZE / 4;
+	}
+	appFree(Data);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Stream decryption
+-----------------------------------------------------------------------------*/
+
+// Decryptors are called for data read in chunks of random size, like file readers do; the result
+// is compared with scalar reference code processing the whole buffer byte by byte
+
+#define DECRYPT_BENCH_SIZE		(32 << 20)
+#define DECRYPT_BENCH_MAX_CHUNK	65536
+
+typedef void (*DecryptFunc_t)(byte *Data, int Size, int Pos);
+
+static byte BenchXorKey[31];		// key size is not a power of 2, like in DecryptTaoYuan()
+
+static void DecryptXor(byte *Data, int Size, int Pos)
+{
+	appXorBlock(Data, Size, BenchXorKey, ARRAY_COUNT(BenchXorKey), Pos);
+}
+
+static void DecryptXorRef(byte *Data, int Size, int Pos)
+{
+	for (int i = 0; i < Size; i++)
+		Data[i] ^= BenchXorKey[(Pos + i) % ARRAY_COUNT(BenchXorKey)];
+}
+
+#if BATTLE_TERR
+
+static void DecryptBattleTerrPos(byte *Data, int Size, int Pos)
+{
+	DecryptBattleTerr(Data, Size);
+}
+
+static void DecryptBattleTerrRef(byte *Data, int Size, int Pos)
+{
+	for (int i = 0; i < Size; i++)
+	{
+		byte b = Data[i];
+		int shift;
+		byte v;
+		for (shift = 1, v = b & (b - 1); v; v = v & (v - 1))
+			shift++;
+		Data[i] = ROL8(b, shift);
+	}
+}
+
+#endif // BATTLE_TERR
+
+#if AA2
+
+static void DecryptAA2Ref(byte *Data, int Size, int Pos)
+{
+	for (int i = 0; i < Size; i++)
+	{
+		byte b = Data[i];
+		int PosXor = Pos + i;
+		PosXor = (PosXor >> 8) ^ PosXor;
+		b ^= (PosXor & 0xFF);
+		if (PosXor & 2)
+			b = ROL8(b, 1);
+		Data[i] = b;
+	}
+}
+
+#endif // AA2
+
+static void BenchDecryptStage(const char *StageName, DecryptFunc_t Decrypt, DecryptFunc_t Reference, const byte *Source, int Size)
+{
+	guard(BenchDecryptStage);
+
+	byte *Data = (byte*)appMalloc(Size);
+	byte *RefData = (byte*)appMalloc(Size);
+	memcpy(Data, Source, Size);
+	memcpy(RefData, Source, Size);
+
+	{
+		CBenchScope Scope(StageName);
+		GRandSeed = 1;
+		for (int Pos = 0; Pos < Size; )
+		{
+			int ChunkSize = BenchRand() % DECRYPT_BENCH_MAX_CHUNK + 1;
+			ChunkSize = min(ChunkSize, Size - Pos);
+			Decrypt(Data + Pos, ChunkSize, Pos);
+			Pos += ChunkSize;
+			Scope.Objects++;
+		}
+		Scope.Bytes = Size;
+	}
+	{
+		CBenchScope Scope(appStrdupPool(va("%s_ref", StageName)));
+		Reference(RefData, Size, 0);
+		Scope.Bytes = Size;
+		Scope.Objects = 1;
+	}
+
+	for (int i = 0; i < Size; i++)
+	{
+		if (Data[i] != RefData[i])
+			appError("%s: result differs from scalar code at offset %d", StageName, i);
+	}
+
+	appFree(Data);
+	appFree(RefData);
+
+	unguard;
+}
+
+static void BenchDecrypt()
+{
+	guard(BenchDecrypt);
+
+	int Size = DECRYPT_BENCH_SIZE * GScale;
+	byte *Source = (byte*)appMalloc(Size);
+	GRandSeed = 0;
+	for (int i = 0; i < Size; i++)
+		Source[i] = BenchRand();
+	for (int i = 0; i < ARRAY_COUNT(BenchXorKey); i++)
+		BenchXorKey[i] = BenchRand();
+
+	BenchDecryptStage("decrypt_xor", DecryptXor, DecryptXorRef, Source, Size);
+#if BATTLE_TERR
+	BenchDecryptStage("decrypt_battleterr", DecryptBattleTerrPos, DecryptBattleTerrRef, Source, Size);
+#endif
+#if AA2
+	BenchDecryptStage("decrypt_aa2", DecryptAA2, DecryptAA2Ref, Source, Size);
+#endif
+
+	appFree(Source);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Benchmark stages
+-----------------------------------------------------------------------------*/
+
+static void BenchDecompress()
+{
+	guard(BenchDecompress);
+
+	CBenchScope Scope("decompress");
+	for (int i = 0; i < GBlobs.Num(); i++)
+	{
+		const CBenchBlob &Blob = GBlobs[i];
+		byte *Buffer = (byte*)appMalloc(Blob.UncompressedSize);
+		appDecompress(Blob.Data, Blob.CompressedSize, Buffer, Blob.UncompressedSize, COMPRESS_ZLIB);
+		appFree(Buffer);
+		Scope.Bytes += Blob.UncompressedSize;
+	}
+	Scope.Objects = GBlobs.Num();
+
+	unguard;
+}
+
+static void BenchPackages(const TArray<const CGameFileInfo*> &Files, bool RegisterClassesForGame)
+{
+	guard(BenchPackages);
+
+	TArray<UnPackage*> Packages;
+	{
+		CBenchScope Scope("open_packages");
+		for (int i = 0; i < Files.Num(); i++)
+		{
+			UnPackage *Package = UnPackage::LoadPackage(Files[i]->RelativeName);
+			if (!Package) continue;
+			Packages.Add(Package);
+			Scope.Bytes += Package->GetFileSize();
+			Scope.Objects += Package->Summary.ExportCount;
+		}
+	}
+	if (!Packages.Num())
+	{
+		appPrintf("No packages were loaded\n");
+		return;
+	}
+
+	if (RegisterClassesForGame)
+	{
+		// classes could be registered only once, and only when engine version is known
+		static bool ClassesRegistered = false;
+		if (!ClassesRegistered)
+		{
+			RegisterUnrealClasses(Packages[0]->Game);
+			ClassesRegistered = true;
+		}
+	}
+
+	{
+		CBenchScope Scope("load_objects");
+		int NumObjects = UObject::GObjObjects.Num();
+		for (int i = 0; i < Packages.Num(); i++)
+		{
+			UnPackage *Package = Packages[i];
+			LoadWholePackage(Package);
+			for (int j = 0; j < Package->Summary.ExportCount; j++)
+			{
+				const FObjectExport &Exp = Package->GetExport(j);
+				if (Exp.Object) Scope.Bytes += Exp.SerialSize;
+			}
+		}
+		Scope.Objects = UObject::GObjObjects.Num() - NumObjects;
+	}
+
+	{
+		CBenchScope Scope("texture_decode");
+		for (int i = 0; i < UObject::GObjObjects.Num(); i++)
+		{
+			const UObject *Obj = UObject::GObjObjects[i];
+			if (!Obj->IsA("UnrealMaterial")) continue;
+			const UUnrealMaterial *Tex = static_cast<const UUnrealMaterial*>(Obj);
+			CTextureData TexData;
+			if (!Tex->GetTextureData(TexData) || !TexData.Mips.Num()) continue;
+			byte *Pic = TexData.Decompress(0);
+			if (Pic)
+			{
+				Scope.Bytes += TexData.Mips[0].USize * TexData.Mips[0].VSize * 4;
+				Scope.Objects++;
+				delete Pic;
+			}
+			Tex->ReleaseTextureData();
+		}
+	}
+
+#if UNREAL3
+	{
+		CBenchScope Scope("convert_anims");
+		for (int i = 0; i < UObject::GObjObjects.Num(); i++)
+		{
+			UObject *Obj = UObject::GObjObjects[i];
+			if (!Obj->IsA("AnimSet")) continue;
+			UAnimSet *AnimSet = static_cast<UAnimSet*>(Obj);
+			// animations were converted in PostLoad(), repeat conversion
+			if (AnimSet->ConvertedAnim) delete AnimSet->ConvertedAnim;
+			AnimSet->ConvertedAnim = NULL;
+			AnimSet->ConvertAnims();
+			for (int j = 0; j < AnimSet->Sequences.Num(); j++)
+			{
+				const UAnimSequence *Seq = AnimSet->Sequences[j];
+				if (!Seq) continue;
+				Scope.Bytes += Seq->CompressedByteStream.Num();
+				Scope.Objects++;
+			}
+		}
+	}
+#endif // UNREAL3
+
+	{
+		CBenchScope Scope("export_objects");
+		// copy object list, exporters could create new objects
+		TArray<UObject*> Objects;
+		CopyArray(Objects, UObject::GObjObjects);
+		for (int i = 0; i < Objects.Num(); i++)
+		{
+			if (ExportObject(Objects[i])) Scope.Objects++;
+		}
+		ResetExportedList();
+	}
+
+	unguard;
+}
+
+static void ReleaseAll()
+{
+	ReleaseAllObjects();
+	UnPackage::UnloadPackages(0);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Report
+-----------------------------------------------------------------------------*/
+
+static double GetStageRate(double Value, double TimeMs)
+{
+	return (TimeMs > 0) ? Value * 1000.0 / TimeMs : 0;
+}
+
+static void WriteJson(const char *FileName, bool Synthetic)
+{
+	FILE *f = fopen(FileName, "w");
+	if (!f)
+	{
+		appPrintf("ERROR: unable to create %s\n", FileName);
+		return;
+	}
+	// one stage per line, so reports could be compared with diff
+	fprintf(f, "{\n\"tool\":\"umodel-bench\",\"mode\":\"%s\",\"scale\":%d,\"threads\":%d,\"peak_rss\":\"%s\",\n\"stages\":[\n",
+		Synthetic ? "synthetic" : "directory", GScale, appGetNumWorkerThreads(), GPeakRssPerStage ? "stage" : "process");
+	for (int i = 0; i < GStages.Num(); i++)
+	{
+		const CBenchStage &S = GStages[i];
+		fprintf(f, "{\"name\":\"%s\",\"runs\":%d,\"time_ms\":%.3f,\"bytes\":%lld,\"objects\":%d,"
+			"\"mb_per_sec\":%.2f,\"objects_per_sec\":%.1f,\"allocs\":%d,\"heap_mb\":%.2f,\"peak_rss_mb\":%.2f}%s\n",
+			S.Name, S.Runs, S.TimeMs, (long long)S.Bytes, S.Objects,
+			GetStageRate(S.Bytes / (1024.0 * 1024.0), S.TimeMs), GetStageRate(S.Objects, S.TimeMs),
+			S.Allocs, S.HeapBytes / (1024.0 * 1024.0), S.PeakRss / (1024.0 * 1024.0),
+			(i < GStages.Num() - 1) ? "," : "");
+	}
+	fprintf(f, "]\n}\n");
+	fclose(f);
+	appPrintf("Report saved to %s\n", FileName);
+}
+
+// Find time of the stage in previously saved report; returns negative value when not found
+static double FindBaselineTime(const char *Baseline, const char *StageName)
+{
+	if (!Baseline) return -1;
+	char Key[256];
+	appSprintf(ARRAY_ARG(Key), "\"name\":\"%s\"", StageName);
+	const char *s = strstr(Baseline, Key);
+	if (!s) return -1;
+	const char *LineEnd = strchr(s, '\n');
+	s = strstr(s, "\"time_ms\":");
+	if (!s || (LineEnd && s > LineEnd)) return -1;
+	return atof(s + 10);
+}
+
+static char* LoadTextFile(const char *FileName)
+{
+	FILE *f = fopen(FileName, "rb");
+	if (!f)
+	{
+		appPrintf("WARNING: unable to open baseline report %s\n", FileName);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	int Size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	char *Text = new char[Size + 1];
+	Size = fread(Text, 1, Size, f);
+	Text[Size] = 0;
+	fclose(f);
+	return Text;
+}
+
+static void PrintReport(const char *Baseline)
+{
+	appPrintf("\n%-22s %10s %10s %12s %10s %10s %10s", "Stage", "Time,ms", "MB/s", "Objects/s", "Allocs", "Heap,MB", "RSS,MB");
+	if (Baseline) appPrintf(" %10s", "Change");
+	appPrintf("\n");
+	for (int i = 0; i < GStages.Num(); i++)
+	{
+		const CBenchStage &S = GStages[i];
+		appPrintf("%-22s %10.2f %10.2f %12.1f %10d %10.2f %10.2f", S.Name, S.TimeMs,
+			GetStageRate(S.Bytes / (1024.0 * 1024.0), S.TimeMs), GetStageRate(S.Objects, S.TimeMs),
+			S.Allocs, S.HeapBytes / (1024.0 * 1024.0), S.PeakRss / (1024.0 * 1024.0));
+		if (Baseline)
+		{
+			double OldTime = FindBaselineTime(Baseline, S.Name);
+			if (OldTime > 0)
+				appPrintf(" %+9.1f%%", (S.TimeMs - OldTime) * 100.0 / OldTime);
+			else
+				appPrintf(" %10s", "-");
+		}
+		appPrintf("\n");
+	}
+	if (!GPeakRssPerStage)
+		appPrintf("Note: RSS is peak resident memory since process start\n");
+}
+
+
+/*-----------------------------------------------------------------------------
+	Main function
+-----------------------------------------------------------------------------*/
+
+static int GLimit = 0;
+
+static bool CollectPackage(const CGameFileInfo *File, TArray<const CGameFileInfo*> &Files)
+{
+	Files.Add(File);
+	return (GLimit <= 0 || Files.Num() < GLimit);
+}
+
+int main(int argc, char **argv)
+{
+	appInitPlatform();
+
+#if DO_GUARD
+	TRY {
+#endif
+
+	guard(Main);
+
+	const char *GameDir  = NULL;
+	const char *DataDir  = "bench-data";
+	const char *OutDir   = "bench-export";
+	const char *JsonFile = "umodel-bench.json";
+	const char *BaselineFile = NULL;
+	int NumRepeats = 1;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const char *opt = argv[arg];
+		if (opt[0] != '-')
+		{
+			if (GameDir) goto help;
+			GameDir = opt;
+			continue;
+		}
+		opt++;
+		if (!strnicmp(opt, "data=", 5))
+			DataDir = opt+5;
+		else if (!strnicmp(opt, "out=", 4))
+			OutDir = opt+4;
+		else if (!strnicmp(opt, "json=", 5))
+			JsonFile = opt+5;
+		else if (!strnicmp(opt, "baseline=", 9))
+			BaselineFile = opt+9;
+		else if (!strnicmp(opt, "scale=", 6))
+			GScale = max(atoi(opt+6), 1);
+		else if (!strnicmp(opt, "repeat=", 7))
+			NumRepeats = max(atoi(opt+7), 1);
+		else if (!strnicmp(opt, "limit=", 6))
+			GLimit = atoi(opt+6);
+		else if (!strnicmp(opt, "threads=", 8))
+			GNumThreads = atoi(opt+8);
+		else if (!strnicmp(opt, "profile=", 8))
+			appStartProfiler(opt+8);
+		else if (!strnicmp(opt, "metrics=", 8))
+			appStartObjectMetrics(opt+8);
+		else if (!strnicmp(opt, "game=", 5))
+		{
+			int tag = FindGameTag(opt+5);
+			if (tag < 0)
+			{
+				printf("ERROR: unknown game tag \"%s\"\n", opt+5);
+				exit(1);
+			}
+			GForceGame = tag;
+		}
+		else
+		{
+		help:
+			printf(	"UModel headless benchmark\n"
+					"Usage: umodel-bench [options] [<game directory>]\n"
+					"\n"
+					"Without game directory, synthetic UE3 packages (textures, animations and meshes) and a\n"
+					"cooked UE4 texture package are generated and processed; texture and animation packages\n"
+					"are also stored in pak files to measure pak reading. When directory is specified,\n"
+					"packages from it are loaded and exported.\n"
+					"\n"
+					"Options:\n"
+					"    -data=PATH      directory for synthetic packages (default: bench-data)\n"
+					"    -out=PATH       export directory (default: bench-export)\n"
+					"    -json=FILE      write report to FILE (default: umodel-bench.json)\n"
+					"    -baseline=FILE  compare stage times with previously saved report\n"
+					"    -scale=N        multiply amount of synthetic data by N\n"
+					"    -repeat=N       run processing stages N times, report the best time\n"
+					"    -limit=N        process only first N packages from game directory\n"
+					"    -threads=N      use up to N threads for parallel work\n"
+					"    -profile=FILE   save Chrome trace of profiled scopes to FILE\n"
+					"    -metrics=FILE   save per-object load/export metrics to FILE\n"
+					"    -game=tag       override game autodetection\n"
+					"\n"
+					"For details and updates please visit " HOMEPAGE "\n"
+			);
+			exit(0);
+		}
+	}
+
+	bool Synthetic = (GameDir == NULL);
+	if (Synthetic)
+	{
+		GenerateData(DataDir);
+		RegisterUnrealClasses(GAME_UE3);
+	}
+	RegisterExporters();
+	appSetBaseExportDirectory(OutDir);
+
+	TArray<const CGameFileInfo*> Files;
+	{
+		CBenchScope Scope("mount");
+		appSetRootDirectory(Synthetic ? DataDir : GameDir);
+		appEnumGameFiles(CollectPackage, Files);
+		Scope.Objects = Files.Num();
+	}
+	if (!Files.Num())
+		appError("No packages found in \"%s\"", Synthetic ? DataDir : GameDir);
+
+	for (int Run = 0; Run < NumRepeats; Run++)
+	{
+		if (Synthetic)
+		{
+			BenchGuards();
+			BenchDecompress();
+			BenchDecrypt();
+		}
+		BenchPackages(Files, !Synthetic);
+#if UNREAL3
+		if (Synthetic) BenchMeshes();
+#endif
+		ReleaseAll();
+	}
+
+	char *Baseline = BaselineFile ? LoadTextFile(BaselineFile) : NULL;
+	PrintReport(Baseline);
+	if (Baseline) delete[] Baseline;
+	WriteJson(JsonFile, Synthetic);
+
+	unguard;
+
+#if DO_GUARD
+	} CATCH {
+		if (GErrorHistory[0])
+		{
+			appNotify("ERROR: %s\n", GErrorHistory);
+		}
+		else
+		{
+			appNotify("Unknown error\n");
+		}
+		exit(1);
+	}
+#endif
+	return 0;
+}
@@ -0,0 +1,6 @@
+@echo off
+
+rm umodel-bench.exe
+bash build.sh
+
+umodel-bench.exe %*
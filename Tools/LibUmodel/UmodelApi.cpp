@@ -0,0 +1,909 @@
+#include "Core.h"
+#include "UnCore.h"
+
+// Classes for registration
+#include "UnrealClasses.h"
+#include "UnPackage.h"
+#include "UnAnimNotify.h"
+
+#include "UnMaterial2.h"
+#include "UnMaterial3.h"
+
+#include "UnMesh2.h"
+#include "UnMesh3.h"
+#include "UnMesh4.h"
+
+#include "UnSound.h"
+#include "UnThirdParty.h"
+
+#include "SkeletalMesh.h"
+#include "StaticMesh.h"
+
+#include "Exporters/Exporters.h"
+
+#include "GameDatabase.h"
+#include "PackageUtils.h"
+
+#define LIBUMODEL_EXPORTS	1
+#include "libumodel.h"
+
+
+#if UNREAL4
+
+int UE4UnversionedPackage(int verMin, int verMax)
+{
+	appError("Unversioned UE4 packages are not supported. Please specify game tag ue4.%d..ue4.%d in umodel_init().", verMin, verMax);
+	return -1;
+}
+
+#endif // UNREAL4
+
+
+static void InitClassSystem(int Game)
+{
+	static bool initialized = false;
+	if (initialized) return;
+	initialized = true;
+
+	RegisterUnrealClasses(Game);
+#if BIOSHOCK
+	if (Game == GAME_Bioshock)
+	{
+		//!! should change this code!
+		CTypeInfo::RemapProp("UShader", "Opacity", "Opacity_Bio"); //!!
+	}
+#endif // BIOSHOCK
+}
+
+
+/*-----------------------------------------------------------------------------
+	Error handling
+-----------------------------------------------------------------------------*/
+
+// Exported functions catch errors with TRY/CATCH and perform real work in separate functions:
+// with Win32 SEH, a function which uses __try can't have objects with destructors.
+
+static char GLastError[2048];
+
+static void SetError(const char *Fmt, ...)
+{
+	va_list argptr;
+	va_start(argptr, Fmt);
+	vsnprintf(ARRAY_ARG(GLastError), Fmt, argptr);
+	va_end(argptr);
+}
+
+// Called from CATCH block
+static void HandleError(bool LoaderFailed)
+{
+	appStrncpyz(GLastError, GErrorHistory[0] ? GErrorHistory : "Unknown error", ARRAY_COUNT(GLastError));
+	// prepare for the next error
+	GErrorHistory[0] = 0;
+	GIsSwError = false;
+
+	FFileWriter::CleanupOnError();
+	ResetExportedList();
+	if (LoaderFailed)
+	{
+		// Objects could be partially loaded, release everything and reset loader state
+		UObject::GObjLoaded.Empty();
+		UObject::GObjBeginLoadCount = 0;
+		UObject::GLoadingObj = NULL;
+		ReleaseAllObjects();
+	}
+}
+
+FORCEINLINE UnPackage *ToPackage(const umodel_package *pkg)
+{
+	return (UnPackage*)pkg;
+}
+
+FORCEINLINE UObject *ToObject(const umodel_object *obj)
+{
+	return (UObject*)obj;
+}
+
+// Exported functions reject NULL handles before doing anything else
+#define CHECK_HANDLE(Handle, Result)						\
+	if (!Handle)											\
+	{														\
+		SetError("%s: NULL " #Handle, __FUNCTION__);		\
+		return Result;										\
+	}
+
+
+/*-----------------------------------------------------------------------------
+	Library
+-----------------------------------------------------------------------------*/
+
+static bool GInitialized = false;
+
+int umodel_api_version(void)
+{
+	return UMODEL_API_VERSION;
+}
+
+static int InitLibrary(const char *GamePath, const char *GameTag)
+{
+	guard(InitLibrary);
+
+	if (GInitialized)
+	{
+		SetError("Library is already initialized");
+		return -1;
+	}
+	if (GameTag)
+	{
+		int tag = FindGameTag(GameTag);
+		if (tag < 0)
+		{
+			SetError("Unknown game tag \"%s\"", GameTag);
+			return -1;
+		}
+		GForceGame = tag;
+	}
+	RegisterExporters();
+	appSetRootDirectory(GamePath);
+	GInitialized = true;
+	return 0;
+
+	unguard;
+}
+
+int umodel_init(const char *game_path, const char *game_tag)
+{
+	GLastError[0] = 0;
+	int result = -1;
+	TRY
+	{
+		result = InitLibrary(game_path, game_tag);
+	}
+	CATCH
+	{
+		HandleError(false);
+	}
+	return result;
+}
+
+const char *umodel_last_error(void)
+{
+	return GLastError;
+}
+
+void umodel_set_log_callback(umodel_log_callback callback, void *param)
+{
+	appSetPrintfRedirect(callback, param);
+}
+
+struct CFindPackagesContext
+{
+	const char		*Mask;
+	const char		**Names;
+	int				MaxNames;
+	int				Count;
+};
+
+static bool FindPackagesCallback(const CGameFileInfo *File, CFindPackagesContext &Context)
+{
+	if (Context.Mask && !appMatchWildcard(File->RelativeName, Context.Mask, true))
+		return true;
+	if (Context.Count < Context.MaxNames)
+		Context.Names[Context.Count] = File->RelativeName;
+	Context.Count++;
+	return true;
+}
+
+int umodel_find_packages(const char *mask, const char **names, int max_names)
+{
+	GLastError[0] = 0;
+	CFindPackagesContext Context;
+	Context.Mask     = mask;
+	Context.Names    = names;
+	Context.MaxNames = names ? max_names : 0;
+	Context.Count    = 0;
+	appEnumGameFiles(FindPackagesCallback, Context);
+	return Context.Count;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Packages and objects
+-----------------------------------------------------------------------------*/
+
+static UnPackage *LoadPackage(const char *Name)
+{
+	guard(LoadPackage);
+
+	UnPackage *Package = UnPackage::LoadPackage(Name);
+	if (!Package)
+	{
+		SetError("Unable to load package \"%s\"", Name);
+		return NULL;
+	}
+	// classes could be registered only when engine version is known
+	InitClassSystem(Package->Game);
+	return Package;
+
+	unguardf("%s", Name);
+}
+
+umodel_package *umodel_load_package(const char *name)
+{
+	GLastError[0] = 0;
+	UnPackage *Package = NULL;
+	TRY
+	{
+		Package = LoadPackage(name);
+	}
+	CATCH
+	{
+		HandleError(true);
+	}
+	return (umodel_package*)Package;
+}
+
+const char *umodel_package_name(const umodel_package *pkg)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(pkg, NULL);
+	return ToPackage(pkg)->Name;
+}
+
+int umodel_package_export_count(const umodel_package *pkg)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(pkg, -1);
+	return ToPackage(pkg)->Summary.ExportCount;
+}
+
+static const FObjectExport *GetExport(const UnPackage *Package, int Index)
+{
+	if (Index < 0 || Index >= Package->Summary.ExportCount)
+	{
+		SetError("Package \"%s\": wrong export index %d", Package->Name, Index);
+		return NULL;
+	}
+	return &Package->ExportTable[Index];
+}
+
+static const char *GetExportName(const UnPackage *Package, int Index, bool ClassName)
+{
+	guard(GetExportName);
+
+	const FObjectExport *Exp = GetExport(Package, Index);
+	if (!Exp) return NULL;
+	return ClassName ? Package->GetObjectName(Exp->ClassIndex) : *Exp->ObjectName;
+
+	unguardf("%s:%d", Package->Name, Index);
+}
+
+const char *umodel_package_export_name(const umodel_package *pkg, int index)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(pkg, NULL);
+	const char *result = NULL;
+	TRY
+	{
+		result = GetExportName(ToPackage(pkg), index, false);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = NULL;
+	}
+	return result;
+}
+
+const char *umodel_package_export_class(const umodel_package *pkg, int index)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(pkg, NULL);
+	const char *result = NULL;
+	TRY
+	{
+		result = GetExportName(ToPackage(pkg), index, true);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = NULL;
+	}
+	return result;
+}
+
+static int FindExport(const UnPackage *Package, const char *Name, const char *ClassName, int FirstIndex)
+{
+	guard(FindExport);
+	return Package->FindExport(Name, ClassName, max(FirstIndex, 0));
+	unguardf("%s", Package->Name);
+}
+
+int umodel_package_find_export(const umodel_package *pkg, const char *name, const char *class_name, int first_index)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(pkg, -1);
+	CHECK_HANDLE(name, -1);
+	int result = -1;
+	TRY
+	{
+		result = FindExport(ToPackage(pkg), name, class_name, first_index);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = -1;
+	}
+	return result;
+}
+
+static UObject *LoadObject(UnPackage *Package, int Index)
+{
+	guard(LoadObject);
+
+	if (Index < 0 || Index >= Package->Summary.ExportCount)
+	{
+		SetError("Package \"%s\": wrong export index %d", Package->Name, Index);
+		return NULL;
+	}
+	UObject *Obj = Package->CreateExport(Index);
+	if (!Obj)
+	{
+		const FObjectExport &Exp = Package->GetExport(Index);
+		SetError("Object \"%s\" of class \"%s\" is not supported", *Exp.ObjectName, Package->GetObjectName(Exp.ClassIndex));
+	}
+	return Obj;
+
+	unguardf("%s:%d", Package->Name, Index);
+}
+
+umodel_object *umodel_load_object(umodel_package *pkg, int index)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(pkg, NULL);
+	UObject *Obj = NULL;
+	TRY
+	{
+		Obj = LoadObject(ToPackage(pkg), index);
+	}
+	CATCH
+	{
+		HandleError(true);
+		Obj = NULL;
+	}
+	return (umodel_object*)Obj;
+}
+
+const char *umodel_object_name(const umodel_object *obj)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, NULL);
+	return ToObject(obj)->Name;
+}
+
+static const char *GetObjectClass(const UObject *Obj)
+{
+	guard(GetObjectClass);
+	return Obj->GetRealClassName();
+	unguardf("%s", Obj->Name);
+}
+
+const char *umodel_object_class(const umodel_object *obj)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, NULL);
+	const char *result = NULL;
+	TRY
+	{
+		result = GetObjectClass(ToObject(obj));
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = NULL;
+	}
+	return result;
+}
+
+void umodel_release_objects(void)
+{
+	GLastError[0] = 0;
+	TRY
+	{
+		ReleaseAllObjects();
+	}
+	CATCH
+	{
+		HandleError(true);
+	}
+}
+
+static int ExportObjects(umodel_object *const *Objs, int Count, const char *OutDir)
+{
+	guard(ExportObjects);
+
+	appSetBaseExportDirectory(OutDir);
+	int NumExported = 0;
+	for (int i = 0; i < Count; i++)
+	{
+		if (Objs[i] && ExportObject(ToObject(Objs[i])))
+			NumExported++;
+	}
+	// wait for completion of file writes, and allow exporting the same objects again
+	ResetExportedList();
+	return NumExported;
+
+	unguard;
+}
+
+int umodel_export_objects(umodel_object *const *objs, int count, const char *out_dir)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(objs, -1);
+	CHECK_HANDLE(out_dir, -1);
+	int result = -1;
+	TRY
+	{
+		result = ExportObjects(objs, count, out_dir);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = -1;
+	}
+	return result;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Textures
+-----------------------------------------------------------------------------*/
+
+static int DecodeTexture(const UObject *Obj, int Mip, umodel_texture *Tex)
+{
+	guard(DecodeTexture);
+
+	memset(Tex, 0, sizeof(umodel_texture));
+	if (!Obj->IsA("UnrealMaterial"))
+	{
+		SetError("Object \"%s\" is not a texture", Obj->Name);
+		return -1;
+	}
+
+	const UUnrealMaterial *Material = static_cast<const UUnrealMaterial*>(Obj);
+	CTextureData TexData;
+	if (Material->GetTextureData(TexData) && TexData.Mips.IsValidIndex(Mip))
+	{
+		// decoded image is passed to the caller without copying
+		Tex->pixels = TexData.Decompress(Mip);
+		if (Tex->pixels)
+		{
+			Tex->width        = TexData.Mips[Mip].USize;
+			Tex->height       = TexData.Mips[Mip].VSize;
+			Tex->num_mips     = TexData.Mips.Num();
+			Tex->is_normalmap = TexData.isNormalmap;
+		}
+	}
+	Material->ReleaseTextureData();
+
+	if (!Tex->pixels)
+	{
+		SetError("Unable to decode mip %d of texture \"%s\"", Mip, Obj->Name);
+		return -1;
+	}
+	return 0;
+
+	unguardf("%s", Obj->Name);
+}
+
+int umodel_texture_decode(umodel_object *obj, int mip, umodel_texture *tex)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	CHECK_HANDLE(tex, -1);
+	int result = -1;
+	TRY
+	{
+		result = DecodeTexture(ToObject(obj), mip, tex);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = -1;
+	}
+	return result;
+}
+
+void umodel_texture_release(umodel_texture *tex)
+{
+	// allocated by CTextureData::Decompress()
+	delete[] tex->pixels;
+	memset(tex, 0, sizeof(umodel_texture));
+}
+
+
+/*-----------------------------------------------------------------------------
+	Meshes
+-----------------------------------------------------------------------------*/
+
+staticAssert(ARRAY_COUNT(((umodel_mesh_lod*)NULL)->extra_uv) == MAX_MESH_UV_SETS-1, Wrong_ExtraUV_Count);
+staticAssert(sizeof(CVec3) == sizeof(float) * 3, Wrong_CVec3_Size);
+staticAssert(sizeof(CQuat) == sizeof(float) * 4, Wrong_CQuat_Size);
+
+static CSkeletalMesh *GetSkeletalMesh(const UObject *Obj)
+{
+	if (Obj->IsA("SkeletalMesh"))
+		return static_cast<const USkeletalMesh*>(Obj)->ConvertedMesh;
+#if UNREAL3
+	if (Obj->IsA("SkeletalMesh3"))
+		return static_cast<const USkeletalMesh3*>(Obj)->ConvertedMesh;
+#endif
+#if UNREAL4
+	if (Obj->IsA("SkeletalMesh4"))
+		return static_cast<const USkeletalMesh4*>(Obj)->ConvertedMesh;
+#endif
+	return NULL;
+}
+
+static CStaticMesh *GetStaticMesh(const UObject *Obj)
+{
+	if (Obj->IsA("StaticMesh"))
+		return static_cast<const UStaticMesh*>(Obj)->ConvertedMesh;
+#if UNREAL3
+	if (Obj->IsA("StaticMesh3"))
+		return static_cast<const UStaticMesh3*>(Obj)->ConvertedMesh;
+#endif
+#if UNREAL4
+	if (Obj->IsA("StaticMesh4"))
+		return static_cast<const UStaticMesh4*>(Obj)->ConvertedMesh;
+#endif
+	return NULL;
+}
+
+int umodel_mesh_lod_count(const umodel_object *obj)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	const UObject *Obj = ToObject(obj);
+	if (const CSkeletalMesh *SkelMesh = GetSkeletalMesh(Obj))
+		return SkelMesh->Lods.Num();
+	if (const CStaticMesh *StatMesh = GetStaticMesh(Obj))
+		return StatMesh->Lods.Num();
+	SetError("Object \"%s\" is not a mesh", Obj->Name);
+	return -1;
+}
+
+static void GetInfluences(const CSkelMeshLod &Lod, umodel_mesh_lod *View)
+{
+	View->weights = &Lod.Verts->PackedWeights;
+	View->bones   = Lod.Verts->Bone;
+}
+
+static void GetInfluences(const CStaticMeshLod &Lod, umodel_mesh_lod *View)
+{
+	View->weights = NULL;
+	View->bones   = NULL;
+}
+
+template<class TLod>
+static void GetLodView(TLod &Lod, umodel_mesh_lod *View)
+{
+	guard(GetLodView);
+
+	memset(View, 0, sizeof(umodel_mesh_lod));
+	if (!Lod.NumVerts) return;
+
+	// normals are built when mesh is loaded, tangents - on demand
+	Lod.BuildNormals();
+	Lod.BuildTangents();
+
+	View->num_verts     = Lod.NumVerts;
+	View->vertex_stride = sizeof(Lod.Verts[0]);
+	View->position      = Lod.Verts->Position.v;
+	View->normal        = &Lod.Verts->Normal.Data;
+	View->tangent       = &Lod.Verts->Tangent.Data;
+	View->uv            = &Lod.Verts->UV.U;
+	GetInfluences(Lod, View);
+
+	View->num_uv_sets   = Lod.NumTexCoords;
+	for (int i = 0; i < Lod.NumTexCoords - 1; i++)
+		View->extra_uv[i] = &Lod.ExtraUV[i]->U;
+
+	const CIndexBuffer &Indices = Lod.Indices;
+	View->num_indices   = Indices.Num();
+	View->index_size    = Indices.Is32Bit() ? 4 : 2;
+	View->indices       = Indices.Is32Bit() ? (const void*)Indices.Indices32.GetData() : (const void*)Indices.Indices16.GetData();
+	View->num_sections  = Lod.Sections.Num();
+
+	unguard;
+}
+
+static int GetMeshLod(const UObject *Obj, int LodIndex, umodel_mesh_lod *View)
+{
+	guard(GetMeshLod);
+
+	CSkeletalMesh *SkelMesh = GetSkeletalMesh(Obj);
+	CStaticMesh *StatMesh = GetStaticMesh(Obj);
+	if (!SkelMesh && !StatMesh)
+	{
+		SetError("Object \"%s\" is not a mesh", Obj->Name);
+		return -1;
+	}
+	int NumLods = SkelMesh ? SkelMesh->Lods.Num() : StatMesh->Lods.Num();
+	if (LodIndex < 0 || LodIndex >= NumLods)
+	{
+		SetError("Mesh \"%s\" has no LOD %d", Obj->Name, LodIndex);
+		return -1;
+	}
+	if (SkelMesh)
+		GetLodView(SkelMesh->Lods[LodIndex], View);
+	else
+		GetLodView(StatMesh->Lods[LodIndex], View);
+	return 0;
+
+	unguardf("%s", Obj->Name);
+}
+
+int umodel_mesh_get_lod(umodel_object *obj, int lod, umodel_mesh_lod *view)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	CHECK_HANDLE(view, -1);
+	int result = -1;
+	TRY
+	{
+		result = GetMeshLod(ToObject(obj), lod, view);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = -1;
+	}
+	return result;
+}
+
+static int GetMeshSection(const UObject *Obj, int LodIndex, int SectionIndex, umodel_mesh_section *View)
+{
+	guard(GetMeshSection);
+
+	const CSkeletalMesh *SkelMesh = GetSkeletalMesh(Obj);
+	const CStaticMesh *StatMesh = GetStaticMesh(Obj);
+	const CBaseMeshLod *Lod = NULL;
+	if (SkelMesh && SkelMesh->Lods.IsValidIndex(LodIndex))
+		Lod = &SkelMesh->Lods[LodIndex];
+	else if (StatMesh && StatMesh->Lods.IsValidIndex(LodIndex))
+		Lod = &StatMesh->Lods[LodIndex];
+	if (!Lod || !Lod->Sections.IsValidIndex(SectionIndex))
+	{
+		SetError("Object \"%s\" has no mesh section %d:%d", Obj->Name, LodIndex, SectionIndex);
+		return -1;
+	}
+	const CMeshSection &Sec = Lod->Sections[SectionIndex];
+	View->first_index = Sec.FirstIndex;
+	View->num_faces   = Sec.NumFaces;
+	View->material    = Sec.Material ? Sec.Material->Name : NULL;
+	return 0;
+
+	unguardf("%s", Obj->Name);
+}
+
+int umodel_mesh_get_section(const umodel_object *obj, int lod, int section, umodel_mesh_section *view)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	CHECK_HANDLE(view, -1);
+	int result = -1;
+	TRY
+	{
+		result = GetMeshSection(ToObject(obj), lod, section, view);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = -1;
+	}
+	return result;
+}
+
+static int GetBoneCount(const UObject *Obj)
+{
+	guard(GetBoneCount);
+
+	const CSkeletalMesh *Mesh = GetSkeletalMesh(Obj);
+	if (!Mesh)
+	{
+		SetError("Object \"%s\" is not a skeletal mesh", Obj->Name);
+		return -1;
+	}
+	return Mesh->RefSkeleton.Num();
+
+	unguardf("%s", Obj->Name);
+}
+
+int umodel_mesh_bone_count(const umodel_object *obj)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	int result = -1;
+	TRY
+	{
+		result = GetBoneCount(ToObject(obj));
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = -1;
+	}
+	return result;
+}
+
+static int GetBone(const UObject *Obj, int Index, umodel_bone *Bone)
+{
+	guard(GetBone);
+
+	const CSkeletalMesh *Mesh = GetSkeletalMesh(Obj);
+	if (!Mesh || !Mesh->RefSkeleton.IsValidIndex(Index))
+	{
+		SetError("Object \"%s\" has no bone %d", Obj->Name, Index);
+		return -1;
+	}
+	const CSkelMeshBone &B = Mesh->RefSkeleton[Index];
+	Bone->name   = B.Name;
+	Bone->parent = (Index > 0) ? B.ParentIndex : -1;		// root bone could reference itself
+	memcpy(Bone->position, &B.Position, sizeof(Bone->position));
+	memcpy(Bone->orientation, &B.Orientation, sizeof(Bone->orientation));
+	return 0;
+
+	unguardf("%s", Obj->Name);
+}
+
+int umodel_mesh_get_bone(const umodel_object *obj, int index, umodel_bone *bone)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	CHECK_HANDLE(bone, -1);
+	int result = -1;
+	TRY
+	{
+		result = GetBone(ToObject(obj), index, bone);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = -1;
+	}
+	return result;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Animations
+-----------------------------------------------------------------------------*/
+
+// Returns false when object is not an animation set. Anim is NULL when animation set has no
+// converted animations (i.e. UE4 Skeleton without loaded AnimSequence objects).
+static bool GetAnimSet(const UObject *Obj, const CAnimSet *&Anim)
+{
+	Anim = NULL;
+	if (Obj->IsA("MeshAnimation"))
+		Anim = static_cast<const UMeshAnimation*>(Obj)->ConvertedAnim;
+#if UNREAL3
+	else if (Obj->IsA("AnimSet"))
+		Anim = static_cast<const UAnimSet*>(Obj)->ConvertedAnim;
+#endif
+#if UNREAL4
+	else if (Obj->IsA("Skeleton"))
+		Anim = static_cast<const USkeleton*>(Obj)->ConvertedAnim;
+#endif
+	else
+	{
+		SetError("Object \"%s\" is not an animation set", Obj->Name);
+		return false;
+	}
+	return true;
+}
+
+static const CAnimSequence *GetAnimSequence(const UObject *Obj, int SeqIndex)
+{
+	const CAnimSet *Anim;
+	if (!GetAnimSet(Obj, Anim)) return NULL;
+	if (!Anim || !Anim->Sequences.IsValidIndex(SeqIndex))
+	{
+		SetError("Animation set \"%s\" has no sequence %d", Obj->Name, SeqIndex);
+		return NULL;
+	}
+	return Anim->Sequences[SeqIndex];
+}
+
+int umodel_anim_track_count(const umodel_object *obj)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	const CAnimSet *Anim;
+	if (!GetAnimSet(ToObject(obj), Anim)) return -1;
+	return Anim ? Anim->TrackBoneNames.Num() : 0;
+}
+
+const char *umodel_anim_track_bone(const umodel_object *obj, int track)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, NULL);
+	const UObject *Obj = ToObject(obj);
+	const CAnimSet *Anim;
+	if (!GetAnimSet(Obj, Anim)) return NULL;
+	if (!Anim || !Anim->TrackBoneNames.IsValidIndex(track))
+	{
+		SetError("Animation set \"%s\" has no track %d", Obj->Name, track);
+		return NULL;
+	}
+	return Anim->TrackBoneNames[track];
+}
+
+int umodel_anim_sequence_count(const umodel_object *obj)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	const CAnimSet *Anim;
+	if (!GetAnimSet(ToObject(obj), Anim)) return -1;
+	return Anim ? Anim->Sequences.Num() : 0;
+}
+
+int umodel_anim_get_sequence(const umodel_object *obj, int seq, umodel_anim_sequence *view)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	CHECK_HANDLE(view, -1);
+	const CAnimSequence *Seq = GetAnimSequence(ToObject(obj), seq);
+	if (!Seq) return -1;
+	view->name       = Seq->Name;
+	view->num_frames = Seq->NumFrames;
+	view->rate       = Seq->Rate;
+	return 0;
+}
+
+static int SampleAnimation(const UObject *Obj, int SeqIndex, int FirstFrame, int NumFrames, float *Positions, float *Orientations)
+{
+	guard(SampleAnimation);
+
+	const CAnimSequence *Seq = GetAnimSequence(Obj, SeqIndex);
+	if (!Seq) return -1;
+	if (FirstFrame < 0 || NumFrames < 0 || FirstFrame + NumFrames > Seq->NumFrames)
+	{
+		SetError("Wrong frame range %d..%d for sequence \"%s\"", FirstFrame, FirstFrame + NumFrames - 1, *Seq->Name);
+		return -1;
+	}
+
+	// sampler doesn't change values for tracks without keys
+	CVec3 *DstPos  = (CVec3*)Positions;
+	CQuat *DstQuat = (CQuat*)Orientations;
+	int Count = NumFrames * Seq->Tracks.Num();
+	for (int i = 0; i < Count; i++)
+	{
+		DstPos[i].Set(0, 0, 0);
+		DstQuat[i].Set(0, 0, 0, 1);
+	}
+
+	CAnimPoseSampler Sampler(*Seq);
+	Sampler.SampleFrames(FirstFrame, NumFrames, DstPos, DstQuat);
+	return 0;
+
+	unguardf("%s", Obj->Name);
+}
+
+int umodel_anim_sample(const umodel_object *obj, int seq, int first_frame, int num_frames, float *positions, float *orientations)
+{
+	GLastError[0] = 0;
+	CHECK_HANDLE(obj, -1);
+	CHECK_HANDLE(positions, -1);
+	CHECK_HANDLE(orientations, -1);
+	int result = -1;
+	TRY
+	{
+		result = SampleAnimation(ToObject(obj), seq, first_frame, num_frames, positions, orientations);
+	}
+	CATCH
+	{
+		HandleError(false);
+		result = -1;
+	}
+	return result;
+}
@@ -0,0 +1,6 @@
+#!/bin/bash
+
+project="libumodel"
+root="../.."
+render=0
+source $root/build.sh
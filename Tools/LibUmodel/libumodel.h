@@ -0,0 +1,211 @@
+#ifndef __LIBUMODEL_H__
+#define __LIBUMODEL_H__
+
+/*-----------------------------------------------------------------------------
+	libumodel: C interface to UModel package loader and exporters
+-----------------------------------------------------------------------------*/
+
+/*
+	Library keeps a single game file system, loaded packages and objects, so its functions should
+	be called from one thread at a time. Functions which could fail return NULL or a negative value,
+	description of the error is available with umodel_last_error(). NULL package and object handles
+	are reported as errors too.
+
+	Packages are cached and live until the library is unloaded. Objects live until
+	umodel_release_objects() is called. Mesh, skeleton and animation data is returned as views:
+	structures with pointers into internal object data, nothing is copied. Views are valid while
+	the object is alive. Decoded textures are owned by the caller and should be freed with
+	umodel_texture_release().
+
+	Increment UMODEL_API_VERSION when structures or function signatures are changed.
+*/
+
+#define UMODEL_API_VERSION		1
+
+#if _WIN32
+#	if LIBUMODEL_EXPORTS
+#		define UMODEL_API		__declspec(dllexport)
+#	else
+#		define UMODEL_API		__declspec(dllimport)
+#	endif
+#elif __GNUC__ >= 4
+#	define UMODEL_API			__attribute__((visibility("default")))
+#else
+#	define UMODEL_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct umodel_package	umodel_package;
+typedef struct umodel_object	umodel_object;
+
+/* Callback receives all text printed by the library, text is not zero-terminated */
+typedef void (*umodel_log_callback)(const char *text, int length, void *param);
+
+
+/*-----------------------------------------------------------------------------
+	Library
+-----------------------------------------------------------------------------*/
+
+/* Returns UMODEL_API_VERSION the library was compiled with */
+UMODEL_API int umodel_api_version(void);
+
+/* Mount game directory, could be called only once. game_tag is a tag of -game=tag option of
+   UModel, NULL enables game autodetection. Returns 0 on success. */
+UMODEL_API int umodel_init(const char *game_path, const char *game_tag);
+
+/* Description of the last error, empty string when there was no error */
+UMODEL_API const char *umodel_last_error(void);
+
+/* Redirect library output (warnings, export progress) from stdout to the callback, NULL
+   restores stdout. Affects the calling thread only. */
+UMODEL_API void umodel_set_log_callback(umodel_log_callback callback, void *param);
+
+/* Find package files which names match the wildcard (for example, "*.upk"). Returns number of
+   found packages, at most max_names names (relative to game directory) are stored to names.
+   Names are valid until the library is unloaded. */
+UMODEL_API int umodel_find_packages(const char *mask, const char **names, int max_names);
+
+
+/*-----------------------------------------------------------------------------
+	Packages and objects
+-----------------------------------------------------------------------------*/
+
+/* Package name could be a file name, a path relative to game directory or a package name
+   without extension */
+UMODEL_API umodel_package *umodel_load_package(const char *name);
+
+UMODEL_API const char *umodel_package_name(const umodel_package *pkg);
+UMODEL_API int umodel_package_export_count(const umodel_package *pkg);
+UMODEL_API const char *umodel_package_export_name(const umodel_package *pkg, int index);
+UMODEL_API const char *umodel_package_export_class(const umodel_package *pkg, int index);
+
+/* Find export by object name and optional class name, search starts from first_index.
+   Returns -1 when not found. */
+UMODEL_API int umodel_package_find_export(const umodel_package *pkg, const char *name, const char *class_name, int first_index);
+
+/* Create object from package export. Returns NULL when object class is not supported, or
+   in a case of error. Objects referenced by this one are loaded too. */
+UMODEL_API umodel_object *umodel_load_object(umodel_package *pkg, int index);
+
+UMODEL_API const char *umodel_object_name(const umodel_object *obj);
+UMODEL_API const char *umodel_object_class(const umodel_object *obj);
+
+/* Release all loaded objects. All object handles and views become invalid. */
+UMODEL_API void umodel_release_objects(void);
+
+/* Export objects with UModel exporters to out_dir (the same file layout as "umodel -export"
+   uses). Returns number of exported objects, or -1 in a case of error. */
+UMODEL_API int umodel_export_objects(umodel_object *const *objs, int count, const char *out_dir);
+
+
+/*-----------------------------------------------------------------------------
+	Textures
+-----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	int				width;
+	int				height;
+	int				num_mips;				/* number of mips in the texture */
+	int				is_normalmap;
+	unsigned char	*pixels;				/* RGBA, 8 bits per channel, width * height * 4 bytes */
+} umodel_texture;
+
+/* Decode mip level of the texture (any object of "UnrealMaterial" class which has texture
+   data). Returns 0 on success. */
+UMODEL_API int umodel_texture_decode(umodel_object *obj, int mip, umodel_texture *tex);
+UMODEL_API void umodel_texture_release(umodel_texture *tex);
+
+
+/*-----------------------------------------------------------------------------
+	Meshes
+-----------------------------------------------------------------------------*/
+
+/*
+	Vertices are stored in a single array, use vertex_stride to get the next vertex:
+	- position:	3 floats
+	- normal, tangent: packed signed bytes x, y, z, w, value = byte / 127; normal.w is
+	  the sign of binormal = cross(normal, tangent)
+	- uv:		2 floats
+	- weights:	(skeletal meshes only) 4 packed unsigned bytes, value = byte / 255
+	- bones:	(skeletal meshes only) 4 bone indices, -1 = unused influence
+	Additional UV sets are arrays of 2 floats per vertex.
+*/
+
+typedef struct
+{
+	int				num_verts;
+	int				vertex_stride;			/* in bytes */
+	const float		*position;
+	const unsigned	*normal;
+	const unsigned	*tangent;
+	const float		*uv;
+	const unsigned	*weights;				/* NULL for static meshes */
+	const short		*bones;					/* NULL for static meshes */
+	int				num_uv_sets;			/* including base set */
+	const float		*extra_uv[7];			/* UV sets [1 .. num_uv_sets-1] */
+	int				num_indices;			/* triangle list */
+	int				index_size;				/* 2 or 4 bytes */
+	const void		*indices;
+	int				num_sections;
+} umodel_mesh_lod;
+
+typedef struct
+{
+	int				first_index;
+	int				num_faces;
+	const char		*material;				/* name of material object, NULL when not set */
+} umodel_mesh_section;
+
+typedef struct
+{
+	const char		*name;
+	int				parent;					/* -1 for root bone */
+	float			position[3];
+	float			orientation[4];			/* quaternion x, y, z, w */
+} umodel_bone;
+
+/* Works with skeletal and static meshes of all engine versions. Returns -1 for other objects. */
+UMODEL_API int umodel_mesh_lod_count(const umodel_object *obj);
+/* Returns 0 on success */
+UMODEL_API int umodel_mesh_get_lod(umodel_object *obj, int lod, umodel_mesh_lod *view);
+UMODEL_API int umodel_mesh_get_section(const umodel_object *obj, int lod, int section, umodel_mesh_section *view);
+
+/* Skeleton of skeletal mesh; returns -1 for other objects */
+UMODEL_API int umodel_mesh_bone_count(const umodel_object *obj);
+UMODEL_API int umodel_mesh_get_bone(const umodel_object *obj, int index, umodel_bone *bone);
+
+
+/*-----------------------------------------------------------------------------
+	Animations
+-----------------------------------------------------------------------------*/
+
+typedef struct
+{
+	const char		*name;
+	int				num_frames;
+	float			rate;					/* frames per second */
+} umodel_anim_sequence;
+
+/* Animation sets (MeshAnimation, AnimSet and Skeleton objects). Functions return -1 for other
+   objects. Animation tracks are bound to bones by name. */
+UMODEL_API int umodel_anim_track_count(const umodel_object *obj);
+UMODEL_API const char *umodel_anim_track_bone(const umodel_object *obj, int track);
+UMODEL_API int umodel_anim_sequence_count(const umodel_object *obj);
+UMODEL_API int umodel_anim_get_sequence(const umodel_object *obj, int seq, umodel_anim_sequence *view);
+
+/* Sample frames [first_frame .. first_frame+num_frames-1] of the sequence. positions receives
+   num_frames * track_count * 3 floats, orientations receives num_frames * track_count * 4 floats
+   (quaternion x, y, z, w), ordered by frame then track. Tracks without keys get zero position
+   and identity orientation. Returns 0 on success. */
+UMODEL_API int umodel_anim_sample(const umodel_object *obj, int seq, int first_frame, int num_frames, float *positions, float *orientations);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __LIBUMODEL_H__ */
@@ -22,6 +22,9 @@
 #include "UnSound.h"
 #include "UnThirdParty.h"
 
+#include "Threading.h"
+#include "Profiler.h"
+#include "ObjectMetrics.h"
 #include "Exporters/Exporters.h"
 
 #if DECLARE_VIEWER_PROPS
@@ -31,10 +34,12 @@
 
 #include "GameDatabase.h"
 #include "PackageUtils.h"
+#include "PackageCatalog.h"
 
 #include "UmodelApp.h"
 #include "Version.h"
 #include "MiscStrings.h"
+#include "Server.h"
 
 #define APP_CAPTION					"UE Viewer"
 
@@ -49,138 +54,10 @@ UmodelSettings GSettings;
 	Table of known Unreal classes
 -----------------------------------------------------------------------------*/
 
-static void RegisterCommonUnrealClasses()
-{
-	// classes and structures
-	RegisterCoreClasses();
-BEGIN_CLASS_TABLE
-
-	REGISTER_MATERIAL_CLASSES
-	REGISTER_ANIM_NOTIFY_CLASSES
-#if BIOSHOCK
-	REGISTER_MATERIAL_CLASSES_BIO
-	REGISTER_MESH_CLASSES_BIO
-#endif
-#if SPLINTER_CELL
-	REGISTER_MATERIAL_CLASSES_SCELL
-#endif
-#if UNREAL3
-	REGISTER_MATERIAL_CLASSES_U3		//!! needed for Bioshock 2 too
-#endif
-
-#if DECLARE_VIEWER_PROPS
-	REGISTER_SKELMESH_VCLASSES
-	REGISTER_STATICMESH_VCLASSES
-#endif // DECLARE_VIEWER_PROPS
-
-END_CLASS_TABLE
-	// enumerations
-	REGISTER_MATERIAL_ENUMS
-#if UNREAL3
-	REGISTER_MATERIAL_ENUMS_U3
-	REGISTER_MESH_ENUMS_U3
-#endif
-}
-
-
-static void RegisterUnrealClasses2()
-{
-BEGIN_CLASS_TABLE
-	REGISTER_MESH_CLASSES_U2
-#if UNREAL1
-	REGISTER_MESH_CLASSES_U1
-#endif
-#if RUNE
-	REGISTER_MESH_CLASSES_RUNE
-#endif
-END_CLASS_TABLE
-}
-
-
-static void RegisterUnrealClasses3()
-{
-#if UNREAL3
-BEGIN_CLASS_TABLE
-//	REGISTER_MATERIAL_CLASSES_U3 -- registered for Bioshock in RegisterCommonUnrealClasses()
-	REGISTER_MESH_CLASSES_U3
-#if TUROK
-	REGISTER_MESH_CLASSES_TUROK
-#endif
-#if MASSEFF
-	REGISTER_MESH_CLASSES_MASSEFF
-#endif
-#if DCU_ONLINE
-	REGISTER_MATERIAL_CLASSES_DCUO
-#endif
-#if TRANSFORMERS
-	REGISTER_MESH_CLASSES_TRANS
-#endif
-#if MKVSDC
-	REGISTER_MESH_CLASSES_MK
-#endif
-END_CLASS_TABLE
-#endif // UNREAL3
-}
-
-
-static void RegisterUnrealClasses4()
-{
-#if UNREAL4
-BEGIN_CLASS_TABLE
-	REGISTER_MESH_CLASSES_U4
-	REGISTER_MATERIAL_CLASSES_U4
-END_CLASS_TABLE
-	REGISTER_MATERIAL_ENUMS_U4
-#endif // UNREAL4
-}
-
-
-
-static void RegisterUnrealSoundClasses()
-{
-BEGIN_CLASS_TABLE
-	REGISTER_SOUND_CLASSES
-#if UNREAL3
-	REGISTER_SOUND_CLASSES_UE3
-#endif
-#if TRANSFORMERS
-	REGISTER_SOUND_CLASSES_TRANS
-#endif
-#if UNREAL4
-	REGISTER_SOUND_CLASSES_UE4
-#endif
-END_CLASS_TABLE
-}
-
-
-static void RegisterUnreal3rdPartyClasses()
-{
-#if UNREAL3
-BEGIN_CLASS_TABLE
-	REGISTER_3RDP_CLASSES
-END_CLASS_TABLE
-#endif
-}
-
 static void RegisterClasses(int game)
 {
 	// prepare classes
-	// note: we are registering classes after loading package: in this case we can know engine version (1/2/3)
-	RegisterCommonUnrealClasses();
-	if (game < GAME_UE3)
-	{
-		RegisterUnrealClasses2();
-	}
-	else if (game < GAME_UE4_BASE)
-	{
-		RegisterUnrealClasses3();
-		RegisterUnreal3rdPartyClasses();
-	}
-	else
-	{
-		RegisterUnrealClasses4();
-	}
-	if (GSettings.UseSound) RegisterUnrealSoundClasses();
+	RegisterUnrealClasses(game, GSettings.UseSound);
 
 	// remove some class loaders when requisted by command line
 	if (!GSettings.UseAnimation)
@@ -207,123 +84,6 @@ static void RegisterClasses(int game)
 }
 
 
-/*-----------------------------------------------------------------------------
-	Exporters
------------------------------------------------------------------------------*/
-
-// wrappers
-static void ExportSkeletalMesh2(const USkeletalMesh *Mesh)
-{
-	assert(Mesh->ConvertedMesh);
-	if (!GSettings.ExportMd5Mesh)
-		ExportPsk(Mesh->ConvertedMesh);
-	else
-		ExportMd5Mesh(Mesh->ConvertedMesh);
-}
-
-#if UNREAL3
-static void ExportSkeletalMesh3(const USkeletalMesh3 *Mesh)
-{
-	assert(Mesh->ConvertedMesh);
-	if (!GSettings.ExportMd5Mesh)
-		ExportPsk(Mesh->ConvertedMesh);
-	else
-		ExportMd5Mesh(Mesh->ConvertedMesh);
-}
-#endif // UNREAL3
-
-static void ExportStaticMesh2(const UStaticMesh *Mesh)
-{
-	assert(Mesh->ConvertedMesh);
-	ExportStaticMesh(Mesh->ConvertedMesh);
-}
-
-#if UNREAL3
-static void ExportStaticMesh3(const UStaticMesh3 *Mesh)
-{
-	assert(Mesh->ConvertedMesh);
-	ExportStaticMesh(Mesh->ConvertedMesh);
-}
-#endif
-
-#if UNREAL4
-static void ExportSkeletalMesh4(const USkeletalMesh4 *Mesh)
-{
-	assert(Mesh->ConvertedMesh);
-	if (!GSettings.ExportMd5Mesh)
-		ExportPsk(Mesh->ConvertedMesh);
-	else
-		ExportMd5Mesh(Mesh->ConvertedMesh);
-}
-
-static void ExportStaticMesh4(const UStaticMesh4 *Mesh)
-{
-	assert(Mesh->ConvertedMesh);
-	ExportStaticMesh(Mesh->ConvertedMesh);
-}
-#endif
-
-static void ExportMeshAnimation(const UMeshAnimation *Anim)
-{
-	assert(Anim->ConvertedAnim);
-	if (!GSettings.ExportMd5Mesh)
-		ExportPsa(Anim->ConvertedAnim);
-	else
-		ExportMd5Anim(Anim->ConvertedAnim);
-}
-
-#if UNREAL3
-static void ExportAnimSet(const UAnimSet *Anim)
-{
-	assert(Anim->ConvertedAnim);
-	if (!GSettings.ExportMd5Mesh)
-		ExportPsa(Anim->ConvertedAnim);
-	else
-		ExportMd5Anim(Anim->ConvertedAnim);
-}
-#endif // UNREAL3
-
-#if UNREAL4
-static void ExportSkeleton(const USkeleton *Skeleton)
-{
-	assert(Skeleton->ConvertedAnim);
-	if (!GSettings.ExportMd5Mesh)
-		ExportPsa(Skeleton->ConvertedAnim);
-	else
-		ExportMd5Anim(Skeleton->ConvertedAnim);
-}
-#endif // UNREAL4
-
-static void RegisterExporters()
-{
-	RegisterExporter("SkeletalMesh",  ExportSkeletalMesh2);
-	RegisterExporter("MeshAnimation", ExportMeshAnimation);
-#if UNREAL3
-	RegisterExporter("SkeletalMesh3", ExportSkeletalMesh3);
-	RegisterExporter("AnimSet",       ExportAnimSet      );
-#endif
-	RegisterExporter("VertMesh",      Export3D           );
-	RegisterExporter("StaticMesh",    ExportStaticMesh2  );
-	RegisterExporter("Texture",       ExportTexture      );
-	RegisterExporter("Sound",         ExportSound        );
-#if UNREAL3
-	RegisterExporter("StaticMesh3",   ExportStaticMesh3  );
-	RegisterExporter("Texture2D",     ExportTexture      );
-	RegisterExporter("SoundNodeWave", ExportSoundNodeWave);
-	RegisterExporter("SwfMovie",      ExportGfx          );
-	RegisterExporter("FaceFXAnimSet", ExportFaceFXAnimSet);
-	RegisterExporter("FaceFXAsset",   ExportFaceFXAsset  );
-#endif // UNREAL3
-#if UNREAL4
-	RegisterExporter("SkeletalMesh4", ExportSkeletalMesh4);
-	RegisterExporter("StaticMesh4",   ExportStaticMesh4  );
-	RegisterExporter("Skeleton",      ExportSkeleton     );
-	RegisterExporter("SoundWave",     ExportSoundWave4   );
-#endif // UNREAL4
-	RegisterExporter("UnrealMaterial", ExportMaterial    );			// register this after Texture/Texture2D exporters
-}
-
-
 /*-----------------------------------------------------------------------------
 	Initialization of class and export systems
 -----------------------------------------------------------------------------*/
@@ -378,6 +138,8 @@ static void PrintUsage()
 			"\n"
 			"Developer commands:\n"
 			"    -log=file       write log to the specified file\n"
+			"    -profile=file   write performance trace (Chrome trace format) to the file\n"
+			"    -metrics=file   write per-object load/export metrics (JSON lines, or CSV for .csv file)\n"
 			"    -dump           dump object information to console\n"
 			"    -pkginfo        load package and display its information\n"
 #if SHOW_HIDDEN_SWITCHES
@@ -394,6 +156,18 @@ static void PrintUsage()
 			"    -pkgver=nnn     override package version (advanced option!)\n"
 			"    -pkg=package    load extra package (in addition to <package>)\n"
 			"    -obj=object     specify object(s) to load\n"
+			"    -catalog[=file] use catalog of all game exports for -list, -pkginfo and finding\n"
+			"                    objects (wildcards allowed) without loading all packages;\n"
+			"                    catalog is kept in export directory, or in specified file\n"
+			"    -maxfiles=N     maximal number of simultaneously opened package files\n"
+			"    -membudget=N    export packages one by one, unloading them to keep memory\n"
+			"                    usage below N megabytes\n"
+#if HAS_SERVER
+			"    -serve=socket   run as a server: keep game files, packages and objects loaded\n"
+			"                    and process -list, -pkginfo, -export, -dump and -stop\n"
+			"                    requests received over the local socket\n"
+			"    -client=socket  send the rest of command line as a request to the server\n"
+#endif
 #if HAS_UI
 			"    -gui            force startup UI to appear\n" //?? debug-only option?
 #endif
@@ -427,11 +201,20 @@ static void PrintUsage()
 			"    -uc             create unreal script when possible\n"
 //			"    -pskx           use pskx format for skeletal mesh\n"
 			"    -md5            use md5mesh/md5anim format for skeletal mesh\n"
+			"    -gltf           use glTF 2.0 binary (glb) format for meshes and animations\n"
 			"    -lods           export all available mesh LOD levels\n"
 			"    -dds            export textures in DDS format whenever possible\n"
+			"    -passthrough    export compressed textures without decoding, with all mipmaps\n"
+			"                    (DDS for PC formats, KTX2 for mobile formats)\n"
+			"    -dedup          don't export textures and sounds which are identical to already\n"
+			"                    exported ones, create hard links to existing files instead\n"
 			"    -notgacomp      disable TGA compression\n"
 			"    -nooverwrite    prevent existing files from being overwritten (better\n"
 			"                    performance)\n"
+			"    -incremental    don't load and export objects which weren't changed since\n"
+			"                    previous export to the same directory\n"
+			"    -threads=N      number of threads used for export; 1 disables\n"
+			"                    multithreading (default: number of CPU cores)\n"
 			"\n"
 			"Supported resources for export:\n"
 			"    SkeletalMesh    exported as ActorX psk file or MD5Mesh\n"
@@ -488,6 +271,7 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 		bool objectSelected = !hasObjectList || (Objects->FindItem(ExpObj) >= 0);
 
 		if (!objectSelected) continue;
+		if (GExportIncremental && IsExportUpToDate(ExpObj)) continue;
 
 		if (notifyPackage != ExpObj->Package)
 		{
@@ -509,6 +293,27 @@ bool ExportObjects(const TArray<UObject*> *Objects, IProgressCallback* progress)
 	unguard;
 }
 
+// Export packages one by one, unloading processed ones when memory usage exceeds GMemoryBudget
+static void ExportPackagesWithBudget(const TArray<const CGameFileInfo*> &Files)
+{
+	guard(ExportPackagesWithBudget);
+
+	for (int i = 0; i < Files.Num(); i++)
+	{
+		UnPackage* Package = UnPackage::LoadPackage(Files[i]->RelativeName);
+		if (!Package) continue;
+		if (GExportIncremental)
+			LoadChangedExports(Package);
+		else
+			LoadWholePackage(Package);
+		ExportObjects();
+		TrimMemoryToBudget();
+	}
+	ResetExportedList();
+
+	unguard;
+}
+
 
 struct ClassStats
 {
@@ -563,11 +368,190 @@ void DisplayPackageStats(const TArray<UnPackage*> &Packages)
 	unguard;
 }
 
+static int CompareInts(const int* p1, const int* p2)
+{
+	return *p1 - *p2;
+}
+
+// The same as DisplayPackageStats(), but takes information from the catalog
+static void DisplayCatalogStats(const CPackageCatalog &Catalog, const TArray<int> &PackageIndices)
+{
+	guard(DisplayCatalogStats);
+
+	TArray<int> counts;
+	counts.AddZeroed(Catalog.Names.Num());
+	for (int i = 0; i < PackageIndices.Num(); i++)
+	{
+		const CCatalogPackage &P = Catalog.Packages[PackageIndices[i]];
+		if (P.Failed)
+		{
+			appPrintf("Package: %s failed to load\n", P.Filename);
+			continue;
+		}
+		appPrintf("Package: %s Ver: %d/%d Exports: %d Game: %X\n", P.Filename, P.Ver, P.LicVer, P.NumExports, P.Game);
+		for (int j = P.FirstExport; j < P.FirstExport + P.NumExports; j++)
+			counts[Catalog.ExportClass[j]]++;
+	}
+
+	TArray<ClassStats> stats;
+	for (int i = 0; i < counts.Num(); i++)
+	{
+		if (!counts[i]) continue;
+		ClassStats* s = new (stats) ClassStats(Catalog.Names[i]);
+		s->Count = counts[i];
+	}
+	stats.Sort(CompareClassStats);
+	appPrintf("Class statistics:\n");
+	for (int i = 0; i < stats.Num(); i++)
+		appPrintf("%5d %s\n", stats[i].Count, stats[i].Name);
+
+	unguard;
+}
+
+// Load the catalog and make it up to date with game files
+static void OpenCatalog(CPackageCatalog &Catalog, const char *CatalogFile)
+{
+	guard(OpenCatalog);
+
+	char catalogName[1024];
+	if (CatalogFile)
+		appStrncpyz(catalogName, CatalogFile, ARRAY_COUNT(catalogName));
+	else
+		appSprintf(ARRAY_ARG(catalogName), "%s/umodel-catalog.bin", *GSettings.ExportPath);
+	Catalog.Load(catalogName, GBuildString);		// will be created from scratch if failed
+	TArray<const CGameFileInfo*> AllFiles;
+	appFindGameFiles("*", AllFiles);
+	Catalog.Update(AllFiles);
+	Catalog.Save(catalogName);
+
+	unguard;
+}
+
+// Find requested objects in the catalog, sorted by export index. When ListAll is false, object
+// name without wildcards is taken from the first package which has it, like UnPackage::FindExport()
+// loop does, and missing objects are reported as error (function returns false).
+static bool FindCatalogExports(const CPackageCatalog &Catalog, const TArray<int> &PackageIndices,
+	const TArray<const char*> &ObjectNames, const char *ClassName, bool ListAll, TArray<int> &Result)
+{
+	guard(FindCatalogExports);
+
+	if (ObjectNames.Num())
+	{
+		for (int objIdx = 0; objIdx < ObjectNames.Num(); objIdx++)
+		{
+			const char *objName   = ObjectNames[objIdx];
+			const char *className = (objIdx == 0) ? ClassName : NULL;
+			TArray<int> found;
+			Catalog.FindExports(PackageIndices, objName, className, found);
+			if (!found.Num() && !ListAll)
+			{
+				appPrintf("Export \"%s\" was not found in specified package(s)\n", objName);
+				return false;
+			}
+			for (int i = 0; i < found.Num(); i++)
+			{
+				if (!ListAll && !appContainsWildcard(objName) && Catalog.ExportPackage[found[i]] != Catalog.ExportPackage[found[0]])
+					break;
+				Result.AddUnique(found[i]);
+			}
+		}
+	}
+	else
+	{
+		Catalog.FindExports(PackageIndices, NULL, ClassName, Result);
+	}
+	Result.Sort(CompareInts);
+	return true;
+
+	unguard;
+}
+
+// The same output as -list command produces, with package headers when listing multiple packages
+static void ListCatalogExports(const CPackageCatalog &Catalog, const TArray<int> &Exports, bool MultiplePackages)
+{
+	guard(ListCatalogExports);
+
+	int lastPackage = INDEX_NONE;
+	for (int i = 0; i < Exports.Num(); i++)
+	{
+		int exp = Exports[i];
+		const CCatalogPackage &P = Catalog.Packages[Catalog.ExportPackage[exp]];
+		if (Catalog.ExportPackage[exp] != lastPackage && MultiplePackages)
+			appPrintf("%s:\n", P.Filename);
+		lastPackage = Catalog.ExportPackage[exp];
+		appPrintf("%4d %8X %8X %s %s\n", exp - P.FirstExport, Catalog.ExportOffset[exp], Catalog.ExportSize[exp],
+			Catalog.GetExportClassName(exp), Catalog.GetExportName(exp));
+	}
+
+	unguard;
+}
+
+// Create requested objects, should be called between UObject::BeginLoad() and UObject::EndLoad().
+// Object is taken from the first package which has it. Returns false when some object was not found.
+static bool LoadRequestedObjects(const TArray<UnPackage*> &Packages, const TArray<const char*> &ObjectNames,
+	const char *ClassName, const char *AttachAnimName, TArray<UObject*> &Objects)
+{
+	guard(LoadRequestedObjects);
+
+	int totalFound = 0;
+	for (int objIdx = 0; objIdx < ObjectNames.Num(); objIdx++)
+	{
+		const char *objName   = ObjectNames[objIdx];
+		const char *className = (objIdx == 0) ? ClassName : NULL;
+		int found = 0;
+		for (int pkg = 0; pkg < Packages.Num(); pkg++)
+		{
+			UnPackage *Package2 = Packages[pkg];
+			// load specific object(s)
+			int idx = -1;
+			while (true)
+			{
+				idx = Package2->FindExport(objName, className, idx + 1);
+				if (idx == INDEX_NONE) break;		// not found in this package
+
+				found++;
+				totalFound++;
+				appPrintf("Export \"%s\" was found in package \"%s\"\n", objName, Package2->Filename);
+
+				// create object from package
+				UObject *Obj = Package2->CreateExport(idx);
+				if (Obj)
+				{
+					Objects.Add(Obj);
+					if (objName == AttachAnimName && (Obj->IsA("MeshAnimation") || Obj->IsA("AnimSet")))
+						GForceAnimSet = Obj;
+				}
+			}
+			if (found) break;
+		}
+		if (!found)
+		{
+			appPrintf("Export \"%s\" was not found in specified package(s)\n", objName);
+			return false;
+		}
+	}
+	appPrintf("Found %d object(s)\n", totalFound);
+	return true;
+
+	unguard;
+}
+
 
 /*-----------------------------------------------------------------------------
 	Main function
 -----------------------------------------------------------------------------*/
 
+enum
+{
+	CMD_View,
+	CMD_Dump,
+	CMD_Check,
+	CMD_PkgInfo,
+	CMD_List,
+	CMD_Export,
+	CMD_Stop,
+};
+
 struct OptionInfo
 {
 	const char	*name;
@@ -587,6 +571,35 @@ static bool ProcessOption(const OptionInfo *Info, int Count, const char *Option)
 	return false;
 }
 
+// Collect command line options which could affect contents of exported files. Used to discard
+// incremental export information when export is performed with different options.
+static void GetExportSettings(int argc, char **argv, FString& Settings)
+{
+	static const char* IgnoredOptions[] =
+	{
+		"log=", "profile=", "metrics=", "path=", "out=", "threads=", "maxfiles=", "membudget=",
+		"pkg=", "obj=", "nooverwrite", "incremental",
+	};
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const char *opt = argv[arg];
+		if (opt[0] != '-') continue;
+		opt++;
+		bool ignored = false;
+		for (int i = 0; i < ARRAY_COUNT(IgnoredOptions); i++)
+		{
+			if (!strnicmp(opt, IgnoredOptions[i], strlen(IgnoredOptions[i])))
+			{
+				ignored = true;
+				break;
+			}
+		}
+		if (ignored) continue;
+		Settings += opt;
+		Settings += " ";
+	}
+}
+
 static void SetPathOption(FString& where, const char* value)
 {
 	// determine whether absolute path is used
@@ -677,12 +690,15 @@ static void AbortHandler(int signal)
 }
 #endif
 
+static bool GIsServer = false;		// running in -serve mode
+
 #if UNREAL4
 
 int UE4UnversionedPackage(int verMin, int verMax)
 {
 #if HAS_UI
-	int version = GApplication.ShowUE4UnversionedPackageDialog(verMin, verMax);
+	// server has no UI, its requests are processed in background threads
+	int version = GIsServer ? -1 : GApplication.ShowUE4UnversionedPackageDialog(verMin, verMax);
 	if (version >= 0) return version;
 #endif
 	appError("Unversioned UE4 packages are not supported. Please restart UModel and select UE4 version in range %d-%d using UI or command line.", verMin, verMax);
@@ -696,6 +712,321 @@ int UE4UnversionedPackage(int verMin, int verMax)
 #define OPT_NBOOL(name,var)				{ name, (byte*)&var, false },
 #define OPT_VALUE(name,var,value)		{ name, (byte*)&var, value },
 
+/*-----------------------------------------------------------------------------
+	Server mode
+-----------------------------------------------------------------------------*/
+
+#if HAS_SERVER
+
+// Catalog of all game packages, it is read-only while serving requests
+static CPackageCatalog GServerCatalog;
+// Loading and exporting of objects use global loader state, so object requests are processed one
+// at time. Catalog requests (-list, -pkginfo) don't need the lock: the catalog and the game file
+// system are read-only, and error history is thread-local.
+static CMutex GServerObjectLock;
+
+// Export options which could be specified in a request. They're applied for this request only.
+static const OptionInfo ServerExportOptions[] =
+{
+	OPT_BOOL ("uncook",  GUncook)
+	OPT_BOOL ("groups",  GUseGroups)
+	OPT_BOOL ("md5",     GExportMd5Mesh)
+	OPT_BOOL ("gltf",    GExportGltf)
+	OPT_BOOL ("lods",    GExportLods)
+	OPT_BOOL ("uc",      GExportScripts)
+	OPT_BOOL ("dds",     GExportDDS)
+	OPT_BOOL ("passthrough", GExportPassthrough)
+	OPT_BOOL ("notgacomp", GNoTgaCompress)
+	OPT_BOOL ("nooverwrite", GDontOverwriteFiles)
+};
+
+// Load requested objects or whole packages, then export or dump them. Called with locked GServerObjectLock.
+static int ServeObjectRequest(byte Cmd, const TArray<const CGameFileInfo*> &Files, const TArray<const char*> &ObjectNames, const char *ClassName)
+{
+	guard(ServeObjectRequest);
+
+	// packages are kept loaded between requests
+	TArray<UnPackage*> Packages;
+	for (int i = 0; i < Files.Num(); i++)
+	{
+		UnPackage* Package = UnPackage::LoadPackage(Files[i]->RelativeName);
+		if (Package) Packages.AddUnique(Package);
+	}
+	if (!Packages.Num())
+	{
+		appPrintf("ERROR: failed to load provided packages\n");
+		return 1;
+	}
+
+	// register exporters and classes (will be performed only once)
+	InitClassAndExportSystems(Packages[0]->Game);
+
+	// objects are kept loaded too, so these calls will load only objects which weren't requested before
+	TArray<UObject*> Objects;
+	bool found = true;
+	UObject::BeginLoad();
+	if (ObjectNames.Num())
+	{
+		found = LoadRequestedObjects(Packages, ObjectNames, ClassName, NULL, Objects);
+	}
+	else
+	{
+		for (int i = 0; i < Packages.Num(); i++)
+			LoadWholePackage(Packages[i]);
+	}
+	UObject::EndLoad();
+	if (!found) return 1;
+
+	if (!ObjectNames.Num())
+	{
+		// use all objects from requested packages
+		for (int i = 0; i < UObject::GObjObjects.Num(); i++)
+		{
+			UObject* Obj = UObject::GObjObjects[i];
+			if (Packages.FindItem(Obj->Package) >= 0)
+				Objects.Add(Obj);
+		}
+		if (!Objects.Num())
+		{
+			appPrintf("The specified package(s) has no supported objects.\n");
+			return 0;
+		}
+	}
+
+	if (Cmd == CMD_Export)
+	{
+		if (ObjectNames.Num())
+		{
+			ExportObjects(&Objects);
+		}
+		else
+		{
+			// whole packages: silently skip objects without exporters, like ExportObjects(NULL) does
+			appPrintf("Exporting objects ...\n");
+			for (int i = 0; i < Objects.Num(); i++)
+				ExportObject(Objects[i]);
+		}
+		ResetExportedList();
+	}
+#if RENDERING
+	else if (Cmd == CMD_Dump)
+	{
+		for (int i = 0; i < Objects.Num(); i++)
+		{
+			GApplication.CreateVisualizer(Objects[i]);
+			if (GApplication.Viewer)
+				GApplication.Viewer->Dump();
+		}
+		// viewer should not outlive objects which could be released later
+		delete GApplication.Viewer;
+		GApplication.Viewer = NULL;
+	}
+#endif // RENDERING
+
+	TrimMemoryToBudget();
+	return 0;
+
+	unguard;
+}
+
+// Request handler, arguments are the same as in umodel command line. Supported commands are
+// -list, -pkginfo, -export, -dump and -stop.
+static int ServeRequest(int argc, char **argv)
+{
+	guard(ServeRequest);
+
+	byte cmd = CMD_View;
+	byte exportOptions[ARRAY_COUNT(ServerExportOptions)];
+	bool hasExportOption[ARRAY_COUNT(ServerExportOptions)];
+	memset(hasExportOption, 0, sizeof(hasExportOption));
+	const char *exportPath = NULL;
+	TArray<const char*> packagesToLoad, objectsToLoad, params;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const char *opt = argv[arg];
+		if (opt[0] != '-')
+		{
+			params.Add(opt);
+			continue;
+		}
+		opt++;			// skip '-'
+		const OptionInfo commands[] =
+		{
+			OPT_VALUE("dump",    cmd, CMD_Dump)
+			OPT_VALUE("export",  cmd, CMD_Export)
+			OPT_VALUE("pkginfo", cmd, CMD_PkgInfo)
+			OPT_VALUE("list",    cmd, CMD_List)
+			OPT_VALUE("stop",    cmd, CMD_Stop)
+		};
+		if (ProcessOption(ARRAY_ARG(commands), opt))
+			continue;
+		if (!strnicmp(opt, "pkg=", 4))
+		{
+			packagesToLoad.Add(opt+4);
+			continue;
+		}
+		if (!strnicmp(opt, "obj=", 4))
+		{
+			objectsToLoad.Add(opt+4);
+			continue;
+		}
+		if (!strnicmp(opt, "out=", 4))
+		{
+			exportPath = opt+4;
+			continue;
+		}
+		int i;
+		for (i = 0; i < ARRAY_COUNT(ServerExportOptions); i++)
+		{
+			if (stricmp(ServerExportOptions[i].name, opt) != 0) continue;
+			exportOptions[i] = ServerExportOptions[i].value;
+			hasExportOption[i] = true;
+			break;
+		}
+		if (i == ARRAY_COUNT(ServerExportOptions))
+		{
+			appPrintf("ERROR: invalid option for server request: -%s\n", opt);
+			return 1;
+		}
+	}
+
+	if (cmd == CMD_Stop)
+	{
+		// wait for completion of the current object request
+		CScopeLock Lock(GServerObjectLock);
+		appPrintf("Server is stopped\n");
+		StopServer();
+		return 0;
+	}
+	if (cmd == CMD_View)
+	{
+		appPrintf("ERROR: command was not specified, use -list, -pkginfo, -export or -dump\n");
+		return 1;
+	}
+
+	// Parse [package_name [obj_name [class_name]]]
+	if (params.Num() > 3)
+	{
+		appPrintf("ERROR: too many arguments\n");
+		return 1;
+	}
+	if (params.Num() >= 1) packagesToLoad.Insert(params[0], 0);
+	if (params.Num() >= 2) objectsToLoad.Insert(params[1], 0);
+	const char *className = (params.Num() >= 3) ? params[2] : NULL;
+	if (!packagesToLoad.Num())
+	{
+		appPrintf("ERROR: package name was not specified\n");
+		return 1;
+	}
+
+	TArray<const CGameFileInfo*> PackageFiles;
+	for (int i = 0; i < packagesToLoad.Num(); i++)
+	{
+		TArray<const CGameFileInfo*> Files;
+		appFindGameFiles(packagesToLoad[i], Files);
+		if (!Files.Num())
+			appPrintf("WARNING: unable to find package %s\n", packagesToLoad[i]);
+		for (int j = 0; j < Files.Num(); j++)
+			PackageFiles.AddUnique(Files[j]);
+	}
+	if (!PackageFiles.Num())
+	{
+		appPrintf("ERROR: failed to load provided packages\n");
+		return 1;
+	}
+
+	if (cmd == CMD_List || cmd == CMD_PkgInfo)
+	{
+		TArray<int> catalogPackages;
+		for (int i = 0; i < PackageFiles.Num(); i++)
+		{
+			int index = GServerCatalog.FindPackage(PackageFiles[i]->RelativeName);
+			if (index >= 0) catalogPackages.Add(index);
+		}
+		if (cmd == CMD_PkgInfo)
+		{
+			DisplayCatalogStats(GServerCatalog, catalogPackages);
+			return 0;
+		}
+		TArray<int> catalogExports;
+		FindCatalogExports(GServerCatalog, catalogPackages, objectsToLoad, className, true, catalogExports);
+		ListCatalogExports(GServerCatalog, catalogExports, PackageFiles.Num() > 1);
+		return 0;
+	}
+
+	// wait for completion of the current object request
+	CScopeLock Lock(GServerObjectLock);
+
+	// apply request options
+	byte savedOptions[ARRAY_COUNT(ServerExportOptions)];
+	for (int i = 0; i < ARRAY_COUNT(ServerExportOptions); i++)
+	{
+		savedOptions[i] = *ServerExportOptions[i].variable;
+		if (hasExportOption[i]) *ServerExportOptions[i].variable = exportOptions[i];
+	}
+	char savedExportPath[512];
+	appStrncpyz(savedExportPath, appGetBaseExportDirectory(), ARRAY_COUNT(savedExportPath));
+	if (exportPath) appSetBaseExportDirectory(exportPath);
+
+	int result = 0;
+	TRY
+	{
+		result = ServeObjectRequest(cmd, PackageFiles, objectsToLoad, className);
+	}
+	CATCH
+	{
+		// Object could be partially loaded or exported. Release everything and reset loader
+		// state, so server could continue working.
+		FFileWriter::CleanupOnError();
+		ResetExportedList();
+#if RENDERING
+		delete GApplication.Viewer;
+		GApplication.Viewer = NULL;
+#endif
+		UObject::GObjLoaded.Empty();
+		UObject::GObjBeginLoadCount = 0;
+		UObject::GLoadingObj = NULL;
+		ReleaseAllObjects();
+		result = -1;
+	}
+
+	// restore options
+	for (int i = 0; i < ARRAY_COUNT(ServerExportOptions); i++)
+		*ServerExportOptions[i].variable = savedOptions[i];
+	appSetBaseExportDirectory(savedExportPath);
+
+	if (result < 0) THROW;		// error message is in GErrorHistory
+	return result;
+
+	unguard;
+}
+
+// Send request to the server, -out option is resolved relative to the client's directory
+static int RunClient(const char *SocketName, int argc, char **argv)
+{
+	TArray<FString> Paths;
+	TArray<int> PathArgs;
+	for (int i = 0; i < argc; i++)
+	{
+		if (strnicmp(argv[i], "-out=", 5) != 0) continue;
+		FString Path;
+		SetPathOption(Path, argv[i]+5);
+		FString* Option = new (Paths) FString("-out=");
+		*Option += *Path;
+		PathArgs.Add(i);
+	}
+	TArray<char*> Args;
+	for (int i = 0; i < argc; i++)
+		Args.Add(argv[i]);
+	for (int i = 0; i < PathArgs.Num(); i++)
+		Args[PathArgs[i]] = (char*)*Paths[i];
+	return SendServerRequest(SocketName, Args.Num(), Args.GetData());
+}
+
+#endif // HAS_SERVER
+
+
 int main(int argc, char **argv)
 {
 	appInitPlatform();
@@ -720,18 +1051,10 @@ int main(int argc, char **argv)
 #endif // HAS_UI
 
 	// parse command line
-	enum
-	{
-		CMD_View,
-		CMD_Dump,
-		CMD_Check,
-		CMD_PkgInfo,
-		CMD_List,
-		CMD_Export,
-	};
-
 	static byte mainCmd = CMD_View;
-	static bool exprtAll = false, hasRootDir = false, forceUI = false;
+	static bool exprtAll = false, hasRootDir = false, forceUI = false, useCatalog = false;
+	const char *catalogFile = NULL;
+	const char *serveSocket = NULL;
 	TArray<const char*> packagesToLoad, objectsToLoad;
 	TArray<const char*> params;
 	const char *attachAnimName = NULL;
@@ -765,7 +1088,8 @@ int main(int argc, char **argv)
 			OPT_BOOL ("uncook",  GUncook)
 			OPT_BOOL ("groups",  GUseGroups)
 //			OPT_BOOL ("pskx",    GExportPskx)	// -- may be useful in a case of more advanced mesh format
-			OPT_BOOL ("md5",     GSettings.ExportMd5Mesh)
+			OPT_BOOL ("md5",     GExportMd5Mesh)
+			OPT_BOOL ("gltf",    GExportGltf)
 			OPT_BOOL ("lods",    GExportLods)
 			OPT_BOOL ("uc",      GExportScripts)
 			// disable classes
@@ -776,8 +1100,12 @@ int main(int argc, char **argv)
 			OPT_NBOOL("nolightmap", GSettings.UseLightmapTexture)
 			OPT_BOOL ("sounds",  GSettings.UseSound)
 			OPT_BOOL ("dds",     GExportDDS)
+			OPT_BOOL ("passthrough", GExportPassthrough)
+			OPT_BOOL ("dedup",   GExportDedup)
 			OPT_BOOL ("notgacomp", GNoTgaCompress)
 			OPT_BOOL ("nooverwrite", GDontOverwriteFiles)
+			OPT_BOOL ("incremental", GExportIncremental)
+			OPT_BOOL ("catalog", useCatalog)
 #if HAS_UI
 			OPT_BOOL ("gui",     forceUI)
 #endif
@@ -797,6 +1125,14 @@ int main(int argc, char **argv)
 		{
 			appOpenLogFile(opt+4);
 		}
+		else if (!strnicmp(opt, "profile=", 8))
+		{
+			appStartProfiler(opt+8);
+		}
+		else if (!strnicmp(opt, "metrics=", 8))
+		{
+			appStartObjectMetrics(opt+8);
+		}
 		else if (!strnicmp(opt, "path=", 5))
 		{
 			SetPathOption(GSettings.GamePath, opt+5);
@@ -826,6 +1162,52 @@ int main(int argc, char **argv)
 			}
 			GForcePackageVersion = ver;
 		}
+		else if (!strnicmp(opt, "threads=", 8))
+		{
+			int num = atoi(opt+8);
+			if (num < 1)
+			{
+				appPrintf("ERROR: number of threads is not valid: %s\n", opt+8);
+				exit(0);
+			}
+			GNumThreads = num;
+		}
+		else if (!strnicmp(opt, "maxfiles=", 9))
+		{
+			int num = atoi(opt+9);
+			if (num < 1)
+			{
+				appPrintf("ERROR: number of files is not valid: %s\n", opt+9);
+				exit(0);
+			}
+			UnPackage::MaxOpenReaders = num;
+		}
+		else if (!strnicmp(opt, "membudget=", 10))
+		{
+			int num = atoi(opt+10);
+			if (num < 1)
+			{
+				appPrintf("ERROR: memory budget is not valid: %s\n", opt+10);
+				exit(0);
+			}
+			GMemoryBudget = (size_t)num << 20;
+		}
+		else if (!strnicmp(opt, "catalog=", 8))
+		{
+			catalogFile = opt+8;
+			useCatalog = true;
+		}
+#if HAS_SERVER
+		else if (!strnicmp(opt, "serve=", 6))
+		{
+			serveSocket = opt+6;
+		}
+		else if (!strnicmp(opt, "client=", 7))
+		{
+			// the rest of command line is a request to the server
+			return RunClient(opt+7, argc - arg - 1, argv + arg + 1);
+		}
+#endif // HAS_SERVER
 		else if (!strnicmp(opt, "pkg=", 4))
 		{
 			const char *pkg = opt+4;
@@ -892,7 +1274,7 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (argc < 2 || (!hasRootDir && !argPkgName) || forceUI)
+	if (!serveSocket && (argc < 2 || (!hasRootDir && !argPkgName) || forceUI))
 	{
 		// fill game path with current directory, if it's empty - for easier work with UI
 		if (GSettings.GamePath.IsEmpty())
@@ -914,9 +1296,30 @@ int main(int argc, char **argv)
 	if (GSettings.ExportPath.IsEmpty())
 		SetPathOption(GSettings.ExportPath, "UmodelExport");	//!! linux: ~/UmodelExport
 	appSetBaseExportDirectory(*GSettings.ExportPath);
+	if (GExportIncremental)
+	{
+		FString Settings;
+		GetExportSettings(argc, argv, Settings);
+		SetIncrementalExportSettings(*Settings);
+	}
+
+#if HAS_SERVER
+	if (serveSocket)
+	{
+		if (params.Num() || packagesToLoad.Num() || objectsToLoad.Num())
+			CommandLineError("packages and objects should be specified in requests to the server");
+		if (!hasRootDir)
+			appSetRootDirectory(".");		// scan for packages
+		GIsServer = true;
+		OpenCatalog(GServerCatalog, catalogFile);
+		ServeRequests(serveSocket, ServeRequest);
+		return 0;
+	}
+#endif // HAS_SERVER
 
 	TArray<UnPackage*> Packages;
 	TArray<UObject*> Objects;
+	TArray<const CGameFileInfo*> PackageFiles;
 
 	if (argPkgName)
 	{
@@ -970,6 +1373,13 @@ int main(int argc, char **argv)
 		appSetRootDirectory(".");			// scan for packages
 	}
 
+	// When exporting with memory budget, packages are loaded later one by one, so only the
+	// first package is loaded here (to detect the game).
+	bool exportWithBudget = (mainCmd == CMD_Export && GMemoryBudget && !objectsToLoad.Num() && !GApplication.GuiShown);
+	// When using the catalog, package tables are taken from it, and only packages with requested
+	// objects are loaded.
+	bool catalogLookup = useCatalog && (mainCmd == CMD_List || mainCmd == CMD_PkgInfo || objectsToLoad.Num());
+
 	// Try to load all packages first.
 	// Note: in this code, packages will be loaded without creating any exported objects.
 	for (int i = 0; i < packagesToLoad.Num(); i++)
@@ -986,6 +1396,11 @@ int main(int argc, char **argv)
 		{
 			for (int j = 0; j < Files.Num(); j++)
 			{
+				if (exportWithBudget || catalogLookup)
+				{
+					PackageFiles.Add(Files[j]);
+					if (Packages.Num() || catalogLookup) continue;
+				}
 				UnPackage* Package = UnPackage::LoadPackage(Files[j]->RelativeName);
 				Packages.Add(Package);
 			}
@@ -993,12 +1408,12 @@ int main(int argc, char **argv)
 	}
 
 #if !HAS_UI
-	if (!Packages.Num())
+	if (!Packages.Num() && !PackageFiles.Num())
 	{
 		CommandLineError("failed to load provided packages");
 	}
 #else
-	if (!Packages.Num())
+	if (!Packages.Num() && !PackageFiles.Num())
 	{
 		if (mainCmd != CMD_View)
 		{
@@ -1014,6 +1429,54 @@ int main(int argc, char **argv)
 	}
 #endif // HAS_UI
 
+	CPackageCatalog Catalog;
+	TArray<int> catalogPackages;			// catalog records of requested packages
+	TArray<int> catalogExports;				// requested objects found in the catalog
+	if (catalogLookup)
+	{
+		guard(Catalog);
+
+		OpenCatalog(Catalog, catalogFile);
+
+		for (int i = 0; i < PackageFiles.Num(); i++)
+		{
+			int index = Catalog.FindPackage(PackageFiles[i]->RelativeName);
+			if (index >= 0) catalogPackages.Add(index);
+		}
+
+		if (mainCmd != CMD_PkgInfo && !FindCatalogExports(Catalog, catalogPackages, objectsToLoad, argClassName, mainCmd == CMD_List, catalogExports))
+			exit(1);
+
+		unguard;
+	}
+
+	if (catalogLookup && mainCmd == CMD_List)
+	{
+		// dump exports of requested packages, or requested objects only
+		ListCatalogExports(Catalog, catalogExports, PackageFiles.Num() > 1);
+		return 0;
+	}
+
+	if (catalogLookup && mainCmd == CMD_PkgInfo)
+	{
+		DisplayCatalogStats(Catalog, catalogPackages);
+		return 0;
+	}
+
+	if (catalogLookup)
+	{
+		// load packages which have requested objects
+		for (int i = 0; i < catalogExports.Num(); i++)
+		{
+			UnPackage *Package = UnPackage::LoadPackage(Catalog.Packages[Catalog.ExportPackage[catalogExports[i]]].Filename);
+			if (Package) Packages.AddUnique(Package);
+		}
+		if (!Packages.Num())
+		{
+			CommandLineError("failed to load provided packages");
+		}
+	}
+
 	if (mainCmd == CMD_List)
 	{
 		guard(List);
@@ -1037,58 +1500,64 @@ int main(int argc, char **argv)
 		return 0;					// already displayed when loaded package; extend it?
 	}
 
+	if (exportWithBudget)
+	{
+		ExportPackagesWithBudget(PackageFiles);
+		return 0;
+	}
+
 	// load requested objects if any, or fully load everything
 	UObject::BeginLoad();
-	if (objectsToLoad.Num())
+	if (catalogLookup)
 	{
-		// selectively load objects
-		int totalFound = 0;
-		for (int objIdx = 0; objIdx < objectsToLoad.Num(); objIdx++)
+		// create objects found in the catalog
+		for (int i = 0; i < catalogExports.Num(); i++)
 		{
-			const char *objName   = objectsToLoad[objIdx];
-			const char *className = (objIdx == 0) ? argClassName : NULL;
-			int found = 0;
-			for (int pkg = 0; pkg < Packages.Num(); pkg++)
+			int exp = catalogExports[i];
+			const CCatalogPackage &P = Catalog.Packages[Catalog.ExportPackage[exp]];
+			UnPackage *Package2 = UnPackage::LoadPackage(P.Filename);
+			if (!Package2 || exp - P.FirstExport >= Package2->Summary.ExportCount)
 			{
-				UnPackage *Package2 = Packages[pkg];
-				// load specific object(s)
-				int idx = -1;
-				while (true)
-				{
-					idx = Package2->FindExport(objName, className, idx + 1);
-					if (idx == INDEX_NONE) break;		// not found in this package
-
-					found++;
-					totalFound++;
-					appPrintf("Export \"%s\" was found in package \"%s\"\n", objName, Package2->Filename);
-
-					// create object from package
-					UObject *Obj = Package2->CreateExport(idx);
-					if (Obj)
-					{
-						Objects.Add(Obj);
-						if (objName == attachAnimName && (Obj->IsA("MeshAnimation") || Obj->IsA("AnimSet")))
-							GForceAnimSet = Obj;
-					}
-				}
-				if (found) break;
+				appPrintf("WARNING: unable to load export \"%s\" from package \"%s\"\n", Catalog.GetExportName(exp), P.Filename);
+				continue;
 			}
-			if (!found)
+			appPrintf("Export \"%s\" was found in package \"%s\"\n", Catalog.GetExportName(exp), Package2->Filename);
+			UObject *Obj = Package2->CreateExport(exp - P.FirstExport);
+			if (Obj)
 			{
-				appPrintf("Export \"%s\" was not found in specified package(s)\n", objName);
-				exit(1);
+				Objects.Add(Obj);
+				if (attachAnimName && appMatchWildcard(Obj->Name, attachAnimName, true) && (Obj->IsA("MeshAnimation") || Obj->IsA("AnimSet")))
+					GForceAnimSet = Obj;
 			}
 		}
-		appPrintf("Found %d object(s)\n", totalFound);
+		appPrintf("Found %d object(s)\n", catalogExports.Num());
+	}
+	else if (objectsToLoad.Num())
+	{
+		// selectively load objects
+		if (!LoadRequestedObjects(Packages, objectsToLoad, argClassName, attachAnimName, Objects))
+			exit(1);
 	}
 	else
 	{
 		// fully load all packages
 		for (int pkg = 0; pkg < Packages.Num(); pkg++)
-			LoadWholePackage(Packages[pkg]);
+		{
+			if (GExportIncremental && mainCmd == CMD_Export)
+				LoadChangedExports(Packages[pkg]);
+			else
+				LoadWholePackage(Packages[pkg]);
+		}
 	}
 	UObject::EndLoad();
 
+	if (GExportIncremental && mainCmd == CMD_Export && !objectsToLoad.Num() && !UObject::GObjObjects.Num())
+	{
+		appPrintf("All objects are up to date.\n");
+		ResetExportedList();		// save the manifest
+		return 0;
+	}
+
 	if (!UObject::GObjObjects.Num() && !GApplication.GuiShown)
 	{
 		appPrintf("\nThe specified package(s) has no supported objects.\n\n");
@@ -8,6 +8,7 @@
 #include "AboutDialog.h"
 
 #include "UnPackage.h"
+#include "PackageUtils.h"
 
 #define USE_FULLY_VIRTUAL_LIST		1		// disable only for testing, to compare UIMulticolumnListbox behavior in virtual modes
 
@@ -653,58 +654,17 @@ void UIPackageDialog::SortPackages()
 	Content tools
 -----------------------------------------------------------------------------*/
 
-static void ScanPackageExports(UnPackage* package, CGameFileInfo* file)
-{
-	for (int idx = 0; idx < package->Summary.ExportCount; idx++)
-	{
-		const char* ObjectClass = package->GetObjectName(package->GetExport(idx).ClassIndex);
-
-		if (!stricmp(ObjectClass, "SkeletalMesh") || !stricmp(ObjectClass, "DestructibleMesh"))
-			file->NumSkeletalMeshes++;
-		else if (!stricmp(ObjectClass, "StaticMesh"))
-			file->NumStaticMeshes++;
-		else if (!stricmp(ObjectClass, "Animation") || !stricmp(ObjectClass, "MeshAnimation") || !stricmp(ObjectClass, "AnimSequence")) // whole AnimSet count for UE2 and number of sequences for UE3+
-			file->NumAnimations++;
-		else if (!strnicmp(ObjectClass, "Texture", 7))
-			file->NumTextures++;
-	}
-}
-
-
 void UIPackageDialog::ScanContent()
 {
 	UIProgressDialog progress;
 	progress.Show("Scanning packages");
 	progress.SetDescription("Scanning package");
 
-	bool cancelled = false;
-	int lastTick = appMilliseconds();
-	for (int i = 0; i < Packages.Num(); i++)
-	{
-		CGameFileInfo* file = const_cast<CGameFileInfo*>(Packages[i]);		// we'll modify this structure here
-		if (file->PackageScanned) continue;
-
-		// Update progress dialog
-		int tick = appMilliseconds();
-		if (tick - lastTick > 50)				// do not update too often
-		{
-			if (!progress.Progress(file->RelativeName, i, GNumPackageFiles))
-			{
-				cancelled = true;
-				break;
-			}
-			lastTick = tick;
-		}
-
-		UnPackage* package = UnPackage::LoadPackage(file->RelativeName, /*silent=*/ true);	// should always return non-NULL
-		file->PackageScanned = true;
-		if (!package) continue;		// should not happen
-
-		ScanPackageExports(package, file);
-	}
+	// packages are scanned in parallel, without loading them
+	bool done = ScanPackageContent(Packages, &progress);
 
 	progress.CloseDialog();
-	if (cancelled) return;
+	if (!done) return;
 	ContentScanned = true;
 
 	SortPackages();
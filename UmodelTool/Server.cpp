@@ -0,0 +1,347 @@
+#include "Core.h"
+#include "UnCore.h"
+#include "Threading.h"
+
+#include "Server.h"
+
+#if HAS_SERVER
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>					// for close(), unlink()
+#include <errno.h>
+#include <signal.h>
+
+// maximal size of request from the client
+#define MAX_REQUEST_SIZE		(1 << 20)
+// amount of buffered output which is sent to the client immediately
+#define OUTPUT_FLUSH_SIZE		16384
+
+
+/*-----------------------------------------------------------------------------
+	Socket helpers
+-----------------------------------------------------------------------------*/
+
+static bool MakeSocketAddress(const char *SocketName, sockaddr_un &Addr)
+{
+	memset(&Addr, 0, sizeof(Addr));
+	Addr.sun_family = AF_UNIX;
+	if (strlen(SocketName) >= sizeof(Addr.sun_path)) return false;
+	strcpy(Addr.sun_path, SocketName);
+	return true;
+}
+
+static bool SendAll(int Socket, const void *Data, int Size)
+{
+	const char *p = (const char*)Data;
+	while (Size > 0)
+	{
+		int n = send(Socket, p, Size, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		p += n;
+		Size -= n;
+	}
+	return true;
+}
+
+static bool RecvAll(int Socket, void *Data, int Size)
+{
+	char *p = (char*)Data;
+	while (Size > 0)
+	{
+		int n = recv(Socket, p, Size, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;		// error, or connection was closed
+		p += n;
+		Size -= n;
+	}
+	return true;
+}
+
+static bool SendFrame(int Socket, int Type, const void *Data, int Size)
+{
+	byte Header[5];
+	Header[0] = Size & 0xFF;
+	Header[1] = (Size >> 8) & 0xFF;
+	Header[2] = (Size >> 16) & 0xFF;
+	Header[3] = (Size >> 24) & 0xFF;
+	Header[4] = Type;
+	return SendAll(Socket, Header, sizeof(Header)) && SendAll(Socket, Data, Size);
+}
+
+// Returns false when connection was closed, or frame is larger than MaxSize
+static bool RecvFrame(int Socket, int &Type, TArray<char> &Data, int MaxSize)
+{
+	byte Header[5];
+	if (!RecvAll(Socket, Header, sizeof(Header))) return false;
+	unsigned Size = Header[0] | (Header[1] << 8) | (Header[2] << 16) | (Header[3] << 24);
+	if (Size > (unsigned)MaxSize) return false;
+	Type = Header[4];
+	Data.Reset(Size);
+	Data.AddUninitialized(Size);
+	return RecvAll(Socket, Data.GetData(), Size);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Server
+-----------------------------------------------------------------------------*/
+
+struct CServerConnection
+{
+	int				Socket;
+	ServeRequest_t	Handler;
+	CMutex			OutputLock;			// output could come from appParallelFor() worker threads
+	TArray<char>	Output;
+	bool			Failed;				// client has disconnected
+};
+
+static const char *ServerSocketName = NULL;
+static volatile bool GStopServer = false;
+
+// Active connections, server closes them when stopping
+static CMutex ConnectionsLock;
+static TArray<CServerConnection*> Connections;
+static bool DrainingConnections = false;	// server waits for termination of connection threads
+static CSemaphore ConnectionClosed;
+
+// Should be called with locked OutputLock
+static void FlushOutput(CServerConnection *Conn)
+{
+	if (Conn->Output.Num() && !Conn->Failed)
+	{
+		if (!SendFrame(Conn->Socket, FRAME_Output, Conn->Output.GetData(), Conn->Output.Num()))
+			Conn->Failed = true;		// continue processing the request, but don't send anything
+	}
+	Conn->Output.Reset(OUTPUT_FLUSH_SIZE);
+}
+
+static void ConnectionOutput(const char *Text, int Length, void *Param)
+{
+	CServerConnection *Conn = (CServerConnection*)Param;
+	CScopeLock Lock(Conn->OutputLock);
+	int Pos = Conn->Output.AddUninitialized(Length);
+	memcpy(&Conn->Output[Pos], Text, Length);
+	if (Conn->Output.Num() >= OUTPUT_FLUSH_SIZE)
+		FlushOutput(Conn);
+}
+
+static void ConnectionThread(void *Param)
+{
+	CServerConnection *Conn = (CServerConnection*)Param;
+
+	TArray<char> Request;
+	int Type;
+	while (!Conn->Failed && RecvFrame(Conn->Socket, Type, Request, MAX_REQUEST_SIZE) && Type == FRAME_Request)
+	{
+		// split request to arguments, use argv[0] for program name like main() does
+		Request.Add(0);
+		TArray<char*> Args;
+		Args.Add((char*)"umodel");
+		char *End = Request.GetData() + Request.Num() - 1;
+		for (char *s = Request.GetData(); s < End; s += strlen(s) + 1)
+			Args.Add(s);
+
+		int ExitCode = 0;
+		appSetPrintfRedirect(ConnectionOutput, Conn);
+		TRY
+		{
+			ExitCode = Conn->Handler(Args.Num(), Args.GetData());
+		}
+		CATCH
+		{
+			CScopeLock Lock(Conn->OutputLock);
+			FlushOutput(Conn);
+			const char *Error = GErrorHistory[0] ? GErrorHistory : "Unknown error\n";
+			if (!Conn->Failed && !SendFrame(Conn->Socket, FRAME_Error, Error, strlen(Error)))
+				Conn->Failed = true;
+			// prepare for the next error
+			GErrorHistory[0] = 0;
+			GIsSwError = false;
+			ExitCode = 1;
+		}
+		appSetPrintfRedirect(NULL, NULL);
+
+		byte Done[4];
+		Done[0] = ExitCode & 0xFF;
+		Done[1] = (ExitCode >> 8) & 0xFF;
+		Done[2] = (ExitCode >> 16) & 0xFF;
+		Done[3] = (ExitCode >> 24) & 0xFF;
+		{
+			CScopeLock Lock(Conn->OutputLock);
+			FlushOutput(Conn);
+			if (!Conn->Failed && !SendFrame(Conn->Socket, FRAME_Done, Done, sizeof(Done)))
+				Conn->Failed = true;
+		}
+
+		if (GStopServer)
+		{
+			// accept() is blocked in the main thread, wake it up with a dummy connection
+			sockaddr_un Addr;
+			int Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+			if (Socket >= 0 && MakeSocketAddress(ServerSocketName, Addr))
+				connect(Socket, (sockaddr*)&Addr, sizeof(Addr));
+			if (Socket >= 0) close(Socket);
+			break;
+		}
+	}
+
+	CScopeLock Lock(ConnectionsLock);
+	Connections.RemoveSingle(Conn);
+	close(Conn->Socket);
+	delete Conn;
+	if (DrainingConnections) ConnectionClosed.Post();
+}
+
+void ServeRequests(const char *SocketName, ServeRequest_t Handler)
+{
+	guard(ServeRequests);
+
+	sockaddr_un Addr;
+	if (!MakeSocketAddress(SocketName, Addr))
+		appError("Socket name is too long: %s", SocketName);
+
+	// remove socket file left by previous server, but don't disturb running one
+	int Probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Probe >= 0)
+	{
+		bool Running = (connect(Probe, (sockaddr*)&Addr, sizeof(Addr)) == 0);
+		close(Probe);
+		if (Running) appError("Server is already running on %s", SocketName);
+	}
+	unlink(SocketName);
+
+	int Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Listener < 0)
+		appError("Unable to create socket: %s", strerror(errno));
+	if (bind(Listener, (sockaddr*)&Addr, sizeof(Addr)) != 0)
+		appError("Unable to bind socket %s: %s", SocketName, strerror(errno));
+	if (listen(Listener, 16) != 0)
+		appError("Unable to listen on socket %s: %s", SocketName, strerror(errno));
+
+	// client which has disconnected in the middle of a request should not terminate the server
+	signal(SIGPIPE, SIG_IGN);
+
+	ServerSocketName = SocketName;
+	appPrintf("Listening on %s\n", SocketName);
+	fflush(stdout);
+
+	while (true)
+	{
+		int Socket = accept(Listener, NULL, NULL);
+		if (Socket < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			appError("Unable to accept connection: %s", strerror(errno));
+		}
+		if (GStopServer)
+		{
+			close(Socket);
+			break;
+		}
+		CServerConnection *Conn = new CServerConnection;
+		Conn->Socket  = Socket;
+		Conn->Handler = Handler;
+		Conn->Failed  = false;
+		CScopeLock Lock(ConnectionsLock);
+		Connections.Add(Conn);
+		if (!appCreateThread(ConnectionThread, Conn))
+		{
+			appPrintf("WARNING: unable to create a thread for client connection\n");
+			Connections.RemoveSingle(Conn);
+			close(Socket);
+			delete Conn;
+		}
+	}
+
+	// Stop accepting connections, let active requests complete. Connection threads waiting
+	// for the next request are woken up by shutting down reading from their sockets.
+	close(Listener);
+	unlink(SocketName);
+	int NumActive;
+	{
+		CScopeLock Lock(ConnectionsLock);
+		DrainingConnections = true;
+		NumActive = Connections.Num();
+		for (int i = 0; i < NumActive; i++)
+			shutdown(Connections[i]->Socket, SHUT_RD);
+	}
+	for (int i = 0; i < NumActive; i++)
+		ConnectionClosed.Wait();
+
+	unguard;
+}
+
+void StopServer()
+{
+	GStopServer = true;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Client
+-----------------------------------------------------------------------------*/
+
+int SendServerRequest(const char *SocketName, int argc, char **argv)
+{
+	guard(SendServerRequest);
+
+	sockaddr_un Addr;
+	int Socket = -1;
+	if (MakeSocketAddress(SocketName, Addr))
+		Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Socket < 0 || connect(Socket, (sockaddr*)&Addr, sizeof(Addr)) != 0)
+	{
+		appPrintf("ERROR: unable to connect to server %s: %s\n", SocketName, strerror(errno));
+		if (Socket >= 0) close(Socket);
+		return 1;
+	}
+
+	// every argument is terminated by zero character
+	TArray<char> Request;
+	for (int i = 0; i < argc; i++)
+	{
+		int Len = strlen(argv[i]) + 1;
+		int Pos = Request.AddUninitialized(Len);
+		memcpy(&Request[Pos], argv[i], Len);
+	}
+
+	int ExitCode = 1;
+	bool Completed = false;
+	if (SendFrame(Socket, FRAME_Request, Request.GetData(), Request.Num()))
+	{
+		TArray<char> Data;
+		int Type;
+		while (RecvFrame(Socket, Type, Data, 0x7FFFFFFF))
+		{
+			if (Type == FRAME_Output)
+			{
+				fwrite(Data.GetData(), Data.Num(), 1, stdout);
+			}
+			else if (Type == FRAME_Error)
+			{
+				fflush(stdout);
+				bool NewLine = Data.Num() && Data[Data.Num()-1] == '\n';
+				fprintf(stderr, "ERROR: %.*s%s", Data.Num(), Data.GetData(), NewLine ? "" : "\n");
+			}
+			else if (Type == FRAME_Done && Data.Num() == 4)
+			{
+				const byte *p = (const byte*)Data.GetData();
+				ExitCode = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+				Completed = true;
+				break;
+			}
+		}
+	}
+	close(Socket);
+
+	fflush(stdout);
+	if (!Completed)
+		appPrintf("ERROR: connection to server %s was lost\n", SocketName);
+	return ExitCode;
+
+	unguard;
+}
+
+#endif // HAS_SERVER
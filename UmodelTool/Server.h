@@ -0,0 +1,50 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+/*-----------------------------------------------------------------------------
+	Resident server mode
+-----------------------------------------------------------------------------*/
+
+// Server keeps game file system, loaded packages and objects in memory and processes requests
+// received over a local (Unix domain) socket, so clients don't pay startup cost for every query.
+// Every client connection is served in its own thread. Request is a command line (without
+// program name), output of appPrintf() performed while processing it is sent back to the client.
+//
+// Protocol: every message is a frame with 4-byte little-endian payload size, 1-byte frame type
+// and payload. Client sends FRAME_Request with arguments separated by zero characters, server
+// responds with any number of FRAME_Output and FRAME_Error frames followed by FRAME_Done with
+// 4-byte little-endian exit code. Connection could be reused for next request.
+
+#if !_WIN32
+#define HAS_SERVER		1
+#endif
+
+#if HAS_SERVER
+
+enum
+{
+	FRAME_Request = 'R',
+	FRAME_Output  = 'O',
+	FRAME_Error   = 'E',
+	FRAME_Done    = 'D',
+};
+
+// Request handler, returns exit code. Errors (appError) are caught and sent to the client.
+typedef int (*ServeRequest_t)(int argc, char **argv);
+
+// Listen on the socket and serve requests until StopServer() is called. Returns when all
+// connections are closed.
+void ServeRequests(const char *SocketName, ServeRequest_t Handler);
+
+// Make server stop after completion of the current request. Requests which are being processed
+// in other connections are completed, idle connections are closed.
+void StopServer();
+
+// Send a request to the server and print its output to console. Returns exit code of the
+// request, or 1 when server is not available.
+int SendServerRequest(const char *SocketName, int argc, char **argv);
+
+#endif // HAS_SERVER
+
+
+#endif // __SERVER_H__
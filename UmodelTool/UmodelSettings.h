@@ -22,7 +22,6 @@ struct UmodelSettings
 
 	// export options
 	FString			ExportPath;
-	bool			ExportMd5Mesh;
 
 	UmodelSettings()
 	{
@@ -50,10 +49,6 @@ struct UmodelSettings
 
 		PackageCompression = 0;
 		Platform = PLATFORM_UNKNOWN;
-
-		// export options
-
-		ExportMd5Mesh = false;
 	}
 };
 
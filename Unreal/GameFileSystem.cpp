@@ -10,8 +10,8 @@
 #	include <io.h>					// for findfirst() set
 #else
 #	include <dirent.h>				// for opendir() etc
-#	include <sys/stat.h>			// for stat()
 #endif
+#include <sys/stat.h>				// for stat()
 
 
 /*-----------------------------------------------------------------------------
@@ -784,20 +784,75 @@ const char *appSkipRootDir(const char *Filename)
 }
 
 
+struct CThreadFileReaders
+{
+	TArray<FVirtualFileSystem*> FileSystems;
+	TArray<FArchive*>	Readers;			// container file readers, indexed as FileSystems
+};
+
+static THREAD_LOCAL CThreadFileReaders* GThreadFileReaders = NULL;
+
+void appOpenThreadFileReaders()
+{
+	// readers could be left open when previous work of this thread failed with error
+	appCloseThreadFileReaders();
+	GThreadFileReaders = new CThreadFileReaders;
+}
+
+void appCloseThreadFileReaders()
+{
+	if (!GThreadFileReaders) return;
+	for (int i = 0; i < GThreadFileReaders->Readers.Num(); i++)
+		delete GThreadFileReaders->Readers[i];
+	delete GThreadFileReaders;
+	GThreadFileReaders = NULL;
+}
+
 FArchive *appCreateFileReader(const CGameFileInfo *info)
 {
-	if (!info->FileSystem)
+	FVirtualFileSystem *vfs = info->FileSystem;
+	if (!vfs)
 	{
 		// regular file
 		char buf[MAX_PACKAGE_PATH];
 		appSprintf(ARRAY_ARG(buf), "%s/%s", RootDirectory, info->RelativeName);
 		return new FFileReader(buf);
 	}
+	else if (GThreadFileReaders)
+	{
+		// file from virtual file system, use container reader of this thread
+		int index = GThreadFileReaders->FileSystems.FindItem(vfs);
+		if (index < 0)
+		{
+			GThreadFileReaders->FileSystems.Add(vfs);
+			index = GThreadFileReaders->Readers.Add(new FFileReader(vfs->GetFilename()));
+		}
+		return vfs->CreateReader(info->RelativeName, GThreadFileReaders->Readers[index]);
+	}
 	else
 	{
 		// file from virtual file system
-		return info->FileSystem->CreateReader(info->RelativeName);
+		return vfs->CreateReader(info->RelativeName);
+	}
+}
+
+void appGetGameFileStamp(const CGameFileInfo *info, CContentHash &Stamp)
+{
+	char buf[MAX_PACKAGE_PATH];
+	const char *Filename = buf;
+	if (!info->FileSystem)
+		appSprintf(ARRAY_ARG(buf), "%s/%s", RootDirectory, info->RelativeName);
+	else
+		Filename = info->FileSystem->GetFilename();
+
+	struct stat st;
+	if (stat(Filename, &st) == 0)
+	{
+		int64 Values[2] = { (int64)st.st_size, (int64)st.st_mtime };
+		Stamp.Update(Values, sizeof(Values));
 	}
+	if (info->FileSystem)
+		Stamp.UpdateValue(info->FileSystem->GetFileSize(info->RelativeName));
 }
 
 
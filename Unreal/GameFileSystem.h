@@ -12,6 +12,11 @@ public:
 	virtual bool AttachReader(FArchive* reader) = 0;
 	// Open a file from VFS.
 	virtual FArchive* CreateReader(const char* name) = 0;
+	// Open a file from VFS using provided reader of the container file instead of the shared one,
+	// so VFS files could be read from different threads. containerReader should outlive returned archive.
+	virtual FArchive* CreateReader(const char* name, FArchive* containerReader) = 0;
+	// Name of the VFS container file.
+	virtual const char* GetFilename() const = 0;
 
 	// Functions for iteration over all stored files
 
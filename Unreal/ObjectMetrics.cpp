@@ -0,0 +1,247 @@
+#include "Core.h"
+#include "UnCore.h"
+#include "UnObject.h"
+#include "UnPackage.h"
+
+#include "ObjectMetrics.h"
+#include "Profiler.h"				// for appNanoseconds()
+#include "Threading.h"
+
+
+#define METRICS_HASH_SIZE		4096
+
+bool GObjectMetricsEnabled = false;
+
+
+/*-----------------------------------------------------------------------------
+	Object records
+-----------------------------------------------------------------------------*/
+
+struct CObjectMetrics
+{
+	const UObject	*Obj;
+	// copy object information, so record could be written from UObject destructor
+	const char		*ClassName;
+	const char		*PackageName;
+	char			*ObjectName;
+	int				SerialSize;
+	int64			Time[METRIC_Count];
+	int64			BytesRead;
+	int64			BytesWritten;
+	CObjectMetrics	*HashNext;
+};
+
+static CObjectMetrics *MetricsHash[METRICS_HASH_SIZE];
+static CMutex *MetricsLock = NULL;			// protects MetricsHash and file
+static FILE *MetricsFile = NULL;
+static bool MetricsCsv = false;
+static int NumMetricsRecords = 0;
+
+static THREAD_LOCAL CObjectMetricsScope *CurrentScope = NULL;
+
+static FORCEINLINE int GetMetricsHash(const UObject *Obj)
+{
+	return ((size_t)Obj >> 4) & (METRICS_HASH_SIZE - 1);
+}
+
+static CObjectMetrics *FindObjectMetrics(const UObject *Obj, bool Create)
+{
+	int h = GetMetricsHash(Obj);
+	for (CObjectMetrics *Rec = MetricsHash[h]; Rec; Rec = Rec->HashNext)
+	{
+		if (Rec->Obj == Obj) return Rec;
+	}
+	if (!Create) return NULL;
+
+	CObjectMetrics *Rec = new CObjectMetrics;
+	memset(Rec, 0, sizeof(CObjectMetrics));
+	Rec->Obj         = Obj;
+	Rec->ClassName   = Obj->GetClassName();
+	Rec->PackageName = Obj->Package ? Obj->Package->Filename : "None";
+	Rec->ObjectName  = appStrdup(Obj->Name ? Obj->Name : "None");
+	if (Obj->Package && Obj->PackageIndex != INDEX_NONE)
+		Rec->SerialSize = Obj->Package->GetExport(Obj->PackageIndex).SerialSize;
+	Rec->HashNext = MetricsHash[h];
+	MetricsHash[h] = Rec;
+	return Rec;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Writing records
+-----------------------------------------------------------------------------*/
+
+static void WriteCsvString(FILE *f, const char *Str)
+{
+	fputc('"', f);
+	for (const char *s = Str; *s; s++)
+	{
+		if (*s == '"') fputc('"', f);
+		fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+static void WriteJsonString(FILE *f, const char *Str)
+{
+	fputc('"', f);
+	for (const char *s = Str; *s; s++)
+	{
+		char c = *s;
+		if (c == '"' || c == '\\')
+			fputc('\\', f);
+		else if ((byte)c < ' ')
+			c = ' ';
+		fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static void WriteRecord(const CObjectMetrics *Rec)
+{
+	FILE *f = MetricsFile;
+	// time is in milliseconds
+	double Load     = Rec->Time[METRIC_Load]     / 1e6;
+	double PostLoad = Rec->Time[METRIC_PostLoad] / 1e6;
+	double Convert  = Rec->Time[METRIC_Convert]  / 1e6;
+	double Export   = Rec->Time[METRIC_Export]   / 1e6;
+	if (MetricsCsv)
+	{
+		WriteCsvString(f, Rec->ClassName);
+		fputc(',', f);
+		WriteCsvString(f, Rec->PackageName);
+		fputc(',', f);
+		WriteCsvString(f, Rec->ObjectName);
+		fprintf(f, ",%d,%lld,%.3f,%.3f,%.3f,%.3f,%lld\n", Rec->SerialSize, (long long)Rec->BytesRead,
+			Load, PostLoad, Convert, Export, (long long)Rec->BytesWritten);
+	}
+	else
+	{
+		fprintf(f, "{\"class\":");
+		WriteJsonString(f, Rec->ClassName);
+		fprintf(f, ",\"package\":");
+		WriteJsonString(f, Rec->PackageName);
+		fprintf(f, ",\"object\":");
+		WriteJsonString(f, Rec->ObjectName);
+		fprintf(f, ",\"serial_size\":%d,\"read_bytes\":%lld,\"load_ms\":%.3f,\"postload_ms\":%.3f,"
+			"\"convert_ms\":%.3f,\"export_ms\":%.3f,\"output_bytes\":%lld}\n",
+			Rec->SerialSize, (long long)Rec->BytesRead, Load, PostLoad, Convert, Export, (long long)Rec->BytesWritten);
+	}
+	NumMetricsRecords++;
+}
+
+static void FreeRecord(CObjectMetrics *Rec)
+{
+	appFree(Rec->ObjectName);
+	delete Rec;
+}
+
+void appFlushObjectMetrics(const UObject *Obj)
+{
+	if (!GObjectMetricsEnabled) return;
+	CScopeLock Lock(*MetricsLock);
+
+	int h = GetMetricsHash(Obj);
+	for (CObjectMetrics **Prev = &MetricsHash[h]; *Prev; Prev = &(*Prev)->HashNext)
+	{
+		CObjectMetrics *Rec = *Prev;
+		if (Rec->Obj != Obj) continue;
+		*Prev = Rec->HashNext;
+		WriteRecord(Rec);
+		FreeRecord(Rec);
+		return;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------
+	Start/stop
+-----------------------------------------------------------------------------*/
+
+static void StopObjectMetricsAtExit()
+{
+	appStopObjectMetrics();
+}
+
+void appStartObjectMetrics(const char *FileName)
+{
+	if (MetricsFile) return;
+	MetricsFile = fopen(FileName, "w");
+	if (!MetricsFile)
+	{
+		appPrintf("ERROR: unable to create metrics file \"%s\"\n", FileName);
+		return;
+	}
+	const char *Ext = strrchr(FileName, '.');
+	MetricsCsv = Ext && !stricmp(Ext, ".csv");
+	if (MetricsCsv)
+		fprintf(MetricsFile, "class,package,object,serial_size,read_bytes,load_ms,postload_ms,convert_ms,export_ms,output_bytes\n");
+	if (!MetricsLock)
+	{
+		MetricsLock = new CMutex;
+		atexit(StopObjectMetricsAtExit);
+	}
+	GObjectMetricsEnabled = true;
+}
+
+void appStopObjectMetrics()
+{
+	if (!GObjectMetricsEnabled) return;
+	GObjectMetricsEnabled = false;
+
+	CScopeLock Lock(*MetricsLock);
+	// write records of objects which are still alive
+	for (int h = 0; h < METRICS_HASH_SIZE; h++)
+	{
+		CObjectMetrics *Next;
+		for (CObjectMetrics *Rec = MetricsHash[h]; Rec; Rec = Next)
+		{
+			Next = Rec->HashNext;
+			WriteRecord(Rec);
+			FreeRecord(Rec);
+		}
+		MetricsHash[h] = NULL;
+	}
+	fclose(MetricsFile);
+	MetricsFile = NULL;
+	appPrintf("Metrics for %d objects saved\n", NumMetricsRecords);
+}
+
+
+/*-----------------------------------------------------------------------------
+	CObjectMetricsScope
+-----------------------------------------------------------------------------*/
+
+void CObjectMetricsScope::Begin(const UObject *InObj, EObjectMetric InMetric)
+{
+	if (!InObj) return;
+	Obj          = InObj;
+	Metric       = InMetric;
+	ChildTime    = ChildRead = ChildWritten = 0;
+	Parent       = CurrentScope;
+	CurrentScope = this;
+	StartRead    = GPackageBytesRead;
+	StartWritten = GFileBytesWritten;
+	StartTime    = appNanoseconds();
+}
+
+void CObjectMetricsScope::End()
+{
+	int64 Time    = appNanoseconds() - StartTime;
+	int64 Read    = GPackageBytesRead - StartRead;
+	int64 Written = GFileBytesWritten - StartWritten;
+	CurrentScope = Parent;
+	if (Parent)
+	{
+		Parent->ChildTime    += Time;
+		Parent->ChildRead    += Read;
+		Parent->ChildWritten += Written;
+	}
+	if (!GObjectMetricsEnabled) return;		// stopped while inside of this scope
+
+	CScopeLock Lock(*MetricsLock);
+	CObjectMetrics *Rec = FindObjectMetrics(Obj, true);
+	Rec->Time[Metric]  += Time - ChildTime;
+	Rec->BytesRead     += Read - ChildRead;
+	Rec->BytesWritten  += Written - ChildWritten;
+}
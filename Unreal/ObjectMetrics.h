@@ -0,0 +1,70 @@
+#ifndef __OBJECT_METRICS_H__
+#define __OBJECT_METRICS_H__
+
+/*-----------------------------------------------------------------------------
+	Per-object load/export metrics
+-----------------------------------------------------------------------------*/
+
+// Metrics are disabled by default and enabled with appStartObjectMetrics() call (-metrics=file
+// command line option). Every object gets a record with time spent in Serialize(), PostLoad(),
+// mesh/animation conversion and export, amount of package data read (GPackageBytesRead) and
+// amount of data written by exporters (GFileBytesWritten). Record is written to the file when
+// object is destroyed, or when application exits. File format is CSV when file name has ".csv"
+// extension, otherwise JSON lines.
+// Time and byte counters are exclusive: when one metrics scope is nested into another (for
+// example, material is exported while exporting a mesh), nested scope's values are subtracted
+// from outer scope, so values could be summed over all objects without double counting.
+
+class UObject;
+
+enum EObjectMetric
+{
+	METRIC_Load,
+	METRIC_PostLoad,
+	METRIC_Convert,
+	METRIC_Export,
+
+	METRIC_Count
+};
+
+extern bool GObjectMetricsEnabled;
+
+void appStartObjectMetrics(const char *FileName);
+// Write records for all remaining objects and close the file; called automatically at exit.
+void appStopObjectMetrics();
+// Write object's record, if any; called from UObject destructor.
+void appFlushObjectMetrics(const UObject *Obj);
+
+class CObjectMetricsScope
+{
+public:
+	FORCEINLINE CObjectMetricsScope(const UObject *InObj, EObjectMetric InMetric)
+	:	Obj(NULL)
+	{
+		if (GObjectMetricsEnabled) Begin(InObj, InMetric);
+	}
+	FORCEINLINE ~CObjectMetricsScope()
+	{
+		if (Obj) End();
+	}
+
+private:
+	const UObject			*Obj;
+	EObjectMetric			Metric;
+	int64					StartTime;
+	int64					StartRead;
+	size_t					StartWritten;
+	// values of nested scopes
+	int64					ChildTime;
+	int64					ChildRead;
+	int64					ChildWritten;
+	CObjectMetricsScope		*Parent;
+
+	void Begin(const UObject *InObj, EObjectMetric InMetric);
+	void End();
+};
+
+#define OBJECT_METRICS_SCOPE(Obj, Metric)	CObjectMetricsScope _MetricsScope(Obj, Metric)
+
+
+#endif // __OBJECT_METRICS_H__
@@ -0,0 +1,515 @@
+#include "Core.h"
+#include "UnCore.h"
+#include "UnPackage.h"
+
+#include "GameFileSystem.h"
+#include "PackageCatalog.h"
+#include "PackageUtils.h"
+
+
+#define CATALOG_TAG				0x54414355		// "UCAT"
+#define CATALOG_VERSION			3
+#define NAME_HASH_SIZE			65536
+#define PACKAGE_HASH_SIZE		4096
+
+
+/*-----------------------------------------------------------------------------
+	Catalog tables
+-----------------------------------------------------------------------------*/
+
+CPackageCatalog::CPackageCatalog()
+{
+	Empty();
+}
+
+void CPackageCatalog::Empty()
+{
+	Packages.Empty();
+	RebuildPackageHash();
+	Names.Empty();
+	NameHashNext.Empty();
+	NameHash.Empty(NAME_HASH_SIZE);
+	NameHash.Init(INDEX_NONE, NAME_HASH_SIZE);
+	ExportPackage.Empty();
+	ExportClass.Empty();
+	ExportName.Empty();
+	ExportOuter.Empty();
+	ExportOffset.Empty();
+	ExportSize.Empty();
+}
+
+// All names are allocated with appStrdupPool(), so the same strings have the same pointers,
+// and names could be hashed and compared as pointers.
+static FORCEINLINE int GetNameHash(const char *Name)
+{
+	return (int)(((uint32)(size_t)Name * 0x9E3779B1) >> 16) & (NAME_HASH_SIZE - 1);
+}
+
+int CPackageCatalog::GetNameIndex(const char *Name)
+{
+	int Hash = GetNameHash(Name);
+	for (int i = NameHash[Hash]; i != INDEX_NONE; i = NameHashNext[i])
+	{
+		if (Names[i] == Name) return i;
+	}
+	int Index = Names.Add(Name);
+	NameHashNext.Add(NameHash[Hash]);
+	NameHash[Hash] = Index;
+	return Index;
+}
+
+static FORCEINLINE int GetPackageHash(const char *Filename)
+{
+	return appStrihash(Filename) & (PACKAGE_HASH_SIZE - 1);
+}
+
+void CPackageCatalog::RebuildPackageHash()
+{
+	PackageHash.Empty(PACKAGE_HASH_SIZE);
+	PackageHash.Init(INDEX_NONE, PACKAGE_HASH_SIZE);
+	PackageHashNext.Empty(Packages.Num());
+	PackageHashNext.AddUninitialized(Packages.Num());
+	for (int i = 0; i < Packages.Num(); i++)
+	{
+		int Hash = GetPackageHash(Packages[i].Filename);
+		PackageHashNext[i] = PackageHash[Hash];
+		PackageHash[Hash] = i;
+	}
+}
+
+int CPackageCatalog::FindPackage(const char *Filename) const
+{
+	for (int i = PackageHash[GetPackageHash(Filename)]; i != INDEX_NONE; i = PackageHashNext[i])
+	{
+		if (!stricmp(Packages[i].Filename, Filename))
+			return i;
+	}
+	return INDEX_NONE;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Loading and saving
+-----------------------------------------------------------------------------*/
+
+// File layout: header, name table as a block of null-terminated strings, package records, and
+// export columns. Numbers are stored in native byte order.
+
+// Hash of everything besides package files which affects scanning results
+static void GetLoaderSettingsHash(const char *BuildVersion, CContentHash &Hash)
+{
+	Hash.Update(BuildVersion);
+	Hash.UpdateValue(GForceGame);
+	Hash.UpdateValue(GForcePackageVersion);
+	Hash.UpdateValue(GForcePlatform);
+	Hash.UpdateValue(GForceCompMethod);
+}
+
+bool CPackageCatalog::Load(const char *Filename, const char *BuildVersion)
+{
+	guard(CPackageCatalog::Load);
+
+	LoaderSettings = CContentHash();
+	GetLoaderSettingsHash(BuildVersion, LoaderSettings);
+
+	Empty();
+	FFileReader Ar(Filename, FRO_NoOpenError);
+	if (!Ar.IsOpen()) return false;
+	if (!LoadFromArchive(Ar))
+	{
+		Empty();
+		return false;
+	}
+	return true;
+
+	unguardf("%s", Filename);
+}
+
+bool CPackageCatalog::LoadFromArchive(FArchive &Ar)
+{
+	guard(CPackageCatalog::LoadFromArchive);
+
+	int Tag, Version;
+	Ar << Tag << Version;
+	if (Tag != CATALOG_TAG || Version != CATALOG_VERSION) return false;
+	TArray<char> RootDir;
+	Ar << RootDir;
+	if (!RootDir.Num() || RootDir[RootDir.Num()-1] != 0 || strcmp(RootDir.GetData(), appGetRootDirectory()) != 0)
+		return false;
+	CContentHash Settings;
+	Ar << Settings.Hash[0] << Settings.Hash[1];
+	if (!(Settings == LoaderSettings))
+	{
+		appPrintf("Package catalog was created with different program build or settings, rebuilding\n");
+		return false;
+	}
+
+	// names
+	int NumNames;
+	TArray<char> NameData;
+	Ar << NumNames << NameData;
+	if (NameData.Num() && NameData[NameData.Num()-1] != 0) return false;
+	Names.Empty(NumNames);
+	NameHashNext.Empty(NumNames);
+	const char *s = NameData.GetData();
+	const char *End = s + NameData.Num();
+	for (int i = 0; i < NumNames; i++)
+	{
+		if (s >= End) return false;
+		GetNameIndex(appStrdupPool(s));
+		s = strchr(s, 0) + 1;
+	}
+
+	// packages
+	int NumPackages;
+	Ar << NumPackages;
+	Packages.Empty(NumPackages);
+	for (int i = 0; i < NumPackages; i++)
+	{
+		CCatalogPackage P;
+		int NameIndex;
+		Ar << NameIndex << P.Stamp.Hash[0] << P.Stamp.Hash[1] << P.Game << P.Ver << P.LicVer << P.FirstExport << P.NumExports << P.Failed;
+		if (NameIndex < 0 || NameIndex >= Names.Num()) return false;
+		P.Filename = Names[NameIndex];
+		Packages.Add(P);
+	}
+	RebuildPackageHash();
+
+	// exports
+	Ar << ExportPackage << ExportClass << ExportName << ExportOuter << ExportOffset << ExportSize;
+	int NumExports = ExportPackage.Num();
+	return ExportClass.Num() == NumExports && ExportName.Num() == NumExports && ExportOuter.Num() == NumExports &&
+		ExportOffset.Num() == NumExports && ExportSize.Num() == NumExports;
+
+	unguard;
+}
+
+void CPackageCatalog::Save(const char *Filename)
+{
+	guard(CPackageCatalog::Save);
+
+	char TempName[1024];
+	appSprintf(ARRAY_ARG(TempName), "%s.tmp", Filename);
+	appMakeDirectoryForFile(TempName);
+
+	FFileWriter *Ar = new FFileWriter(TempName, FRO_NoOpenError);
+	if (!Ar->IsOpen())
+	{
+		appPrintf("ERROR: unable to write package catalog \"%s\"\n", TempName);
+		delete Ar;
+		return;
+	}
+
+	int Tag = CATALOG_TAG, Version = CATALOG_VERSION;
+	*Ar << Tag << Version;
+	TArray<char> RootDir;
+	const char *Root = appGetRootDirectory();
+	RootDir.AddUninitialized(strlen(Root) + 1);
+	memcpy(RootDir.GetData(), Root, RootDir.Num());
+	*Ar << RootDir;
+	*Ar << LoaderSettings.Hash[0] << LoaderSettings.Hash[1];
+
+	// names
+	int NumNames = Names.Num();
+	TArray<char> NameData;
+	int NameDataSize = 0;
+	for (int i = 0; i < NumNames; i++)
+		NameDataSize += strlen(Names[i]) + 1;
+	NameData.AddUninitialized(NameDataSize);
+	char *d = NameData.GetData();
+	for (int i = 0; i < NumNames; i++)
+	{
+		int Len = strlen(Names[i]) + 1;
+		memcpy(d, Names[i], Len);
+		d += Len;
+	}
+	*Ar << NumNames << NameData;
+
+	// packages
+	int NumPackages = Packages.Num();
+	*Ar << NumPackages;
+	for (int i = 0; i < NumPackages; i++)
+	{
+		CCatalogPackage &P = Packages[i];
+		int NameIndex = GetNameIndex(P.Filename);
+		*Ar << NameIndex << P.Stamp.Hash[0] << P.Stamp.Hash[1] << P.Game << P.Ver << P.LicVer << P.FirstExport << P.NumExports << P.Failed;
+	}
+
+	// exports
+	*Ar << ExportPackage << ExportClass << ExportName << ExportOuter << ExportOffset << ExportSize;
+
+	delete Ar;
+	FFileWriter::FlushPendingWrites();
+
+	remove(Filename);
+	if (rename(TempName, Filename) != 0)
+		appPrintf("ERROR: unable to write package catalog \"%s\"\n", Filename);
+
+	unguardf("%s", Filename);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Scanning packages
+-----------------------------------------------------------------------------*/
+
+struct CCatalogScanExport
+{
+	const char		*ClassName;
+	const char		*ObjectName;
+	int				Outer;				// index of outer export in package, INDEX_NONE for top-level objects
+	int				SerialOffset;
+	int				SerialSize;
+};
+
+struct CCatalogScanItem
+{
+	const CGameFileInfo *Info;
+	CContentHash	Stamp;
+	int				Game;
+	int				Ver;
+	int				LicVer;
+	bool			Failed;
+	TArray<CCatalogScanExport> Exports;
+};
+
+static void ScanCatalogPackage(CCatalogScanItem &Item)
+{
+	guard(ScanCatalogPackage);
+
+	UnPackage *Package = UnPackage::LoadPackageTables(Item.Info);
+	Item.Game   = Package->Game;
+	Item.Ver    = Package->ArVer;
+	Item.LicVer = Package->ArLicenseeVer;
+
+	int NumExports = Package->Summary.ExportCount;
+	Item.Exports.AddUninitialized(NumExports);
+	for (int i = 0; i < NumExports; i++)
+	{
+		const FObjectExport &Exp = Package->ExportTable[i];
+		CCatalogScanExport &E = Item.Exports[i];
+		E.ClassName    = Package->GetObjectName(Exp.ClassIndex);
+		E.ObjectName   = Exp.ObjectName;
+		E.Outer        = (Exp.PackageIndex > 0 && Exp.PackageIndex <= NumExports) ? Exp.PackageIndex - 1 : INDEX_NONE;
+		E.SerialOffset = Exp.SerialOffset;
+		E.SerialSize   = Exp.SerialSize;
+	}
+
+	UnPackage::ReleasePackageTables(Package);
+
+	unguardf("%s", Item.Info->RelativeName);
+}
+
+// Corrupted or unsupported package shouldn't stop update of the whole catalog: the error is
+// reported, and the package is recorded as failed.
+static void TryScanCatalogPackage(CCatalogScanItem &Item)
+{
+#if DO_GUARD
+	TRY
+	{
+		ScanCatalogPackage(Item);
+	}
+	CATCH
+	{
+		appPrintf("WARNING: unable to scan package %s: %s\n", Item.Info->RelativeName, GErrorHistory);
+		GErrorHistory[0] = 0;
+		GIsSwError = false;
+		Item.Failed = true;
+	}
+#else
+	ScanCatalogPackage(Item);		// appError() terminates the program
+#endif
+}
+
+static void ScanCatalogFile(const CGameFileInfo *File, int Index, TArray<CCatalogScanItem*> &Items)
+{
+	TryScanCatalogPackage(*Items[Index]);
+}
+
+static int CompareScanItems(CCatalogScanItem* const* A, CCatalogScanItem* const* B)
+{
+	// group files by file system, OS files first
+	size_t FS1 = (size_t)(*A)->Info->FileSystem;
+	size_t FS2 = (size_t)(*B)->Info->FileSystem;
+	if (FS1 != FS2) return (FS1 < FS2) ? -1 : 1;
+	return stricmp((*A)->Info->RelativeName, (*B)->Info->RelativeName);
+}
+
+void CPackageCatalog::Update(const TArray<const CGameFileInfo*> &Files)
+{
+	guard(CPackageCatalog::Update);
+
+	int StartTime = appMilliseconds();
+
+	// remove packages which are not available anymore
+	TArray<bool> KeepPackage;
+	KeepPackage.AddZeroed(Packages.Num());
+	for (int i = 0; i < Packages.Num(); i++)
+	{
+		const CGameFileInfo *Info = appFindGameFile(Packages[i].Filename);
+		KeepPackage[i] = (Info && Info->IsPackage && !stricmp(Info->RelativeName, Packages[i].Filename));
+	}
+
+	// find new and changed packages
+	TArray<CCatalogScanItem*> Items;
+	for (int i = 0; i < Files.Num(); i++)
+	{
+		const CGameFileInfo *Info = Files[i];
+		if (!Info->IsPackage) continue;
+		CContentHash Stamp;
+		appGetGameFileStamp(Info, Stamp);
+		int PackageIndex = FindPackage(Info->RelativeName);
+		if (PackageIndex >= 0)
+		{
+			if (Packages[PackageIndex].Stamp == Stamp) continue;
+			KeepPackage[PackageIndex] = false;
+		}
+		CCatalogScanItem *Item = new CCatalogScanItem;
+		Item->Info   = Info;
+		Item->Stamp  = Stamp;
+		Item->Game   = Item->Ver = Item->LicVer = 0;
+		Item->Failed = false;
+		Items.Add(Item);
+	}
+
+	int NumRemoved = 0;
+	for (int i = 0; i < Packages.Num(); i++)
+		if (!KeepPackage[i]) NumRemoved++;
+	if (!Items.Num() && !NumRemoved) return;
+
+	if (Items.Num())
+	{
+		appPrintf("Scanning %d packages for catalog\n", Items.Num());
+		Items.Sort(CompareScanItems);
+		TArray<const CGameFileInfo*> ScanFiles;
+		ScanFiles.Empty(Items.Num());
+		for (int i = 0; i < Items.Num(); i++)
+			ScanFiles.Add(Items[i]->Info);
+		ScanPackagesParallel(ScanFiles, ScanCatalogFile, Items);
+	}
+
+	// Build new export columns: copy unchanged packages, append scanned ones
+	TArray<CCatalogPackage> OldPackages;
+	Exchange(OldPackages, Packages);
+	TArray<int> OldPackage, OldClass, OldName, OldOuter, OldOffset, OldSize;
+	Exchange(OldPackage, ExportPackage);
+	Exchange(OldClass, ExportClass);
+	Exchange(OldName, ExportName);
+	Exchange(OldOuter, ExportOuter);
+	Exchange(OldOffset, ExportOffset);
+	Exchange(OldSize, ExportSize);
+
+	int NumExports = 0;
+	for (int i = 0; i < OldPackages.Num(); i++)
+		if (KeepPackage[i]) NumExports += OldPackages[i].NumExports;
+	int NumFailed = 0;
+	for (int i = 0; i < Items.Num(); i++)
+	{
+		CCatalogScanItem *Item = Items[i];
+		if (Item->Failed)
+		{
+			// export table could be partially filled
+			Item->Exports.Empty();
+			NumFailed++;
+		}
+		NumExports += Item->Exports.Num();
+	}
+	ExportPackage.Empty(NumExports);
+	ExportClass.Empty(NumExports);
+	ExportName.Empty(NumExports);
+	ExportOuter.Empty(NumExports);
+	ExportOffset.Empty(NumExports);
+	ExportSize.Empty(NumExports);
+
+	for (int i = 0; i < OldPackages.Num(); i++)
+	{
+		if (!KeepPackage[i]) continue;
+		int PackageIndex = Packages.Add(OldPackages[i]);
+		CCatalogPackage &P = Packages[PackageIndex];
+		int OldFirst = P.FirstExport;
+		P.FirstExport = ExportPackage.Num();
+		for (int j = OldFirst; j < OldFirst + P.NumExports; j++)
+		{
+			ExportPackage.Add(PackageIndex);
+			ExportClass.Add(OldClass[j]);
+			ExportName.Add(OldName[j]);
+			ExportOuter.Add(OldOuter[j] >= 0 ? OldOuter[j] - OldFirst + P.FirstExport : INDEX_NONE);
+			ExportOffset.Add(OldOffset[j]);
+			ExportSize.Add(OldSize[j]);
+		}
+	}
+
+	for (int i = 0; i < Items.Num(); i++)
+	{
+		const CCatalogScanItem *Item = Items[i];
+		CCatalogPackage P;
+		P.Filename    = appStrdupPool(Item->Info->RelativeName);
+		GetNameIndex(P.Filename);			// file names are saved as indices in name table
+		P.Stamp       = Item->Stamp;
+		P.Game        = Item->Game;
+		P.Ver         = Item->Ver;
+		P.LicVer      = Item->LicVer;
+		P.FirstExport = ExportPackage.Num();
+		P.NumExports  = Item->Exports.Num();
+		P.Failed      = Item->Failed;
+		int PackageIndex = Packages.Add(P);
+		for (int j = 0; j < Item->Exports.Num(); j++)
+		{
+			const CCatalogScanExport &E = Item->Exports[j];
+			ExportPackage.Add(PackageIndex);
+			ExportClass.Add(GetNameIndex(E.ClassName));
+			ExportName.Add(GetNameIndex(E.ObjectName));
+			ExportOuter.Add(E.Outer >= 0 ? E.Outer + P.FirstExport : INDEX_NONE);
+			ExportOffset.Add(E.SerialOffset);
+			ExportSize.Add(E.SerialSize);
+		}
+		delete Item;
+	}
+	RebuildPackageHash();
+
+	appPrintf("Catalog updated: %d packages, %d exports (%d scanned, %d failed, %d removed) in %.1f sec\n",
+		Packages.Num(), ExportPackage.Num(), Items.Num(), NumFailed, NumRemoved, (appMilliseconds() - StartTime) / 1000.0f);
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Queries
+-----------------------------------------------------------------------------*/
+
+void CPackageCatalog::FindExports(const TArray<int> &PackageIndices, const char *ObjectMask, const char *ClassMask, TArray<int> &Result) const
+{
+	guard(CPackageCatalog::FindExports);
+
+	// Match every name against the masks once, then scan name columns
+	enum
+	{
+		MATCH_OBJECT = 1,
+		MATCH_CLASS  = 2,
+	};
+	TArray<byte> NameFlags;
+	NameFlags.AddUninitialized(Names.Num());
+	for (int i = 0; i < Names.Num(); i++)
+	{
+		byte Flags = 0;
+		if (!ObjectMask || appMatchWildcard(Names[i], ObjectMask, true)) Flags |= MATCH_OBJECT;
+		if (!ClassMask  || appMatchWildcard(Names[i], ClassMask,  true)) Flags |= MATCH_CLASS;
+		NameFlags[i] = Flags;
+	}
+
+	const byte *Flags = NameFlags.GetData();
+	const int *ObjectNames = ExportName.GetData();
+	const int *ClassNames = ExportClass.GetData();
+	for (int i = 0; i < PackageIndices.Num(); i++)
+	{
+		const CCatalogPackage &P = Packages[PackageIndices[i]];
+		for (int j = P.FirstExport; j < P.FirstExport + P.NumExports; j++)
+		{
+			if ((Flags[ObjectNames[j]] & MATCH_OBJECT) && (Flags[ClassNames[j]] & MATCH_CLASS))
+				Result.Add(j);
+		}
+	}
+
+	unguard;
+}
@@ -0,0 +1,87 @@
+#ifndef __PACKAGE_CATALOG_H__
+#define __PACKAGE_CATALOG_H__
+
+/*-----------------------------------------------------------------------------
+	Export catalog
+-----------------------------------------------------------------------------*/
+
+// Catalog holds export tables of game packages in a compact columnar form, so objects could be
+// found by name and class without loading packages. Every export is described by its package,
+// class name, object name, outer export, serial offset and size; names are indices in catalog's
+// name table. Catalog is saved to a file and reused later: only new packages and packages whose
+// files were changed are scanned again. Saved catalog is discarded when it was created by another
+// build of the program, or with other loader overrides (-game, -pkgver, platform and compression
+// options), because they change results of package scanning.
+
+struct CCatalogPackage
+{
+	const char		*Filename;			// relative to game root, allocated with appStrdupPool()
+	CContentHash	Stamp;				// size and modification time of package file
+	int				Game;
+	int				Ver;
+	int				LicVer;
+	int				FirstExport;		// index in export columns
+	int				NumExports;
+	bool			Failed;				// package tables couldn't be loaded, package has no exports
+};
+
+class CPackageCatalog
+{
+public:
+	CPackageCatalog();
+
+	// Returns false when file is missing, has wrong format, or was created for another game directory,
+	// program build or loader settings. BuildVersion is any string which identifies program build.
+	// Settings are remembered here and saved with the catalog: scanning could change them (game
+	// detection sets GForceGame).
+	bool Load(const char *Filename, const char *BuildVersion);
+	void Save(const char *Filename);
+
+	// Make catalog up to date for provided package files: new and changed packages are scanned
+	// in parallel. Packages which are not registered as game files anymore are removed. Packages
+	// which couldn't be scanned are kept as failed ones, and are not scanned again until changed.
+	void Update(const TArray<const CGameFileInfo*> &Files);
+
+	// Returns INDEX_NONE when package is not in catalog
+	int FindPackage(const char *Filename) const;
+
+	// Append indices of exports from provided packages which object name and class name match
+	// wildcards (case-insensitive) to Result. NULL mask matches everything.
+	void FindExports(const TArray<int> &PackageIndices, const char *ObjectMask, const char *ClassMask, TArray<int> &Result) const;
+
+	FORCEINLINE const char* GetExportName(int Index) const
+	{
+		return Names[ExportName[Index]];
+	}
+	FORCEINLINE const char* GetExportClassName(int Index) const
+	{
+		return Names[ExportClass[Index]];
+	}
+
+	// Strings are allocated with appStrdupPool()
+	TArray<const char*>		Names;
+	TArray<CCatalogPackage>	Packages;
+	// Export columns
+	TArray<int>				ExportPackage;	// index in Packages
+	TArray<int>				ExportClass;	// index in Names
+	TArray<int>				ExportName;		// index in Names
+	TArray<int>				ExportOuter;	// index of outer export, INDEX_NONE for top-level objects
+	TArray<int>				ExportOffset;
+	TArray<int>				ExportSize;
+
+protected:
+	TArray<int>				NameHash;
+	TArray<int>				NameHashNext;
+	TArray<int>				PackageHash;
+	TArray<int>				PackageHashNext;
+
+	void Empty();
+	CContentHash			LoaderSettings;
+
+	bool LoadFromArchive(FArchive &Ar);
+	int GetNameIndex(const char *Name);
+	void RebuildPackageHash();
+};
+
+
+#endif // __PACKAGE_CATALOG_H__
@@ -5,6 +5,7 @@
 #include "UnPackage.h"
 
 #include "PackageUtils.h"
+#include "Threading.h"
 
 /*-----------------------------------------------------------------------------
 	Package loader/unloader
@@ -73,23 +74,196 @@ void ReleaseAllObjects()
 	unguard;
 }
 
+bool ReleasePackageObjects(UnPackage* Package, const TArray<UnPackage*>* KeepPackages)
+{
+	guard(ReleasePackageObjects);
+
+	// collect packages with objects referencing objects of this package, recursively
+	TArray<UnPackage*> Packages;
+	Packages.Add(Package);
+	for (int i = 0; i < Packages.Num(); i++)
+	{
+		UnPackage* p = Packages[i];
+		if (KeepPackages && KeepPackages->FindItem(p) >= 0) return false;
+		for (int j = 0; j < p->ReferencingPackages.Num(); j++)
+			Packages.AddUnique(p->ReferencingPackages[j]);
+	}
+
+	// Collect objects first: destructor of one object could release other objects (see Rune's
+	// USkelModel), so GObjObjects could change while releasing.
+	TArray<UObject*> Objects;
+	for (int i = 0; i < UObject::GObjObjects.Num(); i++)
+	{
+		UObject* Obj = UObject::GObjObjects[i];
+		if (Packages.FindItem(Obj->Package) >= 0)
+			Objects.Add(Obj);
+	}
+	for (int i = Objects.Num() - 1; i >= 0; i--)
+	{
+		if (UObject::GObjObjects.FindItem(Objects[i]) >= 0)
+			delete Objects[i];
+	}
+
+	// released packages don't reference anything now
+	const TArray<UnPackage*>& PackageMap = UnPackage::GetPackageMap();
+	for (int i = 0; i < Packages.Num(); i++)
+	{
+		GFullyLoadedPackages.RemoveSingle(Packages[i]);
+		for (int j = 0; j < PackageMap.Num(); j++)
+			PackageMap[j]->ReferencingPackages.RemoveSingle(Packages[i]);
+	}
+	return true;
+
+	unguardf("%s", Package->Name);
+}
+
+size_t GMemoryBudget = 0;
+
+static int CompareUseTime(UnPackage* const* P1, UnPackage* const* P2)
+{
+	return (*P1)->LastUseTime - (*P2)->LastUseTime;
+}
+
+void TrimMemoryToBudget(const TArray<UnPackage*>* KeepPackages)
+{
+	guard(TrimMemoryToBudget);
+
+	if (!GMemoryBudget || UnPackage::GetReclaimableMemory() <= GMemoryBudget) return;
+
+	// release memory a bit more than required, so this will not happen after every package
+	size_t MemoryLimit = GMemoryBudget / 4 * 3;
+
+	// unload packages without objects first, they are cheap to load again
+	int NumUnloaded = UnPackage::UnloadPackages(MemoryLimit, KeepPackages);
+
+	// release objects of least recently used packages, then unload these packages
+	TArray<UnPackage*> Packages;
+	CopyArray(Packages, UnPackage::GetPackageMap());
+	Packages.Sort(CompareUseTime);
+	int NumReleased = 0;
+	for (int i = 0; i < Packages.Num() && UnPackage::GetReclaimableMemory() > MemoryLimit; i++)
+	{
+		UnPackage* Package = Packages[i];
+		if (UnPackage::GetPackageMap().FindItem(Package) < 0) continue;	// already unloaded
+		if (!Package->HasLoadedObjects()) continue;
+		if (!ReleasePackageObjects(Package, KeepPackages)) continue;
+		NumReleased++;
+		NumUnloaded += UnPackage::UnloadPackages(MemoryLimit, KeepPackages);
+	}
+
+	if (NumUnloaded || NumReleased)
+		appPrintf("Released objects of %d packages, unloaded %d packages, allocated " FORMAT_SIZE("d") " bytes\n",
+			NumReleased, NumUnloaded, GTotalAllocationSize);
+
+	unguard;
+}
+
 
 /*-----------------------------------------------------------------------------
-	Package scanner
+	Parallel package scanner
 -----------------------------------------------------------------------------*/
 
-struct ScanPackageData
+// Number of files processed between progress updates
+#define SCAN_BATCH_SIZE		512
+// Number of files from a virtual file system processed by one job, they share container readers
+#define SCAN_VFS_JOB_SIZE	16
+
+struct CScanPackagesContext
+{
+	const TArray<const CGameFileInfo*>* Files;
+	ScanPackageCallback_t Callback;
+	void*				Param;
+	TArray<int>			Items;				// indices of files in a batch, grouped by file system
+	TArray<int>			JobStart;			// job N processes Items[JobStart[N] .. JobStart[N+1]-1]
+};
+
+static void ScanPackagesJob(int Job, CScanPackagesContext &Context)
 {
-	ScanPackageData()
-	:	Progress(NULL)
-	,	Cancelled(false)
-	,	Index(0)
-	{}
+	// all files of a job are from the same file system
+	bool UseVFS = (*Context.Files)[Context.Items[Context.JobStart[Job]]]->FileSystem != NULL;
+	if (UseVFS) appOpenThreadFileReaders();
+	for (int i = Context.JobStart[Job]; i < Context.JobStart[Job+1]; i++)
+	{
+		int Index = Context.Items[i];
+		Context.Callback((*Context.Files)[Index], Index, Context.Param);
+	}
+	if (UseVFS) appCloseThreadFileReaders();
+}
+
+bool ScanPackagesParallel(const TArray<const CGameFileInfo*>& Files, ScanPackageCallback_t Callback, void* Param, IProgressCallback* progress)
+{
+	guard(ScanPackagesParallel);
+
+	if (!Files.Num()) return true;
+
+	CScanPackagesContext Context;
+	Context.Files    = &Files;
+	Context.Callback = Callback;
+	Context.Param    = Param;
+
+	Callback(Files[0], 0, Param);
+
+	TArray<const FVirtualFileSystem*> FileSystems;
+	for (int First = 1; First < Files.Num(); First += SCAN_BATCH_SIZE)
+	{
+		if (progress && !progress->Progress(Files[First]->RelativeName, First, Files.Num()))
+			return false;
 
-	TArray<FileInfo>*	PkgInfo;
-	IProgressCallback*	Progress;
-	bool				Cancelled;
-	int					Index;
+		int Last = min(First + SCAN_BATCH_SIZE, Files.Num());
+		Context.Items.Reset(SCAN_BATCH_SIZE);
+		Context.JobStart.Reset(SCAN_BATCH_SIZE + 1);
+		FileSystems.Reset();
+		// every OS file is a separate job
+		for (int i = First; i < Last; i++)
+		{
+			const FVirtualFileSystem* FileSystem = Files[i]->FileSystem;
+			if (!FileSystem)
+			{
+				Context.JobStart.Add(Context.Items.Num());
+				Context.Items.Add(i);
+			}
+			else
+			{
+				FileSystems.AddUnique(FileSystem);
+			}
+		}
+		// files of a virtual file system are split into jobs of SCAN_VFS_JOB_SIZE files
+		for (int fs = 0; fs < FileSystems.Num(); fs++)
+		{
+			int NumFiles = 0;
+			for (int i = First; i < Last; i++)
+			{
+				if (Files[i]->FileSystem != FileSystems[fs]) continue;
+				if (NumFiles++ % SCAN_VFS_JOB_SIZE == 0)
+					Context.JobStart.Add(Context.Items.Num());
+				Context.Items.Add(i);
+			}
+		}
+		int NumJobs = Context.JobStart.Num();
+		Context.JobStart.Add(Context.Items.Num());
+		appParallelFor(NumJobs, ScanPackagesJob, Context);
+	}
+	return true;
+
+	unguard;
+}
+
+static bool CollectPackage(const CGameFileInfo *file, TArray<const CGameFileInfo*> &Files)
+{
+	Files.Add(file);
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Package version scanner
+-----------------------------------------------------------------------------*/
+
+struct CPackageVersion
+{
+	bool				Valid;
+	int					Ver;
+	int					LicVer;
 };
 
 static int InfoCmp(const FileInfo *p1, const FileInfo *p2)
@@ -99,18 +273,12 @@ static int InfoCmp(const FileInfo *p1, const FileInfo *p2)
 	return p1->LicVer - p2->LicVer;
 }
 
-static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
+static void ReadPackageVersion(const CGameFileInfo *file, int Index, TArray<CPackageVersion> &Versions)
 {
-	guard(ScanPackage);
+	guard(ReadPackageVersion);
 
-	if (data.Progress)
-	{
-		if (!data.Progress->Progress(file->RelativeName, data.Index++, GNumPackageFiles))
-		{
-			data.Cancelled = true;
-			return false;
-		}
-	}
+	CPackageVersion &Info = Versions[Index];
+	Info.Valid = false;
 
 	// read a few first bytes as integers
 	FArchive *Ar = appCreateFileReader(file);
@@ -129,12 +297,10 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		//!! Use CreatePackageLoader() here to allow scanning of packages with custom header (Lineage etc);
 		//!! do that only when something "strange" within data noticed.
 		//!! Also, this function could react on custom package tags.
-		return true;
+		return;
 	}
 	uint32 Version = FileData[1];
 
-	FileInfo Info;
-
 #if UNREAL4
 	if ((Version & 0xFFFFF000) == 0xFFFFF000)
 	{
@@ -148,49 +314,145 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		Info.Ver    = Version & 0xFFFF;
 		Info.LicVer = Version >> 16;
 	}
-
-	Info.Count  = 0;
-	strcpy(Info.FileName, file->RelativeName);
+	Info.Valid = true;
 //	printf("%s - %d/%d\n", file->RelativeName, Info.Ver, Info.LicVer);
-	int Index = INDEX_NONE;
-	for (int i = 0; i < data.PkgInfo->Num(); i++)
+
+	unguardf("%s", file->RelativeName);
+}
+
+#define VERSION_HASH_SIZE	256
+
+static FORCEINLINE int GetVersionHash(int Ver, int LicVer)
+{
+	return (Ver * 31 + LicVer) & (VERSION_HASH_SIZE - 1);
+}
+
+bool ScanPackages(TArray<FileInfo>& info, IProgressCallback* progress)
+{
+	guard(ScanPackages);
+
+	info.Empty();
+
+	// read package headers in parallel
+	TArray<const CGameFileInfo*> Files;
+	appEnumGameFiles(CollectPackage, Files);
+	TArray<CPackageVersion> Versions;
+	Versions.AddZeroed(Files.Num());
+	if (!ScanPackagesParallel(Files, ReadPackageVersion, Versions, progress))
+		return false;
+
+	// group packages by version, in enumeration order
+	int Hash[VERSION_HASH_SIZE];
+	memset(Hash, -1, sizeof(Hash));
+	TArray<int> HashNext;
+	for (int i = 0; i < Files.Num(); i++)
 	{
-		FileInfo &Info2 = (*data.PkgInfo)[i];
-		if (Info2.Ver == Info.Ver && Info2.LicVer == Info.LicVer)
+		const CPackageVersion &Ver = Versions[i];
+		if (!Ver.Valid) continue;
+		const char *FileName = Files[i]->RelativeName;
+
+		int h = GetVersionHash(Ver.Ver, Ver.LicVer);
+		int Index;
+		for (Index = Hash[h]; Index != INDEX_NONE; Index = HashNext[Index])
+		{
+			const FileInfo &Info2 = info[Index];
+			if (Info2.Ver == Ver.Ver && Info2.LicVer == Ver.LicVer) break;
+		}
+		if (Index == INDEX_NONE)
+		{
+			FileInfo Info;
+			Info.Ver    = Ver.Ver;
+			Info.LicVer = Ver.LicVer;
+			Info.Count  = 0;
+			appStrncpyz(Info.FileName, FileName, ARRAY_COUNT(Info.FileName));
+			Index = info.Add(Info);
+			HashNext.Add(Hash[h]);
+			Hash[h] = Index;
+		}
+		// update info
+		FileInfo& fileInfo = info[Index];
+		fileInfo.Count++;
+		// combine filename
+		char *s = fileInfo.FileName;
+		const char *d = FileName;
+		while (*s == *d && *s != 0)
 		{
-			Index = i;
-			break;
+			s++;
+			d++;
 		}
+		*s = 0;
 	}
-	if (Index == INDEX_NONE)
-		Index = data.PkgInfo->Add(Info);
-	// update info
-	FileInfo& fileInfo = (*data.PkgInfo)[Index];
-	fileInfo.Count++;
-	// combine filename
-	char *s = fileInfo.FileName;
-	char *d = Info.FileName;
-	while (*s == *d && *s != 0)
+	info.Sort(InfoCmp);
+
+	return true;
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Package content scanner
+-----------------------------------------------------------------------------*/
+
+static void ScanPackageExportsWorker(const CGameFileInfo *file)
+{
+	guard(ScanPackageExports);
+
+	UnPackage *package = UnPackage::LoadPackageTables(file);
+	CGameFileInfo *info = const_cast<CGameFileInfo*>(file);		// we'll modify this structure here
+
+	for (int idx = 0; idx < package->Summary.ExportCount; idx++)
 	{
-		s++;
-		d++;
+		const char* ObjectClass = package->GetObjectName(package->ExportTable[idx].ClassIndex);
+
+		if (!stricmp(ObjectClass, "SkeletalMesh") || !stricmp(ObjectClass, "DestructibleMesh"))
+			info->NumSkeletalMeshes++;
+		else if (!stricmp(ObjectClass, "StaticMesh"))
+			info->NumStaticMeshes++;
+		else if (!stricmp(ObjectClass, "Animation") || !stricmp(ObjectClass, "MeshAnimation") || !stricmp(ObjectClass, "AnimSequence")) // whole AnimSet count for UE2 and number of sequences for UE3+
+			info->NumAnimations++;
+		else if (!strnicmp(ObjectClass, "Texture", 7))
+			info->NumTextures++;
 	}
-	*s = 0;
+	info->PackageScanned = true;
 
-	return true;
+	UnPackage::ReleasePackageTables(package);
 
 	unguardf("%s", file->RelativeName);
 }
 
+// Corrupted or unsupported package shouldn't stop the whole scan: the error is reported, and the
+// package is marked as scanned, so it will not be scanned again.
+static void ScanPackageExports(const CGameFileInfo *file, int Index, void *Param)
+{
+#if DO_GUARD
+	TRY
+	{
+		ScanPackageExportsWorker(file);
+	}
+	CATCH
+	{
+		appPrintf("WARNING: unable to scan package %s: %s\n", file->RelativeName, GErrorHistory);
+		GErrorHistory[0] = 0;
+		GIsSwError = false;
+		const_cast<CGameFileInfo*>(file)->PackageScanned = true;
+	}
+#else
+	ScanPackageExportsWorker(file);		// appError() terminates the program
+#endif
+}
 
-bool ScanPackages(TArray<FileInfo>& info, IProgressCallback* progress)
+bool ScanPackageContent(const TArray<const CGameFileInfo*>& Files, IProgressCallback* progress)
 {
-	info.Empty();
-	ScanPackageData data;
-	data.PkgInfo = &info;
-	data.Progress = progress;
-	appEnumGameFiles(ScanPackage, data);
-	info.Sort(InfoCmp);
+	guard(ScanPackageContent);
 
-	return !data.Cancelled;
+	TArray<const CGameFileInfo*> FilesToScan;
+	for (int i = 0; i < Files.Num(); i++)
+	{
+		if (Files[i]->IsPackage && !Files[i]->PackageScanned)
+			FilesToScan.Add(Files[i]);
+	}
+	return ScanPackagesParallel(FilesToScan, ScanPackageExports, NULL, progress);
+
+	unguard;
 }
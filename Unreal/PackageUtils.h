@@ -24,6 +24,18 @@ public:
 bool LoadWholePackage(UnPackage* Package, IProgressCallback* progress = NULL);
 void ReleaseAllObjects();
 
+// Memory budget in bytes, 0 = unlimited
+extern size_t GMemoryBudget;
+
+// Release all objects of the package, together with objects of packages which reference them
+// (recursively). Returns false and does nothing when one of these packages is in KeepPackages.
+bool ReleasePackageObjects(UnPackage* Package, const TArray<UnPackage*>* KeepPackages = NULL);
+
+// When reclaimable memory exceeds GMemoryBudget, unload least recently used packages, releasing
+// their objects first. Should be called when loaded objects are not needed anymore, for example
+// after exporting a package. Packages from KeepPackages are not unloaded.
+void TrimMemoryToBudget(const TArray<UnPackage*>* KeepPackages = NULL);
+
 
 // Package scanner
 
@@ -35,7 +47,27 @@ struct FileInfo
 	char	FileName[512];
 };
 
+// Calls Callback(File, Index, Param) for every file from worker threads. The first file is processed
+// in the calling thread before others: game detection could require user interaction (unversioned
+// UE4 packages) and sets GForceGame for following files. Every worker reads virtual file systems with
+// its own container readers. Progress is reported from the calling thread between batches of files.
+// Returns false when cancelled.
+typedef void (*ScanPackageCallback_t)(const CGameFileInfo* File, int Index, void* Param);
+bool ScanPackagesParallel(const TArray<const CGameFileInfo*>& Files, ScanPackageCallback_t Callback, void* Param, IProgressCallback* progress = NULL);
+
+template<typename T>
+FORCEINLINE bool ScanPackagesParallel(const TArray<const CGameFileInfo*>& Files, void (*Callback)(const CGameFileInfo*, int, T&), T& Param, IProgressCallback* progress = NULL)
+{
+	return ScanPackagesParallel(Files, (ScanPackageCallback_t)Callback, &Param, progress);
+}
+
+// Read versions of all game packages and group packages by version.
 bool ScanPackages(TArray<FileInfo>& info, IProgressCallback* progress = NULL);
 
+// Count meshes, animations and textures in packages, and store the result in CGameFileInfo. Only
+// summary, name, import and export tables are read, packages are not registered in PackageMap.
+// Already scanned packages are skipped.
+bool ScanPackageContent(const TArray<const CGameFileInfo*>& Files, IProgressCallback* progress = NULL);
+
 
 #endif // __PACKAGE_UTILS_H__
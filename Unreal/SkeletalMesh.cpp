@@ -264,14 +264,40 @@ static int FindTimeKey(const TArray<float> &KeyTime, float Frame)
 }
 
 
-// In:  KeyTime, Frame, NumFrames, Loop
-// Out: X - previous key index, Y - next key index, F - fraction between keys
-static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F)
+// Find time key using cursor from previous call. When Frame was moved forward by a few keys,
+// the key is found with a linear scan, otherwise falls back to FindTimeKey().
+static FORCEINLINE int FindTimeKeyFromCursor(const TArray<float> &KeyTime, float Frame, int &Cursor)
+{
+	const float *Keys = KeyTime.GetData();
+	int NumKeys = KeyTime.Num();
+	int i = Cursor;
+	if (i < NumKeys && Keys[i] <= Frame)
+	{
+		int Step;
+		for (Step = 0; Step < MAX_LINEAR_KEYS; Step++)
+		{
+			if (i + 1 >= NumKeys || Keys[i+1] > Frame)
+			{
+				Cursor = i;
+				return i;
+			}
+			i++;
+		}
+	}
+	// moved backward or too far forward
+	i = FindTimeKey(KeyTime, Frame);
+	Cursor = i;
+	return i;
+}
+
+
+// In:  KeyTime, Frame, NumFrames, Loop, X - previous key index
+// Out: Y - next key index, F - fraction between keys
+static FORCEINLINE void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFrames, bool Loop, int X, int &Y, float &F)
 {
-	guard(GetKeyParams);
-	X = FindTimeKey(KeyTime, Frame);
 	Y = X + 1;
 	int NumTimeKeys = KeyTime.Num();
+	const float *Keys = KeyTime.GetData();
 	if (Y >= NumTimeKeys)
 	{
 		if (!Loop)
@@ -285,38 +311,61 @@ static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFra
 		{
 			// loop animation
 			Y = 0;
-			F = (Frame - KeyTime[X]) / (NumFrames - KeyTime[X]);
+			F = (Frame - Keys[X]) / (NumFrames - Keys[X]);
 		}
 	}
 	else
 	{
-		F = (Frame - KeyTime[X]) / (KeyTime[Y] - KeyTime[X]);
+		F = (Frame - Keys[X]) / (Keys[Y] - Keys[X]);
 	}
-	unguard;
 }
 
 
-// not 'static', because used in ExportPsa()
-void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const
+// In:  KeyTime, Frame, NumFrames, Loop, Cursor (optional)
+// Out: X - previous key index, Y - next key index, F - fraction between keys
+static void GetKeyParams(const TArray<float> &KeyTime, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F, int *Cursor)
 {
-	guard(CAnimTrack::GetBonePosition);
+	guard(GetKeyParams);
+	X = Cursor ? FindTimeKeyFromCursor(KeyTime, Frame, *Cursor) : FindTimeKey(KeyTime, Frame);
+	GetKeyParams(KeyTime, Frame, NumFrames, Loop, X, Y, F);
+	unguard;
+}
 
-	// fast case: 1 frame only
-	if (KeyTime.Num() == 1 || NumFrames == 1 || Frame == 0)
+
+// Compute key indices for evenly spaced keys
+static FORCEINLINE void GetEvenKeyParams(int NumKeys, float Frame, float NumFrames, bool Loop, int &X, int &Y, float &F)
+{
+	float Position = Frame / NumFrames * NumKeys;
+	X = appFloor(Position);
+	F = Position - X;
+	Y = X + 1;
+	if (Y >= NumKeys)
 	{
-		if (KeyPos.Num())  DstPos  = KeyPos[0];
-		if (KeyQuat.Num()) DstQuat = KeyQuat[0];
-		return;
+		if (!Loop)
+		{
+			Y = NumKeys - 1;
+			F = 0;
+		}
+		else
+			Y = 0;
 	}
+}
 
-	// data for lerping
-	int posX, rotX;			// index of previous frame
-	int posY, rotY;			// index of next frame
-	float posF, rotF;		// fraction between X and Y for lerping
 
-	int NumTimeKeys = KeyTime.Num();
-	int NumPosKeys  = KeyPos.Num();
-	int NumRotKeys  = KeyQuat.Num();
+struct CTrackKeyParams
+{
+	int		posX, rotX;		// index of previous frame
+	int		posY, rotY;		// index of next frame
+	float	posF, rotF;		// fraction between X and Y for lerping
+};
+
+// Compute interpolation parameters for the track. Cursor is optional, and used for sequential
+// sampling of the same track.
+static void GetTrackKeyParams(const CAnimTrack &Track, float Frame, float NumFrames, bool Loop, CTrackKeyParams &P, CAnimPoseSampler::CTrackCursor *Cursor)
+{
+	int NumTimeKeys = Track.KeyTime.Num();
+	int NumPosKeys  = Track.KeyPos.Num();
+	int NumRotKeys  = Track.KeyQuat.Num();
 
 	if (NumTimeKeys)
 	{
@@ -324,91 +373,83 @@ void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3
 		assert(NumPosKeys <= 1 || NumPosKeys == NumTimeKeys);
 		assert(NumRotKeys == 1 || NumRotKeys == NumTimeKeys);
 
-		GetKeyParams(KeyTime, Frame, NumFrames, Loop, posX, posY, posF);
-		rotX = posX;
-		rotY = posY;
-		rotF = posF;
+		GetKeyParams(Track.KeyTime, Frame, NumFrames, Loop, P.posX, P.posY, P.posF, Cursor ? &Cursor->Time : NULL);
+		P.rotX = P.posX;
+		P.rotY = P.posY;
+		P.rotF = P.posF;
 
 		if (NumPosKeys <= 1)
 		{
-			posX = posY = 0;
-			posF = 0;
+			P.posX = P.posY = 0;
+			P.posF = 0;
 		}
 		if (NumRotKeys == 1)
 		{
-			rotX = rotY = 0;
-			rotF = 0;
+			P.rotX = P.rotY = 0;
+			P.rotF = 0;
 		}
 	}
 	else
 	{
 		// empty KeyTime array - keys are evenly spaced on a time line
 		// note: KeyPos and KeyQuat sizes can be different
-		if (KeyPosTime.Num())
+		if (Track.KeyPosTime.Num())
 		{
-			GetKeyParams(KeyPosTime, Frame, NumFrames, Loop, posX, posY, posF);
+			GetKeyParams(Track.KeyPosTime, Frame, NumFrames, Loop, P.posX, P.posY, P.posF, Cursor ? &Cursor->PosTime : NULL);
 		}
 		else if (NumPosKeys > 1)
 		{
-			float Position = Frame / NumFrames * NumPosKeys;
-			posX = appFloor(Position);
-			posF = Position - posX;
-			posY = posX + 1;
-			if (posY >= NumPosKeys)
-			{
-				if (!Loop)
-				{
-					posY = NumPosKeys - 1;
-					posF = 0;
-				}
-				else
-					posY = 0;
-			}
+			GetEvenKeyParams(NumPosKeys, Frame, NumFrames, Loop, P.posX, P.posY, P.posF);
 		}
 		else
 		{
-			posX = posY = 0;
-			posF = 0;
+			P.posX = P.posY = 0;
+			P.posF = 0;
 		}
 
-		if (KeyQuatTime.Num())
+		if (Track.KeyQuatTime.Num())
 		{
-			GetKeyParams(KeyQuatTime, Frame, NumFrames, Loop, rotX, rotY, rotF);
+			GetKeyParams(Track.KeyQuatTime, Frame, NumFrames, Loop, P.rotX, P.rotY, P.rotF, Cursor ? &Cursor->QuatTime : NULL);
 		}
 		else if (NumRotKeys > 1)
 		{
-			float Position = Frame / NumFrames * NumRotKeys;
-			rotX = appFloor(Position);
-			rotF = Position - rotX;
-			rotY = rotX + 1;
-			if (rotY >= NumRotKeys)
-			{
-				if (!Loop)
-				{
-					rotY = NumRotKeys - 1;
-					rotF = 0;
-				}
-				else
-					rotY = 0;
-			}
+			GetEvenKeyParams(NumRotKeys, Frame, NumFrames, Loop, P.rotX, P.rotY, P.rotF);
 		}
 		else
 		{
-			rotX = rotY = 0;
-			rotF = 0;
+			P.rotX = P.rotY = 0;
+			P.rotF = 0;
 		}
 	}
+}
+
+
+// not 'static', because used in ExportPsa()
+void CAnimTrack::GetBonePosition(float Frame, float NumFrames, bool Loop, CVec3 &DstPos, CQuat &DstQuat) const
+{
+	guard(CAnimTrack::GetBonePosition);
+
+	// fast case: 1 frame only
+	if (KeyTime.Num() == 1 || NumFrames == 1 || Frame == 0)
+	{
+		if (KeyPos.Num())  DstPos  = KeyPos[0];
+		if (KeyQuat.Num()) DstQuat = KeyQuat[0];
+		return;
+	}
+
+	CTrackKeyParams P;
+	GetTrackKeyParams(*this, Frame, NumFrames, Loop, P, NULL);
 
 	// get position
-	if (posF > 0)
-		Lerp(KeyPos[posX], KeyPos[posY], posF, DstPos);
-	else if (NumPosKeys)		// do not change DstPos when no keys
-		DstPos = KeyPos[posX];
+	if (P.posF > 0)
+		Lerp(KeyPos[P.posX], KeyPos[P.posY], P.posF, DstPos);
+	else if (KeyPos.Num())		// do not change DstPos when no keys
+		DstPos = KeyPos[P.posX];
 	// get orientation
-	if (rotF > 0)
-		Slerp(KeyQuat[rotX], KeyQuat[rotY], rotF, DstQuat);
-	else if (NumRotKeys)		// do not change DstQuat when no keys
-		DstQuat = KeyQuat[rotX];
+	if (P.rotF > 0)
+		Slerp(KeyQuat[P.rotX], KeyQuat[P.rotY], P.rotF, DstQuat);
+	else if (KeyQuat.Num())		// do not change DstQuat when no keys
+		DstQuat = KeyQuat[P.rotX];
 
 	unguard;
 }
@@ -422,3 +463,182 @@ void CAnimTrack::CopyFrom(const CAnimTrack &Src)
 	CopyArray(KeyQuatTime, Src.KeyQuatTime);
 	CopyArray(KeyPosTime,  Src.KeyPosTime );
 }
+
+
+/*-----------------------------------------------------------------------------
+	CAnimPoseSampler
+-----------------------------------------------------------------------------*/
+
+#define SLERP_BATCH			4
+
+// Queue of quaternions waiting for interpolation
+struct CSlerpBatch
+{
+	const CQuat	*A[SLERP_BATCH];
+	const CQuat	*B[SLERP_BATCH];
+	CQuat		*Dst[SLERP_BATCH];
+	float		Alpha[SLERP_BATCH];
+	int			Count;
+
+	CSlerpBatch()
+	:	Count(0)
+	{}
+
+	FORCEINLINE void Add(const CQuat &InA, const CQuat &InB, float InAlpha, CQuat &InDst)
+	{
+		A[Count]     = &InA;
+		B[Count]     = &InB;
+		Alpha[Count] = InAlpha;
+		Dst[Count]   = &InDst;
+		if (++Count == SLERP_BATCH)
+			Flush();
+	}
+
+	void Flush();
+};
+
+void CSlerpBatch::Flush()
+{
+	if (!Count) return;
+
+#if USE_SSE
+	// Fill unused slots with copy of 1st item, we'll not store results for them
+	for (int i = Count; i < SLERP_BATCH; i++)
+	{
+		A[i] = A[0];
+		B[i] = B[0];
+		Alpha[i] = Alpha[0];
+	}
+
+	// Convert quaternions to SoA form. Everything is computed with the same operations
+	// and in the same order as in Slerp(), so results are identical.
+	__m128 ax = _mm_loadu_ps(&A[0]->x);
+	__m128 ay = _mm_loadu_ps(&A[1]->x);
+	__m128 az = _mm_loadu_ps(&A[2]->x);
+	__m128 aw = _mm_loadu_ps(&A[3]->x);
+	_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+	__m128 bx = _mm_loadu_ps(&B[0]->x);
+	__m128 by = _mm_loadu_ps(&B[1]->x);
+	__m128 bz = _mm_loadu_ps(&B[2]->x);
+	__m128 bw = _mm_loadu_ps(&B[3]->x);
+	_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+	// get cosine of angle between quaternions
+	CVec4 cosom;
+	cosom.mm = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz)), _mm_mul_ps(aw, bw));
+
+	// slerp weights; trigonometry is computed per item
+	CVec4 scaleA, scaleB;
+	for (int i = 0; i < SLERP_BATCH; i++)
+	{
+		float c = cosom[i];
+		float sign = 1;
+		if (c < 0)
+		{
+			c    = -c;
+			sign = -1;
+		}
+		float Alpha1 = Alpha[i];
+		float sA, sB;
+		if (1.0f - c > 1e-6f)
+		{
+			float f        = 1.0f - c * c;
+			float sinomInv = appRsqrt(f);
+			float omega    = atan2(f * sinomInv, fabs(c));
+			sA = sin((1.0f - Alpha1) * omega) * sinomInv;
+			sB = sin(Alpha1 * omega) * sinomInv;
+		}
+		else
+		{
+			sA = 1.0f - Alpha1;
+			sB = Alpha1;
+		}
+		scaleA[i] = sA;
+		scaleB[i] = sB * sign;
+	}
+
+	// lerp result
+	__m128 dx = _mm_add_ps(_mm_mul_ps(scaleA.mm, ax), _mm_mul_ps(scaleB.mm, bx));
+	__m128 dy = _mm_add_ps(_mm_mul_ps(scaleA.mm, ay), _mm_mul_ps(scaleB.mm, by));
+	__m128 dz = _mm_add_ps(_mm_mul_ps(scaleA.mm, az), _mm_mul_ps(scaleB.mm, bz));
+	__m128 dw = _mm_add_ps(_mm_mul_ps(scaleA.mm, aw), _mm_mul_ps(scaleB.mm, bw));
+	_MM_TRANSPOSE4_PS(dx, dy, dz, dw);
+	// note: Dst could be the same as A or B, so store results only when everything is computed
+	_mm_storeu_ps(&Dst[0]->x, dx);
+	if (Count > 1) _mm_storeu_ps(&Dst[1]->x, dy);
+	if (Count > 2) _mm_storeu_ps(&Dst[2]->x, dz);
+	if (Count > 3) _mm_storeu_ps(&Dst[3]->x, dw);
+#else
+	for (int i = 0; i < Count; i++)
+		Slerp(*A[i], *B[i], Alpha[i], *Dst[i]);
+#endif // USE_SSE
+
+	Count = 0;
+}
+
+
+CAnimPoseSampler::CAnimPoseSampler(const CAnimSequence &InSeq, bool InLoop)
+:	Seq(InSeq)
+,	Loop(InLoop)
+{
+	Cursors.AddZeroed(Seq.Tracks.Num());
+}
+
+
+void CAnimPoseSampler::SamplePose(float Frame, CVec3 *DstPos, CQuat *DstQuat)
+{
+	guard(CAnimPoseSampler::SamplePose);
+
+	float NumFrames = Seq.NumFrames;
+	int NumTracks = Seq.Tracks.Num();
+	const CAnimTrack *Track = Seq.Tracks.GetData();
+	CTrackCursor *Cursor = Cursors.GetData();
+	CSlerpBatch Batch;
+
+	for (int i = 0; i < NumTracks; i++, Track++, Cursor++)
+	{
+		const CVec3 *KeyPos  = Track->KeyPos.GetData();
+		const CQuat *KeyQuat = Track->KeyQuat.GetData();
+		int NumPosKeys = Track->KeyPos.Num();
+		int NumRotKeys = Track->KeyQuat.Num();
+
+		// fast case: 1 frame only
+		if (Track->KeyTime.Num() == 1 || NumFrames == 1 || Frame == 0)
+		{
+			if (NumPosKeys) DstPos[i]  = KeyPos[0];
+			if (NumRotKeys) DstQuat[i] = KeyQuat[0];
+			continue;
+		}
+
+		CTrackKeyParams P;
+		GetTrackKeyParams(*Track, Frame, NumFrames, Loop, P, Cursor);
+
+		// get position
+		if (P.posF > 0)
+			Lerp(KeyPos[P.posX], KeyPos[P.posY], P.posF, DstPos[i]);
+		else if (NumPosKeys)
+			DstPos[i] = KeyPos[P.posX];
+		// get orientation; Slerp() returns B when Alpha >= 1
+		if (P.rotF >= 1)
+			DstQuat[i] = KeyQuat[P.rotY];
+		else if (P.rotF > 0)
+			Batch.Add(KeyQuat[P.rotX], KeyQuat[P.rotY], P.rotF, DstQuat[i]);
+		else if (NumRotKeys)
+			DstQuat[i] = KeyQuat[P.rotX];
+	}
+	Batch.Flush();
+
+	unguard;
+}
+
+
+void CAnimPoseSampler::SampleFrames(int FirstFrame, int Count, CVec3 *DstPos, CQuat *DstQuat)
+{
+	int NumTracks = Seq.Tracks.Num();
+	for (int Frame = FirstFrame; Frame < FirstFrame + Count; Frame++)
+	{
+		SamplePose(Frame, DstPos, DstQuat);
+		DstPos  += NumTracks;
+		DstQuat += NumTracks;
+	}
+}
@@ -239,6 +239,41 @@ public:
 };
 
 
+// Pose sampler: evaluates all tracks of CAnimSequence in a single call. Remembers last used key
+// for every track, so sampling frames in increasing order doesn't perform key searches. Rotations
+// are interpolated for 4 tracks at a time using SSE, results are the same as for Slerp().
+class CAnimPoseSampler
+{
+public:
+	CAnimPoseSampler(const CAnimSequence &InSeq, bool InLoop = false);
+
+	// Sample all tracks at the specified time. DstPos and DstQuat are arrays of Seq.Tracks.Num()
+	// items. Same as GetBonePosition(), values are not changed for tracks without keys.
+	void SamplePose(float Frame, CVec3 *DstPos, CQuat *DstQuat);
+	// Sample frames [FirstFrame .. FirstFrame+Count-1]. Output arrays has Count*Seq.Tracks.Num()
+	// items, ordered by frame.
+	void SampleFrames(int FirstFrame, int Count, CVec3 *DstPos, CQuat *DstQuat);
+
+	FORCEINLINE int NumTracks() const
+	{
+		return Seq.Tracks.Num();
+	}
+
+	// key cursor, one per track
+	struct CTrackCursor
+	{
+		int					Time;
+		int					PosTime;
+		int					QuatTime;
+	};
+
+protected:
+	const CAnimSequence		&Seq;
+	bool					Loop;
+	TArray<CTrackCursor>	Cursors;
+};
+
+
 // taken from UE3/SkeletalMeshComponent
 enum EAnimRotationOnly
 {
@@ -5,6 +5,7 @@
 
 #include "SkeletalMesh.h"
 #include "TypeConvert.h"
+#include "ObjectMetrics.h"
 
 
 /*-----------------------------------------------------------------------------
@@ -20,6 +21,7 @@ UMeshAnimation::~UMeshAnimation()
 void UMeshAnimation::ConvertAnims()
 {
 	guard(UMeshAnimation::ConvertAnims);
+	OBJECT_METRICS_SCOPE(this, METRIC_Convert);
 
 	int i, j;
 
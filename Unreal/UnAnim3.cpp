@@ -9,6 +9,7 @@
 
 #include "SkeletalMesh.h"
 #include "TypeConvert.h"
+#include "ObjectMetrics.h"
 
 
 // following defines will help finding new undocumented compression schemes
@@ -578,6 +579,7 @@ void ReadBnS_ZOnlyRLE(FArchive& Reader, int RotKeys, CAnimTrack* A)
 void UAnimSet::ConvertAnims()
 {
 	guard(UAnimSet::ConvertAnims);
+	OBJECT_METRICS_SCOPE(this, METRIC_Convert);
 
 	int i, j;
 
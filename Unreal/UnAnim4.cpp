@@ -9,6 +9,7 @@
 
 #include "SkeletalMesh.h"
 #include "TypeConvert.h"
+#include "ObjectMetrics.h"
 
 //#define DEBUG_DECOMPRESS	1
 
@@ -208,6 +209,7 @@ static void FixRotationKeys(CAnimSequence* Anim)
 void USkeleton::ConvertAnims(UAnimSequence4* Seq)
 {
 	guard(USkeleton::ConvertAnims);
+	OBJECT_METRICS_SCOPE(Seq ? (UObject*)Seq : this, METRIC_Convert);
 
 	CAnimSet* AnimSet = ConvertedAnim;
 
@@ -37,7 +37,7 @@ public:
 	virtual void Seek(int Pos)
 	{
 		guard(FObbFile::Seek);
-		assert(Pos >= 0 && Pos < Info->Size);
+		assert(Pos >= 0 && Pos <= Info->Size);	// seek to the end of file is allowed
 		ArPos = Pos;
 		unguard;
 	}
@@ -128,10 +128,20 @@ public:
 	}
 
 	virtual FArchive* CreateReader(const char* name)
+	{
+		return CreateReader(name, Reader);
+	}
+
+	virtual FArchive* CreateReader(const char* name, FArchive* containerReader)
 	{
 		const FObbEntry* info = FindFile(name);
 		if (!info) return NULL;
-		return new FObbFile(info, Reader);
+		return new FObbFile(info, containerReader);
+	}
+
+	virtual const char* GetFilename() const
+	{
+		return *Filename;
 	}
 
 protected:
@@ -142,8 +152,10 @@ protected:
 
 	const FObbEntry* FindFile(const char* name)
 	{
-		if (LastInfo && !stricmp(LastInfo->Name, name))
-			return LastInfo;
+		// files could be opened from different threads, read LastInfo once
+		FObbEntry* last = LastInfo;
+		if (last && !stricmp(last->Name, name))
+			return last;
 
 		for (int i = 0; i < FileInfos.Num(); i++)
 		{
@@ -203,7 +203,7 @@ public:
 	virtual void Seek(int Pos)
 	{
 		guard(FPakFile::Seek);
-		assert(Pos >= 0 && Pos < Info->UncompressedSize);
+		assert(Pos >= 0 && Pos <= Info->UncompressedSize);	// seek to the end of file is allowed
 		ArPos = Pos;
 		unguard;
 	}
@@ -347,6 +347,11 @@ public:
 	}
 
 	virtual FArchive* CreateReader(const char* name)
+	{
+		return CreateReader(name, Reader);
+	}
+
+	virtual FArchive* CreateReader(const char* name, FArchive* containerReader)
 	{
 		const FPakEntry* info = FindFile(name);
 		if (!info) return NULL;
@@ -355,7 +360,12 @@ public:
 			appPrintf("pak(%s): attempt to open encrypted file %s\n", *Filename, name);
 			return NULL;
 		}
-		return new FPakFile(info, Reader);
+		return new FPakFile(info, containerReader);
+	}
+
+	virtual const char* GetFilename() const
+	{
+		return *Filename;
 	}
 
 protected:
@@ -395,8 +405,10 @@ protected:
 
 	const FPakEntry* FindFile(const char* name)
 	{
-		if (LastInfo && !stricmp(LastInfo->Name, name))
-			return LastInfo;
+		// files could be opened from different threads, read LastInfo once
+		FPakEntry* last = LastInfo;
+		if (last && !stricmp(last->Name, name))
+			return last;
 
 		if (HashTable)
 		{
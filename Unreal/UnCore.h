@@ -119,6 +119,15 @@ void appFindGameFiles(const char *Filename, TArray<const CGameFileInfo*>& Files)
 
 const char *appSkipRootDir(const char *Filename);
 FArchive *appCreateFileReader(const CGameFileInfo *info);
+// Between these calls, files of virtual file systems opened by the calling thread are read with
+// container file readers owned by this thread, so several threads could read the same VFS at once.
+// Archives created with appCreateFileReader() should be closed before appCloseThreadFileReaders().
+void appOpenThreadFileReaders();
+void appCloseThreadFileReaders();
+// Identify version of the file without reading it: files from OS file system are identified by
+// size and modification time. Virtual file systems don't provide file times, so their files are
+// identified by size and time of the container file and by size of the file itself.
+void appGetGameFileStamp(const CGameFileInfo *info, struct CContentHash &Stamp);
 
 typedef bool (*EnumGameFilesCallback_t)(const CGameFileInfo*, void*);
 void appEnumGameFilesWorker(EnumGameFilesCallback_t, const char *Ext = NULL, void *Param = NULL);
@@ -150,6 +159,13 @@ extern const char *GStartupPackage;
 -----------------------------------------------------------------------------*/
 
 const char* appStrdupPool(const char* str);
+// Version for strings with known length and appStrihash() value, for example UE4 name hashes
+// serialized in package. Only lower 16 bits of the hash are used.
+const char* appStrdupPool(const char* str, int len, uint32 hash);
+// Memory used by appStrdupPool() strings, it is never released
+size_t appGetStrdupPoolSize();
+// Case-insensitive string hash, compatible with UE4 FName hash
+uint32 appStrihash(const char* str);
 
 class FName
 {
@@ -382,6 +398,30 @@ enum EPlatform
 	FArchive class
 -----------------------------------------------------------------------------*/
 
+// Vertex format of the mesh being serialized. Values are read from vertex buffer header and used
+// by vertex serializers. This information is stored in archive instead of global variables, so
+// objects could be loaded from different archives in parallel.
+struct FMeshSerializeState
+{
+	int		NumGPUUVSets;				// UE3 GPU skin vertex buffer
+	int		NumSkelUVSets;				// UE4 skeletal mesh vertex buffer
+	int		NumSkelInfluences;			// UE4 skeletal mesh vertex buffer
+	int		NumStaticUVSets;			// UE3 and UE4 static mesh vertex buffer
+	bool	UseStaticFloatUVs;
+	bool	UseHighPrecisionTangents;	// UE4 static mesh vertex buffer
+	bool	StripStaticNormals;			// UE3 static mesh vertex buffer (Batman)
+
+	FMeshSerializeState()
+	:	NumGPUUVSets(1)
+	,	NumSkelUVSets(1)
+	,	NumSkelInfluences(4)
+	,	NumStaticUVSets(1)
+	,	UseStaticFloatUVs(true)
+	,	UseHighPrecisionTangents(false)
+	,	StripStaticNormals(false)
+	{}
+};
+
 class FArchive
 {
 public:
@@ -399,6 +439,8 @@ public:
 	int		Game;				// EGame
 	int		Platform;			// EPlatform
 
+	FMeshSerializeState MeshState;
+
 	FArchive()
 	:	ArPos(0)
 	,	ArStopper(0)
@@ -419,6 +461,7 @@ public:
 		ReverseBytes  = Other.ReverseBytes;
 		Game          = Other.Game;
 		Platform      = Other.Platform;
+		MeshState     = Other.MeshState;
 	}
 
 	// Information aboit game and engine this archive belongs to.
@@ -689,13 +732,7 @@ protected:
 
 inline bool appFileExists(const char* filename)
 {
-	FILE* f = fopen(filename, "rb");
-	if (f)
-	{
-		fclose(f);
-		return true;
-	}
-	return false;
+	return (appGetFileType(filename) & FS_FILE) != 0;
 }
 
 
@@ -712,6 +749,8 @@ public:
 };
 
 
+// File writer with write-behind: filled buffers are written, and files are closed, by a background
+// thread. Data is guaranteed to be on disk only after FlushPendingWrites() call.
 class FFileWriter : public FFileArchive
 {
 	DECLARE_ARCHIVE(FFileWriter, FFileArchive);
@@ -724,10 +763,21 @@ public:
 	virtual void Close();
 	virtual int64 GetFileSize64() const;
 
+	// Wait for completion of all queued writes, including writes of already closed files.
+	// Raises an error if some file was not written successfully.
+	static void FlushPendingWrites();
+	// The same, but errors are not raised, they should be retrieved with GetWriteError().
+	static void WaitForPendingWrites();
+	// Get name of the file which was not written successfully, the oldest one first. Returns
+	// false when there were no errors. Errors which were not retrieved are reported by
+	// FlushPendingWrites() or at exit.
+	static bool GetWriteError(char *FileName, int FileNameSize);
 	static void CleanupOnError();
 
 protected:
-	void FlushBuffer();
+	struct CFileWriteState *WriteState;
+
+	void FlushBuffer(bool CloseFile = false);
 };
 
 
@@ -876,6 +926,18 @@ inline void DUMP_MEM_BYTES(const void* Data, int NumBytes)
 // Reverse byte order for data array, inplace
 void appReverseBytes(void *Block, int NumItems, int ItemSize);
 
+// XOR data with repeating key, inplace: Data[i] ^= Key[(KeyPos + i) % KeySize]
+#define MAX_XOR_KEY_SIZE		1024
+void appXorBlock(void *Data, int Size, const byte *Key, int KeySize, int KeyPos = 0);
+
+// Stream decryptors of per-game file readers, inplace
+#if BATTLE_TERR
+void DecryptBattleTerr(byte* Data, int Size);
+#endif
+#if AA2
+void DecryptAA2(byte* Data, int Size, int StartPos);	// StartPos is file position of Data
+#endif
+
 
 /*-----------------------------------------------------------------------------
 	Math classes
@@ -2041,6 +2103,85 @@ protected:
 };
 
 
+/*-----------------------------------------------------------------------------
+	Memory writer
+-----------------------------------------------------------------------------*/
+
+// Archive for saving data into memory. Used to prepare parts of exported files
+// separately (for example, in worker threads), and then write them to the file.
+class FMemWriter : public FArchive
+{
+	DECLARE_ARCHIVE(FMemWriter, FArchive);
+public:
+	FMemWriter(int ReserveSize = 0)
+	{
+		IsLoading = false;
+		if (ReserveSize) Data.Empty(ReserveSize);
+	}
+
+	virtual void Seek(int Pos)
+	{
+		guard(FMemWriter::Seek);
+		assert(Pos >= 0 && Pos <= Data.Num());
+		ArPos = Pos;
+		unguard;
+	}
+
+	virtual bool IsEof() const
+	{
+		return ArPos >= Data.Num();
+	}
+
+	virtual void Serialize(void *data, int size)
+	{
+		guard(FMemWriter::Serialize);
+		int NewSize = ArPos + size;
+		if (NewSize > Data.Max())
+		{
+			// TArray grows linearly, use exponential growth here
+			Data.ResizeTo(max(NewSize, Data.Max() * 2));
+		}
+		if (NewSize > Data.Num())
+			Data.AddUninitialized(NewSize - Data.Num());
+		memcpy(Data.GetData() + ArPos, data, size);
+		ArPos = NewSize;
+		unguard;
+	}
+
+	virtual int GetFileSize() const
+	{
+		return Data.Num();
+	}
+
+	// preallocate memory for Size bytes of data
+	void Reserve(int Size)
+	{
+		if (Size > Data.Max()) Data.ResizeTo(Size);
+	}
+
+	// remove all data
+	void Reset()
+	{
+		Data.Empty();
+		ArPos = 0;
+	}
+
+	// write accumulated data into another archive
+	void WriteTo(FArchive &Ar)
+	{
+		if (Data.Num()) Ar.Serialize(Data.GetData(), Data.Num());
+	}
+
+	const TArray<byte>& GetData() const
+	{
+		return Data;
+	}
+
+protected:
+	TArray<byte> Data;
+};
+
+
 /*-----------------------------------------------------------------------------
 	Guid
 -----------------------------------------------------------------------------*/
@@ -2070,6 +2211,44 @@ public:
 };
 
 
+/*-----------------------------------------------------------------------------
+	Content hash
+-----------------------------------------------------------------------------*/
+
+// Fast 128-bit non-cryptographic hash (MurmurHash3 x64 variant) used to identify data contents.
+// Data could be hashed with several Update() calls, result depends on boundaries of hashed pieces.
+struct CContentHash
+{
+	uint64		Hash[2];
+
+	CContentHash()
+	{
+		Hash[0] = Hash[1] = 0;
+	}
+
+	void Update(const void *Data, int Size);
+	void Update(const char *Str)
+	{
+		Update(Str, strlen(Str) + 1);
+	}
+	template<class T>
+	FORCEINLINE void UpdateValue(const T &Value)
+	{
+		Update(&Value, sizeof(T));
+	}
+
+	// Buffer should have space for 33 characters
+	void ToString(char *Buffer) const;
+	// Returns false when string is not a valid hash
+	bool FromString(const char *Str);
+
+	FORCEINLINE bool operator==(const CContentHash& Other) const
+	{
+		return Hash[0] == Other.Hash[0] && Hash[1] == Other.Hash[1];
+	}
+};
+
+
 #if UNREAL3
 
 /*-----------------------------------------------------------------------------
@@ -2135,13 +2314,14 @@ struct FByteBulkData //?? separate FUntypedBulkData
 //	int		SavedElementCount;
 //	int		SavedBulkDataOffsetInFile;
 //	int		SavedBulkDataSizeOnDisk;
-	byte	*BulkData;					// pointer to array data
+	byte	*BulkData;					// pointer to array data; use GetData() to load deferred payload
 //	int		LockStatus;
-//	FArchive *AttachedAr;
+	FArchive *AttachedAr;				// package used to load deferred payload; NULL when payload was loaded by Serialize()
 
 	FByteBulkData()
 	:	BulkData(NULL)
 	,	BulkDataOffsetInFile(0)
+	,	AttachedAr(NULL)
 	{}
 
 	virtual ~FByteBulkData()
@@ -2154,12 +2334,27 @@ struct FByteBulkData //?? separate FUntypedBulkData
 		return 1;
 	}
 
+	// Free the payload. When payload loading was deferred, next GetData() call will load it again.
 	void ReleaseData()
 	{
 		if (BulkData) appFree(BulkData);
 		BulkData = NULL;
 	}
 
+	// Returns true when payload is loaded or could be loaded with GetData()
+	bool HasData() const
+	{
+		return BulkData || AttachedAr;
+	}
+
+	// Returns the payload, loading it from the package when it was deferred by Serialize()
+	byte* GetData() const
+	{
+		if (!BulkData && AttachedAr)
+			const_cast<FByteBulkData*>(this)->LoadDeferredData();
+		return BulkData;
+	}
+
 	// support functions
 	void SerializeHeader(FArchive &Ar);
 	void SerializeData(FArchive &Ar);
@@ -2169,6 +2364,8 @@ struct FByteBulkData //?? separate FUntypedBulkData
 
 protected:
 	void SerializeDataChunk(FArchive &Ar);
+	bool DeferData(FArchive &Ar);
+	void LoadDeferredData();
 };
 
 struct FWordBulkData : public FByteBulkData
@@ -2579,6 +2776,7 @@ extern int       GForceGame;
 extern int       GForcePackageVersion;
 extern byte      GForcePlatform;
 extern byte      GForceCompMethod;
+extern volatile size_t GFileBytesWritten;	// total amount of data written with FFileWriter
 
 
 /*-----------------------------------------------------------------------------
@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Profiler.h"
 
 // includes for package decompression
 #include "lzo/lzo1x.h"
@@ -178,6 +179,8 @@ int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *Uncompressed
 {
 	guard(appDecompress);
 
+	PROFILE_SCOPE("Decompress", NULL, UncompressedSize);
+
 #if BLADENSOUL
 	if (GForceGame == GAME_BladeNSoul && Flags == COMPRESS_LZO_ENC_BNS)	// note: GForceGame is required (to not pass 'Game' here)
 	{
@@ -1,4 +1,7 @@
 #include "Core.h"
+#include "UnCore.h"				// for appXorBlock
+
+#include <emmintrin.h>			// SSE2
 
 #if BLADENSOUL
 
@@ -6,9 +9,8 @@ void DecryptBladeAndSoul(byte* CompressedBuffer, int CompressedSize)
 {
 	if (CompressedSize >= 32)
 	{
-		static const char *key = "qiffjdlerdoqymvketdcl0er2subioxq";
-		for (int i = 0; i < CompressedSize; i++)
-			CompressedBuffer[i] ^= key[i % 32];
+		static const char key[] = "qiffjdlerdoqymvketdcl0er2subioxq";
+		appXorBlock(CompressedBuffer, CompressedSize, (const byte*)key, 32);
 	}
 }
 
@@ -23,8 +25,7 @@ void DecryptTaoYuan(byte* CompressedBuffer, int CompressedSize)
 		137, 35, 95, 142, 69, 136, 243, 119, 25, 35, 111, 94, 101, 136, 243, 204,
 		243, 67, 95, 158, 69, 106, 107, 187, 237, 35, 103, 142, 72, 142, 243
 	};
-	for (int i = 0; i < CompressedSize; i++)
-		CompressedBuffer[i] ^= key[i % 31];		// note: "N % 31" is not the same as "N & 0x1F"
+	appXorBlock(CompressedBuffer, CompressedSize, key, 31);		// note: "N % 31" is not the same as "N & 0x1F"
 }
 
 #endif // TAO_YUAN
@@ -85,12 +86,122 @@ void DecryptDevlsThird(byte* CompressedBuffer, int CompressedSize)
 		220, 169, 141,   1, 131,  82,  44,  91, 172,
 	};
 	staticAssert(ARRAY_COUNT(key) == 761, "Bad key");
+	// Original code advances index with "XorIndex = XorIndex % 761 + 1", so only the first index
+	// depends on data size, and then the key is walked sequentially
 	uint32 XorIndex = 244109 * CompressedSize + 240169;
-    for (int i = 0; i < CompressedSize; i++)
+	appXorBlock(CompressedBuffer, CompressedSize, key, 761, XorIndex % 761);
+}
+
+#endif // DEVILS_THIRD
+
+
+/*-----------------------------------------------------------------------------
+	Stream decryptors of per-game file readers
+-----------------------------------------------------------------------------*/
+
+#if BATTLE_TERR || AA2
+
+// Rotate bytes left by Shift bits where Mask has 0xFF
+template<int Shift>
+static FORCEINLINE __m128i RotateBytesLeftMasked(__m128i b, __m128i Mask)
+{
+	__m128i r = _mm_or_si128(
+		_mm_and_si128(_mm_slli_epi16(b, Shift), _mm_set1_epi8((char)(0xFF << Shift))),
+		_mm_and_si128(_mm_srli_epi16(b, 8 - Shift), _mm_set1_epi8((1 << Shift) - 1)));
+	return _mm_xor_si128(b, _mm_and_si128(Mask, _mm_xor_si128(b, r)));
+}
+
+// Returns 0xFF in bytes of v which have Bit set
+static FORCEINLINE __m128i TestBytes(__m128i v, int Bit)
+{
+	__m128i b = _mm_set1_epi8(Bit);
+	return _mm_cmpeq_epi8(_mm_and_si128(v, b), b);
+}
+
+#endif // BATTLE_TERR || AA2
+
+#if BATTLE_TERR
+
+void DecryptBattleTerr(byte* Data, int Size)
+{
+	byte *p = Data;
+	// Process 16 bytes at a time: shift is computed with SWAR popcount, and rotation is
+	// performed as conditional rotations by 1, 2 and 4 bits (shift 8 is a no-op)
+	const __m128i One = _mm_set1_epi8(1);
+	for ( ; Size >= 16; Size -= 16, p += 16)
+	{
+		__m128i b = _mm_loadu_si128((__m128i*)p);
+		__m128i v = _mm_and_si128(b, _mm_sub_epi8(b, One));
+		v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x55)));
+		v = _mm_add_epi8(_mm_and_si128(v, _mm_set1_epi8(0x33)), _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi8(0x33)));
+		v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), _mm_set1_epi8(0x0F));
+		v = _mm_add_epi8(v, One);
+		b = RotateBytesLeftMasked<1>(b, TestBytes(v, 1));
+		b = RotateBytesLeftMasked<2>(b, TestBytes(v, 2));
+		b = RotateBytesLeftMasked<4>(b, TestBytes(v, 4));
+		_mm_storeu_si128((__m128i*)p, b);
+	}
+
+	for (int i = 0; i < Size; i++, p++)
 	{
-		CompressedBuffer[i] ^= key[XorIndex % 761];
-		XorIndex = XorIndex % 761 + 1;
+		byte b = *p;
+		int shift;
+		byte v;
+		for (shift = 1, v = b & (b - 1); v; v = v & (v - 1))	// shift = number of identity bits in 'v' (but b=0 -> shift=1)
+			shift++;
+		b = ROL8(b, shift);
+		*p = b;
 	}
 }
 
-#endif // DEVILS_THIRD
+#endif // BATTLE_TERR
+
+#if AA2
+
+void DecryptAA2(byte* Data, int Size, int StartPos)
+{
+	byte *p = Data;
+#if 1	// should be disabled when switching to "ArraysAGPCount != 0" code below
+	// Vectorized version of "ArraysAGPCount == 0" code. Low byte of PosXor is a XOR
+	// of 2 lower bytes of position; process 16 positions at a time, with carry to the
+	// second byte for positions which crossed 256 boundary.
+	const __m128i Iota = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i Sign = _mm_set1_epi8(-128);
+	for ( ; Size >= 16; Size -= 16, p += 16, StartPos += 16)
+	{
+		__m128i Start = _mm_set1_epi8((char)StartPos);
+		__m128i Lo = _mm_add_epi8(Start, Iota);
+		__m128i Carry = _mm_cmplt_epi8(_mm_xor_si128(Lo, Sign), _mm_xor_si128(Start, Sign));	// unsigned Lo < Start
+		__m128i Hi = _mm_sub_epi8(_mm_set1_epi8((char)(StartPos >> 8)), Carry);
+		__m128i PosXor = _mm_xor_si128(Lo, Hi);
+		__m128i b = _mm_xor_si128(_mm_loadu_si128((__m128i*)p), PosXor);
+		b = RotateBytesLeftMasked<1>(b, TestBytes(PosXor, 2));
+		_mm_storeu_si128((__m128i*)p, b);
+	}
+#endif
+
+	for (int i = 0; i < Size; i++, p++)
+	{
+		byte b = *p;
+	#if 0
+		// used with ArraysAGPCount != 0
+		int shift;
+		byte v;
+		for (shift = 1, v = b & (b - 1); v; v = v & (v - 1))	// shift = number of identity bits in 'v' (but b=0 -> shift=1)
+			shift++;
+		b = ROR8(b, shift);
+	#else
+		// used with ArraysAGPCount == 0
+		int PosXor = StartPos + i;
+		PosXor = (PosXor >> 8) ^ PosXor;
+		b ^= (PosXor & 0xFF);
+		if (PosXor & 2)
+		{
+			b = ROL8(b, 1);
+		}
+	#endif
+		*p = b;
+	}
+}
+
+#endif // AA2
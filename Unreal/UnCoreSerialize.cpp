@@ -1,14 +1,22 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Threading.h"
 
-#if UNREAL4
-#include "UnPackage.h"			// for accessing FPackageFileSummary from FByteBulkData
-#endif
+#include "UnPackage.h"			// for FByteBulkData: accessing FPackageFileSummary and package reader
 
 #if _WIN32
 #include <io.h>					// for _filelengthi64
+#include <process.h>			// for _exit
+#else
+#include <unistd.h>				// for _exit
 #endif
 
+#if __linux__
+#include <fcntl.h>				// for fallocate
+#endif
+
+#include <emmintrin.h>			// SSE2, for appXorBlock
+
 
 #define FILE_BUFFER_SIZE		4096
 
@@ -173,6 +181,38 @@ void appReverseBytes(void *Block, int NumItems, int ItemSize)
 	}
 }
 
+void appXorBlock(void *Data, int Size, const byte *Key, int KeySize, int KeyPos)
+{
+	assert(KeySize > 0 && KeySize <= MAX_XOR_KEY_SIZE);
+	byte *p = (byte*)Data;
+	KeyPos %= KeySize;
+
+	if (Size >= 64)
+	{
+		// Extend the key with its repeated beginning, so 16 bytes could be loaded from any
+		// key position without wrapping around
+		byte ExtKey[MAX_XOR_KEY_SIZE + 16];
+		memcpy(ExtKey, Key, KeySize);
+		for (int i = KeySize; i < KeySize + 16; i++)
+			ExtKey[i] = ExtKey[i - KeySize];
+		int Step = 16 % KeySize;
+		for ( ; Size >= 16; Size -= 16, p += 16)
+		{
+			__m128i v = _mm_loadu_si128((__m128i*)p);
+			v = _mm_xor_si128(v, _mm_loadu_si128((__m128i*)(ExtKey + KeyPos)));
+			_mm_storeu_si128((__m128i*)p, v);
+			KeyPos += Step;
+			if (KeyPos >= KeySize) KeyPos -= KeySize;
+		}
+	}
+
+	for (int i = 0; i < Size; i++)
+	{
+		p[i] ^= Key[KeyPos];
+		if (++KeyPos == KeySize) KeyPos = 0;
+	}
+}
+
 
 FArchive& FArray::SerializeRaw(FArchive &Ar, void (*Serializer)(FArchive&, void*), int elementSize)
 {
@@ -568,7 +608,6 @@ bool FFileArchive::OpenFile(const char *Mode)
 	assert(!IsOpen());
 
 	ArPos64 = FilePos = 0;
-	Buffer = (byte*)appMalloc(FILE_BUFFER_SIZE);
 	BufferPos = 0;
 	BufferSize = 0;
 
@@ -582,7 +621,7 @@ bool FFileArchive::OpenFile(const char *Mode)
 }
 
 FFileReader::FFileReader(const char *Filename, unsigned InOptions)
-:	FFileArchive(Filename, Options)
+:	FFileArchive(Filename, InOptions)
 {
 	guard(FFileReader::FFileReader);
 	IsLoading = true;
@@ -662,7 +701,9 @@ void FFileReader::Serialize(void *data, int size)
 
 bool FFileReader::Open()
 {
-	return OpenFile("rb");
+	if (!OpenFile("rb")) return false;
+	Buffer = (byte*)appMalloc(FILE_BUFFER_SIZE);
+	return true;
 }
 
 int64 FFileReader::GetFileSize64() const
@@ -684,10 +725,252 @@ int64 FFileReader::GetFileSize64() const
 	return FileSize;
 }
 
+/*-----------------------------------------------------------------------------
+	FFileWriter write-behind queue
+-----------------------------------------------------------------------------*/
+
+// FFileWriter doesn't write data in the calling thread: filled buffers are passed to a background
+// thread, which performs writing and closing of files, so export code is not blocked by disk i/o.
+// Buffers are large and are reused between files.
+
+#define WRITE_BUFFER_SIZE		(256*1024)
+#define WRITE_BUFFER_ALIGNMENT	256				// maximal alignment supported by appMalloc()
+#define MAX_PENDING_WRITES		8				// limits amount of memory used by queued buffers
+#define MAX_FREE_WRITE_BUFFERS	(MAX_PENDING_WRITES+4)
+// Large files are preallocated in PREALLOCATE_SIZE steps to reduce fragmentation
+#define PREALLOCATE_THRESHOLD	(4<<20)
+#define PREALLOCATE_SIZE		(32<<20)
+
+// File state owned by the i/o thread
+struct CFileWriteState
+{
+	FILE		*File;
+	const char	*FileName;				// allocated with appStrdup
+	int64		FilePos;
+	int64		Preallocated;
+	bool		Failed;
+};
+
+struct CFileWriteRequest
+{
+	CFileWriteState *State;				// NULL for fence request
+	byte		*Data;					// buffer, returned to the pool after writing
+	int			Size;
+	int64		Pos;
+	bool		CloseFile;
+	CSemaphore	*Fence;					// signalled when all previous requests are completed
+};
+
+class CFileWriteQueue
+{
+public:
+	CFileWriteQueue()
+	:	FreeSlots(MAX_PENDING_WRITES)
+	,	QueuedItems(0)
+	,	Head(0)
+	,	Tail(0)
+	,	NumFreeBuffers(0)
+	,	Threaded(false)
+	{
+#if !DEBUG_MEMORY
+		// memory debugger is not thread-safe, use synchronous writes with it
+		Threaded = appCreateThread((ThreadFunc_t)ThreadFunc, this);
+#endif
+	}
+
+	byte* AllocBuffer()
+	{
+		{
+			CScopeLock Lock(Mutex);
+			if (NumFreeBuffers)
+				return FreeBuffers[--NumFreeBuffers];
+		}
+		return (byte*)appMalloc(WRITE_BUFFER_SIZE, WRITE_BUFFER_ALIGNMENT);
+	}
+
+	void ReleaseBuffer(byte *Data)
+	{
+		{
+			CScopeLock Lock(Mutex);
+			if (NumFreeBuffers < MAX_FREE_WRITE_BUFFERS)
+			{
+				FreeBuffers[NumFreeBuffers++] = Data;
+				return;
+			}
+		}
+		appFree(Data);
+	}
+
+	void Submit(const CFileWriteRequest &Request)
+	{
+		if (!Threaded)
+		{
+			CFileWriteRequest Req = Request;
+			Execute(Req);
+			return;
+		}
+		FreeSlots.Wait();
+		Mutex.Lock();
+		Queue[Tail] = Request;
+		Tail = (Tail + 1) % MAX_PENDING_WRITES;
+		Mutex.Unlock();
+		QueuedItems.Post();
+	}
+
+	// Wait for completion of all submitted requests
+	void WaitForCompletion()
+	{
+		if (!Threaded) return;
+		CSemaphore Fence;
+		CFileWriteRequest Request;
+		memset(&Request, 0, sizeof(Request));
+		Request.Fence = &Fence;
+		Submit(Request);
+		Fence.Wait();
+	}
+
+	// Retrieve the oldest error which happened in i/o thread
+	bool GetError(FString &FileName)
+	{
+		CScopeLock Lock(Mutex);
+		if (!FailedFiles.Num()) return false;
+		FileName = FailedFiles[0];
+		FailedFiles.RemoveAt(0);
+		return true;
+	}
+
+	// Report errors which happened in i/o thread
+	void CheckErrors()
+	{
+		FString FileName;
+		if (!GetError(FileName)) return;
+		int NumErrors;
+		{
+			CScopeLock Lock(Mutex);
+			NumErrors = FailedFiles.Num() + 1;
+			FailedFiles.Empty();
+		}
+		appError("Unable to write file %s (%d files failed)", *FileName, NumErrors);
+	}
+
+protected:
+	CMutex		Mutex;
+	CSemaphore	FreeSlots;
+	CSemaphore	QueuedItems;
+	CFileWriteRequest Queue[MAX_PENDING_WRITES];
+	int			Head;
+	int			Tail;
+	byte		*FreeBuffers[MAX_FREE_WRITE_BUFFERS];
+	int			NumFreeBuffers;
+	bool		Threaded;
+	TArray<FString> FailedFiles;		// protected with Mutex
+
+	static void ThreadFunc(CFileWriteQueue *Self)
+	{
+		while (true)
+		{
+			Self->QueuedItems.Wait();
+			Self->Mutex.Lock();
+			CFileWriteRequest Request = Self->Queue[Self->Head];
+			Self->Head = (Self->Head + 1) % MAX_PENDING_WRITES;
+			Self->Mutex.Unlock();
+			Self->Execute(Request);
+			// release slot after completion, so Fence means that all previous writes are done
+			Self->FreeSlots.Post();
+		}
+	}
+
+	void Execute(CFileWriteRequest &Request)
+	{
+		if (Request.Fence)
+		{
+			Request.Fence->Post();
+			return;
+		}
+
+		CFileWriteState *State = Request.State;
+		if (Request.Size && !State->Failed)
+		{
+			if (Request.Pos != State->FilePos)
+			{
+				if (fseeko64(State->File, Request.Pos, SEEK_SET) != 0)
+					State->Failed = true;
+				State->FilePos = Request.Pos;
+			}
+#if __linux__
+			int64 EndPos = Request.Pos + Request.Size;
+			if (EndPos > PREALLOCATE_THRESHOLD && EndPos > State->Preallocated)
+			{
+				// reserve disk space without changing file size; errors are ignored, this is
+				// just an optimization (not all file systems support it)
+				int64 NewSize = Align(EndPos + PREALLOCATE_SIZE, PREALLOCATE_SIZE);
+				fallocate(fileno(State->File), FALLOC_FL_KEEP_SIZE, State->Preallocated, NewSize - State->Preallocated);
+				State->Preallocated = NewSize;
+			}
+#endif // __linux__
+			if (!State->Failed && fwrite(Request.Data, Request.Size, 1, State->File) != 1)
+				State->Failed = true;
+			State->FilePos += Request.Size;
+		}
+		ReleaseBuffer(Request.Data);
+
+		if (Request.CloseFile)
+		{
+			if (fclose(State->File) != 0)
+				State->Failed = true;
+			if (State->Failed)
+			{
+				CScopeLock Lock(Mutex);
+				FailedFiles.Add(State->FileName);
+			}
+			appFree(const_cast<char*>(State->FileName));
+			delete State;
+		}
+	}
+};
+
+// Allocated once and never released: i/o thread is still running at exit
+static CFileWriteQueue *GFileWriteQueue = NULL;
+
+static void FlushFileWritesAtExit()
+{
+	GFileWriteQueue->WaitForCompletion();
+	// errors could not be thrown here, report them and change the exit code
+	FString FileName;
+	bool Failed = false;
+	while (GFileWriteQueue->GetError(FileName))
+	{
+		appPrintf("ERROR: unable to write file %s\n", *FileName);
+		Failed = true;
+	}
+	if (Failed)
+	{
+		fflush(NULL);
+		_exit(1);
+	}
+}
+
+static CFileWriteQueue* GetFileWriteQueue()
+{
+	if (!GFileWriteQueue)
+	{
+		GFileWriteQueue = new CFileWriteQueue;
+		atexit(FlushFileWritesAtExit);
+	}
+	return GFileWriteQueue;
+}
+
+
+/*-----------------------------------------------------------------------------
+	FFileWriter
+-----------------------------------------------------------------------------*/
+
 static TArray<FFileWriter*> GFileWriters;
+volatile size_t GFileBytesWritten = 0;
 
 FFileWriter::FFileWriter(const char *Filename, unsigned Options)
 :	FFileArchive(Filename, Options)
+,	WriteState(NULL)
 {
 	guard(FFileWriter::FFileWriter);
 	IsLoading = false;
@@ -702,13 +985,44 @@ FFileWriter::~FFileWriter()
 	Close();
 }
 
+void FFileWriter::WaitForPendingWrites()
+{
+	if (GFileWriteQueue)
+		GFileWriteQueue->WaitForCompletion();
+}
+
+bool FFileWriter::GetWriteError(char *FileName, int FileNameSize)
+{
+	FString Name;
+	if (!GFileWriteQueue || !GFileWriteQueue->GetError(Name)) return false;
+	appStrncpyz(FileName, *Name, FileNameSize);
+	return true;
+}
+
+void FFileWriter::FlushPendingWrites()
+{
+	guard(FFileWriter::FlushPendingWrites);
+	if (!GFileWriteQueue) return;
+	GFileWriteQueue->WaitForCompletion();
+	GFileWriteQueue->CheckErrors();
+	unguard;
+}
+
 void FFileWriter::CleanupOnError()
 {
+	TArray<FString> FileNames;
 	for (int i = GFileWriters.Num() - 1; i >= 0; i--)
 	{
 		FFileWriter* Writer = GFileWriters[i];
-		FString FileName(Writer->FullName);
+		FileNames.Add(Writer->FullName);
 		delete Writer;
+	}
+	// files should be closed before deletion
+	if (GFileWriteQueue)
+		GFileWriteQueue->WaitForCompletion();
+	for (int i = 0; i < FileNames.Num(); i++)
+	{
+		const FString& FileName = FileNames[i];
 		appPrintf("Deleting partially saved file %s\n", *FileName);
 #if MAX_DEBUG
 		char NewFileName[1024];
@@ -726,35 +1040,12 @@ void FFileWriter::Serialize(void *data, int size)
 
 	while (size > 0)
 	{
-		int LocalPos64 = int(ArPos64 - BufferPos);
-		if (LocalPos64 < 0 || LocalPos64 >= FILE_BUFFER_SIZE || size >= FILE_BUFFER_SIZE)
+		int64 LocalPos64 = ArPos64 - BufferPos;
+		if (LocalPos64 < 0 || LocalPos64 > BufferSize || LocalPos64 >= WRITE_BUFFER_SIZE)
 		{
-			// trying to write outside of buffer
+			// trying to write outside of buffer (or leave a gap in buffer)
 			FlushBuffer();
-			if (size >= FILE_BUFFER_SIZE)
-			{
-				// large block, write directly to file
-				if (ArPos64 != FilePos)
-				{
-					if (fseeko64(f, ArPos64, SEEK_SET) != 0)
-						appError("Error seeking to position 0x%llX", ArPos64);
-//					int ret = fseeko64(f, ArPos64, SEEK_SET);
-//					assert(ret == 0);
-					FilePos = ArPos64;
-				}
-				int res = fwrite(data, size, 1, f);
-				if (res != 1)
-					appError("Unable to write %d bytes at pos=0x%llX", size, ArPos64);
-			#if PROFILE
-				GNumSerialize++;
-				GSerializeBytes += size;
-			#endif
-				ArPos64 += size;
-				FilePos += size;
-				return;
-			}
 			BufferPos = ArPos64;
-			BufferSize = 0;
 			LocalPos64 = 0;
 		}
 
@@ -762,7 +1053,7 @@ void FFileWriter::Serialize(void *data, int size)
 		int LocalPos = (int)LocalPos64;
 
 		// have something for buffer
-		int CanCopy = FILE_BUFFER_SIZE - LocalPos;
+		int CanCopy = WRITE_BUFFER_SIZE - LocalPos;
 		if (CanCopy > size) CanCopy = size;
 		memcpy(Buffer + LocalPos, data, CanCopy);
 		data = OffsetPointer(data, CanCopy);
@@ -776,45 +1067,71 @@ void FFileWriter::Serialize(void *data, int size)
 
 bool FFileWriter::Open()
 {
+	guard(FFileWriter::Open);
 	assert(!IsOpen());
-	Buffer = (byte*)appMalloc(FILE_BUFFER_SIZE);
+
+	// errors of previously written files are reported with GetWriteError() or FlushPendingWrites()
+	CFileWriteQueue* Queue = GetFileWriteQueue();
+
+	if (!OpenFile("wb")) return false;
+	// all writes are performed with large blocks, stdio buffering is not needed
+	setvbuf(f, NULL, _IONBF, 0);
+
+	WriteState = new CFileWriteState;
+	WriteState->File         = f;
+	WriteState->FileName     = appStrdup(FullName);
+	WriteState->FilePos      = 0;
+	WriteState->Preallocated = 0;
+	WriteState->Failed       = false;
+
+	Buffer = Queue->AllocBuffer();
 	BufferPos = 0;
 	BufferSize = 0;
-	return OpenFile("wb");
+	return true;
+
+	unguard;
 }
 
 void FFileWriter::Close()
 {
-	FlushBuffer();
-	Super::Close();
+	if (!IsOpen()) return;
+	// file will be closed by i/o thread
+	FlushBuffer(true);
+	f = NULL;
+	WriteState = NULL;
 }
 
-void FFileWriter::FlushBuffer()
+void FFileWriter::FlushBuffer(bool CloseFile)
 {
-	if (BufferSize > 0)
-	{
-		if (BufferPos != FilePos)
-		{
-			int ret = fseeko64(f, BufferPos, SEEK_SET);
-			assert(ret == 0);
-			FilePos = BufferPos;
-		}
-		int res = fwrite(Buffer, BufferSize, 1, f);
-		if (res != 1)
-			appError("Unable to write %d bytes at pos=0x%llX", BufferSize, ArPos64);
+	if (BufferSize == 0 && !CloseFile) return;
+
+	CFileWriteRequest Request;
+	Request.State     = WriteState;
+	Request.Data      = Buffer;
+	Request.Size      = BufferSize;
+	Request.Pos       = BufferPos;
+	Request.CloseFile = CloseFile;
+	Request.Fence     = NULL;
 #if PROFILE
+	if (BufferSize)
+	{
 		GNumSerialize++;
 		GSerializeBytes += BufferSize;
-#endif
-		FilePos += BufferSize;
-		BufferSize = 0;
-		if (FilePos > FileSize) FileSize = FilePos;
 	}
+#endif
+	if (BufferSize) appInterlockedAdd(&GFileBytesWritten, BufferSize);
+	if (BufferPos + BufferSize > FileSize) FileSize = BufferPos + BufferSize;
+
+	// buffer is owned by the queue now
+	CFileWriteQueue* Queue = GetFileWriteQueue();
+	Queue->Submit(Request);
+	Buffer = CloseFile ? NULL : Queue->AllocBuffer();
+	BufferSize = 0;
 }
 
 int64 FFileWriter::GetFileSize64() const
 {
-	return max(FileSize, FilePos + BufferSize);
+	return max(FileSize, BufferPos + BufferSize);
 }
 
 
@@ -1124,6 +1441,7 @@ void FByteBulkData::Serialize(FArchive &Ar)
 		}
 		if (BulkDataFlags & BULKDATA_PayloadAtEndOfFile)
 		{
+			if (DeferData(Ar)) return;
 			// stored in the same file, but at different position
 			// save archive position
 			int savePos, saveStopper;
@@ -1139,6 +1457,13 @@ void FByteBulkData::Serialize(FArchive &Ar)
 		}
 		if (BulkDataFlags & BULKDATA_ForceInlinePayload)
 		{
+			// compressed packages has no valid file position for inline data, so load it now
+			if (!Ar.IsCompressed() && DeferData(Ar))
+			{
+				BulkDataOffsetInFile = Ar.Tell64();
+				Ar.Seek64(BulkDataOffsetInFile + BulkDataSizeOnDisk);
+				return;
+			}
 			SerializeDataChunk(Ar);
 			return;
 		}
@@ -1158,6 +1483,7 @@ void FByteBulkData::Serialize(FArchive &Ar)
 
 	if (BulkDataFlags & BULKDATA_SeparateData)
 	{
+		if (DeferData(Ar)) return;
 		// stored in the same file, but at different position
 		// save archive position
 		int savePos, saveStopper;
@@ -1181,6 +1507,12 @@ void FByteBulkData::Serialize(FArchive &Ar)
 	if (ElementCount > 0)
 	{
 //		assert(BulkDataOffsetInFile == Ar.Tell());
+		if (BulkDataOffsetInFile == Ar.Tell64() && DeferData(Ar))
+		{
+			// inline data, skip it (the same check is used in Skip())
+			Ar.Seek64(BulkDataOffsetInFile + BulkDataSizeOnDisk);
+			return;
+		}
 		SerializeData(Ar);
 	}
 
@@ -1188,6 +1520,57 @@ void FByteBulkData::Serialize(FArchive &Ar)
 }
 
 
+// Remember the package for loading the payload later, with GetData() call. Returns false when
+// payload should be loaded immediately.
+bool FByteBulkData::DeferData(FArchive &Ar)
+{
+	if (!Ar.CastTo<UnPackage>()) return false;		// could load later only from package
+	if (ElementCount <= 0) return false;
+	AttachedAr = &Ar;
+	return true;
+}
+
+
+void FByteBulkData::LoadDeferredData()
+{
+	guard(FByteBulkData::LoadDeferredData);
+
+	assert(AttachedAr);
+	FArchive &Ar = *AttachedAr;
+	// package reader could be closed after loading the object, reopen it
+	UnPackage* Package = Ar.CastTo<UnPackage>();
+	UnPackage* PrevPinned = Package ? Package->PinReader() : NULL;
+	// package could be in the middle of serializing another object, save its position
+	int64 savePos   = Ar.Tell64();
+	int saveStopper = Ar.GetStopper();
+	Ar.SetStopper(0);
+
+	bool seekToData = true;
+#if UNREAL4
+	// UE4 compressed packages: SerializeData() will read payload from the file directly
+	if (Ar.Game >= GAME_UE4_BASE && Ar.IsCompressed()) seekToData = false;
+#endif
+	bool failed = false;
+	TRY
+	{
+		if (seekToData) Ar.Seek64(BulkDataOffsetInFile);
+		SerializeData(Ar);
+	}
+	CATCH
+	{
+		failed = true;
+	}
+
+	// restore archive position, also on error: the package could be used again later
+	Ar.Seek64(savePos);
+	Ar.SetStopper(saveStopper);
+	if (Package) UnPackage::UnpinReader(PrevPinned);
+	if (failed) THROW;
+
+	unguardf("pos=%llX", BulkDataOffsetInFile);
+}
+
+
 // Serialize only header, and skip data block if it is inline
 void FByteBulkData::Skip(FArchive &Ar)
 {
@@ -7,6 +7,7 @@
 #include "SkeletalMesh.h"
 #include "StaticMesh.h"
 #include "TypeConvert.h"
+#include "ObjectMetrics.h"
 
 //#define DEBUG_SKELMESH		1
 //#define DEBUG_STATICMESH		1
@@ -655,6 +656,7 @@ void USkeletalMesh::UpgradeMesh()
 void USkeletalMesh::ConvertMesh()
 {
 	guard(USkeletalMesh::ConvertMesh);
+	OBJECT_METRICS_SCOPE(this, METRIC_Convert);
 
 	CSkeletalMesh *Mesh = new CSkeletalMesh(this);
 	ConvertedMesh = Mesh;
@@ -1824,6 +1826,7 @@ void UStaticMesh::SerializeVanguardMesh(FArchive &Ar)
 void UStaticMesh::ConvertMesh()
 {
 	guard(UStaticMesh::ConvertMesh);
+	OBJECT_METRICS_SCOPE(this, METRIC_Convert);
 
 	int i;
 
@@ -11,6 +11,7 @@
 #include "SkeletalMesh.h"
 #include "StaticMesh.h"
 #include "TypeConvert.h"
+#include "ObjectMetrics.h"
 
 
 //#define DEBUG_SKELMESH		1
@@ -666,8 +667,6 @@ struct FGPUVert3Common
 	}
 };
 
-static int GNumGPUUVSets = 1;
-
 struct FGPUVert3Half : FGPUVert3Common
 {
 	FVector				Pos;
@@ -678,7 +677,7 @@ struct FGPUVert3Half : FGPUVert3Common
 		if (Ar.ArVer < 592) Ar << V.Pos;
 		V.Serialize(Ar);
 		if (Ar.ArVer >= 592) Ar << V.Pos;
-		for (int i = 0; i < GNumGPUUVSets; i++) Ar << V.UV[i];
+		for (int i = 0; i < Ar.MeshState.NumGPUUVSets; i++) Ar << V.UV[i];
 		return Ar;
 	}
 };
@@ -710,7 +709,7 @@ struct FGPUVert3Float : FGPUVert3Common
 		if (Ar.ArVer < 592) Ar << V.Pos;
 		V.Serialize(Ar);
 		if (Ar.ArVer >= 592) Ar << V.Pos;
-		for (int i = 0; i < GNumGPUUVSets; i++) Ar << V.UV[i];
+		for (int i = 0; i < Ar.MeshState.NumGPUUVSets; i++) Ar << V.UV[i];
 		return Ar;
 	}
 };
@@ -724,7 +723,7 @@ struct FGPUVert3PackedHalf : FGPUVert3Common
 	{
 		V.Serialize(Ar);
 		Ar << V.Pos;
-		for (int i = 0; i < GNumGPUUVSets; i++) Ar << V.UV[i];
+		for (int i = 0; i < Ar.MeshState.NumGPUUVSets; i++) Ar << V.UV[i];
 		return Ar;
 	}
 };
@@ -738,7 +737,7 @@ struct FGPUVert3PackedFloat : FGPUVert3Common
 	{
 		V.Serialize(Ar);
 		Ar << V.Pos;
-		for (int i = 0; i < GNumGPUUVSets; i++) Ar << V.UV[i];
+		for (int i = 0; i < Ar.MeshState.NumGPUUVSets; i++) Ar << V.UV[i];
 		return Ar;
 	}
 };
@@ -753,7 +752,7 @@ struct FGPUVertBat4_HalfUV_Pos48 : FGPUVert3Common
 	{
 		V.Serialize(Ar);
 		Ar << V.Pos;
-		for (int i = 0; i < GNumGPUUVSets; i++) Ar << V.UV[i];
+		for (int i = 0; i < Ar.MeshState.NumGPUUVSets; i++) Ar << V.UV[i];
 		return Ar;
 	}
 };
@@ -767,7 +766,7 @@ struct FGPUVertBat4_HalfUV_Pos32 : FGPUVert3Common
 	{
 		V.Serialize(Ar);
 		Ar << V.Pos;
-		for (int i = 0; i < GNumGPUUVSets; i++) Ar << V.UV[i];
+		for (int i = 0; i < Ar.MeshState.NumGPUUVSets; i++) Ar << V.UV[i];
 		return Ar;
 	}
 };
@@ -804,7 +803,7 @@ struct FSkeletalMeshVertexBuffer3
 
 		if (Ar.IsLoading) S.bUsePackedPosition = false;
 		bool AllowPackedPosition = false;
-		S.NumUVSets = GNumGPUUVSets = 1;
+		S.NumUVSets = Ar.MeshState.NumGPUUVSets = 1;
 
 	#if HUXLEY
 		if (Ar.Game == GAME_Huxley) goto old_version;
@@ -828,7 +827,7 @@ struct FSkeletalMeshVertexBuffer3
 				Ar << S.bUseFullPrecisionUVs;
 			int VertexSize, NumVerts;
 			Ar << S.NumUVSets << VertexSize << NumVerts;
-			GNumGPUUVSets = S.NumUVSets;
+			Ar.MeshState.NumGPUUVSets = S.NumUVSets;
 			goto serialize_verts;
 		}
 	#endif // FRONTLINES
@@ -874,7 +873,7 @@ struct FSkeletalMeshVertexBuffer3
 		{
 		get_UV_count:
 			Ar << S.NumUVSets;
-			GNumGPUUVSets = S.NumUVSets;
+			Ar.MeshState.NumGPUUVSets = S.NumUVSets;
 		}
 		Ar << S.bUseFullPrecisionUVs;
 		if (Ar.ArVer >= 592)
@@ -886,10 +885,10 @@ struct FSkeletalMeshVertexBuffer3
 		if (Ar.Game == GAME_MOH2010) AllowPackedPosition = true;
 	#endif
 	#if MKVSDC
-		if (Ar.Game == GAME_MK && Ar.ArVer >= 573) GNumGPUUVSets = S.NumUVSets = 2;	// Injustice
+		if (Ar.Game == GAME_MK && Ar.ArVer >= 573) Ar.MeshState.NumGPUUVSets = S.NumUVSets = 2;	// Injustice
 	#endif
 	#if CRIMECRAFT
-		if (Ar.Game == GAME_CrimeCraft && Ar.ArLicenseeVer >= 2) S.NumUVSets = GNumGPUUVSets = 4;
+		if (Ar.Game == GAME_CrimeCraft && Ar.ArLicenseeVer >= 2) S.NumUVSets = Ar.MeshState.NumGPUUVSets = 4;
 	#endif
 	#if LOST_PLANET3
 		if (Ar.Game == GAME_LostPlanet3 && Ar.ArLicenseeVer >= 75)
@@ -1927,6 +1926,7 @@ after_skeleton:
 void USkeletalMesh3::ConvertMesh()
 {
 	guard(USkeletalMesh3::ConvertMesh);
+	OBJECT_METRICS_SCOPE(this, METRIC_Convert);
 
 	CSkeletalMesh *Mesh = new CSkeletalMesh(this);
 	ConvertedMesh = Mesh;
@@ -2631,10 +2631,6 @@ struct FStaticMeshVertexStream3
 };
 
 
-static int  GNumStaticUVSets    = 1;
-static bool GUseStaticFloatUVs  = true;
-static bool GStripStaticNormals = false;
-
 struct FStaticMeshUVItem3
 {
 	FVector				Pos;			// old version (< 472)
@@ -2668,7 +2664,7 @@ struct FStaticMeshUVItem3
 		}
 #endif // AVA
 
-		if (GStripStaticNormals) goto uvs;
+		if (Ar.MeshState.StripStaticNormals) goto uvs;
 
 		if (Ar.ArVer < 472)
 		{
@@ -2703,14 +2699,14 @@ struct FStaticMeshUVItem3
 		if (Ar.ArVer >= 434 && Ar.ArVer < 615)
 			Ar << V.f10;				// starting from 615 made as separate stream
 	uvs:
-		if (GUseStaticFloatUVs)
+		if (Ar.MeshState.UseStaticFloatUVs)
 		{
-			for (int i = 0; i < GNumStaticUVSets; i++)
+			for (int i = 0; i < Ar.MeshState.NumStaticUVSets; i++)
 				Ar << V.UV[i];
 		}
 		else
 		{
-			for (int i = 0; i < GNumStaticUVSets; i++)
+			for (int i = 0; i < Ar.MeshState.NumStaticUVSets; i++)
 			{
 				// read in half format and convert to float
 				FMeshUVHalf UVHalf;
@@ -2774,7 +2770,7 @@ struct FStaticMeshUVStream3
 				Ar << unk;
 			}
 		}
-		GStripStaticNormals = (HasNormals == 0);
+		Ar.MeshState.StripStaticNormals = (HasNormals == 0);
 #endif // BATMAN
 #if MASSEFF
 		if (Ar.Game == GAME_MassEffect3 && Ar.ArLicenseeVer >= 150)
@@ -2830,8 +2826,8 @@ struct FStaticMeshUVStream3
 		// prepare for UV serialization
 		if (S.NumTexCoords > MAX_MESH_UV_SETS)
 			appError("StaticMesh has %d UV sets", S.NumTexCoords);
-		GNumStaticUVSets   = S.NumTexCoords;
-		GUseStaticFloatUVs = (S.bUseFullPrecisionUVs != 0);
+		Ar.MeshState.NumStaticUVSets   = S.NumTexCoords;
+		Ar.MeshState.UseStaticFloatUVs = (S.bUseFullPrecisionUVs != 0);
 		S.UV.BulkSerialize(Ar);
 		return Ar;
 
@@ -3725,6 +3721,7 @@ done:
 void UStaticMesh3::ConvertMesh()
 {
 	guard(UStaticMesh3::ConvertMesh);
+	OBJECT_METRICS_SCOPE(this, METRIC_Convert);
 
 	CStaticMesh *Mesh = new CStaticMesh(this);
 	ConvertedMesh = Mesh;
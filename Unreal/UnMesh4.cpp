@@ -11,6 +11,7 @@
 #include "SkeletalMesh.h"
 #include "StaticMesh.h"
 #include "TypeConvert.h"
+#include "ObjectMetrics.h"
 
 
 //#define DEBUG_SKELMESH		1
@@ -478,9 +479,6 @@ struct FSkelMeshChunk4
 	}
 };
 
-static int GNumSkelUVSets = 1;
-static int GNumSkelInfluences = 4;
-
 struct FSkinWeightInfo
 {
 	byte				BoneIndex[NUM_INFLUENCES_UE4];
@@ -488,23 +486,23 @@ struct FSkinWeightInfo
 
 	friend FArchive& operator<<(FArchive& Ar, FSkinWeightInfo& W)
 	{
-		if (GNumSkelInfluences <= ARRAY_COUNT(W.BoneIndex))
+		if (Ar.MeshState.NumSkelInfluences <= ARRAY_COUNT(W.BoneIndex))
 		{
-			for (int i = 0; i < GNumSkelInfluences; i++)
+			for (int i = 0; i < Ar.MeshState.NumSkelInfluences; i++)
 				Ar << W.BoneIndex[i];
-			for (int i = 0; i < GNumSkelInfluences; i++)
+			for (int i = 0; i < Ar.MeshState.NumSkelInfluences; i++)
 				Ar << W.BoneWeight[i];
 		}
 		else
 		{
 			// possibly this vertex has more vertex influences
-			assert(GNumSkelInfluences <= MAX_TOTAL_INFLUENCES_UE4);
+			assert(Ar.MeshState.NumSkelInfluences <= MAX_TOTAL_INFLUENCES_UE4);
 			// serialize influences
 			byte BoneIndex2[MAX_TOTAL_INFLUENCES_UE4];
 			byte BoneWeight2[MAX_TOTAL_INFLUENCES_UE4];
-			for (int i = 0; i < GNumSkelInfluences; i++)
+			for (int i = 0; i < Ar.MeshState.NumSkelInfluences; i++)
 				Ar << BoneIndex2[i];
-			for (int i = 0; i < GNumSkelInfluences; i++)
+			for (int i = 0; i < Ar.MeshState.NumSkelInfluences; i++)
 				Ar << BoneWeight2[i];
 			// check if sorting needed (possibly 2nd half of influences has zero weight)
 			uint32 PackedWeight2 = * (uint32*) &BoneWeight2[4];
@@ -563,7 +561,7 @@ struct FGPUVert4Half : FGPUVert4Common
 	friend FArchive& operator<<(FArchive &Ar, FGPUVert4Half &V)
 	{
 		Ar << *((FGPUVert4Common*)&V) << V.Pos;
-		for (int i = 0; i < GNumSkelUVSets; i++) Ar << V.UV[i];
+		for (int i = 0; i < Ar.MeshState.NumSkelUVSets; i++) Ar << V.UV[i];
 		return Ar;
 	}
 };
@@ -576,7 +574,7 @@ struct FGPUVert4Float : FGPUVert4Common
 	friend FArchive& operator<<(FArchive &Ar, FGPUVert4Float &V)
 	{
 		Ar << *((FGPUVert4Common*)&V) << V.Pos;
-		for (int i = 0; i < GNumSkelUVSets; i++) Ar << V.UV[i];
+		for (int i = 0; i < Ar.MeshState.NumSkelUVSets; i++) Ar << V.UV[i];
 		return Ar;
 	}
 };
@@ -611,9 +609,9 @@ struct FSkeletalMeshVertexBuffer4
 		Ar << B.MeshExtension << B.MeshOrigin;
 		DBG_SKEL("  Ext=(%g %g %g) Org=(%g %g %g)\n", FVECTOR_ARG(B.MeshExtension), FVECTOR_ARG(B.MeshOrigin));
 
-		// Serialize vertex data. Use global variables to avoid passing variables to serializers.
-		GNumSkelUVSets = B.NumTexCoords;
-		GNumSkelInfluences = B.bExtraBoneInfluences ? MAX_TOTAL_INFLUENCES_UE4 : NUM_INFLUENCES_UE4;
+		// Serialize vertex data. Pass vertex format to serializers with archive.
+		Ar.MeshState.NumSkelUVSets = B.NumTexCoords;
+		Ar.MeshState.NumSkelInfluences = B.bExtraBoneInfluences ? MAX_TOTAL_INFLUENCES_UE4 : NUM_INFLUENCES_UE4;
 		if (!B.bUseFullPrecisionUVs)
 			B.VertsHalf.BulkSerialize(Ar);
 		else
@@ -767,7 +765,7 @@ struct FStaticLODModel4
 				if (!SkinWeightStripFlags.IsDataStrippedForServer())
 				{
 					TArray<FSkinWeightInfo> Weights;
-					GNumSkelInfluences = bExtraBoneInfluences ? MAX_TOTAL_INFLUENCES_UE4 : NUM_INFLUENCES_UE4;
+					Ar.MeshState.NumSkelInfluences = bExtraBoneInfluences ? MAX_TOTAL_INFLUENCES_UE4 : NUM_INFLUENCES_UE4;
 					Weights.BulkSerialize(Ar);
 
 					assert(Weights.Num() == NumVertices);
@@ -889,6 +887,7 @@ void USkeletalMesh4::Serialize(FArchive &Ar)
 void USkeletalMesh4::ConvertMesh()
 {
 	guard(USkeletalMesh4::ConvertMesh);
+	OBJECT_METRICS_SCOPE(this, METRIC_Convert);
 
 	CSkeletalMesh *Mesh = new CSkeletalMesh(this);
 	ConvertedMesh = Mesh;
@@ -1175,10 +1174,6 @@ struct FPositionVertexBuffer4
 };
 
 
-static int  GNumStaticUVSets   = 1;
-static bool GUseStaticFloatUVs = true;
-static bool GUseHighPrecisionTangents = false;
-
 struct FStaticMeshUVItem4
 {
 	FPackedNormal	Normal[3];					//?? do we need 3 items here?
@@ -1186,7 +1181,7 @@ struct FStaticMeshUVItem4
 
 	friend FArchive& operator<<(FArchive& Ar, FStaticMeshUVItem4& V)
 	{
-		if (!GUseHighPrecisionTangents)
+		if (!Ar.MeshState.UseHighPrecisionTangents)
 		{
 			Ar << V.Normal[0] << V.Normal[2];	// TangentX and TangentZ
 		}
@@ -1198,14 +1193,14 @@ struct FStaticMeshUVItem4
 			V.Normal[2] = Tangent.ToPackedNormal();
 		}
 
-		if (GUseStaticFloatUVs)
+		if (Ar.MeshState.UseStaticFloatUVs)
 		{
-			for (int i = 0; i < GNumStaticUVSets; i++)
+			for (int i = 0; i < Ar.MeshState.NumStaticUVSets; i++)
 				Ar << V.UV[i];
 		}
 		else
 		{
-			for (int i = 0; i < GNumStaticUVSets; i++)
+			for (int i = 0; i < Ar.MeshState.NumStaticUVSets; i++)
 			{
 				// read in half format and convert to float
 				FMeshUVHalf UVHalf;
@@ -1240,13 +1235,13 @@ struct FStaticMeshVertexBuffer4
 		{
 			Ar << S.bUseHighPrecisionTangentBasis;
 		}
-		GUseHighPrecisionTangents = S.bUseHighPrecisionTangentBasis;
+		Ar.MeshState.UseHighPrecisionTangents = S.bUseHighPrecisionTangentBasis;
 		DBG_STAT("StaticMesh UV stream: TC:%d IS:%d NV:%d FloatUV:%d HQ_Tangent:%d\n", S.NumTexCoords, S.Stride, S.NumVertices, S.bUseFullPrecisionUVs, S.bUseHighPrecisionTangentBasis);
 
 		if (!StripFlags.IsDataStrippedForServer())
 		{
-			GNumStaticUVSets = S.NumTexCoords;
-			GUseStaticFloatUVs = S.bUseFullPrecisionUVs;
+			Ar.MeshState.NumStaticUVSets = S.NumTexCoords;
+			Ar.MeshState.UseStaticFloatUVs = S.bUseFullPrecisionUVs;
 			S.UV.BulkSerialize(Ar);
 		}
 
@@ -1659,6 +1654,7 @@ no_nav_collision:
 void UStaticMesh4::ConvertMesh()
 {
 	guard(UStaticMesh4::ConvertMesh);
+	OBJECT_METRICS_SCOPE(this, METRIC_Convert);
 
 	CStaticMesh *Mesh = new CStaticMesh(this);
 	ConvertedMesh = Mesh;
@@ -1798,9 +1794,10 @@ void UStaticMesh4::ConvertSourceModels()
 		CStaticMeshLod *Lod = new (Mesh->Lods) CStaticMeshLod;
 
 		FRawMesh RawMesh;
-		FMemReader Reader(Bulk.BulkData, Bulk.ElementCount); // ElementCount is the same as data size, for byte bulk data
+		FMemReader Reader(Bulk.GetData(), Bulk.ElementCount); // ElementCount is the same as data size, for byte bulk data
 		Reader.SetupFrom(*GetPackageArchive());
 		RawMesh.Serialize(Reader);
+		const_cast<FByteBulkData&>(Bulk).ReleaseData();
 
 		int NumTexCoords = MAX_STATIC_UV_SETS_UE4;
 		for (int i = 0; i < MAX_STATIC_UV_SETS_UE4; i++)
@@ -4,6 +4,8 @@
 #include "UnPackage.h"
 
 #include "GameDatabase.h"		// for GetGameTag()
+#include "Profiler.h"
+#include "ObjectMetrics.h"
 
 
 //#define DEBUG_PROPS				1
@@ -27,6 +29,7 @@ UObject::UObject()
 UObject::~UObject()
 {
 //	appPrintf("deleting %s (%p) - package %s, index %d\n", Name, this, Package ? Package->Name : "None", PackageIndex);
+	if (GObjectMetricsEnabled) appFlushObjectMetrics(this);
 	// remove self from GObjObjects
 	GObjObjects.RemoveSingle(this);
 	// remove self from package export table
@@ -173,7 +176,11 @@ void UObject::EndLoad()
 		appResetProfiler();
 #endif
 		GLoadingObj = Obj;
-		Obj->Serialize(*Package);
+		{
+			PROFILE_SCOPE("Serialize", Obj->GetClassName(), Package->GetStopper() - Package->Tell());
+			OBJECT_METRICS_SCOPE(Obj, METRIC_Load);
+			Obj->Serialize(*Package);
+		}
 		GLoadingObj = NULL;
 #if PROFILE_LOADING
 		appPrintProfiler();
@@ -198,7 +205,11 @@ void UObject::EndLoad()
 	int i;
 	guard(PostLoad);
 	for (i = 0; i < LoadedObjects.Num(); i++)
+	{
+		PROFILE_SCOPE("PostLoad", LoadedObjects[i]->GetClassName());
+		OBJECT_METRICS_SCOPE(LoadedObjects[i], METRIC_PostLoad);
 		LoadedObjects[i]->PostLoad();
+	}
 	unguardf("%s", LoadedObjects[i]->Name);
 	// cleanup
 	GObjLoaded.Empty();
@@ -206,9 +217,6 @@ void UObject::EndLoad()
 	appSetNotifyHeader(NULL);
 	assert(GObjBeginLoadCount == 0);
 
-	// close all opened file handles
-	UnPackage::CloseAllReaders();
-
 	unguard;
 }
 
@@ -5,6 +5,9 @@
 #include "UnPackage.h"
 
 #include "GameDatabase.h"		// for GetGameTag()
+#include "Profiler.h"
+
+#include <emmintrin.h>			// SSE2, for name verification
 
 byte GForceCompMethod = 0;		// COMPRESS_...
 
@@ -1252,12 +1255,7 @@ public:
 	{
 		Reader->Serialize(data, size);
 		if (XorKey)
-		{
-			int i;
-			byte *p;
-			for (i = 0, p = (byte*)data; i < size; i++, p++)
-				*p ^= XorKey;
-		}
+			appXorBlock(data, size, &XorKey, 1);
 	}
 
 protected:
@@ -1286,19 +1284,7 @@ public:
 	virtual void Serialize(void *data, int size)
 	{
 		Reader->Serialize(data, size);
-
-		int i;
-		byte *p;
-		for (i = 0, p = (byte*)data; i < size; i++, p++)
-		{
-			byte b = *p;
-			int shift;
-			byte v;
-			for (shift = 1, v = b & (b - 1); v; v = v & (v - 1))	// shift = number of identity bits in 'v' (but b=0 -> shift=1)
-				shift++;
-			b = ROL8(b, shift);
-			*p = b;
-		}
+		DecryptBattleTerr((byte*)data, size);
 	}
 };
 
@@ -1323,31 +1309,7 @@ public:
 	{
 		int StartPos = Reader->Tell();
 		Reader->Serialize(data, size);
-
-		int i;
-		byte *p;
-		for (i = 0, p = (byte*)data; i < size; i++, p++)
-		{
-			byte b = *p;
-		#if 0
-			// used with ArraysAGPCount != 0
-			int shift;
-			byte v;
-			for (shift = 1, v = b & (b - 1); v; v = v & (v - 1))	// shift = number of identity bits in 'v' (but b=0 -> shift=1)
-				shift++;
-			b = ROR8(b, shift);
-		#else
-			// used with ArraysAGPCount == 0
-			int PosXor = StartPos + i;
-			PosXor = (PosXor >> 8) ^ PosXor;
-			b ^= (PosXor & 0xFF);
-			if (PosXor & 2)
-			{
-				b = ROL8(b, 1);
-			}
-		#endif
-			*p = b;
-		}
+		DecryptAA2((byte*)data, size, StartPos);
 	}
 };
 
@@ -1376,13 +1338,8 @@ public:
 		Reader->Serialize(data, size);
 
 		// Note: similar code exists in DecryptBladeAndSoul()
-		int i;
-		byte *p;
-		static const char *key = "qiffjdlerdoqymvketdcl0er2subioxq";
-		for (i = 0, p = (byte*)data; i < size; i++, p++, Pos++)
-		{
-			*p ^= key[Pos % 32];
-		}
+		static const char key[] = "qiffjdlerdoqymvketdcl0er2subioxq";
+		appXorBlock(data, size, (const byte*)key, 32, Pos);
 	}
 };
 
@@ -1853,17 +1810,24 @@ FArchive* UnPackage::CreateLoader(const char* filename, FArchive* baseLoader)
 	unguardf("%s", filename);
 }
 
-UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
+UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent, bool tablesOnly)
 :	Loader(NULL)
+,	FileInfo(NULL)
+,	LastUseTime(tablesOnly ? 0 : ++UseTimeCounter)
+,	TablesOnly(tablesOnly)
 {
 	guard(UnPackage::UnPackage);
 
+	if (!tablesOnly && !PackageMap.Num())
+		FixedMemorySize = GTotalAllocationSize - appGetStrdupPoolSize();
+
 #if PROFILE_PACKAGE_TABLES
 	appResetProfiler();
 #endif
 
 	IsLoading = true;
 	Filename = appStrdupPool(appSkipRootDir(filename));
+	PROFILE_SCOPE("OpenPackage", Filename);
 	Loader = CreateLoader(filename, baseLoader);
 	SetupFrom(*Loader);
 
@@ -1967,6 +1931,7 @@ UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
 
 #if UNREAL3 && !USE_COMPACT_PACKAGE_STRUCTS			// we can serialize dependencies when needed
 	if (Game == GAME_DCUniverse || Game == GAME_Bioshock3) goto no_depends;		// has non-standard checks
+	if (TablesOnly) goto no_depends;
 	if (Summary.DependsOffset)						// some games are patrially upgraded: ArVer >= 415, but no depends table
 	{
 		guard(ReadDependsTable);
@@ -2025,10 +1990,14 @@ no_depends: ;
 	char *s2 = strchr(buf, '.');
 	if (s2) *s2 = 0;
 	Name = appStrdupPool(buf);
-	PackageMap.Add(this);
 
-	// Release package file handle
-	CloseReader();
+	if (!TablesOnly)
+	{
+		PackageMap.Add(this);
+		// Keep package file opened: following object loading will probably use it. The handle
+		// will be released when too many packages are opened.
+		OpenReader();
+	}
 
 #if PROFILE_PACKAGE_TABLES
 	appPrintProfiler();
@@ -2038,14 +2007,51 @@ no_depends: ;
 }
 
 
+// Verify name, some Korean games (B&S) has garbage there. Returns false for names with
+// unreadable characters or with too many unicode characters (replaced with '$' by FString
+// serializer).
+static bool IsGoodName(const char* Str, int Len)
+{
+	int numBadChars = 0;
+	int i = 0;
+	// process 16 characters at a time
+	const __m128i space  = _mm_set1_epi8(' ');
+	const __m128i dollar = _mm_set1_epi8('$');
+	for ( ; i + 16 <= Len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(Str + i));
+		// signed comparison: characters >= 0x80 are negative, so they're detected here too
+		if (_mm_movemask_epi8(_mm_cmplt_epi8(v, space)))
+			return false;
+		for (int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, dollar)); mask; mask &= mask - 1)
+			numBadChars++;
+	}
+	for ( ; i < Len; i++)
+	{
+		char c = Str[i];
+		if (c < ' ' || c > 0x7F)
+			return false;					// unreadable character
+		if (c == '$') numBadChars++;		// unicode characters replaced with '$' in FString serializer
+	}
+	if (numBadChars && Len >= 64) return false;
+	if (numBadChars >= Len / 2 && Len > 16) return false;
+	return true;
+}
+
+
 void UnPackage::LoadNameTable()
 {
 	guard(UnPackage::LoadNameTable);
 
 	if (Summary.NameCount == 0) return;
+	PROFILE_SCOPE("NameTable", Filename);
 
 	Seek(Summary.NameOffset);
 	NameTable = new const char* [Summary.NameCount];
+#if UNREAL4
+	if (Game >= GAME_UE4_BASE && !ReverseBytes && LoadNameTable4())
+		return;
+#endif
 	for (int i = 0; i < Summary.NameCount; i++)
 	{
 		guard(Name);
@@ -2204,22 +2210,7 @@ void UnPackage::LoadNameTable()
 			// Verify name, some Korean games (B&S) has garbage there.
 			// Use separate block to not mess with 'goto crossing variable initialization' error.
 			{
-				bool goodName = true;
-				int numBadChars = 0;
-				for (int j = 0; j < name.Len(); j++)
-				{
-					char c = name[j];
-					if (c < ' ' || c > 0x7F)
-					{
-						// unreadable character
-						goodName = false;
-						break;
-					}
-					if (c == '$') numBadChars++;		// unicode characters replaced with '$' in FString serializer
-				}
-				if (numBadChars && name.Len() >= 64) goodName = false;
-				if (numBadChars >= name.Len() / 2 && name.Len() > 16) goodName = false;
-				if (!goodName)
+				if (!IsGoodName(*name, name.Len()))
 				{
 					// replace name
 					appPrintf("WARNING: %s: fixing name %d\n", Filename, i);
@@ -2309,11 +2300,119 @@ void UnPackage::LoadNameTable()
 }
 
 
+#if UNREAL4
+
+// Number of names used to verify that serialized name hashes are compatible with appStrihash()
+#define NUM_VERIFIED_NAME_HASHES	16
+
+// Load UE4 name table: read the whole table with a single call, and intern names using name
+// hashes serialized in package instead of computing them. Returns false when the table could
+// not be parsed, in this case it should be loaded with common code.
+bool UnPackage::LoadNameTable4()
+{
+	guard(UnPackage::LoadNameTable4);
+
+	// name table is followed by another table, so find its size
+	int EndOffset = GetFileSize();
+	if (Summary.ImportOffset > Summary.NameOffset && Summary.ImportOffset < EndOffset)
+		EndOffset = Summary.ImportOffset;
+	if (Summary.ExportOffset > Summary.NameOffset && Summary.ExportOffset < EndOffset)
+		EndOffset = Summary.ExportOffset;
+	int BlockSize = EndOffset - Summary.NameOffset;
+	if (BlockSize <= 0 || BlockSize > (16 << 20)) return false;
+
+	byte* Block = (byte*)appMalloc(BlockSize);
+	Serialize(Block, BlockSize);
+	const byte* p = Block;
+	const byte* End = Block + BlockSize;
+
+	bool hasHashes = (ArVer >= VER_UE4_NAME_HASHES_SERIALIZED);
+	bool useHashes = hasHashes;
+
+	int i;
+	for (i = 0; i < Summary.NameCount; i++)
+	{
+		char buf[MAX_FNAME_LEN];
+		const char* Str = "";
+		bool isAnsi = true;
+		if (p + 4 > End) break;
+		int len = *(int*)p;
+		p += 4;
+		if (len > 0)
+		{
+			// ANSI string, use it in place
+			if (p + len > End || p[len-1] != 0) break;
+			Str = (const char*)p;
+			p += len;
+			len--;						// exclude null character
+		}
+		else if (len < 0)
+		{
+			// UNICODE string, convert it the same way as FString serializer does
+			len = -len;
+			if (len > ARRAY_COUNT(buf) || p + len * 2 > End) break;
+			for (int j = 0; j < len; j++, p += 2)
+			{
+				uint16 c = p[0] | (p[1] << 8);
+				if (c & 0xFF00) c = '$';
+				buf[j] = c & 255;
+			}
+			if (buf[len-1] != 0) break;
+			len--;
+			Str = buf;
+			isAnsi = false;
+		}
+		uint16 NameHash = 0;
+		if (hasHashes)
+		{
+			if (p + 4 > End) break;
+			NameHash = *(uint16*)p;		// NonCasePreservingHash, followed by CasePreservingHash
+			p += 4;
+		}
+
+		if (!IsGoodName(Str, len))
+		{
+			// replace name
+			appPrintf("WARNING: %s: fixing name %d\n", Filename, i);
+			appSprintf(ARRAY_ARG(buf), "__name_%d__", i);
+			Str = buf;
+			isAnsi = false;
+		}
+
+		// verify few hashes, just in case
+		if (useHashes && isAnsi && i < NUM_VERIFIED_NAME_HASHES && (appStrihash(Str) & 0xFFFF) != NameHash)
+			useHashes = false;
+
+		NameTable[i] = (useHashes && isAnsi) ? appStrdupPool(Str, len, NameHash) : appStrdupPool(Str);
+#if DEBUG_PACKAGE
+		PKG_LOG("Name[%d]: \"%s\"\n", i, NameTable[i]);
+#endif
+	}
+
+	appFree(Block);
+
+	if (i < Summary.NameCount)
+	{
+		// wrong data, or unsupported format
+		Seek(Summary.NameOffset);
+		return false;
+	}
+
+	Seek(Summary.NameOffset + (p - Block));
+	return true;
+
+	unguard;
+}
+
+#endif // UNREAL4
+
+
 void UnPackage::LoadImportTable()
 {
 	guard(UnPackage::LoadImportTable);
 
 	if (Summary.ImportCount == 0) return;
+	PROFILE_SCOPE("ImportTable", Filename);
 
 	Seek(Summary.ImportOffset);
 	FObjectImport *Imp = ImportTable = new FObjectImport[Summary.ImportCount];
@@ -2335,6 +2434,7 @@ void UnPackage::LoadExportTable()
 	guard(UnPackage::LoadExportTable);
 
 	if (Summary.ExportCount == 0) return;
+	PROFILE_SCOPE("ExportTable", Filename);
 
 	Seek(Summary.ExportOffset);
 	FObjectExport *Exp = ExportTable = new FObjectExport[Summary.ExportCount];
@@ -2368,6 +2468,11 @@ UnPackage::~UnPackage()
 {
 	guard(UnPackage::~UnPackage);
 	// free resources
+	if (!TablesOnly)
+	{
+		OpenReaders.RemoveSingle(this);
+		if (ActiveReader == this) ActiveReader = NULL;
+	}
 	if (Loader) delete Loader;
 	delete NameTable;
 	delete ImportTable;
@@ -2376,40 +2481,50 @@ UnPackage::~UnPackage()
 	if (DependsTable) delete DependsTable;
 #endif
 	// remove self from package table
-	int i = PackageMap.FindItem(this);
-	assert(i != INDEX_NONE);
-	PackageMap.RemoveAt(i);
+	if (!TablesOnly)
+	{
+		int i = PackageMap.FindItem(this);
+		assert(i != INDEX_NONE);
+		PackageMap.RemoveAt(i);
+		for (i = 0; i < PackageMap.Num(); i++)
+			PackageMap[i]->ReferencingPackages.RemoveSingle(this);
+	}
 	unguard;
 }
 
-#if 0
-// Commented, not used
-// Find file archive inside a package loader
-static FFileArchive* FindFileArchive(FArchive* Ar)
+UnPackage *UnPackage::LoadPackageTables(const CGameFileInfo *info)
 {
-#if UNREAL3
-	FUE3ArchiveReader* ArUE3 = Ar->CastTo<FUE3ArchiveReader>();
-	if (ArUE3) Ar = ArUE3->Reader;
-#endif
-
-	FReaderWrapper* ArWrap = Ar->CastTo<FReaderWrapper>();
-	if (ArWrap) Ar = ArWrap->Reader;
+	guard(UnPackage::LoadPackageTables);
+	assert(info->IsPackage);
+	UnPackage* package = new UnPackage(info->RelativeName, appCreateFileReader(info), true, true);
+	package->FileInfo = info;
+	return package;
+	unguardf("%s", info->RelativeName);
+}
 
-	return Ar->CastTo<FFileArchive>();
+void UnPackage::ReleasePackageTables(UnPackage *Package)
+{
+	assert(Package->TablesOnly);
+	delete Package;
 }
-#endif
+
+/*-----------------------------------------------------------------------------
+	Package readers
+-----------------------------------------------------------------------------*/
+
+// Readers are not closed after loading objects, so file handles and decompression state of
+// compressed packages are reused by the next loading. Number of opened readers is limited,
+// least recently used readers are closed first.
+
+int UnPackage::MaxOpenReaders = 32;
 
 void UnPackage::SetupReader(int ExportIndex)
 {
 	guard(UnPackage::SetupReader);
 	// open loader if it is closed
-#if 0
-	FFileArchive* File = FindFileArchive(Loader);
-	assert(File);
-	if (!File->IsOpen()) File->Open();
-#else
-	if (!Loader->IsOpen()) Loader->Open();
-#endif
+	OpenReader();
+	ActiveReader = this;
+	LastUseTime = ++UseTimeCounter;
 	// setup for object
 	const FObjectExport &Exp = GetExport(ExportIndex);
 	SetStopper(Exp.SerialOffset + Exp.SerialSize);
@@ -2417,24 +2532,55 @@ void UnPackage::SetupReader(int ExportIndex)
 	unguard;
 }
 
+void UnPackage::OpenReader()
+{
+	guard(UnPackage::OpenReader);
+	int index = OpenReaders.FindItem(this);
+	if (index == OpenReaders.Num() - 1 && index >= 0 && Loader->IsOpen())
+		return;				// already most recently used one
+	if (index >= 0)
+	{
+		OpenReaders.RemoveAt(index);
+	}
+	else
+	{
+		// release least recently used readers
+		while (OpenReaders.Num() >= max(MaxOpenReaders, 1))
+		{
+			UnPackage* Victim = OpenReaders[0];
+			if (Victim == ActiveReader)
+			{
+				if (OpenReaders.Num() == 1) break;
+				Victim = OpenReaders[1];
+			}
+			Victim->CloseReader();
+		}
+	}
+	if (!Loader->IsOpen()) Loader->Open();
+	OpenReaders.Add(this);
+	unguard;
+}
+
+UnPackage* UnPackage::PinReader()
+{
+	guard(UnPackage::PinReader);
+	UnPackage* Prev = ActiveReader;
+	OpenReader();				// this will not close Prev
+	ActiveReader = this;
+	return Prev;
+	unguard;
+}
+
 void UnPackage::CloseReader()
 {
-#if 0
-	FFileArchive* File = FindFileArchive(Loader);
-	assert(File);
-	if (File->IsOpen()) File->Close();
-#else
+	OpenReaders.RemoveSingle(this);
 	Loader->Close();
-#endif
 }
 
 void UnPackage::CloseAllReaders()
 {
-	for (int i = 0; i < PackageMap.Num(); i++)
-	{
-		UnPackage* p = PackageMap[i];
-		p->CloseReader();
-	}
+	for (int i = OpenReaders.Num() - 1; i >= 0; i--)
+		OpenReaders[i]->CloseReader();
 }
 
 
@@ -2458,7 +2604,9 @@ FArchive& UnPackage::operator<<(FName &N)
 		}
 		else
 		{
-			N.Str = appStrdupPool(va("%s%d", GetName(N.Index), N.ExtraIndex-1));	// without "_" char
+			char buf[MAX_FNAME_LEN+16];
+			appSprintf(ARRAY_ARG(buf), "%s%d", GetName(N.Index), N.ExtraIndex-1);	// without "_" char
+			N.Str = appStrdupPool(buf);
 		}
 		return *this;
 	}
@@ -2511,7 +2659,10 @@ FArchive& UnPackage::operator<<(FName &N)
 	}
 	else
 	{
-		N.Str = appStrdupPool(va("%s_%d", GetName(N.Index), N.ExtraIndex-1));
+		// note: not using va() here, this code could be executed from worker threads
+		char buf[MAX_FNAME_LEN+16];
+		appSprintf(ARRAY_ARG(buf), "%s_%d", GetName(N.Index), N.ExtraIndex-1);
+		N.Str = appStrdupPool(buf);
 	}
 #else
 	// no modern engines compiled
@@ -2774,6 +2925,16 @@ UObject* UnPackage::CreateImport(int index)
 	FObjectImport &Imp = GetImport(index);
 	if (Imp.Missing) return NULL;	// error message already displayed for this entry
 
+	// Object of unknown class could not be created, so don't load its package: this could
+	// pull many packages in. Use class name from import table for this check.
+	if (!IsKnownClass(Imp.ClassName))
+	{
+		// the same message as CreateExport() displays when the package is loaded
+		appPrintf("WARNING: Unknown class \"%s\" for import \"%s\"\n", *Imp.ClassName, *Imp.ObjectName);
+		Imp.Missing = true;
+		return NULL;
+	}
+
 	// load package
 	const char *PackageName = GetObjectPackageName(Imp.PackageIndex);
 	UnPackage *Package = LoadPackage(PackageName);
@@ -2832,6 +2993,11 @@ UObject* UnPackage::CreateImport(int index)
 		return NULL;
 	}
 
+	// remember the reference, so objects of this package will be released together with the
+	// imported object
+	if (Package != this)
+		Package->ReferencingPackages.AddUnique(this);
+
 	// create object
 	return Package->CreateExport(ObjIndex);
 
@@ -2954,7 +3120,12 @@ const char *UnPackage::GetUncookedPackageName(int PackageIndex) const
 	Searching for package and maintaining package list
 -----------------------------------------------------------------------------*/
 
+THREAD_LOCAL int64	GPackageBytesRead = 0;
 TArray<UnPackage*>	UnPackage::PackageMap;
+int					UnPackage::UseTimeCounter = 0;
+size_t				UnPackage::FixedMemorySize = 0;
+TArray<UnPackage*>	UnPackage::OpenReaders;
+UnPackage*			UnPackage::ActiveReader = NULL;
 TArray<char*>		MissingPackages;
 
 UnPackage *UnPackage::LoadPackage(const char *Name, bool silent)
@@ -2973,11 +3144,15 @@ UnPackage *UnPackage::LoadPackage(const char *Name, bool silent)
 	{
 		// Check if package was already loaded.
 		if (info->Package)
+		{
+			info->Package->LastUseTime = ++UseTimeCounter;
 			return info->Package;
+		}
 		// Load the package.
 		UnPackage* package = new UnPackage(info->RelativeName, appCreateFileReader(info), silent);
 		// Cache pointer in CGameFileInfo so next time it will be found quickly.
 		const_cast<CGameFileInfo*>(info)->Package = package;
+		package->FileInfo = info;
 		return package;
 	}
 	else
@@ -2997,7 +3172,10 @@ UnPackage *UnPackage::LoadPackage(const char *Name, bool silent)
 		// "path/package.ext", "package.ext", "package"
 		for (i = 0; i < PackageMap.Num(); i++)
 			if (!stricmp(LocalName, PackageMap[i]->Filename))
+			{
+				PackageMap[i]->LastUseTime = ++UseTimeCounter;
 				return PackageMap[i];
+			}
 		// Try to load package.
 		if (appFileExists(Name))
 			return new UnPackage(Name, NULL, silent);
@@ -3011,3 +3189,55 @@ UnPackage *UnPackage::LoadPackage(const char *Name, bool silent)
 
 	unguardf("%s", Name);
 }
+
+bool UnPackage::HasLoadedObjects() const
+{
+	for (int i = 0; i < Summary.ExportCount; i++)
+		if (ExportTable[i].Object) return true;
+	return false;
+}
+
+static int CompareUseTime(UnPackage* const* P1, UnPackage* const* P2)
+{
+	return (*P1)->LastUseTime - (*P2)->LastUseTime;
+}
+
+int UnPackage::UnloadPackages(size_t MemoryLimit, const TArray<UnPackage*>* KeepPackages)
+{
+	guard(UnPackage::UnloadPackages);
+
+	if (GetReclaimableMemory() <= MemoryLimit) return 0;
+
+	TArray<UnPackage*> Candidates;
+	Candidates.ResizeTo(PackageMap.Num());
+	for (int i = 0; i < PackageMap.Num(); i++)
+	{
+		UnPackage* Package = PackageMap[i];
+		if (Package == ActiveReader) continue;
+		if (KeepPackages && KeepPackages->FindItem(Package) >= 0) continue;
+		if (Package->HasLoadedObjects()) continue;
+		Candidates.Add(Package);
+	}
+	Candidates.Sort(CompareUseTime);
+
+	int NumUnloaded = 0;
+	for (int i = 0; i < Candidates.Num() && GetReclaimableMemory() > MemoryLimit; i++)
+	{
+		UnPackage* Package = Candidates[i];
+		if (Package->FileInfo)
+			const_cast<CGameFileInfo*>(Package->FileInfo)->Package = NULL;
+		delete Package;
+		NumUnloaded++;
+	}
+	if (!PackageMap.Num())
+		FixedMemorySize = GTotalAllocationSize - appGetStrdupPoolSize();
+	return NumUnloaded;
+
+	unguard;
+}
+
+size_t UnPackage::GetReclaimableMemory()
+{
+	size_t Used = GTotalAllocationSize - appGetStrdupPoolSize();
+	return (Used > FixedMemorySize) ? Used - FixedMemorySize : 0;
+}
@@ -217,6 +217,11 @@ struct FObjectDepends
 #endif // UNREAL3
 
 
+// Amount of data read from all packages by the current thread (after decompression). Packages are
+// loaded from several threads, so the counter is per-thread: object metrics scopes measure reads
+// of their own thread only.
+extern THREAD_LOCAL int64 GPackageBytesRead;
+
 // In Unreal Engine class with similar functionality named "ULinkerLoad"
 class UnPackage : public FArchive
 {
@@ -225,6 +230,9 @@ public:
 	const char*				Filename;			// full name with path and extension
 	const char*				Name;				// short name
 	FArchive				*Loader;
+	const CGameFileInfo		*FileInfo;			// NULL when package is located outside of game directory
+	int						LastUseTime;		// used for unloading of least recently used packages
+	TArray<UnPackage*>		ReferencingPackages; // packages with loaded objects which reference objects of this package
 	// package header
 	FPackageFileSummary		Summary;
 	// tables
@@ -236,7 +244,7 @@ public:
 #endif
 
 protected:
-	UnPackage(const char *filename, FArchive *baseLoader = NULL, bool silent = false);
+	UnPackage(const char *filename, FArchive *baseLoader = NULL, bool silent = false, bool tablesOnly = false);
 	~UnPackage();
 
 public:
@@ -247,6 +255,25 @@ public:
 
 	static FArchive* CreateLoader(const char* filename, FArchive* baseLoader = NULL);
 
+	// Read package summary, name, import and export tables without registering the package, so
+	// this function could be called from worker threads. Returned package could not be used for
+	// loading objects, it should be released with ReleasePackageTables(). Note: files from the
+	// same virtual file system share a reader, so they should not be scanned in parallel.
+	static UnPackage *LoadPackageTables(const CGameFileInfo *info);
+	static void ReleasePackageTables(UnPackage *Package);
+
+	// Release packages, least recently used first, until reclaimable memory will fit MemoryLimit.
+	// Packages with loaded objects and packages from KeepPackages list are not released.
+	// Returns number of released packages.
+	static int UnloadPackages(size_t MemoryLimit, const TArray<UnPackage*>* KeepPackages = NULL);
+
+	// Memory which could be released by unloading packages and objects. Pooled strings (package
+	// names, name tables) and memory allocated before loading of the first package (game file
+	// system) are never released, so they are not counted.
+	static size_t GetReclaimableMemory();
+
+	bool HasLoadedObjects() const;
+
 	static const TArray<UnPackage*>& GetPackageMap()
 	{
 		return PackageMap;
@@ -255,11 +282,26 @@ public:
 	// Prepare for serialization of particular object. Will open a reader if it was
 	// closed before.
 	void SetupReader(int ExportIndex);
+	// Open the reader if it is closed, and mark it as most recently used. When there are too
+	// many opened readers, the least recently used one will be closed.
+	void OpenReader();
 	// Close reader when not needed anymore. Could be reopened again with SetupReader().
+	// Note: this will also release decompression buffers of compressed packages.
 	void CloseReader();
+	// Open the reader and protect it from closing, for reading data outside of object loading
+	// (deferred bulk data). Returns previously protected package, it should be passed to
+	// UnpinReader() when reading is complete.
+	UnPackage* PinReader();
+	static void UnpinReader(UnPackage* Prev)
+	{
+		ActiveReader = Prev;
+	}
 
 	static void CloseAllReaders();
 
+	// Maximal number of simultaneously opened package readers (file handles)
+	static int MaxOpenReaders;
+
 	const char* GetName(int index)
 	{
 		if (index < 0 || index >= Summary.NameCount)
@@ -347,6 +389,7 @@ public:
 #endif // UNREAL4
 	virtual void Serialize(void *data, int size)
 	{
+		GPackageBytesRead += size;
 		Loader->Serialize(data, size);
 	}
 	virtual void Seek(int Pos)
@@ -375,19 +418,31 @@ public:
 	}
 	virtual bool Open()
 	{
-		return Loader->Open();
+		OpenReader();
+		return true;
 	}
 	virtual void Close()
 	{
-		Loader->Close();
+		CloseReader();
 	}
 
 private:
 	void LoadNameTable();
+#if UNREAL4
+	bool LoadNameTable4();
+#endif
 	void LoadImportTable();
 	void LoadExportTable();
 
+	bool					TablesOnly;			// package was created with LoadPackageTables()
+
 	static TArray<UnPackage*> PackageMap;
+	static int				UseTimeCounter;
+	static size_t			FixedMemorySize;	// memory used when there were no loaded packages
+	static TArray<UnPackage*> OpenReaders;	// least recently used first
+	// Package which is used for loading an object now. It is never closed by OpenReader(): other
+	// packages could be created while the object is serialized.
+	static UnPackage*		ActiveReader;
 };
 
 #endif // __UNPACKAGE_H__
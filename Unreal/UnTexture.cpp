@@ -5,13 +5,17 @@
 #include "UnObject.h"
 #include "UnMaterial.h"
 #include "UnMaterial2.h"		// for UPalette
+#include "Profiler.h"
+#include "Threading.h"
+
+#include <emmintrin.h>			// SSE2, for XBox360 texture untiling
 
 #if SUPPORT_IPHONE
 #	include <PVRTDecompress.h>
 #endif
 
 #if SUPPORT_ANDROID
-#	include "libs/astc/astc_codec_internals.h"
+#	include "UnTextureASTC.h"
 #endif
 
 #include <detex.h>
@@ -99,6 +103,8 @@ byte *CTextureData::Decompress(int MipLevel)
 	if (!Mips.IsValidIndex(MipLevel))
 		return NULL;
 
+	PROFILE_SCOPE("DecodeTexture", OriginalFormatName);
+
 	const CMipMap& Mip = Mips[MipLevel];
 
 	// Get mip map data
@@ -107,6 +113,7 @@ byte *CTextureData::Decompress(int MipLevel)
 	const byte *Data = Mip.CompressedData;
 
 	int size = USize * VSize * 4;
+	PROFILE_SCOPE_BYTES(size);
 	byte *dst = new byte [size];
 
 #if 0
@@ -309,63 +316,8 @@ byte *CTextureData::Decompress(int MipLevel)
 	case TPF_ASTC_8x8:
 	case TPF_ASTC_10x10:
 	case TPF_ASTC_12x12:
-		{
-			static bool initialized = false;
-			if (!initialized)
-			{
-				build_quantization_mode_table();
-				initialized = true;
-			}
-			int blockDim = PixelFormatInfo[Format].BlockSizeX;
-			assert(PixelFormatInfo[Format].BlockSizeY == blockDim);
-			int xBlocks = (USize + blockDim - 1) / blockDim;
-			int yBlocks = (VSize + blockDim - 1) / blockDim;
-			const int xdim = blockDim, ydim = blockDim, zdim = 1, z = 0;
-			const astc_decode_mode decode_mode = DECODE_LDR;
-			static const swizzlepattern swz_decode = { 0, 1, 2, 3 };
-			imageblock pb;
-
-			astc_codec_image* img = allocate_image(8 /*bitness*/, USize, VSize, 1 /*zsize*/, 0);
-			initialize_image(img);
-
-			for (int y = 0; y < yBlocks; y++)
-			{
-				for (int x = 0; x < xBlocks; x++)
-				{
-					int offset = ((y * xBlocks) + x) * 16;
-					const byte* bp = Data + offset;
-					physical_compressed_block pcb = *(physical_compressed_block *) bp;
-					symbolic_compressed_block scb;
-					physical_to_symbolic(xdim, ydim, zdim, pcb, &scb);
-					decompress_symbolic_block(decode_mode, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, &scb, &pb);
-					write_imageblock(img, &pb, xdim, ydim, zdim, x * xdim, y * ydim, z * zdim, swz_decode);
-				}
-			}
-
-			memcpy(dst, img->imagedata8[0][0], size);
-
-			if (isNormalmap)
-			{
-				// UE4 drops blue channel for normal maps before encoding, restore it
-				byte *d = dst;
-				for (int i = 0; i < USize * VSize; i++)
-				{
-					byte u = d[0];
-					byte v = d[1];
-					assert(d[2] == 0);
-					float uf = u / 255.0f * 2 - 1;
-					float vf = v / 255.0f * 2 - 1;
-					float t  = 1.0f - uf * uf - vf * vf;
-					if (t >= 0)
-						d[2] = appFloor((t + 1.0f) * 127.5f);
-					else
-						d[2] = 255;
-					d += 4;
-				}
-			}
-
-			destroy_image(img);
-		}
+		// UE4 drops blue channel for normal maps before encoding, decoder will restore it
+		DecodeASTC(Data, USize, VSize, PixelFormatInfo[Format].BlockSizeX, PixelFormatInfo[Format].BlockSizeY, isNormalmap, dst);
 		return dst;
 #endif // SUPPORT_ANDROID
 
@@ -509,12 +461,141 @@ static void UntileXbox360Texture(const unsigned *src, unsigned *dst, int tiledWi
 	unguard;
 }
 
+// Tile maps: swizzled block index for every block of tiled image. Computing GetTiledOffset() is
+// slow, and textures (and mip levels) of the same size are very common, so maps are cached.
+// Cached maps are never released, so pointers to them could be used without holding the lock.
+
+#define MAX_TILE_MAP_CACHE		(64 << 20)			// memory limit for cached maps
+
+struct CXbox360TileMap
+{
+	int			BlockWidth;
+	int			BlockHeight;
+	int			LogBpb;
+	int			*Offsets;
+};
+
+static TArray<CXbox360TileMap> TileMapCache;
+static size_t TileMapCacheSize = 0;
+static CMutex TileMapLock;
+
+static int* BuildXbox360TileMap(int BlockWidth, int BlockHeight, int LogBpb)
+{
+	guard(BuildXbox360TileMap);
+
+	int NumBlocks = BlockWidth * BlockHeight;
+	int *Offsets = (int*)appMalloc(NumBlocks * sizeof(int));
+	int *p = Offsets;
+	for (int y = 0; y < BlockHeight; y++)
+	{
+		for (int x = 0; x < BlockWidth; x++)
+		{
+			unsigned swzAddr = GetTiledOffset(x, y, BlockWidth, LogBpb);
+			assert(swzAddr < NumBlocks);
+			*p++ = swzAddr;
+		}
+	}
+	return Offsets;
+
+	unguard;
+}
+
+// Returns tile map for tiled image of BlockWidth x BlockHeight blocks. When map couldn't be
+// cached, TempMap is set to allocated map, and it should be released by caller.
+static const int* GetXbox360TileMap(int BlockWidth, int BlockHeight, int LogBpb, int *&TempMap)
+{
+	guard(GetXbox360TileMap);
+
+	TempMap = NULL;
+	CScopeLock Lock(TileMapLock);
+
+	for (int i = 0; i < TileMapCache.Num(); i++)
+	{
+		const CXbox360TileMap &Map = TileMapCache[i];
+		if (Map.BlockWidth == BlockWidth && Map.BlockHeight == BlockHeight && Map.LogBpb == LogBpb)
+			return Map.Offsets;
+	}
+
+	int *Offsets = BuildXbox360TileMap(BlockWidth, BlockHeight, LogBpb);
+	size_t MapSize = BlockWidth * BlockHeight * sizeof(int);
+	if (TileMapCacheSize + MapSize > MAX_TILE_MAP_CACHE)
+	{
+		TempMap = Offsets;
+		return Offsets;
+	}
+	CXbox360TileMap *Map = new (TileMapCache) CXbox360TileMap;
+	Map->BlockWidth  = BlockWidth;
+	Map->BlockHeight = BlockHeight;
+	Map->LogBpb      = LogBpb;
+	Map->Offsets     = Offsets;
+	TileMapCacheSize += MapSize;
+	return Offsets;
+
+	unguard;
+}
+
+struct CUntileContext
+{
+	const byte	*Src;
+	byte		*Dst;
+	const int	*Map;						// tile map, pointing to 1st used block of the line
+	int			MapPitch;					// width of tiled image in blocks
+	int			BlockWidth;					// width of destination image in blocks
+	int			BytesPerBlock;
+	int			SwapSize;					// size of item for byte swapping, 1 = no swapping
+};
+
+// Swap bytes in 16-bit words
+static FORCEINLINE __m128i SwapWords(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static void UntileXbox360Line(int dy, CUntileContext &Ctx)
+{
+	const int *Map   = Ctx.Map + dy * Ctx.MapPitch;
+	const byte *Src  = Ctx.Src;
+	int BytesPerBlock = Ctx.BytesPerBlock;
+	int Width        = Ctx.BlockWidth;
+	byte *pDst       = Ctx.Dst + dy * Width * BytesPerBlock;
+
+	if (BytesPerBlock == 16 && Ctx.SwapSize == 2)
+	{
+		// DXT3, DXT5
+		for (int dx = 0; dx < Width; dx++, pDst += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(Src + Map[dx] * 16));
+			_mm_storeu_si128((__m128i*)pDst, SwapWords(v));
+		}
+	}
+	else if (BytesPerBlock == 8 && Ctx.SwapSize == 2)
+	{
+		// DXT1
+		for (int dx = 0; dx < Width; dx++, pDst += 8)
+		{
+			__m128i v = _mm_loadl_epi64((const __m128i*)(Src + Map[dx] * 8));
+			_mm_storel_epi64((__m128i*)pDst, SwapWords(v));
+		}
+	}
+	else
+	{
+		// uncompressed formats
+		for (int dx = 0; dx < Width; dx++, pDst += BytesPerBlock)
+		{
+			memcpy(pDst, Src + Map[dx] * BytesPerBlock, BytesPerBlock);
+			if (Ctx.SwapSize > 1)
+				appReverseBytes(pDst, BytesPerBlock / Ctx.SwapSize, Ctx.SwapSize);
+		}
+	}
+}
+
 // Untile compressed texture - it will remains compressed, but in PC format instead of XBox360.
-// This function also removes U alignment when originalWidth < tiledWidth
+// This function also removes U alignment when originalWidth < tiledWidth, and swaps bytes
+// in items of swapSize bytes.
 //!! Note: this function doesn't work well with non-square textures - UModel will not crash, but textures
 //!! will not appear correctly. Example (from Gears of War 3):
 //!!   umodel GearGame.xxx -game=gowj T_Ramp_Right_To_Left
-static void UntileCompressedXbox360Texture(const byte *src, byte *dst, int tiledWidth, int originalWidth, int tiledHeight, int originalHeight, int blockSizeX, int blockSizeY, int bytesPerBlock)
+static void UntileCompressedXbox360Texture(const byte *src, byte *dst, int tiledWidth, int originalWidth, int tiledHeight, int originalHeight, int blockSizeX, int blockSizeY, int bytesPerBlock, int swapSize)
 {
 	guard(UntileCompressedXbox360Texture);
 
@@ -548,23 +629,33 @@ static void UntileCompressedXbox360Texture(const byte *src, byte *dst, int tiled
 #endif
 	}
 
-	int numImageBlocks = tiledBlockWidth * tiledBlockHeight;	// used for verification
-
-	// iterate image blocks
-	for (int dy = 0; dy < originalBlockHeight; dy++)
+	// Map contains swizzled block index, which is (sy * tiledBlockWidth + sx), so it could be
+	// used for source block addressing directly.
+	int *TempMap;
+	const int *Map = GetXbox360TileMap(tiledBlockWidth, tiledBlockHeight, logBpp, TempMap);
+
+	CUntileContext Ctx;
+	Ctx.Src           = src;
+	Ctx.Dst           = dst;
+	Ctx.Map           = Map + sxOffset;
+	Ctx.MapPitch      = tiledBlockWidth;
+	Ctx.BlockWidth    = originalBlockWidth;
+	Ctx.BytesPerBlock = bytesPerBlock;
+	Ctx.SwapSize      = swapSize;
+
+	if (originalBlockWidth * originalBlockHeight >= 16384)
 	{
-		for (int dx = 0; dx < originalBlockWidth; dx++)
-		{
-			unsigned swzAddr = GetTiledOffset(dx + sxOffset, dy, tiledBlockWidth, logBpp);	// do once for whole block
-			assert(swzAddr < numImageBlocks);
-			int sy = swzAddr / tiledBlockWidth;
-			int sx = swzAddr % tiledBlockWidth;
-
-			byte       *pDst = dst + (dy * originalBlockWidth + dx) * bytesPerBlock;
-			const byte *pSrc = src + (sy * tiledBlockWidth    + sx) * bytesPerBlock;
-			memcpy(pDst, pSrc, bytesPerBlock);
-		}
+		// large image, process lines in parallel
+		appParallelFor(originalBlockHeight, UntileXbox360Line, Ctx);
+	}
+	else
+	{
+		for (int dy = 0; dy < originalBlockHeight; dy++)
+			UntileXbox360Line(dy, Ctx);
 	}
+
+	if (TempMap) appFree(TempMap);
+
 	unguard;
 }
 
@@ -643,21 +734,16 @@ bool CTextureData::DecodeXBox360(int MipLevel)
 		}
 	}
 
-	// untile and unalign
-	byte *buf = (byte*)appMalloc(Mip.DataSize);   	// older code: 'Mip.DataSize * 16'; perhaps should use Mip.USize * Mip.VSize * BytesPerPixel
-	UntileCompressedXbox360Texture(Mip.CompressedData, buf, USize1, Mip.USize, VSize1, Mip.VSize, Info.BlockSizeX, Info.BlockSizeY, Info.BytesPerBlock);
-
-	// swap bytes
+	// swap bytes: dwords for 32-bit formats, words for everything else
+	int SwapSize = 1;
 	if (Format == TPF_RGBA8 || Format == TPF_BGRA8)
-	{
-		// Swap dwords for 32-bit formats
-		appReverseBytes(buf, Mip.DataSize / 4, 4);
-	}
+		SwapSize = 4;
 	else if (Info.BytesPerBlock > 1)
-	{
-		// Swap words for everything else
-		appReverseBytes(buf, Mip.DataSize / 2, 2);
-	}
+		SwapSize = 2;
+
+	// untile, unalign and swap bytes
+	byte *buf = (byte*)appMalloc(Mip.DataSize);   	// older code: 'Mip.DataSize * 16'; perhaps should use Mip.USize * Mip.VSize * BytesPerPixel
+	UntileCompressedXbox360Texture(Mip.CompressedData, buf, USize1, Mip.USize, VSize1, Mip.VSize, Info.BlockSizeX, Info.BlockSizeY, Info.BytesPerBlock, SwapSize);
 
 	// release old CompressedData
 	Mip.ReleaseData();
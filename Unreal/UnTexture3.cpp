@@ -194,41 +194,6 @@ skip_rest:
 
 #if DCU_ONLINE
 
-// string hashing
-static unsigned GCRCTable[256];
-
-static void BuildCRCTable()
-{
-	assert(!GCRCTable[0]);
-    for (int i = 0; i < 256; i++)
-	{
-		unsigned hash = i << 24;
-		for (int j = 0; j < 8; j++)
-		{
-			if (hash & 0x80000000)
-				hash = (hash << 1) ^ 0x04C11DB7;
-			else
-				hash <<= 1;
-		}
-		GCRCTable[i] = hash;
-	}
-}
-
-static unsigned appStrihash(const char *str)
-{
-	if (!GCRCTable[0]) BuildCRCTable();
-
-	unsigned Hash = 0;
-	while (*str)
-	{
-		byte B = toupper(*str++);
-		Hash   = ((Hash >> 8) & 0x00FFFFFF) ^ GCRCTable[(Hash ^ B) & 0x000000FF];
-		B      = 0;		// simulate unicode
-		Hash   = ((Hash >> 8) & 0x00FFFFFF) ^ GCRCTable[(Hash ^ B) & 0x000000FF];
-	}
-	return Hash;
-}
-
 // UTextureFileCacheRemap class
 
 struct FTfcRemapEntry_DCU
@@ -769,7 +734,7 @@ void UTexture2D::ReleaseTextureData() const
 	{
 		const FTexture2DMipMap &Mip = (*MipsArray)[n];
 		const FByteBulkData &Bulk = Mip.Data;
-		if (Bulk.BulkData && (Bulk.BulkDataFlags & BULKDATA_StoreInSeparateFile))
+		if (Bulk.BulkData && ((Bulk.BulkDataFlags & BULKDATA_StoreInSeparateFile) || Bulk.AttachedAr))
 			const_cast<FByteBulkData*>(&Bulk)->ReleaseData();
 	}
 
@@ -921,7 +886,7 @@ bool UTexture2D::GetTextureData(CTextureData &TexData) const
 			// reference: DemoPlayerSkins.utx/DemoSkeleton have null-sized 1st 2 mips
 			const FTexture2DMipMap &Mip = (*MipsArray)[mipLevel];
 			const FByteBulkData &Bulk = Mip.Data;
-			if (!Mip.Data.BulkData)
+			if (!Bulk.GetData())
 			{
 				// check for external bulk
 				//?? Separate this function ?
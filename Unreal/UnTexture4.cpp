@@ -127,7 +127,7 @@ void UTexture2D::Serialize4(FArchive& Ar)
 			Ar << PixelFormatEnum;
 		}
 	}
-	else if (SourceArt.BulkData != NULL)
+	else if (SourceArt.HasData())
 	{
 		guard(UTexture4::LoadSourceData);
 
@@ -160,7 +160,7 @@ void UTexture2D::Serialize4(FArchive& Ar)
 			int MipOffset = 0;
 
 			Mips.AddDefaulted(Source.NumMips);
-			const byte* SourceData = SourceArt.BulkData;
+			const byte* SourceData = SourceArt.GetData();
 			int SourceDataSize = SourceArt.ElementCount;
 //			appPrintf("SourceDataSize = %X\n", SourceDataSize);
 			for (int MipIndex = 0; MipIndex < Source.NumMips; MipIndex++, MipSizeX >>= 1, MipSizeY >>= 1)
@@ -177,9 +177,10 @@ void UTexture2D::Serialize4(FArchive& Ar)
 				assert(MipOffset + MipDataSize <= SourceDataSize);
 				Mip.Data.BulkData = (byte*)appMalloc(MipDataSize);
 				Mip.Data.ElementCount = MipDataSize;
-				memcpy(Mip.Data.BulkData, SourceArt.BulkData + MipOffset, MipDataSize);
+				memcpy(Mip.Data.BulkData, SourceData + MipOffset, MipDataSize);
 				MipOffset += MipDataSize;
 			}
+			SourceArt.ReleaseData();
 			appPrintf("  Loading SourceArt: %s, NumMips=%d, Slices=%d, PNGCompressed=%d\n", FormatName, Source.NumMips, Source.NumSlices, Source.bPNGCompressed);
 		}
 		else
@@ -204,8 +205,10 @@ void UMaterial3::ScanForTextures()
 	{
 		const FObjectImport &Imp = Package->GetImport(i);
 //		printf("--> import %d (%s)\n", i, *Imp.ClassName);
-		if (stricmp(Imp.ClassName, "Class") == 0 || stricmp(Imp.ClassName, "Package") == 0)
-			continue;		// avoid spamming to log
+		// check class using import table, so packages with non-texture objects will not be loaded
+		const CTypeInfo* Type = FindClassType(Imp.ClassName);
+		if (!Type || !Type->IsA("Texture3"))
+			continue;
 		UObject* obj = Package->CreateImport(i);
 //		if (obj) printf("--> %s (%s)\n", obj->Name, obj->GetClassName());
 		if (obj && obj->IsA("Texture3"))
@@ -0,0 +1,1014 @@
+#include "Core.h"
+#include "UnCore.h"
+
+#if SUPPORT_ANDROID
+
+#include "UnTextureASTC.h"
+#include "Threading.h"
+
+/*-----------------------------------------------------------------------------
+	ASTC LDR decoder
+-----------------------------------------------------------------------------*/
+
+// Decoder follows ASTC specification and ARM reference decoder (libs/astc) bit-exactly, but
+// works with integers only, decodes blocks directly into destination RGBA8 image and uses
+// precomputed tables for everything which depends on block size only: block modes, weight
+// infill and partition assignment.
+
+#define ASTC_MAX_BLOCK_SIZE		12
+#define ASTC_MAX_TEXELS			(ASTC_MAX_BLOCK_SIZE * ASTC_MAX_BLOCK_SIZE)
+#define ASTC_MAX_WEIGHTS		64
+#define ASTC_MIN_WEIGHT_BITS	24
+#define ASTC_MAX_WEIGHT_BITS	96
+#define ASTC_NUM_BLOCK_MODES	2048
+#define ASTC_NUM_SEEDS			1024
+
+// Minimal number of blocks in texture for multithreaded decoding
+#define ASTC_PARALLEL_BLOCKS	1024
+
+
+/*-----------------------------------------------------------------------------
+	Global tables
+-----------------------------------------------------------------------------*/
+
+// Number of bits and presence of trit or quint for every quantization level
+static const byte ISEBits[21]   = { 1, 0, 2, 0, 1, 3, 1, 2, 4, 2, 3, 5, 3, 4, 6, 4, 5, 7, 5, 6, 8 };
+static const byte ISETrits[21]  = { 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0 };
+static const byte ISEQuints[21] = { 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0 };
+
+static byte TritsOfInteger[256][5];
+static byte QuintsOfInteger[128][3];
+static byte ColorUnquantize[21][256];			// levels 0..3 are not allowed for colors
+static byte WeightUnquantize[12][32];
+static signed char ColorQuantLevel[10][128];	// [NumValues/2][NumBits], -1 = not enough bits
+static byte Unorm16ToByte[65536];
+static byte NormalZ[256 * 256];					// [X * 256 + Y]
+
+static int ISEBitCount(int Count, int Level)
+{
+	int Bits = Count * ISEBits[Level];
+	if (ISETrits[Level])  Bits += (8 * Count + 4) / 5;
+	if (ISEQuints[Level]) Bits += (7 * Count + 2) / 3;
+	return Bits;
+}
+
+// Compute 'B' value of unquantization procedure. Pattern is a bit string from ASTC specification:
+// '0' is zero bit, 'a'..'f' are bits of quantized value.
+static int UnquantizePattern(const char *Pattern, int Value)
+{
+	int r = 0;
+	for (const char *s = Pattern; *s; s++)
+	{
+		r <<= 1;
+		if (*s != '0') r |= (Value >> (*s - 'a')) & 1;
+	}
+	return r;
+}
+
+// Replicate Value of NumBits bits to DstBits bits
+static int ReplicateBits(int Value, int NumBits, int DstBits)
+{
+	int r = 0;
+	for (int Shift = DstBits - NumBits; Shift > -NumBits; Shift -= NumBits)
+		r |= (Shift >= 0) ? Value << Shift : Value >> -Shift;
+	return r;
+}
+
+static void BuildIntegerSequenceTables()
+{
+	int i;
+	for (i = 0; i < 256; i++)
+	{
+		byte *t = TritsOfInteger[i];
+		int C;
+		if (((i >> 2) & 7) == 7)
+		{
+			C = (((i >> 5) & 7) << 2) | (i & 3);
+			t[4] = t[3] = 2;
+		}
+		else
+		{
+			C = i & 0x1F;
+			if (((i >> 5) & 3) == 3)
+			{
+				t[4] = 2;
+				t[3] = (i >> 7) & 1;
+			}
+			else
+			{
+				t[4] = (i >> 7) & 1;
+				t[3] = (i >> 5) & 3;
+			}
+		}
+		if ((C & 3) == 3)
+		{
+			t[2] = 2;
+			t[1] = (C >> 4) & 1;
+			t[0] = (((C >> 3) & 1) << 1) | ((C >> 2) & ~(C >> 3) & 1);
+		}
+		else if (((C >> 2) & 3) == 3)
+		{
+			t[2] = 2;
+			t[1] = 2;
+			t[0] = C & 3;
+		}
+		else
+		{
+			t[2] = (C >> 4) & 1;
+			t[1] = (C >> 2) & 3;
+			t[0] = (((C >> 1) & 1) << 1) | (C & ~(C >> 1) & 1);
+		}
+	}
+
+	for (i = 0; i < 128; i++)
+	{
+		byte *q = QuintsOfInteger[i];
+		if (((i >> 1) & 3) == 3 && ((i >> 5) & 3) == 0)
+		{
+			q[2] = ((i & 1) << 2) | (((i >> 4) & ~i & 1) << 1) | ((i >> 3) & ~i & 1);
+			q[1] = q[0] = 4;
+		}
+		else
+		{
+			int C;
+			if (((i >> 1) & 3) == 3)
+			{
+				q[2] = 4;
+				C = (((i >> 3) & 3) << 3) | (((~i >> 5) & 3) << 1) | (i & 1);
+			}
+			else
+			{
+				q[2] = (i >> 5) & 3;
+				C = i & 0x1F;
+			}
+			if ((C & 7) == 5)
+			{
+				q[1] = 4;
+				q[0] = (C >> 3) & 3;
+			}
+			else
+			{
+				q[1] = (C >> 3) & 3;
+				q[0] = C & 7;
+			}
+		}
+	}
+}
+
+static void BuildUnquantizeTables()
+{
+	// Patterns and 'C' values for trit and quint encodings with 1..6 bits
+	static const char *ColorTritB[6]  = { "000000000", "b000b0bb0", "cb000cbcb", "dcb000dcb", "edcb000ed", "fedcb000f" };
+	static const int   ColorTritC[6]  = { 204, 93, 44, 22, 11, 5 };
+	static const char *ColorQuintB[5] = { "000000000", "b0000bb00", "cb0000cbc", "dcb0000dc", "edcb0000e" };
+	static const int   ColorQuintC[5] = { 113, 54, 26, 13, 6 };
+	static const char *WeightTritB[3]  = { "0000000", "b000b0b", "cb000cb" };
+	static const int   WeightTritC[3]  = { 50, 23, 11 };
+	static const char *WeightQuintB[2] = { "0000000", "b0000b0" };
+	static const int   WeightQuintC[2] = { 28, 13 };
+
+	int Level, v;
+	for (Level = 4; Level < 21; Level++)
+	{
+		int Bits = ISEBits[Level];
+		int NumValues = (1 << Bits) * (ISETrits[Level] ? 3 : ISEQuints[Level] ? 5 : 1);
+		for (v = 0; v < NumValues; v++)
+		{
+			if (!ISETrits[Level] && !ISEQuints[Level])
+			{
+				ColorUnquantize[Level][v] = ReplicateBits(v, Bits, 8);
+				continue;
+			}
+			int A = (v & 1) ? 0x1FF : 0;
+			int B = ISETrits[Level] ? UnquantizePattern(ColorTritB[Bits-1], v) : UnquantizePattern(ColorQuintB[Bits-1], v);
+			int C = ISETrits[Level] ? ColorTritC[Bits-1] : ColorQuintC[Bits-1];
+			int T = ((v >> Bits) * C + B) ^ A;
+			ColorUnquantize[Level][v] = (A & 0x80) | (T >> 2);
+		}
+	}
+
+	for (Level = 0; Level < 12; Level++)
+	{
+		int Bits = ISEBits[Level];
+		int NumValues = (1 << Bits) * (ISETrits[Level] ? 3 : ISEQuints[Level] ? 5 : 1);
+		for (v = 0; v < NumValues; v++)
+		{
+			int T;
+			if (!ISETrits[Level] && !ISEQuints[Level])
+			{
+				T = ReplicateBits(v, Bits, 6);
+			}
+			else if (Bits == 0)
+			{
+				// values are already in 0..64 range
+				WeightUnquantize[Level][v] = v * (ISETrits[Level] ? 32 : 16);
+				continue;
+			}
+			else
+			{
+				int A = (v & 1) ? 0x7F : 0;
+				int B = ISETrits[Level] ? UnquantizePattern(WeightTritB[Bits-1], v) : UnquantizePattern(WeightQuintB[Bits-1], v);
+				int C = ISETrits[Level] ? WeightTritC[Bits-1] : WeightQuintC[Bits-1];
+				T = ((v >> Bits) * C + B) ^ A;
+				T = (A & 0x20) | (T >> 2);
+			}
+			if (T > 32) T++;
+			WeightUnquantize[Level][v] = T;
+		}
+	}
+
+	// Highest color quantization level which fits into the available number of bits
+	for (int NumPairs = 1; NumPairs < 10; NumPairs++)
+	{
+		for (int Bits = 0; Bits < 128; Bits++)
+		{
+			int Found = -1;
+			for (Level = 0; Level < 21; Level++)
+				if (ISEBitCount(NumPairs * 2, Level) <= Bits) Found = Level;
+			ColorQuantLevel[NumPairs][Bits] = Found;
+		}
+	}
+}
+
+static void BuildOutputTables()
+{
+	// Reference decoder converts interpolated 16-bit color to half-float (truncating it to 11
+	// significant bits), then to float, then rounds it to 8 bits.
+	for (int i = 0; i < 65535; i++)
+	{
+		int v = i;
+		if (v >= 2048)
+		{
+			int Shift = 0;
+			while ((v >> Shift) >= 2048) Shift++;
+			v &= ~((1 << Shift) - 1);
+		}
+		Unorm16ToByte[i] = (v * 255 + 32768) >> 16;
+	}
+	Unorm16ToByte[65535] = 255;
+
+	for (int u = 0; u < 256; u++)
+	{
+		for (int v = 0; v < 256; v++)
+		{
+			float uf = u / 255.0f * 2 - 1;
+			float vf = v / 255.0f * 2 - 1;
+			float t  = 1.0f - uf * uf - vf * vf;
+			NormalZ[u * 256 + v] = (t >= 0) ? appFloor((t + 1.0f) * 127.5f) : 255;
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------------
+	Block size dependent tables
+-----------------------------------------------------------------------------*/
+
+struct CASTCBlockMode
+{
+	byte		XWeights;					// 0 for reserved or invalid block mode
+	byte		YWeights;
+	byte		DualPlane;
+	byte		QuantLevel;
+	byte		WeightBits;
+};
+
+// Weight infill for a single texel: weighted sum of up to 4 grid weights
+struct CASTCTexelWeights
+{
+	byte		Index[4];
+	byte		Factor[4];
+};
+
+struct CASTCBlockContext
+{
+	int			BlockSizeX;
+	int			BlockSizeY;
+	CASTCBlockMode Modes[ASTC_NUM_BLOCK_MODES];
+	CASTCTexelWeights *Infill[ASTC_MAX_BLOCK_SIZE+1][ASTC_MAX_BLOCK_SIZE+1];	// [YWeights][XWeights]
+	byte		*Partitions;				// [PartitionCount-2][Seed][Texel]
+};
+
+static TArray<CASTCBlockContext*> ASTCContextCache;
+static CMutex ASTCContextLock;
+
+static bool DecodeBlockMode(int Mode, int BlockSizeX, int BlockSizeY, CASTCBlockMode &Info)
+{
+	int BaseQuant = (Mode >> 4) & 1;
+	int H = (Mode >> 9) & 1;
+	int D = (Mode >> 10) & 1;
+	int A = (Mode >> 5) & 3;
+	int N = 0, M = 0;
+
+	if (Mode & 3)
+	{
+		BaseQuant |= (Mode & 3) << 1;
+		int B = (Mode >> 7) & 3;
+		switch ((Mode >> 2) & 3)
+		{
+		case 0:
+			N = B + 4; M = A + 2;
+			break;
+		case 1:
+			N = B + 8; M = A + 2;
+			break;
+		case 2:
+			N = A + 2; M = B + 8;
+			break;
+		case 3:
+			B &= 1;
+			if (Mode & 0x100)
+			{
+				N = B + 2; M = A + 2;
+			}
+			else
+			{
+				N = A + 2; M = B + 6;
+			}
+			break;
+		}
+	}
+	else
+	{
+		BaseQuant |= ((Mode >> 2) & 3) << 1;
+		if (((Mode >> 2) & 3) == 0)
+			return false;
+		int B = (Mode >> 9) & 3;
+		switch ((Mode >> 7) & 3)
+		{
+		case 0:
+			N = 12; M = A + 2;
+			break;
+		case 1:
+			N = A + 2; M = 12;
+			break;
+		case 2:
+			N = A + 6; M = B + 6;
+			D = H = 0;
+			break;
+		case 3:
+			if (A == 0)
+			{
+				N = 6; M = 10;
+			}
+			else if (A == 1)
+			{
+				N = 10; M = 6;
+			}
+			else
+			{
+				return false;
+			}
+			break;
+		}
+	}
+
+	int WeightCount = N * M * (D + 1);
+	int QuantLevel = (BaseQuant - 2) + 6 * H;
+	int WeightBits = ISEBitCount(WeightCount, QuantLevel);
+	if (WeightCount > ASTC_MAX_WEIGHTS || WeightBits < ASTC_MIN_WEIGHT_BITS || WeightBits > ASTC_MAX_WEIGHT_BITS)
+		return false;
+	// weight grid can't be larger than block
+	if (N > BlockSizeX || M > BlockSizeY)
+		return false;
+
+	Info.XWeights   = N;
+	Info.YWeights   = M;
+	Info.DualPlane  = D;
+	Info.QuantLevel = QuantLevel;
+	Info.WeightBits = WeightBits;
+	return true;
+}
+
+static CASTCTexelWeights* BuildInfill(int BlockSizeX, int BlockSizeY, int XWeights, int YWeights)
+{
+	CASTCTexelWeights *Infill = new CASTCTexelWeights[BlockSizeX * BlockSizeY];
+	CASTCTexelWeights *p = Infill;
+	for (int y = 0; y < BlockSizeY; y++)
+	{
+		for (int x = 0; x < BlockSizeX; x++, p++)
+		{
+			int wx = (((1024 + BlockSizeX / 2) / (BlockSizeX - 1)) * x * (XWeights - 1) + 32) >> 6;
+			int wy = (((1024 + BlockSizeY / 2) / (BlockSizeY - 1)) * y * (YWeights - 1) + 32) >> 6;
+			int fx = wx & 0xF;
+			int fy = wy & 0xF;
+			int Index = (wx >> 4) + (wy >> 4) * XWeights;
+			int Factor3 = (fx * fy + 8) >> 4;
+			p->Index[0]  = Index;
+			p->Index[1]  = Index + 1;
+			p->Index[2]  = Index + XWeights;
+			p->Index[3]  = Index + XWeights + 1;
+			p->Factor[0] = 16 - fx - fy + Factor3;
+			p->Factor[1] = fx - Factor3;
+			p->Factor[2] = fy - Factor3;
+			p->Factor[3] = Factor3;
+			// unused weights may point outside of the grid
+			for (int i = 1; i < 4; i++)
+				if (!p->Factor[i]) p->Index[i] = Index;
+		}
+	}
+	return Infill;
+}
+
+static uint32 PartitionHash(uint32 v)
+{
+	v ^= v >> 15;
+	v *= 0xEEDE0891;
+	v ^= v >> 5;
+	v += v << 16;
+	v ^= v >> 7;
+	v ^= v >> 3;
+	v ^= v << 6;
+	v ^= v >> 17;
+	return v;
+}
+
+static int SelectPartition(int Seed, int x, int y, int PartitionCount, bool SmallBlock)
+{
+	if (SmallBlock)
+	{
+		x <<= 1;
+		y <<= 1;
+	}
+	Seed += (PartitionCount - 1) * 1024;
+	uint32 rnum = PartitionHash(Seed);
+
+	byte s[8];
+	for (int i = 0; i < 8; i++)
+	{
+		byte v = (rnum >> (i * 4)) & 0xF;
+		s[i] = v * v;
+	}
+
+	int sh1, sh2;
+	if (Seed & 1)
+	{
+		sh1 = (Seed & 2) ? 4 : 5;
+		sh2 = (PartitionCount == 3) ? 6 : 5;
+	}
+	else
+	{
+		sh1 = (PartitionCount == 3) ? 6 : 5;
+		sh2 = (Seed & 2) ? 4 : 5;
+	}
+
+	// 2D blocks: z = 0, so seeds 9..12 are not used
+	int a = (((s[0] >> sh1) * x + (s[1] >> sh2) * y) + (rnum >> 14)) & 0x3F;
+	int b = (((s[2] >> sh1) * x + (s[3] >> sh2) * y) + (rnum >> 10)) & 0x3F;
+	int c = (((s[4] >> sh1) * x + (s[5] >> sh2) * y) + (rnum >> 6))  & 0x3F;
+	int d = (((s[6] >> sh1) * x + (s[7] >> sh2) * y) + (rnum >> 2))  & 0x3F;
+
+	if (PartitionCount <= 3) d = 0;
+	if (PartitionCount <= 2) c = 0;
+
+	if (a >= b && a >= c && a >= d)
+		return 0;
+	else if (b >= c && b >= d)
+		return 1;
+	else if (c >= d)
+		return 2;
+	return 3;
+}
+
+static CASTCBlockContext* BuildBlockContext(int BlockSizeX, int BlockSizeY)
+{
+	guard(BuildBlockContext);
+
+	CASTCBlockContext *Ctx = new CASTCBlockContext;
+	memset(Ctx, 0, sizeof(CASTCBlockContext));
+	Ctx->BlockSizeX = BlockSizeX;
+	Ctx->BlockSizeY = BlockSizeY;
+
+	for (int Mode = 0; Mode < ASTC_NUM_BLOCK_MODES; Mode++)
+	{
+		CASTCBlockMode &Info = Ctx->Modes[Mode];
+		if (!DecodeBlockMode(Mode, BlockSizeX, BlockSizeY, Info))
+			continue;
+		CASTCTexelWeights *&Infill = Ctx->Infill[Info.YWeights][Info.XWeights];
+		if (!Infill)
+			Infill = BuildInfill(BlockSizeX, BlockSizeY, Info.XWeights, Info.YWeights);
+	}
+
+	int NumTexels = BlockSizeX * BlockSizeY;
+	bool SmallBlock = NumTexels < 32;
+	Ctx->Partitions = new byte[3 * ASTC_NUM_SEEDS * NumTexels];
+	byte *p = Ctx->Partitions;
+	for (int PartitionCount = 2; PartitionCount <= 4; PartitionCount++)
+		for (int Seed = 0; Seed < ASTC_NUM_SEEDS; Seed++)
+			for (int y = 0; y < BlockSizeY; y++)
+				for (int x = 0; x < BlockSizeX; x++)
+					*p++ = SelectPartition(Seed, x, y, PartitionCount, SmallBlock);
+
+	return Ctx;
+
+	unguard;
+}
+
+static const CASTCBlockContext* GetBlockContext(int BlockSizeX, int BlockSizeY)
+{
+	guard(GetBlockContext);
+
+	CScopeLock Lock(ASTCContextLock);
+
+	if (!ASTCContextCache.Num())
+	{
+		BuildIntegerSequenceTables();
+		BuildUnquantizeTables();
+		BuildOutputTables();
+	}
+
+	for (int i = 0; i < ASTCContextCache.Num(); i++)
+	{
+		const CASTCBlockContext *Ctx = ASTCContextCache[i];
+		if (Ctx->BlockSizeX == BlockSizeX && Ctx->BlockSizeY == BlockSizeY)
+			return Ctx;
+	}
+
+	CASTCBlockContext *Ctx = BuildBlockContext(BlockSizeX, BlockSizeY);
+	ASTCContextCache.Add(Ctx);
+	return Ctx;
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Block decoding
+-----------------------------------------------------------------------------*/
+
+static FORCEINLINE int ReadBits(const uint64 *Bits, int Offset, int Count)
+{
+	uint64 v;
+	if (Offset < 64)
+	{
+		v = Bits[0] >> Offset;
+		if (Offset) v |= Bits[1] << (64 - Offset);
+	}
+	else if (Offset < 128)
+	{
+		v = Bits[1] >> (Offset - 64);
+	}
+	else
+	{
+		v = 0;
+	}
+	return (int)v & ((1 << Count) - 1);
+}
+
+static FORCEINLINE uint64 ReverseBits64(uint64 v)
+{
+	v = ((v >> 1)  & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+	v = ((v >> 2)  & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+	v = ((v >> 4)  & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+	v = ((v >> 8)  & 0x00FF00FF00FF00FFull) | ((v & 0x00FF00FF00FF00FFull) << 8);
+	v = ((v >> 16) & 0x0000FFFF0000FFFFull) | ((v & 0x0000FFFF0000FFFFull) << 16);
+	return (v >> 32) | (v << 32);
+}
+
+// Decode integer sequence of Count values starting at bit Offset
+static void DecodeIntegerSequence(const uint64 *Bits, int Offset, int Count, int Level, byte *Out)
+{
+	int NumBits = ISEBits[Level];
+	if (ISETrits[Level])
+	{
+		static const int TritBits[5] = { 2, 2, 1, 2, 1 };
+		for (int i = 0; i < Count; i += 5)
+		{
+			int Low[5], T = 0, Shift = 0;
+			int n = min(Count - i, 5);
+			for (int j = 0; j < n; j++)
+			{
+				Low[j] = ReadBits(Bits, Offset, NumBits);
+				Offset += NumBits;
+				T |= ReadBits(Bits, Offset, TritBits[j]) << Shift;
+				Offset += TritBits[j];
+				Shift  += TritBits[j];
+			}
+			const byte *Trits = TritsOfInteger[T];
+			for (int j = 0; j < n; j++)
+				Out[i + j] = Low[j] | (Trits[j] << NumBits);
+		}
+	}
+	else if (ISEQuints[Level])
+	{
+		static const int QuintBits[3] = { 3, 2, 2 };
+		for (int i = 0; i < Count; i += 3)
+		{
+			int Low[3], Q = 0, Shift = 0;
+			int n = min(Count - i, 3);
+			for (int j = 0; j < n; j++)
+			{
+				Low[j] = ReadBits(Bits, Offset, NumBits);
+				Offset += NumBits;
+				Q |= ReadBits(Bits, Offset, QuintBits[j]) << Shift;
+				Offset += QuintBits[j];
+				Shift  += QuintBits[j];
+			}
+			const byte *Quints = QuintsOfInteger[Q];
+			for (int j = 0; j < n; j++)
+				Out[i + j] = Low[j] | (Quints[j] << NumBits);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < Count; i++, Offset += NumBits)
+			Out[i] = ReadBits(Bits, Offset, NumBits);
+	}
+}
+
+static FORCEINLINE int Clamp255(int v)
+{
+	return (v < 0) ? 0 : (v > 255) ? 255 : v;
+}
+
+// Transfer precision from the second value to the first one, used by "base+offset" formats
+static FORCEINLINE void BitTransferSigned(int &a, int &b)
+{
+	a |= (b & 0x80) << 1;
+	b &= 0x7F;
+	if (b & 0x40) b -= 0x80;
+	a >>= 1;
+	b >>= 1;
+}
+
+// Unpack LDR endpoints from unquantized color values. Returns false for HDR formats, which
+// are not supported in LDR mode.
+static bool UnpackEndpoints(int Format, const int *v, int *E0, int *E1)
+{
+	switch (Format)
+	{
+	case 0:		// luminance, direct
+		E0[0] = E0[1] = E0[2] = v[0]; E0[3] = 255;
+		E1[0] = E1[1] = E1[2] = v[1]; E1[3] = 255;
+		break;
+
+	case 1:		// luminance, base+offset
+		{
+			int l0 = (v[0] >> 2) | (v[1] & 0xC0);
+			int l1 = min(l0 + (v[1] & 0x3F), 255);
+			E0[0] = E0[1] = E0[2] = l0; E0[3] = 255;
+			E1[0] = E1[1] = E1[2] = l1; E1[3] = 255;
+		}
+		break;
+
+	case 4:		// luminance+alpha, direct
+		E0[0] = E0[1] = E0[2] = v[0]; E0[3] = v[2];
+		E1[0] = E1[1] = E1[2] = v[1]; E1[3] = v[3];
+		break;
+
+	case 5:		// luminance+alpha, base+offset
+		{
+			int l0 = v[0], l1 = v[1], a0 = v[2], a1 = v[3];
+			BitTransferSigned(l0, l1);
+			BitTransferSigned(a0, a1);
+			l1 = Clamp255(l0 + l1);
+			a1 = Clamp255(a0 + a1);
+			E0[0] = E0[1] = E0[2] = l0; E0[3] = a0;
+			E1[0] = E1[1] = E1[2] = l1; E1[3] = a1;
+		}
+		break;
+
+	case 6:		// RGB, base+scale
+	case 10:	// RGB, base+scale, plus 2 alpha values
+		E1[0] = v[0]; E1[1] = v[1]; E1[2] = v[2]; E1[3] = 255;
+		E0[0] = (v[0] * v[3]) >> 8;
+		E0[1] = (v[1] * v[3]) >> 8;
+		E0[2] = (v[2] * v[3]) >> 8;
+		E0[3] = 255;
+		if (Format == 10)
+		{
+			E0[3] = v[4];
+			E1[3] = v[5];
+		}
+		break;
+
+	case 8:		// RGB, direct
+	case 12:	// RGBA, direct
+		{
+			bool Swap = (v[0] + v[2] + v[4] > v[1] + v[3] + v[5]);
+			if (Swap)
+			{
+				// blue contraction
+				E0[0] = (v[1] + v[5]) >> 1; E0[1] = (v[3] + v[5]) >> 1; E0[2] = v[5];
+				E1[0] = (v[0] + v[4]) >> 1; E1[1] = (v[2] + v[4]) >> 1; E1[2] = v[4];
+			}
+			else
+			{
+				E0[0] = v[0]; E0[1] = v[2]; E0[2] = v[4];
+				E1[0] = v[1]; E1[1] = v[3]; E1[2] = v[5];
+			}
+			E0[3] = E1[3] = 255;
+			if (Format == 12)
+			{
+				E0[3] = Swap ? v[7] : v[6];
+				E1[3] = Swap ? v[6] : v[7];
+			}
+		}
+		break;
+
+	case 9:		// RGB, base+offset
+	case 13:	// RGBA, base+offset
+		{
+			int r0 = v[0], r1 = v[1], g0 = v[2], g1 = v[3], b0 = v[4], b1 = v[5];
+			BitTransferSigned(r0, r1);
+			BitTransferSigned(g0, g1);
+			BitTransferSigned(b0, b1);
+			bool Swap = (r1 + g1 + b1 < 0);
+			r1 += r0;
+			g1 += g0;
+			b1 += b0;
+			if (Swap)
+			{
+				// blue contraction
+				E0[0] = Clamp255((r1 + b1) >> 1); E0[1] = Clamp255((g1 + b1) >> 1); E0[2] = Clamp255(b1);
+				E1[0] = Clamp255((r0 + b0) >> 1); E1[1] = Clamp255((g0 + b0) >> 1); E1[2] = Clamp255(b0);
+			}
+			else
+			{
+				E0[0] = Clamp255(r0); E0[1] = Clamp255(g0); E0[2] = Clamp255(b0);
+				E1[0] = Clamp255(r1); E1[1] = Clamp255(g1); E1[2] = Clamp255(b1);
+			}
+			E0[3] = E1[3] = 255;
+			if (Format == 13)
+			{
+				int a0 = v[6], a1 = v[7];
+				BitTransferSigned(a0, a1);
+				a1 = Clamp255(a0 + a1);
+				E0[3] = Swap ? a1 : a0;
+				E1[3] = Swap ? a0 : a1;
+			}
+		}
+		break;
+
+	default:
+		// HDR formats: 2, 3, 7, 11, 14, 15
+		return false;
+	}
+	return true;
+}
+
+static void FillBlock(byte *Dst, int Pitch, int Width, int Height, const byte *Color)
+{
+	uint32 c;
+	memcpy(&c, Color, 4);
+	for (int y = 0; y < Height; y++, Dst += Pitch)
+	{
+		uint32 *d = (uint32*)Dst;
+		for (int x = 0; x < Width; x++)
+			d[x] = c;
+	}
+}
+
+// Decode a single block, Width and Height are number of visible texels (block could be clipped
+// by the image border)
+static void DecodeBlock(const CASTCBlockContext &Ctx, const byte *Block, byte *Dst, int Pitch, int Width, int Height, bool IsNormalmap)
+{
+	// Color of invalid block or texel, reference decoder uses it for NaN values
+	static const byte ErrorColor[4] = { 0xFF, 0x00, 0xFF, 0xFF };
+
+	uint64 Bits[2];
+	memcpy(Bits, Block, 16);
+
+	byte Color[4];
+	int i;
+
+	int BlockMode = ReadBits(Bits, 0, 11);
+	if ((BlockMode & 0x1FF) == 0x1FC)
+	{
+		// void-extent block: constant color
+		int LowS  = ReadBits(Bits, 12, 13);
+		int HighS = ReadBits(Bits, 25, 13);
+		int LowT  = ReadBits(Bits, 38, 13);
+		int HighT = ReadBits(Bits, 51, 13);
+		bool AllOnes = (LowS & HighS & LowT & HighT) == 0x1FFF;
+		if ((BlockMode & 0x200) ||					// HDR
+			ReadBits(Bits, 10, 2) != 3 ||
+			((LowS >= HighS || LowT >= HighT) && !AllOnes))
+		{
+			memcpy(Color, ErrorColor, 4);
+		}
+		else
+		{
+			for (i = 0; i < 4; i++)
+				Color[i] = Unorm16ToByte[(Bits[1] >> (i * 16)) & 0xFFFF];
+		}
+		if (IsNormalmap) Color[2] = NormalZ[Color[0] * 256 + Color[1]];
+		FillBlock(Dst, Pitch, Width, Height, Color);
+		return;
+	}
+
+	const CASTCBlockMode &Mode = Ctx.Modes[BlockMode];
+	int PartitionCount = ReadBits(Bits, 11, 2) + 1;
+	if (!Mode.XWeights || (Mode.DualPlane && PartitionCount == 4))
+		goto error;
+
+	{
+		// color endpoint formats
+		int BelowWeightsPos = 128 - Mode.WeightBits;
+		int HighPartSize = 0;
+		int Formats[4];
+		int Seed = 0;
+		if (PartitionCount == 1)
+		{
+			Formats[0] = ReadBits(Bits, 13, 4);
+		}
+		else
+		{
+			HighPartSize = 3 * PartitionCount - 4;
+			BelowWeightsPos -= HighPartSize;
+			int Encoded = ReadBits(Bits, 23, 6) | (ReadBits(Bits, BelowWeightsPos, HighPartSize) << 6);
+			int BaseClass = Encoded & 3;
+			if (BaseClass == 0)
+			{
+				// all partitions use the same format
+				for (i = 0; i < PartitionCount; i++)
+					Formats[i] = (Encoded >> 2) & 0xF;
+				BelowWeightsPos += HighPartSize;
+				HighPartSize = 0;
+			}
+			else
+			{
+				int BitPos = 2;
+				BaseClass--;
+				for (i = 0; i < PartitionCount; i++, BitPos++)
+					Formats[i] = (((Encoded >> BitPos) & 1) + BaseClass) << 2;
+				for (i = 0; i < PartitionCount; i++, BitPos += 2)
+					Formats[i] |= (Encoded >> BitPos) & 3;
+			}
+			Seed = ReadBits(Bits, 13, 10);
+		}
+
+		int NumColorValues = 0;
+		for (i = 0; i < PartitionCount; i++)
+			NumColorValues += ((Formats[i] >> 2) + 1) * 2;
+		if (NumColorValues > 18)
+			goto error;
+
+		static const int ColorBitsAvailable[5] = { 0, 111, 99, 99, 99 };
+		int ColorBits = ColorBitsAvailable[PartitionCount] - Mode.WeightBits - HighPartSize;
+		if (Mode.DualPlane) ColorBits -= 2;
+		if (ColorBits < 0) ColorBits = 0;
+		int ColorLevel = ColorQuantLevel[NumColorValues >> 1][ColorBits];
+		if (ColorLevel < 4)
+			goto error;
+
+		// endpoints
+		byte RawColors[20];
+		DecodeIntegerSequence(Bits, (PartitionCount == 1) ? 17 : 29, NumColorValues, ColorLevel, RawColors);
+		int Endpoints[4][2][4];			// [Partition][Endpoint][Component], expanded to 16 bits
+		bool PartitionValid[4];
+		const byte *pRaw = RawColors;
+		for (i = 0; i < PartitionCount; i++)
+		{
+			int Values[8];
+			int NumValues = ((Formats[i] >> 2) + 1) * 2;
+			for (int j = 0; j < NumValues; j++)
+				Values[j] = ColorUnquantize[ColorLevel][*pRaw++];
+			int *E0 = Endpoints[i][0], *E1 = Endpoints[i][1];
+			PartitionValid[i] = UnpackEndpoints(Formats[i], Values, E0, E1);
+			for (int j = 0; j < 4; j++)
+			{
+				E0[j] *= 257;
+				E1[j] *= 257;
+			}
+		}
+
+		// weights are stored in reversed bit order from the end of the block
+		uint64 RevBits[2];
+		RevBits[0] = ReverseBits64(Bits[1]);
+		RevBits[1] = ReverseBits64(Bits[0]);
+		int WeightCount = Mode.XWeights * Mode.YWeights;
+		byte RawWeights[ASTC_MAX_WEIGHTS + 4];
+		byte Weights1[ASTC_MAX_WEIGHTS], Weights2[ASTC_MAX_WEIGHTS];
+		const byte *Unquantize = WeightUnquantize[Mode.QuantLevel];
+		int Plane2Component = -1;
+		if (Mode.DualPlane)
+		{
+			DecodeIntegerSequence(RevBits, 0, WeightCount * 2, Mode.QuantLevel, RawWeights);
+			for (i = 0; i < WeightCount; i++)
+			{
+				Weights1[i] = Unquantize[RawWeights[i * 2]];
+				Weights2[i] = Unquantize[RawWeights[i * 2 + 1]];
+			}
+			Plane2Component = ReadBits(Bits, BelowWeightsPos - 2, 2);
+		}
+		else
+		{
+			DecodeIntegerSequence(RevBits, 0, WeightCount, Mode.QuantLevel, RawWeights);
+			for (i = 0; i < WeightCount; i++)
+				Weights1[i] = Unquantize[RawWeights[i]];
+		}
+
+		// texels
+		const CASTCTexelWeights *Infill = Ctx.Infill[Mode.YWeights][Mode.XWeights];
+		const byte *PartitionOf = (PartitionCount > 1)
+			? Ctx.Partitions + ((PartitionCount - 2) * ASTC_NUM_SEEDS + Seed) * Ctx.BlockSizeX * Ctx.BlockSizeY
+			: NULL;
+		for (int y = 0; y < Height; y++, Dst += Pitch)
+		{
+			byte *d = Dst;
+			int Texel = y * Ctx.BlockSizeX;
+			for (int x = 0; x < Width; x++, Texel++, d += 4)
+			{
+				int Part = PartitionOf ? PartitionOf[Texel] : 0;
+				if (!PartitionValid[Part])
+				{
+					memcpy(d, ErrorColor, 4);
+				}
+				else
+				{
+					const CASTCTexelWeights &W = Infill[Texel];
+					int w1 = (8 + Weights1[W.Index[0]] * W.Factor[0] + Weights1[W.Index[1]] * W.Factor[1]
+						+ Weights1[W.Index[2]] * W.Factor[2] + Weights1[W.Index[3]] * W.Factor[3]) >> 4;
+					int w2 = w1;
+					if (Plane2Component >= 0)
+					{
+						w2 = (8 + Weights2[W.Index[0]] * W.Factor[0] + Weights2[W.Index[1]] * W.Factor[1]
+							+ Weights2[W.Index[2]] * W.Factor[2] + Weights2[W.Index[3]] * W.Factor[3]) >> 4;
+					}
+					const int *E0 = Endpoints[Part][0], *E1 = Endpoints[Part][1];
+					for (int c = 0; c < 4; c++)
+					{
+						int w = (c == Plane2Component) ? w2 : w1;
+						d[c] = Unorm16ToByte[(E0[c] * (64 - w) + E1[c] * w + 32) >> 6];
+					}
+				}
+				if (IsNormalmap) d[2] = NormalZ[d[0] * 256 + d[1]];
+			}
+		}
+		return;
+	}
+
+error:
+	memcpy(Color, ErrorColor, 4);
+	if (IsNormalmap) Color[2] = NormalZ[Color[0] * 256 + Color[1]];
+	FillBlock(Dst, Pitch, Width, Height, Color);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Texture decoding
+-----------------------------------------------------------------------------*/
+
+struct CASTCDecodeContext
+{
+	const CASTCBlockContext *Block;
+	const byte	*Data;
+	byte		*Dst;
+	int			USize;
+	int			VSize;
+	int			XBlocks;
+	bool		IsNormalmap;
+};
+
+static void DecodeASTCRow(int BlockY, CASTCDecodeContext &Ctx)
+{
+	guard(DecodeASTCRow);
+
+	const CASTCBlockContext &Block = *Ctx.Block;
+	int BlockSizeX = Block.BlockSizeX;
+	int BlockSizeY = Block.BlockSizeY;
+	int Pitch  = Ctx.USize * 4;
+	int Height = min(BlockSizeY, Ctx.VSize - BlockY * BlockSizeY);
+	const byte *Src = Ctx.Data + BlockY * Ctx.XBlocks * 16;
+	byte *Dst = Ctx.Dst + BlockY * BlockSizeY * Pitch;
+	for (int BlockX = 0; BlockX < Ctx.XBlocks; BlockX++, Src += 16, Dst += BlockSizeX * 4)
+	{
+		int Width = min(BlockSizeX, Ctx.USize - BlockX * BlockSizeX);
+		DecodeBlock(Block, Src, Dst, Pitch, Width, Height, Ctx.IsNormalmap);
+	}
+
+	unguard;
+}
+
+void DecodeASTC(const byte *Data, int USize, int VSize, int BlockSizeX, int BlockSizeY, bool IsNormalmap, byte *Dst)
+{
+	guard(DecodeASTC);
+
+	assert(BlockSizeX >= 4 && BlockSizeX <= ASTC_MAX_BLOCK_SIZE && BlockSizeY >= 4 && BlockSizeY <= ASTC_MAX_BLOCK_SIZE);
+
+	CASTCDecodeContext Ctx;
+	Ctx.Block       = GetBlockContext(BlockSizeX, BlockSizeY);
+	Ctx.Data        = Data;
+	Ctx.Dst         = Dst;
+	Ctx.USize       = USize;
+	Ctx.VSize       = VSize;
+	Ctx.XBlocks     = (USize + BlockSizeX - 1) / BlockSizeX;
+	Ctx.IsNormalmap = IsNormalmap;
+	int YBlocks = (VSize + BlockSizeY - 1) / BlockSizeY;
+
+	if (Ctx.XBlocks * YBlocks >= ASTC_PARALLEL_BLOCKS)
+	{
+		appParallelFor(YBlocks, DecodeASTCRow, Ctx);
+	}
+	else
+	{
+		for (int BlockY = 0; BlockY < YBlocks; BlockY++)
+			DecodeASTCRow(BlockY, Ctx);
+	}
+
+	unguard;
+}
+
+
+#endif // SUPPORT_ANDROID
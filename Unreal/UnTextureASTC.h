@@ -0,0 +1,15 @@
+#ifndef __UNTEXTURE_ASTC_H__
+#define __UNTEXTURE_ASTC_H__
+
+/*-----------------------------------------------------------------------------
+	ASTC texture decoder
+-----------------------------------------------------------------------------*/
+
+// Decode 2D ASTC texture in LDR mode to RGBA8 image. Blocks are decoded with integer math
+// and produce the same result as ARM reference decoder. Invalid and HDR blocks are decoded
+// as magenta color. When IsNormalmap is set, blue channel is reconstructed from red and green
+// ones (UE4 drops it for normal maps before encoding).
+void DecodeASTC(const byte *Data, int USize, int VSize, int BlockSizeX, int BlockSizeY, bool IsNormalmap, byte *Dst);
+
+
+#endif // __UNTEXTURE_ASTC_H__
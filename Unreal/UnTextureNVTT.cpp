@@ -120,6 +120,6 @@ void DecodeDDS(const unsigned char* Data, int USize, int VSize, nv::DDSHeader& h
 void WriteDDSHeader(unsigned char* Data, nv::DDSHeader& header)
 {
 	uint8 dummy[128];
-	NVTTStream stream(Data, 128, dummy, sizeof(dummy), false);
+	NVTTStream stream(Data, header.hasDX10Header() ? 148 : 128, dummy, sizeof(dummy), false);
 	stream << header;
 }
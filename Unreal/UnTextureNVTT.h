@@ -3,4 +3,5 @@
 #undef __FUNC__						// conflicted with our guard macros
 
 void DecodeDDS(const unsigned char* Data, int USize, int VSize, nv::DDSHeader& header, nv::Image& image);
+// Data should have space for 128 bytes, or 148 bytes when header has DX10 extension
 void WriteDDSHeader(unsigned char* Data, nv::DDSHeader& header);